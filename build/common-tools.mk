@@ -20,6 +20,7 @@ CURL = curl
 CRC = crc32
 XXD = xxd
 SERIAL_SWITCHER = $(COMMON_BUILD)/serial_switcher.py
+LOG_DECODER = $(COMMON_BUILD)/../scripts/logdecode.py
 
 crc32_path := $(shell which $(CRC))
 ifeq ("$(crc32_path)", "")
@@ -100,6 +100,7 @@ elf: $(TARGET_BASE).elf
 bin: $(TARGET_BASE).bin
 hex: $(TARGET_BASE).hex
 lst: $(TARGET_BASE).lst
+logfmt: $(TARGET_BASE).logfmt.json
 exe: $(TARGET_BASE)$(EXECUTABLE_EXTENSION)
 	@echo Built x-compile executable at $(TARGET_BASE)$(EXECUTABLE_EXTENSION)
 none:
@@ -170,6 +171,13 @@ size: $(TARGET_BASE).elf
 	$(call,echo,'Finished building: $@')
 	$(call,echo,)
 
+# extract the string table used to decode binary log output
+%.logfmt.json: %.elf
+	$(call,echo,'Invoking: Log Format String Extractor')
+	$(VERBOSE)python3 $(LOG_DECODER) extract $< -o $@
+	$(call,echo,'Finished building: $@')
+	$(call,echo,)
+
 # Create a hex file from ELF file
 %.hex : %.elf
 	$(call,echo,'Invoking: ARM GNU Create Flash Image')
@@ -303,7 +311,7 @@ clean: clean_deps
 	$(VERBOSE)$(RMDIR) $(BUILD_PATH)
 	$(call,echo,)
 
-.PHONY: all prebuild postbuild none elf bin hex size program-dfu program-cloud st-flash program-serial
+.PHONY: all prebuild postbuild none elf bin hex logfmt size program-dfu program-cloud st-flash program-serial
 .SECONDARY:
 
 # Disable implicit builtin rules
@@ -21,6 +21,7 @@
 #include "service_debug.h"
 #include "coap.h"
 #include <algorithm>
+#include <new>
 
 namespace particle { namespace protocol {
 
@@ -98,6 +99,10 @@ ProtocolError ChunkedTransfer::handle_update_begin(
             // know the correct size of the bitmap.
             set_chunks_received(flags & 1 ? 0 : 0xFF);
 
+            // fall back to writing each chunk synchronously if there's not enough RAM for the window
+            if (OTA_CHUNK_WINDOW_SIZE && !alloc_window())
+                WARN("chunk window not available");
+
             // send update_reaady - use fast OTA if available
             size_t size = Messages::update_ready(updateReady.buf(), 0, token, (flags & 0x1), channel.is_unreliable());
             updateReady.set_length(size);
@@ -184,13 +189,12 @@ ProtocolError ChunkedTransfer::handle_chunk(token_t token, Message& message,
                 crc_valid, fast_ota, updating);
         if (crc_valid)
         {
-            callbacks->save_firmware_chunk(file, chunk, NULL);
+            store_chunk(chunk_index, chunk, file.chunk_size);
             if (!fast_ota)
             {
                 // message is confirmable for regular OTA or when
                 response_size = Messages::chunk_received(response.buf(), 0, token, ChunkReceivedCode::OK, channel.is_unreliable());
             }
-            flag_chunk_received(chunk_index);
             chunk_index++;
         }
         else
@@ -253,6 +257,8 @@ ProtocolError ChunkedTransfer::handle_update_done(token_t token, Message& messag
     Message response;
 
     DEBUG("update done received");
+    // all received chunks need to be in flash before the update can be validated
+    flush_buffered_chunks();
     chunk_index_t index = next_chunk_missing(0);
     bool missing = index != NO_CHUNKS_MISSING;
     uint8_t* queue = message.buf();
@@ -335,8 +341,9 @@ ProtocolError ChunkedTransfer::send_missing_chunks(MessageChannel& channel,
 
 ProtocolError ChunkedTransfer::idle(MessageChannel& channel)
 {
-    /* Timeout to resend missing chunks removed.
-     * Leaving idle() here in case we need to add something in the future. */
+    // write one chunk at a time so that incoming messages are not delayed for long
+    if (window_count)
+        write_buffered_chunk();
     return NO_ERROR;
 }
 
@@ -346,6 +353,7 @@ void ChunkedTransfer::cancel()
     {
         // was updating but had an error, inform the client
         WARN("handle received message failed - aborting transfer");
+        free_window();
         callbacks->finish_firmware_update(file, 0, NULL);
     }
 }
@@ -353,19 +361,24 @@ void ChunkedTransfer::cancel()
 
 chunk_index_t ChunkedTransfer::next_chunk_missing(chunk_index_t start)
 {
-    chunk_index_t chunk = NO_CHUNKS_MISSING;
-    chunk_index_t chunks = file.chunk_count(chunk_size);
-    chunk_index_t idx = start;
-    for (; idx < chunks; idx++)
+    const unsigned chunks = file.chunk_count(chunk_size);
+    unsigned idx = start;
+    while (idx < chunks)
     {
+        // skip over bytes of the bitmap in which all chunks are received
+        if (!(idx & 7) && chunk_bitmap()[idx >> 3] == 0xFF)
+        {
+            idx += 8;
+            continue;
+        }
         if (!is_chunk_received(idx))
         {
             //serial_dump("next missing chunk %d from %d", idx, start);
-            chunk = idx;
-            break;
+            return idx;
         }
+        idx++;
     }
-    return chunk;
+    return NO_CHUNKS_MISSING;
 }
 
 void ChunkedTransfer::set_chunks_received(uint8_t value)
@@ -375,5 +388,67 @@ void ChunkedTransfer::set_chunks_received(uint8_t value)
         memset(bitmap, value, bytes);
 }
 
+void ChunkedTransfer::store_chunk(chunk_index_t idx, const uint8_t* chunk, uint16_t size)
+{
+    flag_chunk_received(idx);
+    if (!window_capacity || size > chunk_size)
+    {
+        save_chunk(idx, chunk, size);
+        return;
+    }
+    if (window_count == window_capacity)
+    {
+        // the window is full, make room by writing the oldest chunk
+        write_buffered_chunk();
+    }
+    const unsigned slot = (window_head + window_count) % window_capacity;
+    memcpy(window + slot * chunk_size, chunk, size);
+    window_chunks[slot].index = idx;
+    window_chunks[slot].size = size;
+    window_count++;
+}
+
+bool ChunkedTransfer::save_chunk(chunk_index_t idx, const uint8_t* chunk, uint16_t size)
+{
+    file.chunk_size = size;
+    file.chunk_address = file.file_address + (idx * chunk_size);
+    if (callbacks->save_firmware_chunk(file, chunk, NULL))
+    {
+        WARN("failed to save chunk %d", idx);
+        flag_chunk_missing(idx);
+        return false;
+    }
+    return true;
+}
+
+void ChunkedTransfer::write_buffered_chunk()
+{
+    const BufferedChunk& c = window_chunks[window_head];
+    save_chunk(c.index, window + window_head * chunk_size, c.size);
+    window_head = (window_head + 1) % window_capacity;
+    window_count--;
+}
+
+bool ChunkedTransfer::alloc_window()
+{
+    free_window();
+    if (!OTA_CHUNK_WINDOW_SIZE || !chunk_size)
+        return false;
+    window = new(std::nothrow) uint8_t[OTA_CHUNK_WINDOW_SIZE * chunk_size];
+    if (!window)
+        return false;
+    window_capacity = OTA_CHUNK_WINDOW_SIZE;
+    return true;
+}
+
+void ChunkedTransfer::free_window()
+{
+    delete[] window;
+    window = nullptr;
+    window_head = 0;
+    window_count = 0;
+    window_capacity = 0;
+}
+
 
 }}
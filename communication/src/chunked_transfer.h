@@ -90,6 +90,22 @@ private:
 	bool fast_ota_override;
 	bool fast_ota_value;
 
+	struct BufferedChunk
+	{
+		chunk_index_t index;
+		uint16_t size;
+	};
+
+	/**
+	 * Chunks that passed the CRC check but are not yet written to flash. Flash writes are
+	 * deferred to idle() so that they don't hold up the reception of subsequent chunks.
+	 */
+	uint8_t* window;
+	BufferedChunk window_chunks[OTA_CHUNK_WINDOW_SIZE ? OTA_CHUNK_WINDOW_SIZE : 1];
+	uint8_t window_head;
+	uint8_t window_count;
+	uint8_t window_capacity;
+
 protected:
 
 	unsigned chunk_bitmap_size()
@@ -108,6 +124,11 @@ protected:
 		chunk_bitmap()[idx >> 3] |= uint8_t(1 << (idx & 7));
 	}
 
+	inline void flag_chunk_missing(chunk_index_t idx)
+	{
+		chunk_bitmap()[idx >> 3] &= ~uint8_t(1 << (idx & 7));
+	}
+
 	inline bool is_chunk_received(chunk_index_t idx)
 	{
 		return (chunk_bitmap()[idx >> 3] & uint8_t(1 << (idx & 7)));
@@ -115,11 +136,45 @@ protected:
 
 	chunk_index_t next_chunk_missing(chunk_index_t start);
 	void set_chunks_received(uint8_t value);
+
+	/**
+	 * Buffers a verified chunk in the window, or writes it to flash directly if the window
+	 * is not available. The chunk is flagged as received.
+	 */
+	void store_chunk(chunk_index_t idx, const uint8_t* chunk, uint16_t size);
+
+	/**
+	 * Writes a chunk to flash. If the write fails, the chunk is flagged as missing so that
+	 * it's requested again.
+	 */
+	bool save_chunk(chunk_index_t idx, const uint8_t* chunk, uint16_t size);
+
+	/**
+	 * Writes the oldest buffered chunk to flash.
+	 */
+	void write_buffered_chunk();
+
+	void flush_buffered_chunks()
+	{
+		while (window_count)
+		{
+			write_buffered_chunk();
+		}
+	}
+
+	bool alloc_window();
+	void free_window();
 public:
 
 	ChunkedTransfer() :
-			updating(false), callbacks(nullptr), fast_ota_override(false), fast_ota_value(true)
+			updating(false), callbacks(nullptr), fast_ota_override(false), fast_ota_value(true),
+			window(nullptr), window_head(0), window_count(0), window_capacity(0)
+	{
+	}
+
+	~ChunkedTransfer()
 	{
+		free_window();
 	}
 
 	void init(Callbacks* callbacks)
@@ -159,6 +214,12 @@ public:
 	{
 		updating = false;
 		last_chunk_millis = 0;    // this is used for the time latency also
+		free_window();
+	}
+
+	size_t buffered_chunks() const
+	{
+		return window_count;
 	}
 
 	void cancel();
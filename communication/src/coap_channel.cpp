@@ -22,6 +22,8 @@
 #include "messages.h"
 #include "communication_diagnostic.h"
 
+#include <new>
+
 namespace particle { namespace protocol {
 
 uint16_t CoAPMessage::message_count = 0;
@@ -54,31 +56,136 @@ void CoAPMessageStore::message_timeout(CoAPMessage& msg, Channel& channel)
 		channel.command(MessageChannel::CLOSE);
 }
 
+bool CoAPMessageStore::index_grow()
+{
+	const uint16_t capacity = index_capacity ? index_capacity * 2 : MIN_INDEX_CAPACITY;
+	CoAPMessage** table = new(std::nothrow) CoAPMessage*[capacity];
+	if (!table)
+		return false;
+	memset(table, 0, capacity * sizeof(CoAPMessage*));
+	CoAPMessage** old = index;
+	const uint16_t old_capacity = index_capacity;
+	index = table;
+	index_capacity = capacity;
+	for (unsigned i = 0; i < old_capacity; ++i)
+	{
+		CoAPMessage* msg = old[i];
+		if (msg)
+		{
+			unsigned j = index_slot(msg->get_id());
+			while (index[j])
+				j = (j + 1) & (index_capacity - 1);
+			index[j] = msg;
+		}
+	}
+	delete[] old;
+	return true;
+}
+
+bool CoAPMessageStore::index_add(CoAPMessage& message)
+{
+	// Keep the load factor below 1/2 so that probe sequences stay short
+	if ((count + 1) * 2 > index_capacity && !index_grow())
+		return false;
+	unsigned i = index_slot(message.get_id());
+	while (index[i])
+		i = (i + 1) & (index_capacity - 1);
+	index[i] = &message;
+	++count;
+	return true;
+}
+
+void CoAPMessageStore::index_remove(unsigned pos)
+{
+	// Backward shift deletion: move subsequent entries of the probe sequence
+	// into the vacated slot, so that lookups never need tombstones
+	const unsigned mask = index_capacity - 1;
+	unsigned hole = pos;
+	unsigned i = (pos + 1) & mask;
+	while (index[i])
+	{
+		const unsigned home = index_slot(index[i]->get_id());
+		// Move the entry if its home slot is not within (hole, i]
+		if (((i - home) & mask) >= ((i - hole) & mask))
+		{
+			index[hole] = index[i];
+			hole = i;
+		}
+		i = (i + 1) & mask;
+	}
+	index[hole] = nullptr;
+	--count;
+}
+
+void CoAPMessageStore::wheel_add(CoAPMessage& message)
+{
+	// Messages that are already due are placed in the current slot,
+	// otherwise they would only be seen once the wheel wraps around
+	const system_tick_t t = time_has_passed(wheel_time, message.get_timeout()) ? wheel_time : message.get_timeout();
+	message.slot = wheel_slot(t);
+	CoAPMessage*& head = wheel[message.slot];
+	message.prev = nullptr;
+	message.next = head;
+	if (head)
+		head->prev = &message;
+	head = &message;
+}
+
+void CoAPMessageStore::wheel_remove(CoAPMessage& message)
+{
+	if (message.prev)
+		message.prev->next = message.next;
+	else
+		wheel[message.slot] = message.next;
+	if (message.next)
+		message.next->prev = message.prev;
+	message.removed();
+}
+
 /**
  * Process existing messages, resending any unacknowledged requests to the given channel.
  */
 void CoAPMessageStore::process(system_tick_t time, Channel& channel)
 {
-	CoAPMessage* msg = head;
-	CoAPMessage* prev = nullptr;
-	while (msg!=nullptr)
+	const system_tick_t now = time - (time % WHEEL_TICK);
+	if (count)
 	{
-		if (time_has_passed(time, msg->get_timeout()) && !retransmit(msg, channel, time))
+		unsigned slots = (now - wheel_time) / WHEEL_TICK + 1;
+		if (slots > WHEEL_SLOTS)
+			slots = WHEEL_SLOTS;
+		for (unsigned i = 0; i < slots; ++i)
 		{
-			remove(msg, prev);
-			message_timeout(*msg, channel);
-			delete msg;
-			msg = (prev==nullptr) ? head : prev->get_next();
-		}
-		else
-		{
-			prev = msg;
-			msg = msg->get_next();
+			const unsigned slot = wheel_slot(wheel_time + i * WHEEL_TICK);
+			CoAPMessage* msg = wheel[slot];
+			while (msg!=nullptr)
+			{
+				CoAPMessage* next = msg->next;
+				if (time_has_passed(time, msg->get_timeout()))
+				{
+					wheel_remove(*msg);
+					if (retransmit(msg, channel, time))
+					{
+						wheel_add(*msg);
+					}
+					else
+					{
+						// The message is already unlinked from the wheel, only remove it from the index
+						const int pos = index_of(msg->get_id());
+						if (pos >= 0)
+							index_remove(pos);
+						message_timeout(*msg, channel);
+						delete msg;
+						// the channel may have modified the store when notified of the timeout
+						next = wheel[slot];
+					}
+				}
+				msg = next;
+			}
 		}
 	}
+	wheel_time = now;
 }
 
-
 /**
  * Registers that this message has been sent from the application.
  * Confirmable messages, and ack/reset responses are cached.
@@ -100,7 +207,12 @@ ProtocolError CoAPMessageStore::send(Message& msg, system_tick_t time)
 			coapmsg->prepare_retransmit(time);
 		else
 			coapmsg->set_expiration(time+CoAPMessage::MAX_TRANSMIT_SPAN);
-		add(*coapmsg);
+		const ProtocolError error = add(*coapmsg);
+		if (error)
+		{
+			delete coapmsg;
+			return error;
+		}
 	}
 	return NO_ERROR;
 }
@@ -151,7 +263,12 @@ ProtocolError CoAPMessageStore::receive(Message& msg, Channel& channel, system_t
 			// the timeout here is ideally purely academic since the application will respond immediately with an ACK/RESET
 			// which will be stored in place of this message, with it's own timeout.
 			coapmsg->set_expiration(time+CoAPMessage::MAX_TRANSMIT_SPAN);
-			add(*coapmsg);
+			const ProtocolError error = add(*coapmsg);
+			if (error)
+			{
+				delete coapmsg;
+				return error;
+			}
 		}
 	}
 	// else it's a NON message - pass through
@@ -160,8 +277,9 @@ ProtocolError CoAPMessageStore::receive(Message& msg, Channel& channel, system_t
 
 bool CoAPMessageStore::has_unacknowledged_requests() const
 {
-	for (const CoAPMessage* msg = head; msg != nullptr; msg = msg->get_next()) {
-		if (is_confirmable((uint8_t*)msg->get_data()))
+	for (unsigned i = 0; i < index_capacity; ++i) {
+		const CoAPMessage* msg = index[i];
+		if (msg && is_confirmable((uint8_t*)msg->get_data()))
 			return true;
 	}
 
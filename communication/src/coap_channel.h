@@ -99,11 +99,16 @@ public:
 
 private:
 	/**
-	 * Messages are stored as a singly-linked list.
+	 * Messages awaiting the same timer wheel slot are stored as a doubly-linked list.
 	 * This pointer is the next message in the list, or nullptr if this is the last message in the list.
 	 */
 	CoAPMessage* next;
 
+	/**
+	 * The previous message in the timer wheel slot, or nullptr if this is the first message in the list.
+	 */
+	CoAPMessage* prev;
+
 	/**
 	 * The time when the system will resend this message or give up sending
 	 * when the maximum number of transmits has been reached.
@@ -121,8 +126,11 @@ private:
 	 */
 	uint8_t transmit_count;
 
-	// padding
-	// uint8_t reserved;
+	/**
+	 * The slot of the message store's timer wheel this message is linked into.
+	 */
+	uint8_t slot;
+
 	std::function<void(Delivery)>* delivered;
 
 
@@ -162,7 +170,7 @@ public:
 	static const uint8_t NSTART = 1;
 
 
-	CoAPMessage(message_id_t id_) : next(nullptr), timeout(0), id(id_), transmit_count(0), delivered(nullptr), data_len(0) {
+	CoAPMessage(message_id_t id_) : next(nullptr), prev(nullptr), timeout(0), id(id_), transmit_count(0), slot(0), delivered(nullptr), data_len(0) {
 		message_count++;
 	}
 
@@ -191,10 +199,9 @@ public:
 	static uint16_t messages() { return message_count; }
 
 	inline CoAPMessage* get_next() const { return next; }
-	inline void set_next(CoAPMessage* next) { this->next = next; }
 	inline bool matches(message_id_t id) const { return this->id==id; }
 	inline message_id_t get_id() const { return id; }
-	inline void removed() { next = nullptr; }
+	inline void removed() { next = nullptr; prev = nullptr; }
 	inline system_tick_t get_timeout() const { return timeout; }
 
 	inline void set_delivered_handler(std::function<void(Delivery)>* handler) { this->delivered = handler; }
@@ -274,6 +281,7 @@ public:
     		}
     }
 
+	friend class CoAPMessageStore;
 };
 
 inline bool time_has_passed(system_tick_t now, system_tick_t tick)
@@ -293,59 +301,100 @@ inline bool time_has_passed(system_tick_t now, system_tick_t tick)
 
 /**
  * A mix-in class that provides message resending for reliable delivery of messages.
+ *
+ * Messages are indexed by their ID in an open-addressing hash table, so that acknowledgements
+ * are matched in constant time. Retransmission deadlines are tracked with a hashed timer wheel:
+ * each message is linked into the slot of its timeout, and process() only visits the slots whose
+ * time has come.
  */
 class CoAPMessageStore
 {
 	LOG_CATEGORY("comm.coap");
 
+public:
+	/**
+	 * The number of slots in the timer wheel. Must be a power of 2.
+	 */
+	static const unsigned WHEEL_SLOTS = 32;
+
+	/**
+	 * The time span covered by a single slot of the timer wheel, in milliseconds.
+	 */
+	static const system_tick_t WHEEL_TICK = 128;
+
+	/**
+	 * The initial capacity of the message index. Must be a power of 2.
+	 */
+	static const uint16_t MIN_INDEX_CAPACITY = 8;
+
+private:
+	/**
+	 * The index of messages, keyed by message ID. Collisions are resolved using linear probing.
+	 */
+	CoAPMessage** index;
+	uint16_t index_capacity;
+	uint16_t count;
+
 	/**
-	 * The head of the list of messages.
+	 * The timer wheel. Each slot is the head of a list of messages that time out in that slot.
 	 */
-	CoAPMessage* head;
+	CoAPMessage* wheel[WHEEL_SLOTS];
 
 	/**
-	 * Retrieves the message with the given ID and the previous message.
-	 * If no message exists with the given id, nullptr is returned.
+	 * The start time of the earliest slot that has not been fully processed.
 	 */
-	CoAPMessage* for_id(message_id_t id, CoAPMessage*& prev) const
+	system_tick_t wheel_time;
+
+	static unsigned wheel_slot(system_tick_t time)
 	{
-		prev = nullptr;
-		CoAPMessage* next = head;
-		while (next)
-		{
-			if (next->matches(id))
-				return next;
-			prev = next;
-			next = next->get_next();
-		}
-		return nullptr;
+		return (time / WHEEL_TICK) & (WHEEL_SLOTS - 1);
+	}
+
+	unsigned index_slot(message_id_t id) const
+	{
+		// Message IDs are mostly sequential, so they distribute evenly without further hashing
+		return id & (index_capacity - 1);
 	}
 
 	/**
-	 * Removes a message given the message to remove and the previous entry in the list.
+	 * Retrieves the position of the message with the given ID in the index,
+	 * or -1 if no such message exists.
 	 */
-	void remove(CoAPMessage* message, CoAPMessage* previous)
+	int index_of(message_id_t id) const
 	{
-		if (previous)
-			previous->set_next(message->get_next());
-		else
-			head = message->get_next();
-		message->removed();
+		if (!count)
+			return -1;
+		unsigned i = index_slot(id);
+		while (index[i])
+		{
+			if (index[i]->matches(id))
+				return i;
+			i = (i + 1) & (index_capacity - 1);
+		}
+		return -1;
 	}
 
+	bool index_add(CoAPMessage& message);
+	void index_remove(unsigned pos);
+	bool index_grow();
+
+	void wheel_add(CoAPMessage& message);
+	void wheel_remove(CoAPMessage& message);
+
 	void message_timeout(CoAPMessage& msg, Channel& channel);
 
 public:
 
-	CoAPMessageStore() : head(nullptr) {}
+	CoAPMessageStore() : index(nullptr), index_capacity(0), count(0), wheel{}, wheel_time(0) {}
 
 	~CoAPMessageStore() {
 		clear();
+		delete[] index;
 	}
 
 	bool has_messages() const
 	{
-		return head!=nullptr;
+		return count!=0;
 	}
 
 	bool has_unacknowledged_requests() const;
@@ -357,9 +406,8 @@ public:
 	 */
 	CoAPMessage* from_id(message_id_t id) const
 	{
-		CoAPMessage* prev;
-		CoAPMessage* next = for_id(id, prev);
-		return next;
+		const int pos = index_of(id);
+		return (pos >= 0) ? index[pos] : nullptr;
 	}
 
 	ProtocolError add(CoAPMessage* message)
@@ -377,10 +425,11 @@ public:
 			return NO_ERROR;
 
 		clear_message(message.get_id());
-		if (message.get_next())
+		if (message.next || message.prev)
 			return INVALID_STATE;
-		message.set_next(head);
-		head = &message;
+		if (!index_add(message))
+			return INSUFFICIENT_STORAGE;
+		wheel_add(message);
 		return NO_ERROR;
 	}
 
@@ -391,11 +440,12 @@ public:
 	 */
 	CoAPMessage* remove(message_id_t msg_id)
 	{
-		CoAPMessage* prev;
-		CoAPMessage* msg = for_id(msg_id, prev);
-		if (msg) {
-			remove(msg, prev);
-		}
+		const int pos = index_of(msg_id);
+		if (pos < 0)
+			return nullptr;
+		CoAPMessage* msg = index[pos];
+		index_remove(pos);
+		wheel_remove(*msg);
 		return msg;
 	}
 
@@ -497,9 +547,16 @@ public:
 	 */
 	void clear()
 	{
-		while (head!=nullptr)
+		for (unsigned i = 0; i < index_capacity && count; ++i)
 		{
-			delete remove(head->get_id());
+			CoAPMessage* msg = index[i];
+			if (msg)
+			{
+				index[i] = nullptr;
+				--count;
+				wheel_remove(*msg);
+				delete msg;
+			}
 		}
 	}
 
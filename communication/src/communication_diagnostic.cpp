@@ -2,3 +2,5 @@
 
 particle::SimpleIntegerDiagnosticData g_rateLimitedEventsCounter(DIAG_ID_CLOUD_RATE_LIMITED_EVENTS, DIAG_NAME_CLOUD_RATE_LIMITED_EVENTS);
 particle::SimpleIntegerDiagnosticData g_unacknowledgedMessageCounter(DIAG_ID_CLOUD_UNACKNOWLEDGED_MESSAGES, DIAG_NAME_CLOUD_UNACKNOWLEDGED_MESSAGES);
+particle::SimpleIntegerDiagnosticData g_publishQueueDepth(DIAG_ID_CLOUD_PUBLISH_QUEUE_DEPTH, DIAG_NAME_CLOUD_PUBLISH_QUEUE_DEPTH);
+particle::SimpleIntegerDiagnosticData g_droppedEventsCounter(DIAG_ID_CLOUD_DROPPED_EVENTS, DIAG_NAME_CLOUD_DROPPED_EVENTS);
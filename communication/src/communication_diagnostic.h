@@ -2,3 +2,5 @@
 
 extern particle::SimpleIntegerDiagnosticData g_rateLimitedEventsCounter;
 extern particle::SimpleIntegerDiagnosticData g_unacknowledgedMessageCounter;
+extern particle::SimpleIntegerDiagnosticData g_publishQueueDepth;
+extern particle::SimpleIntegerDiagnosticData g_droppedEventsCounter;
@@ -735,6 +735,7 @@ bool CoreProtocol::add_event_handler(const char *event_name, EventHandler handle
         memcpy(event_handlers[i].device_id, id, id_len);
         event_handlers[i].device_id[id_len] = 0;
         event_handlers[i].scope = scope;
+        event_handlers[i].flags = 0;
       return true;
     }
   }
@@ -235,7 +235,24 @@ ProtocolError DTLSMessageChannel::init(
  */
 inline int DTLSMessageChannel::send(const uint8_t* data, size_t len)
 {
-	if (move_session && len && data[0]==23)
+	if (move_session && len && data[0]==23 && callbacks.send_vector)
+	{
+		// send the amended record straight from the DTLS buffer
+		const uint8_t type = 254;					// move session record type
+		const uint8_t id_len = DEVICE_ID_LEN;
+		const SparkIoVector vec[] = {
+			{ &type, 1 },
+			{ data+1, len-1 },						// original application data
+			{ device_id, DEVICE_ID_LEN },			// the device ID
+			{ &id_len, 1 }							// the device ID length as the last byte in the packet
+		};
+		int result = callbacks.send_vector(vec, sizeof(vec)/sizeof(vec[0]), callbacks.tx_context);
+		// hide the increased length from DTLS
+		if (result==int(len+DEVICE_ID_LEN+1))
+			result = len;
+		return result;
+	}
+	else if (move_session && len && data[0]==23)
 	{
 		// buffer for a new packet that contains the device ID length and a byte for the length appended to the existing data.
 		uint8_t d[len+DEVICE_ID_LEN+1];
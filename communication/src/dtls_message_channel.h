@@ -26,6 +26,7 @@
 #include "device_keys.h"
 #include "message_channel.h"
 #include "buffer_message_channel.h"
+#include "spark_protocol_functions.h"
 
 #include "mbedtls/ssl.h"
 #include "mbedtls/ssl_internal.h"
@@ -66,6 +67,7 @@ public:
 		void (*handle_seed)(const uint8_t* seed, size_t length);
 		int (*send)(const unsigned char *buf, uint32_t buflen, void* handle);
 		int (*receive)(unsigned char *buf, uint32_t buflen, void* handle);
+		int (*send_vector)(const SparkIoVector* vec, size_t count, void* handle);
 
 		// persistence
 		/**
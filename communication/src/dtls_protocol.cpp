@@ -25,6 +25,9 @@ void DTLSProtocol::init(const char *id,
 		channelCallbacks.save = callbacks.save;
 		channelCallbacks.restore = callbacks.restore;
 	}
+	if (callbacks.size>=56) {
+		channelCallbacks.send_vector = callbacks.send_vector;
+	}
 
 	channel.set_millis(callbacks.millis);
 
@@ -81,8 +81,11 @@ public:
 			result = wait_confirmable();
 			break;
 		case ProtocolCommands::DISCONNECT:
+			// Send the batched events before the session is closed
+			publisher.flush(channel);
 			result = wait_confirmable();
 			ack_handlers.clear();
+			publisher.clear();
 			break;
 		case ProtocolCommands::WAKE:
 			wake();
@@ -90,6 +93,7 @@ public:
 			break;
 		case ProtocolCommands::TERMINATE:
 			ack_handlers.clear();
+			publisher.clear();
 			result = NO_ERROR;
 			break;
 		case ProtocolCommands::FORCE_PING: {
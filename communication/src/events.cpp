@@ -24,6 +24,21 @@
   */
 #include "events.h"
 #include <string.h>
+#include <stddef.h>
+#include <atomic>
+#include <new>
+
+namespace {
+
+// Reference-counted buffer holding the name and data of a retained event
+struct EventViewBuffer
+{
+  std::atomic<int> refs;
+  EventView view;
+  char bytes[1];
+};
+
+} // namespace
 
 // Private, used by two subscription variants below
 uint8_t *subscription_prelude(uint8_t buf[], uint16_t message_id,
@@ -106,3 +121,46 @@ size_t event_name_uri_path(uint8_t buf[], const char *name, size_t name_len)
     return name_len + 2;
   }
 }
+
+EventView *event_view_retain(EventView *view)
+{
+  EventViewBuffer *buf = (EventViewBuffer*)view->owner;
+  if (NULL == buf)
+  {
+    // The name and data are copied once per event, regardless of the number of handlers
+    buf = (EventViewBuffer*)malloc(offsetof(EventViewBuffer, bytes) + view->name_length + view->data_length);
+    if (NULL == buf)
+    {
+      return NULL;
+    }
+    new(&buf->refs) std::atomic<int>(1); // Held by the original view
+    char *p = buf->bytes;
+    memcpy(p, view->name, view->name_length);
+    buf->view.name = p;
+    buf->view.name_length = view->name_length;
+    p += view->name_length;
+    if (view->data)
+    {
+      memcpy(p, view->data, view->data_length);
+      buf->view.data = p;
+    }
+    else
+    {
+      buf->view.data = NULL;
+    }
+    buf->view.data_length = view->data_length;
+    buf->view.owner = buf;
+    *view = buf->view;
+  }
+  buf->refs.fetch_add(1, std::memory_order_relaxed);
+  return &buf->view;
+}
+
+void event_view_release(EventView *view)
+{
+  EventViewBuffer *buf = (EventViewBuffer*)view->owner;
+  if (NULL != buf && buf->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+  {
+    free(buf);
+  }
+}
@@ -72,8 +72,33 @@ namespace SubscriptionScope {
   };
 }
 
+namespace EventHandlerFlag {
+  enum Enum {
+    /**
+     * The handler is an EventViewHandler and receives the event as a view of the message buffer.
+     */
+    VIEW = 0x01
+  };
+}
+
+/**
+ * A view of a received event. The name and data are not NUL-terminated.
+ *
+ * The view passed to a handler refers to the message buffer and is only valid for the duration
+ * of the call, unless it is retained with event_view_retain().
+ */
+struct EventView
+{
+  const char *name;
+  size_t name_length;
+  const char *data; // NULL if the event has no data
+  size_t data_length;
+  void *owner; // Reference-counted buffer holding the name and data, or NULL
+};
+
 typedef void (*EventHandler)(const char *event_name, const char *data);
 typedef void (*EventHandlerWithData)(void *handler_data, const char *event_name, const char *data);
+typedef void (*EventViewHandler)(void *handler_data, const EventView *event);
 
 /**
  *  This is used in a callback so only change by adding fields to the end
@@ -85,6 +110,7 @@ struct FilteringEventHandler
   void *handler_data;
   SubscriptionScope::Enum scope;
   char device_id[13];
+  uint8_t flags; // EventHandlerFlag
 };
 
 
@@ -96,4 +122,16 @@ size_t subscription(uint8_t buf[], uint16_t message_id,
 
 size_t event_name_uri_path(uint8_t buf[], const char *name, size_t name_len);
 
+/**
+ * Returns a view of the event that remains valid until it is released with event_view_release(),
+ * or NULL if there is not enough memory.
+ *
+ * If the view refers to the message buffer, the name and data are moved to a reference-counted
+ * buffer first and the view is updated to refer to that buffer, so that all handlers of the event
+ * share a single copy. The owner of such a view must release it as well.
+ */
+EventView *event_view_retain(EventView *view);
+
+void event_view_release(EventView *view);
+
 #endif // __EVENTS_H
@@ -27,11 +27,17 @@ int LightSSLProtocol::command(ProtocolCommands::Enum command, uint32_t data)
   int result = UNKNOWN;
   switch (command) {
   case ProtocolCommands::SLEEP:
+    result = this->wait_confirmable();
+    break;
   case ProtocolCommands::DISCONNECT:
+    // Send the batched events before the session is closed
+    publisher.flush(channel);
     result = this->wait_confirmable();
+    publisher.clear();
     break;
   case ProtocolCommands::TERMINATE:
     ack_handlers.clear();
+    publisher.clear();
     result = NO_ERROR;
     break;
   }
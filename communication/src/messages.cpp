@@ -356,6 +356,50 @@ size_t Messages::event(uint8_t buf[], uint16_t message_id, const char *event_nam
   return p - buf;
 }
 
+size_t Messages::event_batch(uint8_t buf[], uint16_t message_id, const uint8_t* records,
+             size_t records_size, bool confirmable)
+{
+  uint8_t *p = buf;
+  *p++ = confirmable ? 0x40 : 0x50; // non-confirmable /confirmable, no token
+  *p++ = 0x02; // code 0.02 POST request
+  *p++ = message_id >> 8;
+  *p++ = message_id & 0xff;
+  *p++ = 0xb1; // one-byte Uri-Path option
+  *p++ = 'B';
+
+  if (records_size)
+  {
+    *p++ = 0xff;
+    memcpy(p, records, records_size);
+    p += records_size;
+  }
+
+  return p - buf;
+}
+
+size_t Messages::event_batch_record(uint8_t buf[], const char *event_name, const char *data,
+             int ttl, EventType::Enum event_type)
+{
+  const size_t name_len = strnlen(event_name, MAX_EVENT_NAME_LENGTH);
+  const size_t data_len = data ? strnlen(data, MAX_EVENT_DATA_LENGTH) : 0;
+  const size_t size = 7 + name_len + data_len;
+  if (buf)
+  {
+    uint8_t *p = buf;
+    *p++ = event_type;
+    *p++ = (ttl >> 16) & 0xff;
+    *p++ = (ttl >> 8) & 0xff;
+    *p++ = ttl & 0xff;
+    *p++ = name_len;
+    memcpy(p, event_name, name_len);
+    p += name_len;
+    *p++ = (data_len >> 8) & 0xff;
+    *p++ = data_len & 0xff;
+    memcpy(p, data, data_len);
+  }
+  return size;
+}
+
 size_t Messages::coded_ack(uint8_t* buf, uint8_t token, uint8_t code,
                            uint8_t message_id_msb, uint8_t message_id_lsb,
                            uint8_t* data, size_t data_len)
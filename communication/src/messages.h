@@ -89,6 +89,21 @@ public:
 	static size_t event(uint8_t buf[], uint16_t message_id, const char *event_name,
 	             const char *data, int ttl, EventType::Enum event_type, bool confirmable);
 
+	/**
+	 * Encodes a message carrying several events. The payload is a sequence of records
+	 * produced by {@code event_batch_record()}.
+	 */
+	static size_t event_batch(uint8_t buf[], uint16_t message_id, const uint8_t* records,
+	             size_t records_size, bool confirmable);
+
+	/**
+	 * Encodes a single event of a batched event message. Each record consists of the event type (1 byte),
+	 * TTL (3 bytes), name length (1 byte), name, data length (2 bytes) and data. Multi-byte fields
+	 * are big-endian. If {@code buf} is null, only the size of the record is computed.
+	 */
+	static size_t event_batch_record(uint8_t buf[], const char *event_name, const char *data,
+	             int ttl, EventType::Enum event_type);
+
 
     static inline size_t empty_ack(unsigned char *buf,
                           unsigned char message_id_msb,
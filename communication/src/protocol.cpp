@@ -290,6 +290,8 @@ int Protocol::begin()
 
 	// FIXME: Pending completion handlers should be cancelled at the end of a previous session
 	ack_handlers.clear();
+	// Events queued or batched during a previous session are not sent to the new one
+	publisher.clear();
 	last_ack_handlers_update = callbacks.millis();
 
 	uint32_t channel_flags = 0;
@@ -222,7 +222,10 @@ protected:
 		}
 		else
 		{
-			ProtocolError error = pinger.process(
+			ProtocolError error = publisher.process(channel, callbacks.millis());
+			if (error)
+				return error;
+			error = pinger.process(
 					callbacks.millis() - last_message_millis, [this]
 					{	return ping();});
 			if (error)
@@ -327,6 +330,49 @@ public:
 		chunkedTransfer.set_fast_ota(data);
 	}
 
+	/**
+	 * Configures the rate limit for application or system events.
+	 * @param burst		The number of events that can be published back to back.
+	 * @param period	The number of milliseconds after which one more event is allowed.
+	 */
+	void set_publish_rate_limit(bool system_events, unsigned burst, system_tick_t period)
+	{
+		publisher.set_rate_limit(system_events, burst, period);
+	}
+
+	/**
+	 * Changes the number of events that can be published back to back, keeping the refill period.
+	 */
+	void set_publish_rate_burst(bool system_events, unsigned burst)
+	{
+		publisher.set_rate_limit(system_events, burst, publisher.rate_limit_period(system_events));
+	}
+
+	/**
+	 * Changes the refill period of the rate limit, keeping the burst size.
+	 */
+	void set_publish_rate_period(bool system_events, system_tick_t period)
+	{
+		publisher.set_rate_limit(system_events, publisher.rate_limit_burst(system_events), period);
+	}
+
+	/**
+	 * Sets the maximum number of rate-limited events queued for sending.
+	 */
+	void set_max_pending_events(size_t count)
+	{
+		publisher.set_max_pending_events(count);
+	}
+
+	/**
+	 * Sets the window during which application events are batched into a single message.
+	 * Batching is disabled if the window is 0.
+	 */
+	void set_publish_batch_window(system_tick_t window)
+	{
+		publisher.set_batch_window(window);
+	}
+
 	void set_handlers(CommunicationsHandlers& handlers)
 	{
 		copy_and_init(&this->handlers, sizeof(this->handlers), &handlers, handlers.size);
@@ -392,7 +438,8 @@ public:
 	 */
 	ProtocolError post_description(int desc_flags);
 
-	// Returns true on success, false on sending timeout or rate-limiting failure
+	// Returns true on success, false on sending timeout or rate-limiting failure. Rate-limited
+	// events are queued by the publisher and the handler is invoked once they are sent
 	bool send_event(const char *event_name, const char *data, int ttl,
 			EventType::Enum event_type, int flags, CompletionHandler handler)
 	{
@@ -438,10 +485,10 @@ public:
 
 	inline bool add_event_handler(const char *event_name, EventHandler handler,
 			void *handler_data, SubscriptionScope::Enum scope,
-			const char* device_id)
+			const char* device_id, uint8_t flags = 0)
 	{
 		return !subscriptions.add_event_handler(event_name, handler,
-				handler_data, scope, device_id);
+				handler_data, scope, device_id, flags);
 	}
 
 	inline bool send_subscriptions()
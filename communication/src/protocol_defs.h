@@ -64,6 +64,12 @@ const chunk_index_t NO_CHUNKS_MISSING = 65535;
 const chunk_index_t MAX_CHUNKS        = 65535;
 const size_t MISSED_CHUNKS_TO_SEND    = 40u;
 const size_t MINIMUM_CHUNK_INCREASE   = 2u;
+// Number of verified firmware chunks buffered in RAM until they are written to flash
+#if PLATFORM_ID<2
+const size_t OTA_CHUNK_WINDOW_SIZE    = 0u;
+#else
+const size_t OTA_CHUNK_WINDOW_SIZE    = 4u;
+#endif
 const size_t MAX_EVENT_TTL_SECONDS    = 16777215;
 const size_t MAX_OPTION_DELTA_LENGTH  = 12;
 #if PLATFORM_ID<2
@@ -83,6 +89,18 @@ const size_t MAX_OPTION_DELTA_LENGTH  = 12;
 // Timeout in milliseconds given to receive an acknowledgement for a published event
 const unsigned SEND_EVENT_ACK_TIMEOUT = 20000;
 
+// Default publish rate limits. Application events are allowed in bursts of 4 and refilled at
+// one event per second, system events in bursts of 255 refilled at roughly 255 events per minute.
+// Note that the sliding window used previously let applications publish 4 events per second
+// indefinitely, as long as none of the events was rate limited
+const unsigned PUBLISH_APP_EVENT_BURST = 4;
+const system_tick_t PUBLISH_APP_EVENT_PERIOD = 1000;
+const unsigned PUBLISH_SYSTEM_EVENT_BURST = 255;
+const system_tick_t PUBLISH_SYSTEM_EVENT_PERIOD = 256;
+
+// Maximum number of rate-limited events held by the publisher until tokens become available
+const size_t PUBLISH_MAX_PENDING_EVENTS = 8;
+
 #ifndef PROTOCOL_BUFFER_SIZE
     #if PLATFORM_ID<2
         #define PROTOCOL_BUFFER_SIZE 640
@@ -91,6 +109,10 @@ const unsigned SEND_EVENT_ACK_TIMEOUT = 20000;
     #endif
 #endif
 
+// Maximum size of the records of a batched event message. Leaves room for the CoAP header
+// and the message channel's own framing within the protocol buffer
+const size_t EVENT_BATCH_MAX_SIZE = PROTOCOL_BUFFER_SIZE - 128;
+
 
 namespace ChunkReceivedCode {
   enum Enum {
@@ -112,7 +134,11 @@ namespace Connection
 enum Enum
 {
     PING = 0,
-    FAST_OTA = 1
+    FAST_OTA = 1,
+    MAX_PENDING_EVENTS = 2, // Maximum number of rate-limited events queued for sending
+    PUBLISH_BATCH_WINDOW = 3, // Application event batching window in milliseconds, 0 disables batching
+    PUBLISH_RATE_BURST = 4, // Number of application events that can be published back to back
+    PUBLISH_RATE_PERIOD = 5 // Number of milliseconds after which one more application event is allowed
 };
 }
 
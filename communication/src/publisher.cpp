@@ -19,6 +19,255 @@
 
 #include "protocol.h"
 
-void particle::protocol::Publisher::add_ack_handler(message_id_t msg_id, CompletionHandler handler) {
-    protocol->add_ack_handler(msg_id, std::move(handler), SEND_EVENT_ACK_TIMEOUT);
+#include <new>
+
+namespace particle { namespace protocol {
+
+ProtocolError Publisher::send_event(MessageChannel& channel, const char* event_name,
+		const char* data, int ttl, EventType::Enum event_type, int flags,
+		system_tick_t time, CompletionHandler handler)
+{
+	const bool is_system_event = is_system(event_name);
+	// Events of the same class are sent in the order they were published, so a new event
+	// has to wait if older events are still queued
+	if (!has_pending(is_system_event) && !is_rate_limited(is_system_event, time)) {
+		return dispatch(channel, event_name, data, ttl, event_type, flags, is_system_event, time,
+				std::move(handler));
+	}
+	g_rateLimitedEventsCounter++;
+	return enqueue(event_name, data, ttl, event_type, flags, is_system_event, std::move(handler));
+}
+
+ProtocolError Publisher::process(MessageChannel& channel, system_tick_t time)
+{
+	int i = 0;
+	while (i < pending.size()) {
+		if (!bucket(pending.at(i).is_system_event).take(time)) {
+			++i;
+			continue;
+		}
+		PendingEvent event = pending.takeAt(i);
+		g_publishQueueDepth = pending.size();
+		const ProtocolError error = dispatch(channel, event.name, event.data, event.ttl,
+				event.event_type, event.flags, event.is_system_event, time, std::move(event.handler));
+		if (error != NO_ERROR) {
+			return error;
+		}
+	}
+	if (!batch_events.isEmpty() && time - batch_start >= batch_window) {
+		return flush(channel);
+	}
+	return NO_ERROR;
+}
+
+ProtocolError Publisher::flush(MessageChannel& channel)
+{
+	if (batch_events.isEmpty()) {
+		return NO_ERROR;
+	}
+	spark::Vector<BatchedEvent> events(std::move(batch_events));
+	const bool with_ack = batch_with_ack;
+	Message message;
+	channel.create(message);
+	const bool confirmable = with_ack || (channel.is_unreliable() && !batch_no_ack);
+	ProtocolError result = NO_ERROR;
+	if (message.capacity() < batch.size() + 16) {
+		result = INSUFFICIENT_STORAGE;
+	} else {
+		const size_t msglen = Messages::event_batch(message.buf(), 0, batch.data(), batch.size(),
+				confirmable);
+		message.set_length(msglen);
+		result = channel.send(message);
+	}
+	batch.clear();
+	batch_with_ack = false;
+	batch_no_ack = true;
+	if (result != NO_ERROR) {
+		for (BatchedEvent& event: events) {
+			event.handler.setError(toSystemError(result));
+		}
+		return result;
+	}
+	// Handlers of the events that requested an acknowledgement are invoked once the whole
+	// message is acknowledged
+	spark::Vector<CompletionHandler>* ack_handlers = nullptr;
+	if (with_ack && message.has_id()) {
+		ack_handlers = new(std::nothrow) spark::Vector<CompletionHandler>();
+	}
+	for (BatchedEvent& event: events) {
+		if (event.with_ack && ack_handlers) {
+			if (ack_handlers->append(std::move(event.handler))) {
+				continue;
+			}
+		}
+		event.handler.setResult();
+	}
+	if (ack_handlers) {
+		add_ack_handler(message.get_id(), CompletionHandler(batch_ack_callback, ack_handlers));
+	}
+	return NO_ERROR;
+}
+
+void Publisher::clear()
+{
+	for (PendingEvent& event: pending) {
+		event.handler.setError(SYSTEM_ERROR_ABORTED);
+	}
+	pending.clear();
+	g_publishQueueDepth = 0;
+	for (BatchedEvent& event: batch_events) {
+		event.handler.setError(SYSTEM_ERROR_ABORTED);
+	}
+	batch_events.clear();
+	batch.clear();
+	batch_with_ack = false;
+	batch_no_ack = true;
+}
+
+bool Publisher::has_pending(bool is_system_event) const
+{
+	for (const PendingEvent& event: pending) {
+		if (event.is_system_event == is_system_event) {
+			return true;
+		}
+	}
+	return false;
+}
+
+ProtocolError Publisher::enqueue(const char* event_name, const char* data, int ttl,
+		EventType::Enum event_type, int flags, bool is_system_event,
+		CompletionHandler handler)
+{
+	// Coalesce with a queued event of the same name, the most recent data wins
+	for (PendingEvent& event: pending) {
+		if (!strncmp(event.name, event_name, MAX_EVENT_NAME_LENGTH)) {
+			CString d(data);
+			if (data && !d) {
+				handler.setError(SYSTEM_ERROR_NO_MEMORY);
+				return INSUFFICIENT_STORAGE;
+			}
+			event.data = std::move(d);
+			event.ttl = ttl;
+			event.event_type = event_type;
+			event.flags = flags;
+			event.handler.setError(SYSTEM_ERROR_CANCELLED);
+			event.handler = std::move(handler);
+			g_droppedEventsCounter++;
+			return NO_ERROR;
+		}
+	}
+	if ((size_t)pending.size() >= max_pending) {
+		g_droppedEventsCounter++;
+		handler.setError(SYSTEM_ERROR_LIMIT_EXCEEDED);
+		return BANDWIDTH_EXCEEDED;
+	}
+	PendingEvent event = { CString(event_name), CString(data), ttl, event_type, flags,
+			is_system_event, std::move(handler) };
+	if (!event.name || (data && !event.data) || !pending.reserve(pending.size() + 1)) {
+		g_droppedEventsCounter++;
+		event.handler.setError(SYSTEM_ERROR_NO_MEMORY);
+		return INSUFFICIENT_STORAGE;
+	}
+	pending.append(std::move(event));
+	g_publishQueueDepth = pending.size();
+	return NO_ERROR;
 }
+
+ProtocolError Publisher::dispatch(MessageChannel& channel, const char* event_name,
+		const char* data, int ttl, EventType::Enum event_type, int flags,
+		bool is_system_event, system_tick_t time, CompletionHandler handler)
+{
+	// System events are never delayed by batching
+	if (batch_window && !is_system_event) {
+		return add_to_batch(channel, event_name, data, ttl, event_type, flags, time,
+				std::move(handler));
+	}
+	return send_now(channel, event_name, data, ttl, event_type, flags, std::move(handler));
+}
+
+ProtocolError Publisher::add_to_batch(MessageChannel& channel, const char* event_name,
+		const char* data, int ttl, EventType::Enum event_type, int flags,
+		system_tick_t time, CompletionHandler handler)
+{
+	const size_t size = Messages::event_batch_record(nullptr, event_name, data, ttl, event_type);
+	if (!batch_events.isEmpty() && batch.size() + size > EVENT_BATCH_MAX_SIZE) {
+		const ProtocolError error = flush(channel);
+		if (error != NO_ERROR) {
+			handler.setError(toSystemError(error));
+			return error;
+		}
+	}
+	if (size > EVENT_BATCH_MAX_SIZE || !batch.reserve(EVENT_BATCH_MAX_SIZE) ||
+			!batch_events.reserve(batch_events.size() + 1)) {
+		// The event doesn't fit into a batch, or there's not enough memory
+		const ProtocolError error = flush(channel);
+		if (error != NO_ERROR) {
+			handler.setError(toSystemError(error));
+			return error;
+		}
+		return send_now(channel, event_name, data, ttl, event_type, flags, std::move(handler));
+	}
+	if (batch_events.isEmpty()) {
+		batch_start = time;
+	}
+	const int offs = batch.size();
+	batch.resize(offs + size);
+	Messages::event_batch_record(batch.data() + offs, event_name, data, ttl, event_type);
+	const bool with_ack = flags & EventType::WITH_ACK;
+	if (with_ack) {
+		batch_with_ack = true;
+	}
+	if (!(flags & EventType::NO_ACK)) {
+		batch_no_ack = false;
+	}
+	batch_events.append({ std::move(handler), with_ack });
+	return NO_ERROR;
+}
+
+ProtocolError Publisher::send_now(MessageChannel& channel, const char* event_name,
+		const char* data, int ttl, EventType::Enum event_type, int flags,
+		CompletionHandler handler)
+{
+	Message message;
+	channel.create(message);
+	bool confirmable = channel.is_unreliable();
+	if (flags & EventType::NO_ACK) {
+		confirmable = false;
+	} else if (flags & EventType::WITH_ACK) {
+		confirmable = true;
+	}
+	size_t msglen = Messages::event(message.buf(), 0, event_name, data, ttl,
+			event_type, confirmable);
+	message.set_length(msglen);
+	const ProtocolError result = channel.send(message);
+	if (result == NO_ERROR) {
+		// Register completion handler only if acknowledgement was requested explicitly
+		if ((flags & EventType::WITH_ACK) && message.has_id()) {
+			add_ack_handler(message.get_id(), std::move(handler));
+		} else {
+			handler.setResult();
+		}
+	} else {
+		handler.setError(toSystemError(result));
+	}
+	return result;
+}
+
+void Publisher::add_ack_handler(message_id_t msg_id, CompletionHandler handler) {
+	protocol->add_ack_handler(msg_id, std::move(handler), SEND_EVENT_ACK_TIMEOUT);
+}
+
+void Publisher::batch_ack_callback(int error, const void* data, void* callback_data, void* reserved)
+{
+	const auto handlers = static_cast<spark::Vector<CompletionHandler>*>(callback_data);
+	for (CompletionHandler& handler: *handlers) {
+		if (error != SYSTEM_ERROR_NONE) {
+			handler.setError(error);
+		} else {
+			handler.setResult();
+		}
+	}
+	delete handlers;
+}
+
+}} // namespace particle::protocol
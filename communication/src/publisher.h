@@ -23,9 +23,12 @@
 #include "events.h"
 #include "message_channel.h"
 #include "messages.h"
+#include "token_bucket.h"
 
 #include "completion_handler.h"
 #include "communication_diagnostic.h"
+#include "c_string.h"
+#include "spark_wiring_vector.h"
 
 namespace particle
 {
@@ -34,11 +37,29 @@ namespace protocol
 
 class Protocol;
 
+/**
+ * Sends events to the cloud.
+ *
+ * Each event class (application and system events) is rate limited by its own token bucket.
+ * Events that exceed the rate are held in a bounded queue and sent by process() as soon as tokens
+ * become available. Repeated publishes of an event that is still queued are coalesced, so that
+ * only the most recent data is sent.
+ *
+ * Optionally, application events sent within a configurable window are packed into a single
+ * batched message, which saves the per-message overhead of CoAP and DTLS on constrained links.
+ */
 class Publisher
 {
 public:
 	explicit Publisher(Protocol* protocol) :
-			protocol(protocol)
+			protocol(protocol),
+			app_bucket(PUBLISH_APP_EVENT_BURST, PUBLISH_APP_EVENT_PERIOD),
+			system_bucket(PUBLISH_SYSTEM_EVENT_BURST, PUBLISH_SYSTEM_EVENT_PERIOD),
+			max_pending(PUBLISH_MAX_PENDING_EVENTS),
+			batch_window(0),
+			batch_start(0),
+			batch_with_ack(false),
+			batch_no_ack(true)
 	{
 	}
 
@@ -47,84 +68,138 @@ public:
 		return !strncmp(event_name, "spark", 5) || !strncmp(event_name, "particle", 8);
 	}
 
+	/**
+	 * Takes a token from the bucket of the given event class.
+	 * Returns {@code true} if the bucket is empty and the event should not be sent now.
+	 */
 	bool is_rate_limited(bool is_system_event, system_tick_t millis)
 	{
-		if (is_system_event)
-		{
-			static uint16_t lastMinute = 0;
-			static uint8_t eventsThisMinute = 0;
-
-			uint16_t currentMinute = uint16_t(millis >> 16);
-			if (currentMinute == lastMinute)
-			{      // == handles millis() overflow
-				if (eventsThisMinute == 255)
-					return true;
-			}
-			else
-			{
-				lastMinute = currentMinute;
-				eventsThisMinute = 0;
-			}
-			eventsThisMinute++;
-		}
-		else
-		{
-			static system_tick_t recent_event_ticks[5] =
-			{ (system_tick_t) -1000, (system_tick_t) -1000,
-					(system_tick_t) -1000, (system_tick_t) -1000,
-					(system_tick_t) -1000 };
-			static int evt_tick_idx = 0;
-
-			system_tick_t now = recent_event_ticks[evt_tick_idx] = millis;
-			evt_tick_idx++;
-			evt_tick_idx %= 5;
-			if (now - recent_event_ticks[evt_tick_idx] < 1000)
-			{
-				// exceeded allowable burst of 4 events per second
-				return true;
-			}
-		}
-		return false;
+		return !bucket(is_system_event).take(millis);
 	}
 
-	ProtocolError send_event(MessageChannel& channel, const char* event_name,
-			const char* data, int ttl, EventType::Enum event_type, int flags,
-			system_tick_t time, CompletionHandler handler)
+	/**
+	 * Configures the rate limit of an event class.
+	 * @param burst		The number of events that can be sent back to back.
+	 * @param period	The number of milliseconds after which one more event is allowed.
+	 */
+	void set_rate_limit(bool is_system_event, unsigned burst, system_tick_t period)
+	{
+		bucket(is_system_event).configure(burst, period);
+	}
+
+	unsigned rate_limit_burst(bool is_system_event)
+	{
+		return bucket(is_system_event).capacity();
+	}
+
+	system_tick_t rate_limit_period(bool is_system_event)
+	{
+		return bucket(is_system_event).period();
+	}
+
+	/**
+	 * Sets the maximum number of rate-limited events held in the queue. Setting
+	 * the limit to 0 makes the publisher reject rate-limited events immediately.
+	 */
+	void set_max_pending_events(size_t count)
+	{
+		max_pending = count;
+	}
+
+	size_t pending_events() const
+	{
+		return pending.size();
+	}
+
+	/**
+	 * Sets the number of milliseconds during which application events are collected
+	 * into a single message. Setting the window to 0 disables batching.
+	 */
+	void set_batch_window(system_tick_t window)
+	{
+		batch_window = window;
+	}
+
+	size_t batched_events() const
 	{
-		bool is_system_event = is_system(event_name);
-		bool rate_limited = is_rate_limited(is_system_event, time);
-		if (rate_limited) {
-			g_rateLimitedEventsCounter++;
-			return BANDWIDTH_EXCEEDED;
-		}
-
-		Message message;
-		channel.create(message);
-		bool confirmable = channel.is_unreliable();
-		if (flags & EventType::NO_ACK) {
-			confirmable = false;
-		} else if (flags & EventType::WITH_ACK) {
-			confirmable = true;
-		}
-		size_t msglen = Messages::event(message.buf(), 0, event_name, data, ttl,
-				event_type, confirmable);
-		message.set_length(msglen);
-		const ProtocolError result = channel.send(message);
-		if (result == NO_ERROR) {
-			// Register completion handler only if acknowledgement was requested explicitly
-			if ((flags & EventType::WITH_ACK) && message.has_id()) {
-			    add_ack_handler(message.get_id(), std::move(handler));
-			} else {
-			    handler.setResult();
-			}
-		}
-		return result;
+		return batch_events.size();
 	}
 
+	ProtocolError send_event(MessageChannel& channel, const char* event_name,
+			const char* data, int ttl, EventType::Enum event_type, int flags,
+			system_tick_t time, CompletionHandler handler);
+
+	/**
+	 * Sends queued events for which tokens have become available.
+	 */
+	ProtocolError process(MessageChannel& channel, system_tick_t time);
+
+	/**
+	 * Sends the batched events right away.
+	 */
+	ProtocolError flush(MessageChannel& channel);
+
+	/**
+	 * Cancels all queued and batched events.
+	 */
+	void clear();
+
 private:
+	struct PendingEvent
+	{
+		CString name;
+		CString data;
+		int ttl;
+		EventType::Enum event_type;
+		int flags;
+		bool is_system_event;
+		CompletionHandler handler;
+	};
+
+	struct BatchedEvent
+	{
+		CompletionHandler handler;
+		bool with_ack;
+	};
+
 	Protocol* protocol;
+	TokenBucket app_bucket;
+	TokenBucket system_bucket;
+	spark::Vector<PendingEvent> pending;
+	size_t max_pending;
+	spark::Vector<uint8_t> batch;
+	spark::Vector<BatchedEvent> batch_events;
+	system_tick_t batch_window;
+	system_tick_t batch_start;
+	bool batch_with_ack;
+	bool batch_no_ack;
+
+	TokenBucket& bucket(bool is_system_event)
+	{
+		return is_system_event ? system_bucket : app_bucket;
+	}
+
+	bool has_pending(bool is_system_event) const;
+
+	ProtocolError enqueue(const char* event_name, const char* data, int ttl,
+			EventType::Enum event_type, int flags, bool is_system_event,
+			CompletionHandler handler);
+
+	ProtocolError dispatch(MessageChannel& channel, const char* event_name,
+			const char* data, int ttl, EventType::Enum event_type, int flags,
+			bool is_system_event, system_tick_t time, CompletionHandler handler);
+
+	ProtocolError add_to_batch(MessageChannel& channel, const char* event_name,
+			const char* data, int ttl, EventType::Enum event_type, int flags,
+			system_tick_t time, CompletionHandler handler);
+
+	ProtocolError send_now(MessageChannel& channel, const char* event_name,
+			const char* data, int ttl, EventType::Enum event_type, int flags,
+			CompletionHandler handler);
 
 	void add_ack_handler(message_id_t msg_id, CompletionHandler handler);
+
+	static void batch_ack_callback(int error, const void* data, void* callback_data, void* reserved);
 };
 
 }}
@@ -156,6 +156,12 @@ bool spark_protocol_add_event_handler(ProtocolFacade* protocol, const char *even
     return protocol->add_event_handler(event_name, handler, handler_data, scope, device_id);
 }
 
+bool spark_protocol_add_event_view_handler(ProtocolFacade* protocol, const char *event_name,
+    EventViewHandler handler, SubscriptionScope::Enum scope, const char* device_id, void* handler_data, void* reserved) {
+    ASSERT_ON_SYSTEM_OR_MAIN_THREAD();
+    return protocol->add_event_handler(event_name, (EventHandler)handler, handler_data, scope, device_id, EventHandlerFlag::VIEW);
+}
+
 bool spark_protocol_send_time_request(ProtocolFacade* protocol, void* reserved) {
     ASSERT_ON_SYSTEM_THREAD();
     (void)reserved;
@@ -200,6 +206,21 @@ int spark_protocol_set_connection_property(ProtocolFacade* protocol, unsigned pr
     } else if (property_id == particle::protocol::Connection::FAST_OTA)
     {
         protocol->set_fast_ota(data);
+    } else if (property_id == particle::protocol::Connection::MAX_PENDING_EVENTS)
+    {
+        protocol->set_max_pending_events(data);
+    } else if (property_id == particle::protocol::Connection::PUBLISH_BATCH_WINDOW)
+    {
+        protocol->set_publish_batch_window(data);
+    } else if (property_id == particle::protocol::Connection::PUBLISH_RATE_BURST)
+    {
+        if (data == 0) {
+            return SYSTEM_ERROR_INVALID_ARGUMENT; // Would block all application events
+        }
+        protocol->set_publish_rate_burst(false /* system_events */, data);
+    } else if (property_id == particle::protocol::Connection::PUBLISH_RATE_PERIOD)
+    {
+        protocol->set_publish_rate_period(false /* system_events */, data);
     }
     return 0;
 }
@@ -308,6 +329,11 @@ bool spark_protocol_add_event_handler(CoreProtocol* protocol, const char *event_
     return protocol->add_event_handler(event_name, handler, handler_data, scope, device_id);
 }
 
+bool spark_protocol_add_event_view_handler(CoreProtocol* protocol, const char *event_name,
+    EventViewHandler handler, SubscriptionScope::Enum scope, const char* device_id, void* handler_data, void* reserved) {
+    return false; // Not supported by the legacy protocol
+}
+
 bool spark_protocol_send_time_request(CoreProtocol* protocol, void* reserved) {
     ASSERT_ON_SYSTEM_THREAD();
     (void)reserved;
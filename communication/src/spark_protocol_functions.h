@@ -48,6 +48,15 @@ struct SparkKeys
 
 PARTICLE_STATIC_ASSERT(SparkKeys_size, sizeof(SparkKeys)==16 || sizeof(void*)!=4);
 
+/**
+ * A buffer passed to the scatter-gather send callback.
+ */
+struct SparkIoVector
+{
+    const void* data;
+    size_t size;
+};
+
 enum ProtocolFactory
 {
 	PROTOCOL_NONE,
@@ -117,9 +126,17 @@ struct SparkCallbacks
 	int (*restore)(void* data, size_t max_length, uint8_t type, void* reserved);
 
 	// size == 52
+
+	/**
+	 * Sends the contents of multiple buffers as a single datagram. Optional, the protocol
+	 * falls back to send() if not set.
+	 */
+	int (*send_vector)(const SparkIoVector* vec, size_t count, void* handle);
+
+	// size == 56
 };
 
-PARTICLE_STATIC_ASSERT(SparkCallbacks_size, sizeof(SparkCallbacks)==(sizeof(void*)*13));
+PARTICLE_STATIC_ASSERT(SparkCallbacks_size, sizeof(SparkCallbacks)==(sizeof(void*)*14));
 
 /**
  * Application-supplied callbacks. (Deliberately distinct from the system-supplied
@@ -174,6 +191,11 @@ bool spark_protocol_send_event(ProtocolFacade* protocol, const char *event_name,
 bool spark_protocol_send_subscription_device(ProtocolFacade* protocol, const char *event_name, const char *device_id, void* reserved=NULL);
 bool spark_protocol_send_subscription_scope(ProtocolFacade* protocol, const char *event_name, SubscriptionScope::Enum scope, void* reserved=NULL);
 bool spark_protocol_add_event_handler(ProtocolFacade* protocol, const char *event_name, EventHandler handler, SubscriptionScope::Enum scope, const char* id, void* handler_data=NULL);
+/**
+ * Adds a handler that receives events as a view of the message buffer rather than as NUL-terminated
+ * copies of the event name and data.
+ */
+bool spark_protocol_add_event_view_handler(ProtocolFacade* protocol, const char *event_name, EventViewHandler handler, SubscriptionScope::Enum scope, const char* id, void* handler_data, void* reserved=NULL);
 bool spark_protocol_send_time_request(ProtocolFacade* protocol, void* reserved=NULL);
 void spark_protocol_send_subscriptions(ProtocolFacade* protocol, void* reserved=NULL);
 void spark_protocol_remove_event_handlers(ProtocolFacade* protocol, const char *event_name, void* reserved=NULL);
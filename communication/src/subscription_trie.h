@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+
+namespace particle { namespace protocol {
+
+/**
+ * A compact prefix trie (radix tree) mapping event filters to lists of entries.
+ *
+ * Matching an event name visits only the nodes along the path spelled by the name, so the cost
+ * of dispatching an event depends on the length of its name rather than on the number of filters.
+ * Entries are owned by the caller and linked via their `next` member.
+ */
+template<typename EntryT>
+class SubscriptionTrie {
+public:
+    SubscriptionTrie() :
+            root_() {
+    }
+
+    ~SubscriptionTrie() {
+        clear();
+    }
+
+    // This class is non-copyable
+    SubscriptionTrie(const SubscriptionTrie&) = delete;
+    SubscriptionTrie& operator=(const SubscriptionTrie&) = delete;
+
+    /**
+     * Adds an entry for the given filter. Entries with the same filter are kept in insertion order.
+     * Returns `false` if a node could not be allocated.
+     */
+    bool insert(const char* filter, size_t len, EntryT* entry) {
+        Node* node = &root_;
+        size_t pos = 0;
+        while (pos < len) {
+            Node** link = &node->child;
+            Node* child = *link;
+            while (child && child->label[0] != filter[pos]) {
+                link = &child->sibling;
+                child = *link;
+            }
+            if (!child) {
+                child = makeNode(filter + pos, len - pos, nullptr, 0);
+                if (!child) {
+                    return false;
+                }
+                child->sibling = node->child;
+                node->child = child;
+                node = child;
+                break;
+            }
+            const size_t n = commonPrefix(child->label, child->len, filter + pos, len - pos);
+            if (n < child->len) {
+                // Split the edge: the new node holds the common part of the label
+                Node* mid = makeNode(child->label, n, nullptr, 0);
+                if (!mid) {
+                    return false;
+                }
+                memmove(child->label, child->label + n, child->len - n);
+                child->len -= n;
+                mid->child = child;
+                mid->sibling = child->sibling;
+                child->sibling = nullptr;
+                *link = mid;
+                child = mid;
+            }
+            node = child;
+            pos += n;
+        }
+        entry->next = nullptr;
+        EntryT** tail = &node->entries;
+        while (*tail) {
+            tail = &(*tail)->next;
+        }
+        *tail = entry;
+        return true;
+    }
+
+    /**
+     * Removes all entries with exactly the given filter and returns them as a linked list.
+     */
+    EntryT* remove(const char* filter, size_t len) {
+        if (!len) {
+            EntryT* entries = root_.entries;
+            root_.entries = nullptr;
+            return entries;
+        }
+        return remove(&root_.child, filter, len);
+    }
+
+    /**
+     * Removes a single entry with the given filter. Returns `false` if the entry is not found.
+     */
+    bool remove(const char* filter, size_t len, EntryT* entry) {
+        if (!len) {
+            return unlink(&root_.entries, entry);
+        }
+        return remove(&root_.child, filter, len, entry) == entry;
+    }
+
+    /**
+     * Invokes `fn(EntryT&)` for every entry whose filter is a prefix of the given name.
+     *
+     * The function may add entries but must not remove them.
+     */
+    template<typename F>
+    void match(const char* name, size_t len, F fn) const {
+        const Node* node = &root_;
+        size_t pos = 0;
+        for (;;) {
+            for (EntryT* e = node->entries; e;) {
+                EntryT* next = e->next;
+                fn(*e);
+                e = next;
+            }
+            if (pos == len) {
+                break;
+            }
+            const Node* child = node->child;
+            while (child && child->label[0] != name[pos]) {
+                child = child->sibling;
+            }
+            if (!child || child->len > len - pos || memcmp(child->label, name + pos, child->len) != 0) {
+                break;
+            }
+            pos += child->len;
+            node = child;
+        }
+    }
+
+    /**
+     * Removes all nodes. The entries are not deallocated.
+     */
+    void clear() {
+        freeNodes(root_.child);
+        root_.child = nullptr;
+        root_.entries = nullptr;
+    }
+
+private:
+    struct Node {
+        Node* child;
+        Node* sibling;
+        EntryT* entries;
+        size_t len;
+        char label[1];
+    };
+
+    Node root_;
+
+    static Node* makeNode(const char* label, size_t len, const char* label2, size_t len2) {
+        Node* node = (Node*)malloc(offsetof(Node, label) + len + len2);
+        if (node) {
+            node->child = nullptr;
+            node->sibling = nullptr;
+            node->entries = nullptr;
+            node->len = len + len2;
+            memcpy(node->label, label, len);
+            if (len2) {
+                memcpy(node->label + len, label2, len2);
+            }
+        }
+        return node;
+    }
+
+    static size_t commonPrefix(const char* s1, size_t len1, const char* s2, size_t len2) {
+        size_t n = 0;
+        while (n < len1 && n < len2 && s1[n] == s2[n]) {
+            ++n;
+        }
+        return n;
+    }
+
+    static void freeNodes(Node* node) {
+        while (node) {
+            Node* sibling = node->sibling;
+            freeNodes(node->child);
+            free(node);
+            node = sibling;
+        }
+    }
+
+    static bool unlink(EntryT** list, EntryT* entry) {
+        while (*list && *list != entry) {
+            list = &(*list)->next;
+        }
+        if (!*list) {
+            return false;
+        }
+        *list = entry->next;
+        return true;
+    }
+
+    // Removes the given entry, or all entries of the node if `entry` is null
+    static EntryT* remove(Node** link, const char* filter, size_t len, EntryT* entry = nullptr) {
+        Node* node = *link;
+        while (node && node->label[0] != filter[0]) {
+            link = &node->sibling;
+            node = *link;
+        }
+        if (!node || node->len > len || memcmp(node->label, filter, node->len) != 0) {
+            return nullptr;
+        }
+        EntryT* entries = nullptr;
+        if (node->len == len) {
+            if (!entry) {
+                entries = node->entries;
+                node->entries = nullptr;
+            } else if (unlink(&node->entries, entry)) {
+                entries = entry;
+            }
+        } else {
+            entries = remove(&node->child, filter + node->len, len - node->len, entry);
+        }
+        if (entries) {
+            compact(link);
+        }
+        return entries;
+    }
+
+    // Removes the node if it has neither entries nor children, or merges it with its only child
+    static void compact(Node** link) {
+        Node* node = *link;
+        if (node->entries) {
+            return;
+        }
+        if (!node->child) {
+            *link = node->sibling;
+            free(node);
+            return;
+        }
+        Node* child = node->child;
+        if (!child->sibling) {
+            Node* merged = makeNode(node->label, node->len, child->label, child->len);
+            if (!merged) {
+                return; // The trie is still valid, just not as compact
+            }
+            merged->child = child->child;
+            merged->entries = child->entries;
+            merged->sibling = node->sibling;
+            *link = merged;
+            free(child);
+            free(node);
+        }
+    }
+};
+
+}} // namespace particle::protocol
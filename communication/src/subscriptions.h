@@ -19,23 +19,126 @@
 
 #pragma once
 
-namespace particle
-{
-namespace protocol
-{
-
 #include "protocol_defs.h"
 #include "events.h"
 #include "message_channel.h"
+#include "messages.h"
+#include "coap.h"
+#include "subscription_trie.h"
+#include "spark_wiring_vector.h"
 #include <stdint.h>
+#include <new>
+
+namespace particle
+{
+namespace protocol
+{
 
+/**
+ * Manages the event subscriptions of this device.
+ *
+ * Subscriptions are indexed by their filter in a prefix trie, so dispatching an event is
+ * proportional to the length of its name. The checksum of the subscriptions is maintained
+ * incrementally as subscriptions are added and removed.
+ */
 class Subscriptions
 {
 public:
 	typedef uint32_t (*calculate_crc_fn)(const unsigned char *buf, uint32_t buflen);
 
 private:
-	FilteringEventHandler event_handlers[5];
+	struct Subscription
+	{
+		/**
+		 * The handler info passed to the system. Its address remains stable for
+		 * the lifetime of the subscription.
+		 */
+		FilteringEventHandler handler;
+
+		/**
+		 * The next subscription with the same filter.
+		 */
+		Subscription* next;
+
+		/**
+		 * The checksum of this subscription, valid once it has been
+		 * included in the subscriptions checksum.
+		 */
+		uint32_t checksum;
+
+		/**
+		 * The next subscription removed while an event was being dispatched.
+		 */
+		Subscription* next_removed;
+
+		/**
+		 * Set if the subscription has been removed while an event was being dispatched.
+		 */
+		bool removed;
+	};
+
+	/**
+	 * The subscriptions indexed by filter.
+	 */
+	SubscriptionTrie<Subscription> trie;
+
+	/**
+	 * The subscriptions in the order they were added.
+	 */
+	spark::Vector<Subscription*> subscriptions;
+
+	/**
+	 * The sum of the checksums of the first {@code checksum_count} subscriptions.
+	 */
+	uint32_t checksum_sum;
+	int checksum_count;
+
+	/**
+	 * Subscriptions removed by the event handlers are kept in the trie until the event has been
+	 * dispatched, so that the trie can be walked while the handlers are invoked.
+	 */
+	Subscription* removed;
+	int dispatching;
+
+	static size_t filter_length(const FilteringEventHandler& handler)
+	{
+		return strnlen(handler.filter, sizeof(handler.filter));
+	}
+
+	void remove_subscription(Subscription* subscription)
+	{
+		const int i = subscriptions.indexOf(subscription);
+		if (i >= 0)
+		{
+			if (i < checksum_count)
+			{
+				checksum_sum -= subscription->checksum;
+				--checksum_count;
+			}
+			subscriptions.removeAt(i);
+		}
+		if (dispatching)
+		{
+			subscription->removed = true;
+			subscription->next_removed = removed;
+			removed = subscription;
+		}
+		else
+		{
+			delete subscription;
+		}
+	}
+
+	void delete_removed_subscriptions()
+	{
+		while (removed)
+		{
+			Subscription* subscription = removed;
+			removed = subscription->next_removed;
+			trie.remove(subscription->handler.filter, filter_length(subscription->handler), subscription);
+			delete subscription;
+		}
+	}
 
 protected:
 
@@ -60,26 +163,52 @@ protected:
 
 public:
 
-	Subscriptions()
+	Subscriptions() :
+			checksum_sum(0),
+			checksum_count(0),
+			removed(nullptr),
+			dispatching(0)
 	{
-		memset(&event_handlers, 0, sizeof(event_handlers));
 	}
 
+	~Subscriptions()
+	{
+		remove_event_handlers(nullptr);
+	}
+
+	/**
+	 * Computes the checksum of the registered subscriptions. Only the subscriptions added
+	 * since the previous call are hashed, the checksum of the others is cached.
+	 */
 	uint32_t compute_subscriptions_checksum(calculate_crc_fn calculate_crc)
 	{
-		uint32_t checksum = 0;
-		for_each([&checksum, calculate_crc](FilteringEventHandler& handler){
-			uint32_t chk[4];
-			chk[0] = checksum;
-			chk[1] = calculate_crc((const uint8_t*)handler.device_id, sizeof(handler.device_id));
-			chk[2] = calculate_crc((const uint8_t*)handler.filter, sizeof(handler.filter));
-			chk[3] = calculate_crc((const uint8_t*)&handler.scope, sizeof(handler.scope));
-			checksum = calculate_crc((const uint8_t*)chk, sizeof(chk));
-			return NO_ERROR;
-		});
-		return checksum;
+		for (; checksum_count < subscriptions.size(); ++checksum_count)
+		{
+			Subscription* subscription = subscriptions.at(checksum_count);
+			const FilteringEventHandler& handler = subscription->handler;
+			uint32_t chk[3];
+			chk[0] = calculate_crc((const uint8_t*)handler.device_id, sizeof(handler.device_id));
+			chk[1] = calculate_crc((const uint8_t*)handler.filter, sizeof(handler.filter));
+			chk[2] = calculate_crc((const uint8_t*)&handler.scope, sizeof(handler.scope));
+			subscription->checksum = calculate_crc((const uint8_t*)chk, sizeof(chk));
+			checksum_sum += subscription->checksum;
+		}
+		if (!checksum_count)
+		{
+			return 0;
+		}
+		// The sum is independent of the order in which subscriptions were added and removed
+		uint32_t chk[2];
+		chk[0] = checksum_sum;
+		chk[1] = checksum_count;
+		return calculate_crc((const uint8_t*)chk, sizeof(chk));
 	}
 
+	/**
+	 * Dispatches a received event to the matching handlers. Handlers registered with
+	 * {@code EventHandlerFlag::VIEW} receive a view of the message buffer, the other handlers
+	 * receive the name and data as NUL-terminated strings.
+	 */
 	ProtocolError handle_event(Message& message,
 			void (*call_event_handler)(uint16_t size,
 					FilteringEventHandler* handler, const char* event,
@@ -139,112 +268,125 @@ public:
 			next_src += next_len;
 		}
 
+		EventView view = {};
+		view.name = (const char*)event_name;
+		view.name_length = event_name_length;
 		unsigned char *data = NULL;
 		if (next_src < end && 0xff == *next_src)
 		{
 			// payload is next
 			data = next_src + 1;
-			// null terminate data string
-			*end = 0;
+			view.data = (const char*)data;
+			view.data_length = end - data;
 		}
-		// null terminate event name string
-		event_name[event_name_length] = 0;
 
-		const int NUM_HANDLERS = sizeof(event_handlers)
-				/ sizeof(FilteringEventHandler);
-		for (int i = 0; i < NUM_HANDLERS; i++)
-		{
-			if (NULL == event_handlers[i].handler)
+		// The name and data are NUL-terminated in the message buffer only when a handler
+		// that expects C strings is found
+		bool terminated = false;
+		++dispatching;
+		trie.match((const char*)event_name, event_name_length, [&](Subscription& subscription) {
+			if (subscription.removed)
 			{
-				break;
+				// Removed by one of the handlers invoked earlier
+				return;
 			}
-			const size_t MAX_FILTER_LENGTH = sizeof(event_handlers[i].filter);
-			const size_t filter_length = strnlen(event_handlers[i].filter,
-					MAX_FILTER_LENGTH);
-
-			if (event_name_length < filter_length)
+			FilteringEventHandler& handler = subscription.handler;
+			const bool use_view = (handler.flags & EventHandlerFlag::VIEW);
+			if (!use_view && !terminated)
 			{
-				// does not match this filter, try the next event handler
-				continue;
+				if (data)
+					*end = 0;
+				event_name[event_name_length] = 0;
+				terminated = true;
 			}
-
-			const int cmp = memcmp(event_handlers[i].filter, event_name,
-					filter_length);
-			if (0 == cmp)
+			// don't call the handler directly, use a callback for it.
+			if (!call_event_handler)
 			{
-				// don't call the handler directly, use a callback for it.
-				if (!call_event_handler)
+				if (use_view)
 				{
-					if (event_handlers[i].handler_data)
-					{
-						EventHandlerWithData handler =
-								(EventHandlerWithData) event_handlers[i].handler;
-						handler(event_handlers[i].handler_data,
-								(char *) event_name, (char *) data);
-					}
-					else
-					{
-						event_handlers[i].handler((char *) event_name,
-								(char *) data);
-					}
+					EventViewHandler view_handler = (EventViewHandler) handler.handler;
+					view_handler(handler.handler_data, &view);
+				}
+				else if (handler.handler_data)
+				{
+					EventHandlerWithData handler_with_data = (EventHandlerWithData) handler.handler;
+					handler_with_data(handler.handler_data, (char *) event_name, (char *) data);
 				}
 				else
 				{
-					call_event_handler(sizeof(FilteringEventHandler),
-							&event_handlers[i], (const char*) event_name,
-							(const char*) data, NULL);
+					handler.handler((char *) event_name, (char *) data);
 				}
 			}
-			// else continue the for loop to try the next handler
+			else
+			{
+				// The view is passed to the system as the reserved argument, which also tells
+				// the system that the handler is a view handler. The handler info is only valid
+				// for the duration of the call
+				call_event_handler(sizeof(FilteringEventHandler), &handler,
+						(const char*) event_name, (const char*) data, use_view ? &view : NULL);
+			}
+		});
+		if (--dispatching == 0)
+		{
+			delete_removed_subscriptions();
+		}
+		if (view.owner)
+		{
+			// A handler has retained the event
+			event_view_release(&view);
 		}
 		return NO_ERROR;
 	}
 
 	template<typename F> ProtocolError for_each(F callback)
 	{
-		const int NUM_HANDLERS = sizeof(event_handlers)
-				/ sizeof(FilteringEventHandler);
 		ProtocolError error = NO_ERROR;
-		for (unsigned i = 0; i < NUM_HANDLERS; i++)
+		for (Subscription* subscription: subscriptions)
 		{
-			if (nullptr != event_handlers[i].handler)
-			{
-				error = callback(event_handlers[i]);
-				if (error)
-					break;
-			}
+			error = callback(subscription->handler);
+			if (error)
+				break;
 		}
 		return error;
 	}
 
 	void remove_event_handlers(const char* event_name)
 	{
-		if (NULL == event_name)
+		if (dispatching)
 		{
-			memset(event_handlers, 0, sizeof(event_handlers));
+			// Leave the trie intact while it's being walked
+			const size_t MAX_FILTER_LEN = sizeof(FilteringEventHandler::filter);
+			const size_t len = event_name ? strnlen(event_name, MAX_FILTER_LEN) : 0;
+			for (int i = subscriptions.size() - 1; i >= 0; --i)
+			{
+				Subscription* subscription = subscriptions.at(i);
+				const FilteringEventHandler& h = subscription->handler;
+				if (!event_name || (filter_length(h) == len && !memcmp(h.filter, event_name, len)))
+				{
+					remove_subscription(subscription);
+				}
+			}
+		}
+		else if (NULL == event_name)
+		{
+			trie.clear();
+			for (Subscription* subscription: subscriptions)
+			{
+				delete subscription;
+			}
+			subscriptions.clear();
+			checksum_sum = 0;
+			checksum_count = 0;
 		}
 		else
 		{
-			const int NUM_HANDLERS = sizeof(event_handlers)
-					/ sizeof(FilteringEventHandler);
-			int dest = 0;
-			for (int i = 0; i < NUM_HANDLERS; i++)
+			const size_t MAX_FILTER_LEN = sizeof(FilteringEventHandler::filter);
+			Subscription* subscription = trie.remove(event_name, strnlen(event_name, MAX_FILTER_LEN));
+			while (subscription)
 			{
-				if (!strcmp(event_name, event_handlers[i].filter))
-				{
-					memset(&event_handlers[i], 0, sizeof(event_handlers[i]));
-				}
-				else
-				{
-					if (dest != i)
-					{
-						memcpy(event_handlers + dest, event_handlers + i,
-								sizeof(event_handlers[i]));
-						memset(event_handlers + i, 0,
-								sizeof(event_handlers[i]));
-					}
-					dest++;
-				}
+				Subscription* next = subscription->next;
+				remove_subscription(subscription);
+				subscription = next;
 			}
 		}
 	}
@@ -255,25 +397,23 @@ public:
 	bool event_handler_exists(const char *event_name, EventHandler handler,
 			void *handler_data, SubscriptionScope::Enum scope, const char* id)
 	{
-		const int NUM_HANDLERS = sizeof(event_handlers)
-				/ sizeof(FilteringEventHandler);
-		for (int i = 0; i < NUM_HANDLERS; i++)
+		for (const Subscription* subscription: subscriptions)
 		{
-			if (event_handlers[i].handler == handler
-					&& event_handlers[i].handler_data == handler_data
-					&& event_handlers[i].scope == scope)
+			const FilteringEventHandler& h = subscription->handler;
+			if (h.handler == handler
+					&& h.handler_data == handler_data
+					&& h.scope == scope)
 			{
-				const size_t MAX_FILTER_LEN = sizeof(event_handlers[i].filter);
+				const size_t MAX_FILTER_LEN = sizeof(h.filter);
 				const size_t FILTER_LEN = strnlen(event_name, MAX_FILTER_LEN);
-				if (!strncmp(event_handlers[i].filter, event_name, FILTER_LEN))
+				if (!strncmp(h.filter, event_name, FILTER_LEN))
 				{
-					const size_t MAX_ID_LEN =
-							sizeof(event_handlers[i].device_id) - 1;
+					const size_t MAX_ID_LEN = sizeof(h.device_id) - 1;
 					const size_t id_len = id ? strnlen(id, MAX_ID_LEN) : 0;
 					if (id_len)
-						return !strncmp(event_handlers[i].device_id, id, id_len);
+						return !strncmp(h.device_id, id, id_len);
 					else
-						return !event_handlers[i].device_id[0];
+						return !h.device_id[0];
 				}
 			}
 		}
@@ -284,32 +424,33 @@ public:
 	 * Adds the given handler.
 	 */
 	ProtocolError add_event_handler(const char *event_name, EventHandler handler,
-			void *handler_data, SubscriptionScope::Enum scope, const char* id)
+			void *handler_data, SubscriptionScope::Enum scope, const char* id, uint8_t flags = 0)
 	{
 		if (event_handler_exists(event_name, handler, handler_data, scope, id))
 			return NO_ERROR;
 
-		const int NUM_HANDLERS = sizeof(event_handlers) / sizeof(FilteringEventHandler);
-		for (int i = 0; i < NUM_HANDLERS; i++)
+		Subscription* subscription = new(std::nothrow) Subscription();
+		if (!subscription)
+			return INSUFFICIENT_STORAGE;
+		FilteringEventHandler& h = subscription->handler;
+		const size_t MAX_FILTER_LEN = sizeof(h.filter);
+		const size_t FILTER_LEN = strnlen(event_name, MAX_FILTER_LEN);
+		memcpy(h.filter, event_name, FILTER_LEN);
+		h.handler = handler;
+		h.handler_data = handler_data;
+		const size_t MAX_ID_LEN = sizeof(h.device_id) - 1;
+		const size_t id_len = id ? strnlen(id, MAX_ID_LEN) : 0;
+		memcpy(h.device_id, id, id_len);
+		h.scope = scope;
+		h.flags = flags;
+
+		if (!subscriptions.reserve(subscriptions.size() + 1) || !trie.insert(h.filter, FILTER_LEN, subscription))
 		{
-			if (NULL == event_handlers[i].handler)
-			{
-				const size_t MAX_FILTER_LEN = sizeof(event_handlers[i].filter);
-				const size_t FILTER_LEN = strnlen(event_name, MAX_FILTER_LEN);
-				memcpy(event_handlers[i].filter, event_name, FILTER_LEN);
-				memset(event_handlers[i].filter + FILTER_LEN, 0, MAX_FILTER_LEN - FILTER_LEN);
-				event_handlers[i].handler = handler;
-				event_handlers[i].handler_data = handler_data;
-				event_handlers[i].device_id[0] = 0;
-				const size_t MAX_ID_LEN = sizeof(event_handlers[i].device_id) - 1;
-				const size_t id_len = id ? strnlen(id, MAX_ID_LEN) : 0;
-				memcpy(event_handlers[i].device_id, id, id_len);
-				event_handlers[i].device_id[id_len] = 0;
-				event_handlers[i].scope = scope;
-				return NO_ERROR;
-			}
+			delete subscription;
+			return INSUFFICIENT_STORAGE;
 		}
-		return INSUFFICIENT_STORAGE;
+		subscriptions.append(subscription);
+		return NO_ERROR;
 	}
 
 	inline ProtocolError send_subscriptions(MessageChannel& channel)
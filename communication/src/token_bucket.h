@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_tick_hal.h"
+
+namespace particle { namespace protocol {
+
+/**
+ * A token bucket holding up to `capacity` tokens and refilled with one token every `period`
+ * milliseconds.
+ */
+class TokenBucket
+{
+public:
+    TokenBucket(unsigned capacity, system_tick_t period) :
+            capacity_(capacity),
+            tokens_(capacity),
+            period_(period),
+            lastRefill_(0),
+            started_(false) {
+    }
+
+    /**
+     * Changes the bucket parameters. The bucket is refilled to its new capacity.
+     */
+    void configure(unsigned capacity, system_tick_t period) {
+        capacity_ = capacity;
+        period_ = period;
+        reset();
+    }
+
+    void reset() {
+        tokens_ = capacity_;
+        started_ = false;
+    }
+
+    /**
+     * Adds the tokens accumulated since the last refill.
+     */
+    void refill(system_tick_t now) {
+        if (!started_) {
+            lastRefill_ = now;
+            started_ = true;
+            return;
+        }
+        if (tokens_ >= capacity_ || period_ == 0) {
+            // Nothing to accumulate while the bucket is full
+            tokens_ = capacity_;
+            lastRefill_ = now;
+            return;
+        }
+        const system_tick_t elapsed = now - lastRefill_;
+        const system_tick_t count = elapsed / period_;
+        if (count > 0) {
+            if (count >= capacity_ - tokens_) {
+                tokens_ = capacity_;
+                lastRefill_ = now;
+            } else {
+                tokens_ += count;
+                // Keep the fractional part of the period
+                lastRefill_ += count * period_;
+            }
+        }
+    }
+
+    /**
+     * Takes a token from the bucket. Returns `false` if the bucket is empty.
+     */
+    bool take(system_tick_t now) {
+        refill(now);
+        if (tokens_ == 0) {
+            return false;
+        }
+        --tokens_;
+        return true;
+    }
+
+    bool available(system_tick_t now) {
+        refill(now);
+        return tokens_ > 0;
+    }
+
+    unsigned tokens() const {
+        return tokens_;
+    }
+
+    unsigned capacity() const {
+        return capacity_;
+    }
+
+    system_tick_t period() const {
+        return period_;
+    }
+
+private:
+    unsigned capacity_;
+    unsigned tokens_;
+    system_tick_t period_;
+    system_tick_t lastRefill_;
+    bool started_;
+};
+
+}} // namespace particle::protocol
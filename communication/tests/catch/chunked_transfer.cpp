@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chunked_transfer.h"
+
+#include "catch.hpp"
+#include "fakeit.hpp"
+
+#include <vector>
+
+using namespace fakeit;
+using namespace particle::protocol;
+
+namespace {
+
+const uint32_t CHUNK_CRC = 0x12345678;
+
+void make_update_begin(Message& msg, uint8_t* buf, uint16_t chunk_size, uint32_t file_length)
+{
+	memset(buf, 0, 20);
+	buf[7] = 0xff;
+	buf[8] = 0x01; // fast OTA
+	buf[9] = chunk_size >> 8;
+	buf[10] = chunk_size & 0xff;
+	buf[11] = file_length >> 24;
+	buf[12] = (file_length >> 16) & 0xff;
+	buf[13] = (file_length >> 8) & 0xff;
+	buf[14] = file_length & 0xff;
+	msg.set_length(20);
+}
+
+void make_chunk(Message& msg, uint8_t* buf, chunk_index_t index, uint8_t value, size_t size)
+{
+	memset(buf, 0, 7);
+	buf[7] = 0x04; // CRC option
+	buf[8] = CHUNK_CRC >> 24;
+	buf[9] = (CHUNK_CRC >> 16) & 0xff;
+	buf[10] = (CHUNK_CRC >> 8) & 0xff;
+	buf[11] = CHUNK_CRC & 0xff;
+	buf[12] = 0x02; // chunk index option
+	buf[13] = index >> 8;
+	buf[14] = index & 0xff;
+	buf[15] = 0xff;
+	memset(buf + 16, value, size);
+	msg.set_length(16 + size);
+}
+
+} // namespace
+
+SCENARIO("firmware chunks are written to flash outside of the receive path")
+{
+	GIVEN("an update in progress")
+	{
+		uint8_t in_buf[256];
+		uint8_t out_buf[256];
+		std::vector<std::pair<uint32_t, uint8_t>> saved; // address, first byte
+
+		Mock<MessageChannel> channel_mock;
+		When(Method(channel_mock,create)).AlwaysDo([&out_buf](Message& msg, size_t len)
+				{
+					msg.set_buffer(out_buf, sizeof(out_buf)); return NO_ERROR;
+				});
+		When(Method(channel_mock,response)).AlwaysDo([&out_buf](Message& msg, Message& response, size_t len)
+				{
+					response.set_buffer(out_buf, sizeof(out_buf)); return NO_ERROR;
+				});
+		When(Method(channel_mock,is_unreliable)).AlwaysReturn(true);
+		When(Method(channel_mock,send)).AlwaysReturn(NO_ERROR);
+		MessageChannel& channel = channel_mock.get();
+
+		Mock<ChunkedTransfer::Callbacks> callbacks_mock;
+		When(Method(callbacks_mock,prepare_for_firmware_update)).AlwaysReturn(0);
+		When(Method(callbacks_mock,finish_firmware_update)).AlwaysReturn(0);
+		When(Method(callbacks_mock,calculate_crc)).AlwaysReturn(CHUNK_CRC);
+		When(Method(callbacks_mock,millis)).AlwaysReturn(0);
+		When(Method(callbacks_mock,save_firmware_chunk)).AlwaysDo(
+				[&saved](FileTransfer::Descriptor& file, const unsigned char* chunk, void*)
+				{
+					saved.push_back(std::make_pair(uint32_t(file.chunk_address), uint8_t(chunk[0]))); return 0;
+				});
+
+		ChunkedTransfer transfer;
+		transfer.init(&callbacks_mock.get());
+		transfer.reset();
+
+		Message msg;
+		msg.set_buffer(in_buf, sizeof(in_buf));
+		make_update_begin(msg, in_buf, 8, 40);
+		REQUIRE(transfer.handle_update_begin(0, msg, channel)==NO_ERROR);
+		REQUIRE(transfer.is_updating());
+
+		for (chunk_index_t i=0; i<3; i++) {
+			make_chunk(msg, in_buf, i, i + 1, 8);
+			REQUIRE(transfer.handle_chunk(0, msg, channel)==NO_ERROR);
+		}
+
+		THEN("the verified chunks are buffered rather than written immediately")
+		{
+			REQUIRE(saved.empty());
+			REQUIRE(transfer.buffered_chunks()==3);
+		}
+
+		WHEN("the protocol is idle")
+		{
+			REQUIRE(transfer.idle(channel)==NO_ERROR);
+			THEN("the oldest chunk is written")
+			{
+				REQUIRE(saved.size()==1);
+				REQUIRE(saved[0].first==0);
+				REQUIRE(saved[0].second==1);
+				REQUIRE(transfer.buffered_chunks()==2);
+			}
+		}
+
+		WHEN("the window is full")
+		{
+			for (chunk_index_t i=3; i<OTA_CHUNK_WINDOW_SIZE + 1; i++) {
+				make_chunk(msg, in_buf, i, i + 1, 8);
+				REQUIRE(transfer.handle_chunk(0, msg, channel)==NO_ERROR);
+			}
+			THEN("chunks are written in order to make room")
+			{
+				REQUIRE(saved.size()==1);
+				REQUIRE(saved[0].first==0);
+				REQUIRE(transfer.buffered_chunks()==OTA_CHUNK_WINDOW_SIZE);
+			}
+		}
+
+		WHEN("the update is done")
+		{
+			msg.set_length(4);
+			REQUIRE(transfer.handle_update_done(0, msg, channel)==NO_ERROR);
+			THEN("all buffered chunks are written and the missing chunks are requested")
+			{
+				REQUIRE(saved.size()==3);
+				REQUIRE(saved[2].first==16);
+				REQUIRE(saved[2].second==3);
+				REQUIRE(transfer.buffered_chunks()==0);
+				REQUIRE(out_buf[5]=='c');
+				REQUIRE(out_buf[7]==0);
+				REQUIRE(out_buf[8]==3);
+				REQUIRE(out_buf[10]==4);
+			}
+		}
+
+		WHEN("a chunk cannot be written")
+		{
+			When(Method(callbacks_mock,save_firmware_chunk)).AlwaysReturn(1);
+			msg.set_length(4);
+			REQUIRE(transfer.handle_update_done(0, msg, channel)==NO_ERROR);
+			THEN("it is requested again")
+			{
+				REQUIRE(out_buf[5]=='c');
+				REQUIRE(out_buf[8]==0);
+				REQUIRE(out_buf[10]==1);
+			}
+		}
+	}
+}
@@ -393,6 +393,127 @@ SCENARIO("an unacknowledged message is resent up to MAX_TRANSMIT times, with exp
 
 }
 
+SCENARIO("many in-flight messages are indexed by id and resent when their timeout expires")
+{
+	REQUIRE(CoAPMessage::messages()==0);
+	GIVEN("a message store with many confirmable messages")
+	{
+		Mock<MessageChannel> mock;
+		MessageChannel& channel = mock.get();
+		build_message_channel_mock(mock);
+		When(Method(mock,send)).AlwaysReturn(NO_ERROR);
+
+		const int count = 100;
+		CoAPMessageStore store;
+		for (int i=0; i<count; i++)
+		{
+			// spread the message IDs so that some of them collide in the index
+			const message_id_t id = i * 7;
+			uint8_t data[] = { 0x40, 0, uint8_t(id >> 8), uint8_t(id & 0xFF) };
+			Message m(data, sizeof(data), sizeof(data));
+			m.decode_id();
+			REQUIRE(store.send(m, i)==NO_ERROR);
+		}
+
+		THEN("all messages can be retrieved by id")
+		{
+			for (int i=0; i<count; i++)
+			{
+				CoAPMessage* m = store.from_id(i * 7);
+				REQUIRE(m!=nullptr);
+				REQUIRE(m->get_id()==i * 7);
+			}
+			REQUIRE(store.from_id(1)==nullptr);
+		}
+
+		WHEN("every other message is acknowledged")
+		{
+			for (int i=0; i<count; i+=2)
+			{
+				uint8_t ack[4];
+				const message_id_t id = i * 7;
+				Message m(ack, sizeof(ack), Messages::empty_ack(ack, id >> 8, id & 0xFF));
+				REQUIRE(store.receive(m, channel, 0)==NO_ERROR);
+			}
+
+			THEN("only the unacknowledged messages remain")
+			{
+				for (int i=0; i<count; i++)
+				{
+					CoAPMessage* m = store.from_id(i * 7);
+					REQUIRE((m!=nullptr)==(i % 2==1));
+				}
+			}
+
+			AND_WHEN("time passes beyond the first retransmit timeout of all messages")
+			{
+				// the second retransmit timeout is at least 2*ACK_TIMEOUT after the first one
+				for (system_tick_t t=0; t<3*CoAPMessage::ACK_TIMEOUT; t+=50)
+					store.process(t, channel);
+
+				THEN("each remaining message has been resent exactly once")
+				{
+					Verify(Method(mock,send)).Exactly(count / 2);
+				}
+			}
+		}
+	}
+	REQUIRE(CoAPMessage::messages()==0);
+}
+
+SCENARIO("messages that expire in the same timer wheel slot are all removed")
+{
+	REQUIRE(CoAPMessage::messages()==0);
+	GIVEN("a message store with several acknowledgements sent at the same time")
+	{
+		Mock<MessageChannel> mock;
+		MessageChannel& channel = mock.get();
+		build_message_channel_mock(mock);
+		When(Method(mock,send)).AlwaysReturn(NO_ERROR);
+
+		const int count = 5;
+		CoAPMessageStore store;
+		for (int i=0; i<count; i++)
+		{
+			uint8_t ack[4];
+			Message m(ack, sizeof(ack), Messages::empty_ack(ack, 0x10, i));
+			m.decode_id();
+			REQUIRE(store.send(m, 0)==NO_ERROR);
+		}
+		REQUIRE(store.has_messages());
+
+		WHEN("the messages expire")
+		{
+			store.process(CoAPMessage::MAX_TRANSMIT_SPAN, channel);
+
+			THEN("none of the messages remain in the store")
+			{
+				for (int i=0; i<count; i++)
+				{
+					REQUIRE(store.from_id(0x1000 | i)==nullptr);
+				}
+				REQUIRE_FALSE(store.has_messages());
+				REQUIRE(CoAPMessage::messages()==0);
+			}
+		}
+
+		WHEN("one of the messages is acknowledged before the others expire")
+		{
+			uint8_t buf[4];
+			Message m(buf, sizeof(buf), Messages::empty_ack(buf, 0x10, 2));
+			REQUIRE(store.receive(m, channel, 0)==NO_ERROR);
+			store.process(CoAPMessage::MAX_TRANSMIT_SPAN, channel);
+
+			THEN("the remaining messages are removed as well")
+			{
+				REQUIRE_FALSE(store.has_messages());
+				REQUIRE(CoAPMessage::messages()==0);
+			}
+		}
+	}
+	REQUIRE(CoAPMessage::messages()==0);
+}
+
 SCENARIO("a CoAPMessage can be created with the message buffer part of the allocation")
 {
 	// todo - factor out the message tests to their own test suite
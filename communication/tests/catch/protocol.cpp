@@ -66,11 +66,11 @@ void event_handler(const char* event, const char* data)
 {
 }
 
-SCENARIO("5 subscribe messages are registered")
+SCENARIO("more than 5 subscribe messages are registered")
 {
 	MessageChannel* channel = nullptr;
 	AbstractProtocol p(*channel);	// channel is not used
-	for (int i=0; i<5; i++) {
+	for (int i=0; i<20; i++) {
 		INFO("adding event " << i);
 		char buf[2];
 		buf[1] = 0;
@@ -80,7 +80,7 @@ SCENARIO("5 subscribe messages are registered")
 	}
 
 	bool added = p.add_event_handler("abcd", event_handler);
-	REQUIRE(!added);
+	REQUIRE(added);
 
 	p.remove_event_handlers(nullptr);
 
@@ -233,3 +233,44 @@ SCENARIO("Events are non-confirmable over an unreliable channel with the NO_ACK
 {
 	verify_event_type_with_flags(EventType::NO_ACK, CoAPType::NON);
 }
+
+namespace {
+
+void store_result(int error, const void* data, void* callback_data, void* reserved)
+{
+	*static_cast<int*>(callback_data) = error;
+}
+
+} // namespace
+
+SCENARIO("events of a previous session are cancelled when a new session is established")
+{
+	ProtocolBuilder builder;
+	builder.callbacks.millis = &fake_millis;
+	Mock<MessageChannel> channel;
+	uint8_t buf[PROTOCOL_BUFFER_SIZE];
+	When(Method(channel,create)).AlwaysDo([&buf](Message& msg, size_t size) {
+		msg.set_buffer(buf, sizeof(buf));
+		return NO_ERROR;
+	});
+	When(Method(channel,is_unreliable)).AlwaysReturn(true);
+	When(Method(channel,send)).AlwaysReturn(NO_ERROR);
+	When(Method(channel,establish)).AlwaysReturn(IO_ERROR);
+	AbstractProtocol p(channel.get());
+	builder.build(p);
+
+	// Batch an event and queue a rate-limited event
+	p.set_publish_batch_window(1000);
+	p.set_publish_rate_limit(false, 1, 1000);
+	int batched = 1, queued = 1;
+	REQUIRE(p.send_event("a", "1", 60, EventType::PRIVATE, 0, CompletionHandler(store_result, &batched)));
+	REQUIRE(p.send_event("b", "2", 60, EventType::PRIVATE, 0, CompletionHandler(store_result, &queued)));
+	REQUIRE(batched==1);
+	REQUIRE(queued==1);
+
+	REQUIRE(p.begin()==IO_ERROR);
+
+	REQUIRE(batched==SYSTEM_ERROR_ABORTED);
+	REQUIRE(queued==SYSTEM_ERROR_ABORTED);
+	Verify(Method(channel,send)).Never();
+}
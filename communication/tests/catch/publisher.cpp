@@ -20,9 +20,21 @@
 #include "publisher.h"
 
 #include "catch.hpp"
+#include "fakeit.hpp"
 
+using namespace fakeit;
+using namespace particle;
 using namespace particle::protocol;
 
+namespace {
+
+void store_result(int error, const void* data, void* callback_data, void* reserved)
+{
+	*static_cast<int*>(callback_data) = error;
+}
+
+} // namespace
+
 SCENARIO("publisher")
 {
 	GIVEN("a publisher")
@@ -37,15 +49,21 @@ SCENARIO("publisher")
 			REQUIRE(publisher.is_rate_limited(false, 1400)==false);
 			REQUIRE(publisher.is_rate_limited(false, 1600)==false);
 
-			const system_tick_t next_app_event = 5000;  // 1000ms + 4s
-			THEN("application events until 4 seconds have elapsed are rate limited")
+			const system_tick_t next_app_event = 2000;  // 1000ms + 1s
+			THEN("application events until a token is refilled are rate limited")
 			{
 				for (system_tick_t i=1600; i<next_app_event; i+=100) {
 					REQUIRE(publisher.is_rate_limited(false, i)==true);
 				}
+				AND_THEN("one application event per second is not rate limited")
+				{
+					REQUIRE(publisher.is_rate_limited(false, next_app_event)==false);
+					REQUIRE(publisher.is_rate_limited(false, next_app_event)==true);
+					REQUIRE(publisher.is_rate_limited(false, next_app_event+1000)==false);
+				}
 			}
 
-			THEN("an application event after 4 seconds have elapsed is not rate limited")
+			THEN("an application event after 1 second has elapsed is not rate limited")
 			{
 				REQUIRE(publisher.is_rate_limited(false, next_app_event)==false);
 			}
@@ -58,25 +76,20 @@ SCENARIO("publisher")
 				REQUIRE(publisher.is_rate_limited(true, i)==false);
 			}
 
-			THEN("all system events until the next minute begins are rate limited")
+			THEN("system events are rate limited until a token is refilled")
 			{
-				for (int i=1000; i<60*1000; i+=1000) {
-					INFO("The counter is " << i);
-					REQUIRE(publisher.is_rate_limited(true, i)==true);
-				}
+				REQUIRE(publisher.is_rate_limited(true, 255)==true);
+				REQUIRE(publisher.is_rate_limited(true, PUBLISH_SYSTEM_EVENT_PERIOD)==false);
+				REQUIRE(publisher.is_rate_limited(true, PUBLISH_SYSTEM_EVENT_PERIOD)==true);
 
-				// it's only approximately 1 minute, the cutoff is 64k milliseconds
-				for (int i=60000; i<65536; i+=8) {
-					INFO("The counter is " << i);
-					REQUIRE(publisher.is_rate_limited(true, i)==true);
-				}
-
-				AND_THEN("system events in the next minute are not rate limited")
+				AND_THEN("a full burst of system events is allowed once the bucket is refilled")
 				{
-					for (int i=65536; i<65536+255; i++) {
+					const system_tick_t t = PUBLISH_SYSTEM_EVENT_PERIOD * (PUBLISH_SYSTEM_EVENT_BURST + 1);
+					for (int i=0; i<255; i++) {
 						INFO("The counter is " << i);
-						REQUIRE(publisher.is_rate_limited(true, i)==false);
+						REQUIRE(publisher.is_rate_limited(true, t)==false);
 					}
+					REQUIRE(publisher.is_rate_limited(true, t)==true);
 				}
 			}
 
@@ -89,5 +102,201 @@ SCENARIO("publisher")
 				REQUIRE(publisher.is_rate_limited(false, 1000)==true);
 			}
 		}
+
+		WHEN("the application event rate limit is changed")
+		{
+			publisher.set_rate_limit(false, 2, 500);
+			THEN("the new burst size and refill period are used")
+			{
+				REQUIRE(publisher.is_rate_limited(false, 0)==false);
+				REQUIRE(publisher.is_rate_limited(false, 0)==false);
+				REQUIRE(publisher.is_rate_limited(false, 499)==true);
+				REQUIRE(publisher.is_rate_limited(false, 500)==false);
+			}
+			THEN("the system event rate limit is not affected")
+			{
+				REQUIRE(publisher.rate_limit_burst(false)==2);
+				REQUIRE(publisher.rate_limit_period(false)==500);
+				REQUIRE(publisher.rate_limit_burst(true)==PUBLISH_SYSTEM_EVENT_BURST);
+				REQUIRE(publisher.rate_limit_period(true)==PUBLISH_SYSTEM_EVENT_PERIOD);
+			}
+		}
+	}
+}
+
+SCENARIO("publisher queues rate-limited events")
+{
+	GIVEN("a publisher and a message channel")
+	{
+		Mock<MessageChannel> mock;
+		uint8_t buf[PROTOCOL_BUFFER_SIZE];
+		When(Method(mock,create)).AlwaysDo([&buf](Message& msg, size_t len)
+				{
+					msg.set_buffer(buf, sizeof(buf)); return NO_ERROR;
+				});
+		When(Method(mock,is_unreliable)).AlwaysReturn(false);
+		When(Method(mock,send)).AlwaysReturn(NO_ERROR);
+		MessageChannel& channel = mock.get();
+
+		Protocol* protocol = nullptr;
+		Publisher publisher(protocol);
+		publisher.set_max_pending_events(2);
+
+		for (int i=0; i<4; i++) {
+			REQUIRE(publisher.send_event(channel, "burst", "x", 60, EventType::PRIVATE, 0, 0, CompletionHandler())==NO_ERROR);
+		}
+		Verify(Method(mock,send)).Exactly(4);
+
+		WHEN("an event exceeds the rate limit")
+		{
+			int result = 1;
+			REQUIRE(publisher.send_event(channel, "a", "1", 60, EventType::PRIVATE, 0, 0,
+					CompletionHandler(store_result, &result))==NO_ERROR);
+
+			THEN("it is queued and sent once a token is refilled")
+			{
+				REQUIRE(publisher.pending_events()==1);
+				REQUIRE(publisher.process(channel, 999)==NO_ERROR);
+				REQUIRE(publisher.pending_events()==1);
+				REQUIRE(result==1);
+				REQUIRE(publisher.process(channel, 1000)==NO_ERROR);
+				REQUIRE(publisher.pending_events()==0);
+				REQUIRE(result==SYSTEM_ERROR_NONE);
+				Verify(Method(mock,send)).Exactly(5);
+			}
+
+			THEN("a repeated publish of the same event replaces the queued data")
+			{
+				int result2 = 1;
+				REQUIRE(publisher.send_event(channel, "a", "2", 60, EventType::PRIVATE, 0, 0,
+						CompletionHandler(store_result, &result2))==NO_ERROR);
+				REQUIRE(publisher.pending_events()==1);
+				REQUIRE(result==SYSTEM_ERROR_CANCELLED);
+				REQUIRE(publisher.process(channel, 1000)==NO_ERROR);
+				REQUIRE(result2==SYSTEM_ERROR_NONE);
+			}
+
+			THEN("events are dropped when the queue is full")
+			{
+				REQUIRE(publisher.send_event(channel, "b", "1", 60, EventType::PRIVATE, 0, 0, CompletionHandler())==NO_ERROR);
+				int result3 = 1;
+				REQUIRE(publisher.send_event(channel, "c", "1", 60, EventType::PRIVATE, 0, 0,
+						CompletionHandler(store_result, &result3))==BANDWIDTH_EXCEEDED);
+				REQUIRE(result3==SYSTEM_ERROR_LIMIT_EXCEEDED);
+				REQUIRE(publisher.pending_events()==2);
+			}
+
+			THEN("system events are not delayed by queued application events")
+			{
+				REQUIRE(publisher.send_event(channel, "particle/x", "1", 60, EventType::PRIVATE, 0, 0, CompletionHandler())==NO_ERROR);
+				REQUIRE(publisher.pending_events()==1);
+				Verify(Method(mock,send)).Exactly(5);
+			}
+
+			THEN("clearing the queue cancels the queued events")
+			{
+				publisher.clear();
+				REQUIRE(publisher.pending_events()==0);
+				REQUIRE(result==SYSTEM_ERROR_ABORTED);
+			}
+			// The completion handlers of the queued events refer to the local results
+			publisher.clear();
+		}
+	}
+}
+
+SCENARIO("publisher batches application events")
+{
+	GIVEN("a publisher with a batch window")
+	{
+		Mock<MessageChannel> mock;
+		uint8_t buf[PROTOCOL_BUFFER_SIZE];
+		size_t sent_length = 0;
+		When(Method(mock,create)).AlwaysDo([&buf](Message& msg, size_t len)
+				{
+					msg.set_buffer(buf, sizeof(buf)); return NO_ERROR;
+				});
+		When(Method(mock,is_unreliable)).AlwaysReturn(false);
+		When(Method(mock,send)).AlwaysDo([&sent_length](Message& msg)
+				{
+					sent_length = msg.length(); return NO_ERROR;
+				});
+		MessageChannel& channel = mock.get();
+
+		Protocol* protocol = nullptr;
+		Publisher publisher(protocol);
+		publisher.set_batch_window(100);
+
+		int result1 = 1, result2 = 1;
+		REQUIRE(publisher.send_event(channel, "a", "1", 60, EventType::PRIVATE, 0, 0,
+				CompletionHandler(store_result, &result1))==NO_ERROR);
+		REQUIRE(publisher.send_event(channel, "bc", nullptr, 300, EventType::PUBLIC, 0, 10,
+				CompletionHandler(store_result, &result2))==NO_ERROR);
+
+		WHEN("the window has not elapsed")
+		{
+			REQUIRE(publisher.process(channel, 99)==NO_ERROR);
+			THEN("nothing is sent")
+			{
+				Verify(Method(mock,send)).Never();
+				REQUIRE(publisher.batched_events()==2);
+				REQUIRE(result1==1);
+			}
+		}
+
+		WHEN("the window has elapsed")
+		{
+			REQUIRE(publisher.process(channel, 100)==NO_ERROR);
+			THEN("the events are sent in a single message")
+			{
+				Verify(Method(mock,send)).Once();
+				REQUIRE(publisher.batched_events()==0);
+				REQUIRE(result1==SYSTEM_ERROR_NONE);
+				REQUIRE(result2==SYSTEM_ERROR_NONE);
+				const uint8_t expected[] = {
+					0x50, 0x02, 0x00, 0x00, 0xb1, 'B', 0xff,
+					EventType::PRIVATE, 0x00, 0x00, 60, 1, 'a', 0x00, 0x01, '1',
+					EventType::PUBLIC, 0x00, 0x01, 0x2c, 2, 'b', 'c', 0x00, 0x00
+				};
+				REQUIRE(sent_length==sizeof(expected));
+				REQUIRE(memcmp(buf, expected, sizeof(expected))==0);
+			}
+		}
+
+		WHEN("a system event is sent")
+		{
+			REQUIRE(publisher.send_event(channel, "spark/x", "1", 60, EventType::PRIVATE, 0, 20,
+					CompletionHandler())==NO_ERROR);
+			THEN("it is sent immediately")
+			{
+				Verify(Method(mock,send)).Once();
+				REQUIRE(publisher.batched_events()==2);
+			}
+		}
+
+		WHEN("the events don't fit into a single message")
+		{
+			std::string data(EVENT_BATCH_MAX_SIZE / 2, 'x');
+			REQUIRE(publisher.send_event(channel, "d", data.c_str(), 60, EventType::PRIVATE, 0, 20,
+					CompletionHandler())==NO_ERROR);
+			REQUIRE(publisher.send_event(channel, "e", data.c_str(), 60, EventType::PRIVATE, 0, 30,
+					CompletionHandler())==NO_ERROR);
+			THEN("the batch is flushed early")
+			{
+				Verify(Method(mock,send)).Once();
+				REQUIRE(result1==SYSTEM_ERROR_NONE);
+				REQUIRE(publisher.batched_events()==1);
+			}
+		}
+
+		WHEN("the publisher is cleared")
+		{
+			publisher.clear();
+			THEN("the batched events are cancelled")
+			{
+				REQUIRE(result1==SYSTEM_ERROR_ABORTED);
+				REQUIRE(publisher.batched_events()==0);
+			}
+		}
 	}
 }
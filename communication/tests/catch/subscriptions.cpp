@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "subscriptions.h"
+#include "messages.h"
+
+#include "catch.hpp"
+#include "fakeit.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace fakeit;
+using namespace particle::protocol;
+
+namespace {
+
+std::vector<std::string> g_received;
+
+void record_event(void* handler_data, const char* event_name, const char* data)
+{
+	g_received.push_back(std::string((const char*)handler_data) + ":" + event_name);
+}
+
+uint32_t sum_crc(const unsigned char* buf, uint32_t len)
+{
+	uint32_t crc = 0;
+	for (uint32_t i = 0; i < len; i++) {
+		crc = crc * 31 + buf[i];
+	}
+	return crc;
+}
+
+std::vector<EventView*> g_retained;
+
+void record_event_view(void* handler_data, const EventView* event)
+{
+	g_received.push_back(std::string((const char*)handler_data) + ":" + std::string(event->name, event->name_length)
+			+ ":" + std::string(event->data, event->data_length));
+}
+
+void retain_event_view(void* handler_data, const EventView* event)
+{
+	g_retained.push_back(event_view_retain(const_cast<EventView*>(event)));
+}
+
+Subscriptions* g_subscriptions = nullptr;
+
+void unsubscribe_all(void* handler_data, const char* event_name, const char* data)
+{
+	record_event(handler_data, event_name, data);
+	g_subscriptions->remove_event_handlers(nullptr);
+}
+
+void unsubscribe_temp(void* handler_data, const char* event_name, const char* data)
+{
+	record_event(handler_data, event_name, data);
+	g_subscriptions->remove_event_handlers("temp");
+}
+
+void subscribe_more(void* handler_data, const char* event_name, const char* data)
+{
+	record_event(handler_data, event_name, data);
+	static char added[] = "added";
+	REQUIRE(g_subscriptions->add_event_handler("te", (::EventHandler)record_event, added, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+	REQUIRE(g_subscriptions->add_event_handler("temp/inside/out", (::EventHandler)record_event, added, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+}
+
+void dispatch(Subscriptions& subscriptions, MessageChannel& channel, const char* name, uint8_t* buf, size_t size)
+{
+	const size_t len = Messages::event(buf, 0x1234, name, "data", 60, EventType::PUBLIC, false);
+	Message message(buf, size, len);
+	message.decode_id();
+	REQUIRE(subscriptions.handle_event(message, nullptr, channel)==NO_ERROR);
+}
+
+void dispatch(Subscriptions& subscriptions, MessageChannel& channel, const char* name)
+{
+	uint8_t buf[128];
+	dispatch(subscriptions, channel, name, buf, sizeof(buf));
+}
+
+} // namespace
+
+SCENARIO("subscriptions are matched by event name prefix")
+{
+	g_received.clear();
+	Mock<MessageChannel> mock;
+	MessageChannel& channel = mock.get();
+	Subscriptions subscriptions;
+
+	static char all[] = "all";
+	static char temp[] = "temp";
+	static char temp_in[] = "temp/in";
+	static char other[] = "other";
+	REQUIRE(subscriptions.add_event_handler("", (::EventHandler)record_event, all, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+	REQUIRE(subscriptions.add_event_handler("temp", (::EventHandler)record_event, temp, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+	REQUIRE(subscriptions.add_event_handler("temp/in", (::EventHandler)record_event, temp_in, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+	REQUIRE(subscriptions.add_event_handler("tea", (::EventHandler)record_event, other, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+
+	WHEN("an event matching several filters is received")
+	{
+		dispatch(subscriptions, channel, "temp/inside");
+		THEN("every handler with a matching filter is invoked")
+		{
+			REQUIRE(g_received.size()==3);
+			REQUIRE(g_received[0]=="all:temp/inside");
+			REQUIRE(g_received[1]=="temp:temp/inside");
+			REQUIRE(g_received[2]=="temp/in:temp/inside");
+		}
+	}
+
+	WHEN("an event that is shorter than a filter is received")
+	{
+		dispatch(subscriptions, channel, "te");
+		THEN("only the catch-all handler is invoked")
+		{
+			REQUIRE(g_received.size()==1);
+			REQUIRE(g_received[0]=="all:te");
+		}
+	}
+
+	WHEN("the handlers for a filter are removed")
+	{
+		subscriptions.remove_event_handlers("temp");
+		dispatch(subscriptions, channel, "temp/inside");
+		THEN("the handlers of the other filters are still invoked")
+		{
+			REQUIRE(g_received.size()==2);
+			REQUIRE(g_received[0]=="all:temp/inside");
+			REQUIRE(g_received[1]=="temp/in:temp/inside");
+		}
+	}
+
+	WHEN("all handlers are removed")
+	{
+		subscriptions.remove_event_handlers(nullptr);
+		dispatch(subscriptions, channel, "temp/inside");
+		THEN("no handler is invoked")
+		{
+			REQUIRE(g_received.empty());
+		}
+	}
+}
+
+SCENARIO("the subscriptions checksum does not depend on the order subscriptions were added")
+{
+	Subscriptions s1;
+	Subscriptions s2;
+	REQUIRE(s1.compute_subscriptions_checksum(sum_crc)==0);
+
+	REQUIRE(s1.add_event_handler("a", (::EventHandler)record_event, nullptr, SubscriptionScope::MY_DEVICES, nullptr)==NO_ERROR);
+	const uint32_t crc_a = s1.compute_subscriptions_checksum(sum_crc);
+	REQUIRE(crc_a!=0);
+	REQUIRE(s1.add_event_handler("b", (::EventHandler)record_event, nullptr, SubscriptionScope::MY_DEVICES, nullptr)==NO_ERROR);
+	const uint32_t crc_ab = s1.compute_subscriptions_checksum(sum_crc);
+	REQUIRE(crc_ab!=crc_a);
+
+	REQUIRE(s2.add_event_handler("b", (::EventHandler)record_event, nullptr, SubscriptionScope::MY_DEVICES, nullptr)==NO_ERROR);
+	REQUIRE(s2.add_event_handler("a", (::EventHandler)record_event, nullptr, SubscriptionScope::MY_DEVICES, nullptr)==NO_ERROR);
+	REQUIRE(s2.compute_subscriptions_checksum(sum_crc)==crc_ab);
+
+	s1.remove_event_handlers("b");
+	REQUIRE(s1.compute_subscriptions_checksum(sum_crc)==crc_a);
+}
+
+SCENARIO("view handlers receive the event without copies of the name and data")
+{
+	g_received.clear();
+	g_retained.clear();
+	Mock<MessageChannel> mock;
+	MessageChannel& channel = mock.get();
+	Subscriptions subscriptions;
+
+	static char view[] = "view";
+	REQUIRE(subscriptions.add_event_handler("temp", (::EventHandler)record_event_view, view, SubscriptionScope::FIREHOSE, nullptr, EventHandlerFlag::VIEW)==NO_ERROR);
+
+	WHEN("an event is received")
+	{
+		uint8_t buf[128];
+		memset(buf, 0xaa, sizeof(buf));
+		dispatch(subscriptions, channel, "temp/inside", buf, sizeof(buf));
+		THEN("the handler receives the name and data with their lengths")
+		{
+			REQUIRE(g_received.size()==1);
+			REQUIRE(g_received[0]=="view:temp/inside:data");
+		}
+		THEN("the message buffer is not modified")
+		{
+			uint8_t expected[128];
+			memset(expected, 0xaa, sizeof(expected));
+			const size_t len = Messages::event(expected, 0x1234, "temp/inside", "data", 60, EventType::PUBLIC, false);
+			REQUIRE(memcmp(buf, expected, len + 1)==0);
+		}
+	}
+
+	WHEN("several handlers retain the event")
+	{
+		static char first[] = "first";
+		static char second[] = "second";
+		REQUIRE(subscriptions.add_event_handler("temp", (::EventHandler)retain_event_view, first, SubscriptionScope::FIREHOSE, nullptr, EventHandlerFlag::VIEW)==NO_ERROR);
+		REQUIRE(subscriptions.add_event_handler("", (::EventHandler)retain_event_view, second, SubscriptionScope::FIREHOSE, nullptr, EventHandlerFlag::VIEW)==NO_ERROR);
+		uint8_t buf[128];
+		dispatch(subscriptions, channel, "temp/inside", buf, sizeof(buf));
+		memset(buf, 0, sizeof(buf));
+		THEN("they share a single copy of the event that outlives the message buffer")
+		{
+			REQUIRE(g_retained.size()==2);
+			REQUIRE(g_retained[0]!=nullptr);
+			REQUIRE(g_retained[0]==g_retained[1]);
+			const EventView* event = g_retained[0];
+			REQUIRE(std::string(event->name, event->name_length)=="temp/inside");
+			REQUIRE(std::string(event->data, event->data_length)=="data");
+		}
+		for (EventView* event: g_retained) {
+			event_view_release(event);
+		}
+	}
+}
+
+SCENARIO("a handler can unsubscribe while an event is dispatched")
+{
+	g_received.clear();
+	Mock<MessageChannel> mock;
+	MessageChannel& channel = mock.get();
+	Subscriptions subscriptions;
+	g_subscriptions = &subscriptions;
+
+	static char first[] = "first";
+	static char second[] = "second";
+	static char third[] = "third";
+	REQUIRE(subscriptions.add_event_handler("temp", (::EventHandler)record_event, first, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+	REQUIRE(subscriptions.add_event_handler("temp", (::EventHandler)unsubscribe_all, second, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+	REQUIRE(subscriptions.add_event_handler("temp/in", (::EventHandler)record_event, third, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+
+	WHEN("a handler removes all subscriptions")
+	{
+		dispatch(subscriptions, channel, "temp/inside");
+		THEN("the handlers invoked before it are not affected and the others are not invoked")
+		{
+			REQUIRE(g_received.size()==2);
+			REQUIRE(g_received[0]=="first:temp/inside");
+			REQUIRE(g_received[1]=="second:temp/inside");
+		}
+		THEN("the next event is not dispatched")
+		{
+			g_received.clear();
+			dispatch(subscriptions, channel, "temp/inside");
+			REQUIRE(g_received.empty());
+		}
+	}
+	g_subscriptions = nullptr;
+}
+
+SCENARIO("a handler can change the subscriptions for the event being dispatched")
+{
+	g_received.clear();
+	Mock<MessageChannel> mock;
+	MessageChannel& channel = mock.get();
+	Subscriptions subscriptions;
+	g_subscriptions = &subscriptions;
+
+	static char first[] = "first";
+	static char second[] = "second";
+	static char third[] = "third";
+
+	WHEN("a handler removes the subscriptions with its own filter")
+	{
+		REQUIRE(subscriptions.add_event_handler("temp", (::EventHandler)unsubscribe_temp, first, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+		REQUIRE(subscriptions.add_event_handler("temp", (::EventHandler)record_event, second, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+		REQUIRE(subscriptions.add_event_handler("temp/in", (::EventHandler)record_event, third, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+		const uint32_t checksum = [&]() {
+			Subscriptions s;
+			REQUIRE(s.add_event_handler("temp/in", (::EventHandler)record_event, third, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+			return s.compute_subscriptions_checksum(sum_crc);
+		}();
+		dispatch(subscriptions, channel, "temp/inside");
+		THEN("the removed handlers are not invoked and the others are")
+		{
+			REQUIRE(g_received.size()==2);
+			REQUIRE(g_received[0]=="first:temp/inside");
+			REQUIRE(g_received[1]=="third:temp/inside");
+		}
+		THEN("only the subscriptions with other filters remain")
+		{
+			REQUIRE(subscriptions.compute_subscriptions_checksum(sum_crc)==checksum);
+			g_received.clear();
+			dispatch(subscriptions, channel, "temp/inside");
+			REQUIRE(g_received.size()==1);
+			REQUIRE(g_received[0]=="third:temp/inside");
+		}
+	}
+
+	WHEN("a handler adds subscriptions")
+	{
+		REQUIRE(subscriptions.add_event_handler("temp", (::EventHandler)subscribe_more, first, SubscriptionScope::FIREHOSE, nullptr)==NO_ERROR);
+		dispatch(subscriptions, channel, "temp/inside/out");
+		THEN("the new subscriptions receive the next event")
+		{
+			g_received.clear();
+			subscriptions.remove_event_handlers("temp");
+			dispatch(subscriptions, channel, "temp/inside/out");
+			REQUIRE(g_received.size()==2);
+			REQUIRE(g_received[0]=="added:temp/inside/out");
+			REQUIRE(g_received[1]=="added:temp/inside/out");
+		}
+	}
+	g_subscriptions = nullptr;
+}
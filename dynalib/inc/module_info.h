@@ -174,6 +174,34 @@ typedef struct module_info_crc_t {
     uint32_t crc32;
 } __attribute__((packed)) module_info_crc_t;
 
+#define MODULE_ENCODED_MAGIC 0x434e4550 /* "PENC" */
+
+typedef enum module_encoded_flags_t {
+    MODULE_ENCODED_FLAG_NONE = 0x0000,
+    /* The payload is a delta patch against the currently installed module */
+    MODULE_ENCODED_FLAG_DELTA = 0x0001,
+    /* The payload is compressed with raw deflate. Compression is applied after the delta encoding */
+    MODULE_ENCODED_FLAG_COMPRESSED = 0x0002
+} module_encoded_flags_t;
+
+/**
+ * The header of an encoded module image. An encoded image is stored in the OTA region like a
+ * regular module and is decoded into the module it describes before the module is validated.
+ */
+typedef struct module_encoded_header_t {
+    uint32_t magic;                     /* MODULE_ENCODED_MAGIC */
+    uint16_t size;                      /* size of this header */
+    uint16_t flags;                     /* see module_encoded_flags_t */
+    uint32_t payload_size;              /* the number of bytes following the header */
+    uint32_t decoded_size;              /* size of the decoded module, including the CRC */
+    uint8_t source_function;            /* the module a delta patch applies to */
+    uint8_t source_index;
+    uint16_t reserved;
+    uint8_t source_sha[32];             /* SHA-256 found in the suffix of the source module */
+} __attribute__((packed)) module_encoded_header_t;
+
+PARTICLE_STATIC_ASSERT(module_encoded_header_size, sizeof(module_encoded_header_t) == 52);
+
 extern const module_info_t module_info;
 extern const module_info_suffix_t module_info_suffix;
 extern const module_info_crc_t module_info_crc;
@@ -34,6 +34,35 @@
 
 /* Exported types ------------------------------------------------------------*/
 
+/**
+ * Flags of the EEPROM flush policy.
+ */
+typedef enum hal_eeprom_flush_policy_flag {
+    HAL_EEPROM_FLUSH_POLICY_BEFORE_SLEEP = 0x01 ///< Flush the pending changes before entering a sleep mode.
+} hal_eeprom_flush_policy_flag;
+
+/**
+ * Policy for writing the changes made to the EEPROM to the persistent storage.
+ *
+ * The changes are buffered in RAM and written out when `delay` milliseconds have passed since
+ * the first unflushed change or when more than `max_pending_size` bytes have changed, whichever
+ * happens first. A delay of 0 disables buffering, which is the default.
+ */
+typedef struct hal_eeprom_flush_policy {
+    uint16_t size; ///< Size of this structure.
+    uint16_t flags; ///< Policy flags (a combination of the `hal_eeprom_flush_policy_flag` flags).
+    uint32_t delay; ///< Maximum time in milliseconds the changes can stay unflushed.
+    uint32_t max_pending_size; ///< Maximum number of changed bytes that can stay unflushed.
+} hal_eeprom_flush_policy;
+
+/**
+ * Flags for `hal_eeprom_flush()`.
+ */
+typedef enum hal_eeprom_flush_flag {
+    HAL_EEPROM_FLUSH_IF_DUE = 0x01, ///< Flush only if required by the flush policy.
+    HAL_EEPROM_FLUSH_SLEEP = 0x02 ///< The device is about to enter a sleep mode.
+} hal_eeprom_flush_flag;
+
 /* Exported constants --------------------------------------------------------*/
 
 /* Exported macros -----------------------------------------------------------*/
@@ -54,6 +83,33 @@ void HAL_EEPROM_Clear();
 bool HAL_EEPROM_Has_Pending_Erase();
 void HAL_EEPROM_Perform_Pending_Erase();
 
+/**
+ * Set the policy for flushing the changes made to the EEPROM.
+ *
+ * @param policy Flush policy.
+ * @param reserved Reserved argument. Should be set to `NULL`.
+ * @return 0 on success or a negative result code in case of an error.
+ */
+int hal_eeprom_set_flush_policy(const hal_eeprom_flush_policy* policy, void* reserved);
+
+/**
+ * Get the current flush policy.
+ *
+ * @param policy[out] Flush policy.
+ * @param reserved Reserved argument. Should be set to `NULL`.
+ * @return 0 on success or a negative result code in case of an error.
+ */
+int hal_eeprom_get_flush_policy(hal_eeprom_flush_policy* policy, void* reserved);
+
+/**
+ * Write the pending changes to the persistent storage.
+ *
+ * @param flags Flags (a combination of the `hal_eeprom_flush_flag` flags).
+ * @param reserved Reserved argument. Should be set to `NULL`.
+ * @return 0 on success or a negative result code in case of an error.
+ */
+int hal_eeprom_flush(int flags, void* reserved);
+
 #ifdef __cplusplus
 }
 #endif
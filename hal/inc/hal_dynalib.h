@@ -23,6 +23,7 @@
 #pragma once
 
 #include "dynalib.h"
+#include "hal_platform.h"
 
 #ifdef DYNALIB_EXPORT
 #include "rng_hal.h"
@@ -84,6 +85,12 @@ DYNALIB_FN(BASE_IDX + 20, hal, HAL_RTC_Time_Is_Valid, uint8_t(void*))
 DYNALIB_FN(BASE_IDX + 21, hal, hal_timer_millis, uint64_t(void*))
 DYNALIB_FN(BASE_IDX + 22, hal, hal_timer_micros, uint64_t(void*))
 
+#if HAL_PLATFORM_FILESYSTEM
+DYNALIB_FN(BASE_IDX + 23, hal, hal_eeprom_set_flush_policy, int(const hal_eeprom_flush_policy*, void*))
+DYNALIB_FN(BASE_IDX + 24, hal, hal_eeprom_get_flush_policy, int(hal_eeprom_flush_policy*, void*))
+DYNALIB_FN(BASE_IDX + 25, hal, hal_eeprom_flush, int(int, void*))
+#endif // HAL_PLATFORM_FILESYSTEM
+
 DYNALIB_END(hal)
 
 #undef BASE_IDX
@@ -258,6 +258,64 @@ int sock_socket(int domain, int type, int protocol);
  */
 int sock_fcntl(int s, int cmd, ...);
 
+/**
+ * Waits for one of a set of sockets to become ready to perform I/O.
+ *
+ * @param[inout]  fds      an array of pollfd structures, each specifying a socket and
+ *                         the events of interest; on return, the revents field of each
+ *                         structure contains the events that occurred
+ * @param[in]     nfds     number of elements in fds
+ * @param[in]     timeout  maximum time to wait in milliseconds, 0 to return immediately
+ *                         or a negative value to wait indefinitely
+ *
+ * @returns       On success, the number of sockets that have a nonzero revents field,
+ *                0 if the timeout expired. On error, -1 is returned, and errno is set appropriately.
+ */
+int sock_poll(struct pollfd* fds, nfds_t nfds, int timeout);
+
+/**
+ * Waits for one of a set of sockets to become ready to perform I/O.
+ *
+ * @param[in]     nfds       the highest-numbered socket in any of the three sets, plus 1
+ * @param[inout]  readfds    (optional) sockets to be checked for readability
+ * @param[inout]  writefds   (optional) sockets to be checked for writability
+ * @param[inout]  exceptfds  (optional) sockets to be checked for errors
+ * @param[in]     timeout    (optional) maximum time to wait, or NULL to wait indefinitely
+ *
+ * @returns       On success, the number of sockets contained in the three returned sets,
+ *                0 if the timeout expired. On error, -1 is returned, and errno is set appropriately.
+ */
+int sock_select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds,
+                struct timeval* timeout);
+
+/**
+ * Send a message on a socket, gathering the data from multiple buffers.
+ *
+ * @param[in]  s      a socket that has been created with sock_socket()
+ * @param[in]  msg    a pointer to a msghdr structure describing the buffers to send
+ *                    (msg_iov, msg_iovlen) and, optionally, the destination address
+ *                    (msg_name, msg_namelen) for connectionless sockets
+ * @param[in]  flags  a bitwise OR of zero or more flags
+ *
+ * @returns    On success, the number of bytes sent. On error, -1 is returned,
+ *             and errno is set appropriately.
+ */
+ssize_t sock_sendmsg(int s, const struct msghdr* msg, int flags);
+
+/**
+ * Receive a message from a socket, scattering the data into multiple buffers.
+ *
+ * @param[in]     s      a socket that has been created with sock_socket()
+ * @param[inout]  msg    a pointer to a msghdr structure describing the buffers to fill
+ *                       (msg_iov, msg_iovlen) and, optionally, a buffer for the source
+ *                       address (msg_name, msg_namelen)
+ * @param[in]     flags  a bitwise OR of zero or more flags
+ *
+ * @returns    On success, the number of bytes received. On error, -1 is returned,
+ *             and errno is set appropriately.
+ */
+ssize_t sock_recvmsg(int s, struct msghdr* msg, int flags);
+
 /**
  * @}
  *
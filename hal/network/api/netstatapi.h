@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETWORK_API_NETSTATAPI_H
+#define NETWORK_API_NETSTATAPI_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Network stack memory usage and TCP counters, accumulated since boot.
+ */
+typedef struct netstat_info {
+    uint16_t size; // Size of this structure
+    uint16_t reserved; // Reserved (should be set to 0)
+    uint32_t pbuf_pool_size; // Number of buffers in the pbuf pool
+    uint32_t pbuf_pool_used; // Number of buffers currently in use
+    uint32_t pbuf_pool_max; // Maximum number of buffers that were in use at the same time
+    uint32_t pbuf_pool_errors; // Number of failed allocations from the pbuf pool
+    uint32_t heap_used; // Number of bytes of heap memory currently allocated by the stack
+    uint32_t heap_max; // Maximum number of bytes of heap memory allocated by the stack
+    uint32_t heap_errors; // Number of failed heap allocations
+    uint32_t tcp_sent; // Number of TCP segments sent
+    uint32_t tcp_received; // Number of TCP segments received
+    uint32_t tcp_retransmits; // Number of TCP segments retransmitted
+    uint32_t tcp_dropped; // Number of received TCP segments that were dropped
+} netstat_info;
+
+/**
+ * Retrieves the network stack statistics.
+ *
+ * @param info The structure to fill in. The `size` field should be set to the size of the structure.
+ * @param reserved Reserved argument (should be set to NULL).
+ * @return 0 on success, or a negative result code in case of an error.
+ */
+int netstat_get_info(netstat_info* info, void* reserved);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* NETWORK_API_NETSTATAPI_H */
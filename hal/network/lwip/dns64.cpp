@@ -16,10 +16,12 @@
  */
 
 #include "dns64.h"
+#include "dns_cache.h"
 
 #include "socket_hal_posix.h"
 
 #include "system_error.h"
+#include "check.h"
 #include "logging.h"
 
 #include "lwiplock.h"
@@ -27,22 +29,14 @@
 
 #include "lwip/dns.h"
 
+#include <algorithm>
+
 LOG_SOURCE_CATEGORY("net.dns64")
 
 #ifndef DEBUG_DNS64
 #define DEBUG_DNS64 0
 #endif
 
-// TODO: Move this macro to a global header
-#define CHECK(_expr) \
-        ({ \
-            const auto _ret = _expr; \
-            if (_ret < 0) { \
-                return _ret; \
-            } \
-            _ret; \
-        })
-
 #define CHECK_SOCKET(_expr) \
         ({ \
             const auto _ret = _expr; \
@@ -128,9 +122,12 @@ struct Record { // RFC 1035, 4.1.3
 // Maximum size of a UDP message
 const size_t MAX_MESSAGE_SIZE = 512; // RFC 1035, 2.3.4
 
-// Value of the TTL field sent in all response messages
+// Value of the TTL field sent in response messages if the TTL of the upstream record is not known
 const uint32_t DEFAULT_TTL = 0; // Do not cache (RFC 1035, 4.1.3)
 
+// Maximum TTL of a synthesized AAAA record if the TTL of the negative AAAA answer is not known
+const uint32_t MAX_SYNTHESIZED_TTL = 600; // RFC 6147, 5.1.7
+
 // Timeout for select() in milliseconds
 const unsigned SOCKET_RECV_TIMEOUT = 1000;
 
@@ -193,7 +190,7 @@ ssize_t writeRecord(char* data, size_t size, const Record& r) {
     Record rr = {};
     rr.type = lwip_htons(r.type);
     rr.cls = lwip_htons(r.cls);
-    rr.ttl = lwip_htons(r.ttl);
+    rr.ttl = lwip_htonl(r.ttl);
     rr.rdlength = lwip_htons(r.rdlength);
     memcpy(data, &rr, sizeof(Record));
     return sizeof(Record);
@@ -504,6 +501,20 @@ int Dns64::sendResponse(const ip_addr_t& addr, const char* name, const Query& q,
     r.type = IP_IS_V6(&raddr) ? Type::AAAA : Type::A;
     r.cls = Class::IN;
     r.ttl = DEFAULT_TTL;
+    uint32_t ttl = 0;
+    const uint8_t addrType = IP_IS_V6(&addr) ? LWIP_DNS_ADDRTYPE_IPV6 : LWIP_DNS_ADDRTYPE_IPV4;
+    if (DnsCache::instance()->lookup(name, addrType, nullptr, &ttl) == DnsCache::FOUND) {
+        r.ttl = ttl;
+        if (IP_IS_V6(&raddr) && !IP_IS_V6(&addr)) {
+            // The TTL of a synthesized record should not exceed the TTL of the original A record
+            // and the negative caching TTL of the AAAA query that triggered the synthesis
+            uint32_t negTtl = 0;
+            if (DnsCache::instance()->lookup(name, LWIP_DNS_ADDRTYPE_IPV6, nullptr, &negTtl) != DnsCache::NOT_FOUND) {
+                negTtl = MAX_SYNTHESIZED_TTL;
+            }
+            r.ttl = std::min(r.ttl, negTtl);
+        }
+    }
     r.rdlength = addrSize;
     data += CHECK(writeRecord(data, end - data, r));
     if (end - data < (ptrdiff_t)addrSize) {
@@ -547,6 +558,20 @@ int Dns64::sendErrorResponse(int error, const char* name, const Query& q, Contex
 }
 
 int Dns64::getHostByName(const char* name, ip_addr_t* addr, Query* q) {
+    for (;;) {
+        const uint8_t addrType = (q->type == Type::A) ? LWIP_DNS_ADDRTYPE_IPV4 : LWIP_DNS_ADDRTYPE_IPV6;
+        const auto r = DnsCache::instance()->lookup(name, addrType, addr);
+        if (r == DnsCache::FOUND) {
+            return GetHostByNameResult::DONE;
+        }
+        if (r == DnsCache::MISS) {
+            break;
+        }
+        if (q->type != Type::AAAA) {
+            return SYSTEM_ERROR_NOT_FOUND;
+        }
+        q->type = Type::A; // There's no cached IPv6 address, try getting an IPv4 address
+    }
     const uint8_t addrType = (q->type == Type::A) ? LWIP_DNS_ADDRTYPE_IPV4 : LWIP_DNS_ADDRTYPE_IPV6;
     LwipTcpIpCoreLock lock; // LwIP's DNS client API is not thread-safe
     const auto lwipRet = dns_gethostbyname_addrtype(name, addr, Dns64::dnsCallback, q, addrType);
@@ -565,6 +590,7 @@ void Dns64::dnsCallback(const char* name, const ip_addr_t* addr, void* data) {
     if (!name) {
         return;
     }
+    DnsCache::instance()->confirm(name, (q->type == Type::A) ? LWIP_DNS_ADDRTYPE_IPV4 : LWIP_DNS_ADDRTYPE_IPV6, addr);
     const auto ctx = q->ctx.lock();
     if (!ctx) {
         return;
@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dns_cache.h"
+
+#include "system_error.h"
+#include "check.h"
+#include "timer_hal.h"
+#include "logging.h"
+
+#include "lwiplock.h"
+
+#include "lwip/dns.h"
+#include "lwip/pbuf.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
+
+#include <cstring>
+#include <strings.h>
+
+LOG_SOURCE_CATEGORY("net.dnsc")
+
+namespace particle {
+
+namespace net {
+
+namespace {
+
+// Message header flags
+enum HeaderFlag { // RFC 1035, 4.1.1
+    QR = 0x8000,
+    OPCODE_MASK = 0x7800,
+    OPCODE_QUERY = 0x0000,
+    TC = 0x0200,
+    RCODE_MASK = 0x000f,
+    RCODE_NO_ERROR = 0x0000,
+    RCODE_NAME_ERROR = 0x0003
+};
+
+// TYPE values
+enum Type {
+    A = 1, // RFC 1035, 3.2.2
+    CNAME = 5, // RFC 1035, 3.2.2
+    SOA = 6, // RFC 1035, 3.2.2
+    AAAA = 28 // RFC 3596, 2.1
+};
+
+// CLASS values
+enum Class {
+    IN = 1 // RFC 1035, 3.2.4
+};
+
+const uint16_t DNS_SERVER_PORT = 53;
+
+// Maximum size of a UDP message
+const size_t MAX_MESSAGE_SIZE = 512; // RFC 1035, 2.3.4
+
+// Maximum length of a domain name, not including the term. null byte. Longer names cannot be
+// resolved by lwIP anyway
+const size_t MAX_NAME_LENGTH = DNS_MAX_NAME_LENGTH;
+
+// Maximum number of compression pointers followed while reading a name
+const unsigned MAX_NAME_POINTERS = 16;
+
+class Reader {
+public:
+    Reader(const char* data, size_t size) :
+            begin_((const uint8_t*)data),
+            end_(begin_ + size),
+            p_(begin_) {
+    }
+
+    int readU16(uint16_t* val) {
+        if (end_ - p_ < 2) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        *val = ((uint16_t)p_[0] << 8) | p_[1];
+        p_ += 2;
+        return 0;
+    }
+
+    int readU32(uint32_t* val) {
+        uint16_t hi = 0, lo = 0;
+        CHECK(readU16(&hi));
+        CHECK(readU16(&lo));
+        *val = ((uint32_t)hi << 16) | lo;
+        return 0;
+    }
+
+    int readData(const uint8_t** data, size_t size) {
+        if ((size_t)(end_ - p_) < size) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        *data = p_;
+        p_ += size;
+        return 0;
+    }
+
+    // Reads a possibly compressed domain name (RFC 1035, 4.1.4). If `name` is null, the name is
+    // skipped
+    int readName(char* name, size_t size) {
+        const uint8_t* p = p_;
+        const uint8_t* next = nullptr; // Position following the name in the message
+        size_t len = 0;
+        unsigned ptrs = 0;
+        for (;;) {
+            if (p >= end_) {
+                return SYSTEM_ERROR_BAD_DATA;
+            }
+            const size_t n = *p;
+            if ((n & 0xc0) == 0xc0) {
+                if (end_ - p < 2 || ++ptrs > MAX_NAME_POINTERS) {
+                    return SYSTEM_ERROR_BAD_DATA;
+                }
+                if (!next) {
+                    next = p + 2;
+                }
+                p = begin_ + (((n & 0x3f) << 8) | p[1]);
+                continue;
+            }
+            if (n & 0xc0) {
+                return SYSTEM_ERROR_BAD_DATA;
+            }
+            ++p;
+            if (!n) {
+                break;
+            }
+            if ((size_t)(end_ - p) < n) {
+                return SYSTEM_ERROR_BAD_DATA;
+            }
+            if (name) {
+                if (len + n + 1 >= size) {
+                    return SYSTEM_ERROR_TOO_LARGE;
+                }
+                if (len) {
+                    name[len++] = '.';
+                }
+                memcpy(name + len, p, n);
+                len += n;
+            }
+            p += n;
+        }
+        if (name) {
+            name[len] = '\0';
+        }
+        p_ = next ? next : p;
+        return 0;
+    }
+
+private:
+    const uint8_t* begin_;
+    const uint8_t* end_;
+    const uint8_t* p_;
+};
+
+uint32_t minTtl(uint32_t ttl1, uint32_t ttl2) {
+    return (ttl1 < ttl2) ? ttl1 : ttl2;
+}
+
+bool isExpired(uint32_t expiry, uint32_t now) {
+    return (int32_t)(expiry - now) <= 0;
+}
+
+} // particle::net::
+
+DnsCache::Result DnsCache::lookup(const char* name, uint8_t addrType, ip_addr_t* addr, uint32_t* ttl) {
+    const LwipTcpIpCoreLock lock;
+    const uint32_t now = HAL_Timer_Get_Milli_Seconds();
+    const auto e = find(name, addrType, now);
+    if (!e) {
+        return Result::MISS;
+    }
+    e->lastUsed = now;
+    if (ttl) {
+        *ttl = (e->expiry - now) / 1000;
+    }
+    if (!e->found) {
+        return Result::NOT_FOUND;
+    }
+    if (addr) {
+        ip_addr_copy(*addr, e->addr);
+    }
+    return Result::FOUND;
+}
+
+void DnsCache::addAddress(const char* name, const ip_addr_t& addr, uint32_t ttl) {
+    const LwipTcpIpCoreLock lock;
+    const uint8_t addrType = IP_IS_V6(&addr) ? LWIP_DNS_ADDRTYPE_IPV6 : LWIP_DNS_ADDRTYPE_IPV4;
+    const auto e = add(name, addrType, minTtl(ttl, MAX_TTL), HAL_Timer_Get_Milli_Seconds());
+    if (e) {
+        ip_addr_copy(e->addr, addr);
+        e->found = true;
+    }
+}
+
+void DnsCache::addNotFound(const char* name, uint8_t addrType, uint32_t ttl) {
+    const LwipTcpIpCoreLock lock;
+    const auto e = add(name, addrType, minTtl(ttl, MAX_NEGATIVE_TTL), HAL_Timer_Get_Milli_Seconds());
+    if (e) {
+        e->found = false;
+    }
+}
+
+int DnsCache::processResponse(const char* data, size_t size) {
+    Reader r(data, size);
+    // Parse the header section
+    uint16_t id = 0, flags = 0, qdcount = 0, ancount = 0, nscount = 0, arcount = 0;
+    CHECK(r.readU16(&id));
+    CHECK(r.readU16(&flags));
+    CHECK(r.readU16(&qdcount));
+    CHECK(r.readU16(&ancount));
+    CHECK(r.readU16(&nscount));
+    CHECK(r.readU16(&arcount));
+    if (!(flags & HeaderFlag::QR) || (flags & HeaderFlag::OPCODE_MASK) != HeaderFlag::OPCODE_QUERY ||
+            (flags & HeaderFlag::TC) || qdcount != 1) {
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+    const uint16_t rcode = flags & HeaderFlag::RCODE_MASK;
+    if (rcode != HeaderFlag::RCODE_NO_ERROR && rcode != HeaderFlag::RCODE_NAME_ERROR) {
+        return SYSTEM_ERROR_NOT_SUPPORTED; // Transient errors are not cached
+    }
+    // Parse the question section
+    char qname[MAX_NAME_LENGTH + 1] = {};
+    uint16_t qtype = 0, qclass = 0;
+    CHECK(r.readName(qname, sizeof(qname)));
+    CHECK(r.readU16(&qtype));
+    CHECK(r.readU16(&qclass));
+    if ((qtype != Type::A && qtype != Type::AAAA) || qclass != Class::IN || !qname[0]) {
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+    // Parse the answer section. The first address of the requested type is cached, following
+    // the CNAME chain if necessary
+    char target[MAX_NAME_LENGTH + 1] = {};
+    strcpy(target, qname);
+    uint32_t ttl = MAX_TTL;
+    for (unsigned i = 0; i < ancount; ++i) {
+        char name[MAX_NAME_LENGTH + 1] = {};
+        uint16_t type = 0, cls = 0, rdlength = 0;
+        uint32_t rrTtl = 0;
+        CHECK(r.readName(name, sizeof(name)));
+        CHECK(r.readU16(&type));
+        CHECK(r.readU16(&cls));
+        CHECK(r.readU32(&rrTtl));
+        CHECK(r.readU16(&rdlength));
+        Reader rdata(r);
+        const uint8_t* d = nullptr;
+        CHECK(r.readData(&d, rdlength));
+        if (cls != Class::IN || strcasecmp(name, target) != 0) {
+            continue;
+        }
+        if (type == Type::CNAME) {
+            CHECK(rdata.readName(target, sizeof(target)));
+            ttl = minTtl(ttl, rrTtl);
+        } else if (type == qtype && type == Type::A && rdlength == 4) {
+            ip_addr_t addr = {};
+            IP_SET_TYPE_VAL(addr, IPADDR_TYPE_V4);
+            memcpy(ip_2_ip4(&addr), d, 4);
+            addResponse(qname, LWIP_DNS_ADDRTYPE_IPV4, &addr, minTtl(ttl, rrTtl));
+            return 0;
+        } else if (type == qtype && type == Type::AAAA && rdlength == 16) {
+            ip_addr_t addr = {};
+            IP_SET_TYPE_VAL(addr, IPADDR_TYPE_V6);
+            memcpy(ip_2_ip6(&addr)->addr, d, 16);
+            addResponse(qname, LWIP_DNS_ADDRTYPE_IPV6, &addr, minTtl(ttl, rrTtl));
+            return 0;
+        }
+    }
+    // No address found, look for an SOA record in the authority section (RFC 2308, 5)
+    for (unsigned i = 0; i < nscount; ++i) {
+        uint16_t type = 0, cls = 0, rdlength = 0;
+        uint32_t rrTtl = 0;
+        CHECK(r.readName(nullptr, 0));
+        CHECK(r.readU16(&type));
+        CHECK(r.readU16(&cls));
+        CHECK(r.readU32(&rrTtl));
+        CHECK(r.readU16(&rdlength));
+        Reader rdata(r);
+        const uint8_t* d = nullptr;
+        CHECK(r.readData(&d, rdlength));
+        if (type != Type::SOA || cls != Class::IN) {
+            continue;
+        }
+        uint32_t serial = 0, refresh = 0, retry = 0, expire = 0, minimum = 0;
+        CHECK(rdata.readName(nullptr, 0)); // MNAME
+        CHECK(rdata.readName(nullptr, 0)); // RNAME
+        CHECK(rdata.readU32(&serial));
+        CHECK(rdata.readU32(&refresh));
+        CHECK(rdata.readU32(&retry));
+        CHECK(rdata.readU32(&expire));
+        CHECK(rdata.readU32(&minimum));
+        const uint32_t negTtl = minTtl(ttl, minTtl(rrTtl, minimum));
+        if (rcode == HeaderFlag::RCODE_NAME_ERROR) {
+            // The name doesn't exist, so there are no addresses of either type
+            addResponse(qname, LWIP_DNS_ADDRTYPE_IPV4_IPV6, nullptr, negTtl);
+        } else {
+            addResponse(qname, (qtype == Type::A) ? LWIP_DNS_ADDRTYPE_IPV4 : LWIP_DNS_ADDRTYPE_IPV6, nullptr, negTtl);
+        }
+        return 0;
+    }
+    // Negative responses without an SOA record are not cached
+    return SYSTEM_ERROR_NOT_FOUND;
+}
+
+void DnsCache::confirm(const char* name, uint8_t addrType, const ip_addr_t* addr) {
+    const LwipTcpIpCoreLock lock;
+    const uint32_t now = HAL_Timer_Get_Milli_Seconds();
+    for (auto& r: unconfirmed_) {
+        if (!r.name || (r.addrType != addrType && r.addrType != LWIP_DNS_ADDRTYPE_IPV4_IPV6) ||
+                strcasecmp(r.name.get(), name) != 0) {
+            continue;
+        }
+        if (!isExpired(r.received + UNCONFIRMED_TIMEOUT, now)) {
+            if (addr && r.found && ip_addr_cmp(addr, &r.addr)) {
+                addAddress(r.name.get(), r.addr, r.ttl);
+            } else if (!addr && !r.found) {
+                if (r.addrType == LWIP_DNS_ADDRTYPE_IPV4_IPV6) {
+                    addNotFound(r.name.get(), LWIP_DNS_ADDRTYPE_IPV4, r.ttl);
+                    addNotFound(r.name.get(), LWIP_DNS_ADDRTYPE_IPV6, r.ttl);
+                } else {
+                    addNotFound(r.name.get(), r.addrType, r.ttl);
+                }
+            }
+            // A response that doesn't match the result of the lookup is discarded
+        }
+        r.name.reset();
+        break;
+    }
+}
+
+void DnsCache::ip4Input(pbuf* p, const ip_hdr* iphdr) {
+    if (IPH_PROTO(iphdr) != IP_PROTO_UDP || (IPH_OFFSET(iphdr) & PP_HTONS(IP_OFFMASK | IP_MF)) != 0) {
+        return;
+    }
+    const uint16_t hlen = IPH_HL_BYTES(iphdr);
+    udp_hdr udphdr = {};
+    if (pbuf_copy_partial(p, &udphdr, UDP_HLEN, hlen) != UDP_HLEN || lwip_ntohs(udphdr.src) != DNS_SERVER_PORT) {
+        return;
+    }
+    // Only responses from the configured servers are trusted
+    ip_addr_t src = {};
+    IP_SET_TYPE_VAL(src, IPADDR_TYPE_V4);
+    ip4_addr_copy(*ip_2_ip4(&src), iphdr->src);
+    bool fromServer = false;
+    for (int i = 0; i < DNS_MAX_SERVERS && !fromServer; ++i) {
+        fromServer = ip_addr_cmp(&src, dns_getserver(i));
+    }
+    if (!fromServer) {
+        return;
+    }
+    const uint16_t udpLen = lwip_ntohs(udphdr.len);
+    if (udpLen <= UDP_HLEN || (size_t)(udpLen - UDP_HLEN) > MAX_MESSAGE_SIZE) {
+        return;
+    }
+    const uint16_t size = udpLen - UDP_HLEN;
+    std::unique_ptr<char[]> buf(new(std::nothrow) char[size]);
+    if (!buf || pbuf_copy_partial(p, buf.get(), size, hlen + UDP_HLEN) != size) {
+        return;
+    }
+    const int r = processResponse(buf.get(), size);
+    if (r < 0 && r != SYSTEM_ERROR_NOT_FOUND && r != SYSTEM_ERROR_NOT_SUPPORTED) {
+        LOG_DEBUG(TRACE, "Unable to parse DNS response: %d", r);
+    }
+}
+
+void DnsCache::clear() {
+    const LwipTcpIpCoreLock lock;
+    for (auto& e: entries_) {
+        e.name.reset();
+    }
+    for (auto& r: unconfirmed_) {
+        r.name.reset();
+    }
+}
+
+DnsCache* DnsCache::instance() {
+    static DnsCache cache;
+    return &cache;
+}
+
+DnsCache::Entry* DnsCache::find(const char* name, uint8_t addrType, uint32_t now) {
+    for (auto& e: entries_) {
+        if (!e.name || e.addrType != addrType || strcasecmp(e.name.get(), name) != 0) {
+            continue;
+        }
+        if (isExpired(e.expiry, now)) {
+            e.name.reset();
+            return nullptr;
+        }
+        return &e;
+    }
+    return nullptr;
+}
+
+void DnsCache::addResponse(const char* name, uint8_t addrType, const ip_addr_t* addr, uint32_t ttl) {
+    const LwipTcpIpCoreLock lock;
+    const uint32_t now = HAL_Timer_Get_Milli_Seconds();
+    // Replace a response to the same question, or use a free slot, or the oldest one
+    Response* r = nullptr;
+    for (auto& rr: unconfirmed_) {
+        if (rr.name && rr.addrType == addrType && strcasecmp(rr.name.get(), name) == 0) {
+            r = &rr;
+            break;
+        }
+        if (!r || (r->name && (!rr.name || (int32_t)(rr.received - r->received) < 0))) {
+            r = &rr;
+        }
+    }
+    const size_t len = strlen(name);
+    r->name.reset(new(std::nothrow) char[len + 1]);
+    if (!r->name) {
+        return;
+    }
+    memcpy(r->name.get(), name, len + 1);
+    r->addrType = addrType;
+    r->found = (addr != nullptr);
+    if (addr) {
+        ip_addr_copy(r->addr, *addr);
+    }
+    r->ttl = ttl;
+    r->received = now;
+}
+
+DnsCache::Entry* DnsCache::add(const char* name, uint8_t addrType, uint32_t ttl, uint32_t now) {
+    if (!ttl) {
+        return nullptr; // Do not cache (RFC 1035, 4.1.3)
+    }
+    auto e = find(name, addrType, now);
+    if (!e) {
+        // Use a free or expired entry, or evict the least recently used one
+        for (auto& ee: entries_) {
+            if (!ee.name || isExpired(ee.expiry, now)) {
+                e = &ee;
+                break;
+            }
+            if (!e || (int32_t)(ee.lastUsed - e->lastUsed) < 0) {
+                e = &ee;
+            }
+        }
+        const size_t len = strlen(name);
+        e->name.reset(new(std::nothrow) char[len + 1]);
+        if (!e->name) {
+            return nullptr;
+        }
+        memcpy(e->name.get(), name, len + 1);
+        e->addrType = addrType;
+    }
+    e->expiry = now + ttl * 1000;
+    e->lastUsed = now;
+    return e;
+}
+
+} // particle::net
+
+} // particle
+
+using namespace particle::net;
+
+extern "C" int lwip_hook_netconn_external_resolve(const char* name, ip_addr_t* addr, u8_t addrtype, err_t* err) {
+    // Both address types are looked up in the order of preference for the dual-stack queries
+    uint8_t types[2] = { addrtype, addrtype };
+    if (addrtype == LWIP_DNS_ADDRTYPE_IPV4_IPV6) {
+        types[0] = LWIP_DNS_ADDRTYPE_IPV4;
+        types[1] = LWIP_DNS_ADDRTYPE_IPV6;
+    } else if (addrtype == LWIP_DNS_ADDRTYPE_IPV6_IPV4) {
+        types[0] = LWIP_DNS_ADDRTYPE_IPV6;
+        types[1] = LWIP_DNS_ADDRTYPE_IPV4;
+    }
+    const auto cache = DnsCache::instance();
+    for (const auto type: types) {
+        const auto r = cache->lookup(name, type, addr);
+        if (r == DnsCache::FOUND) {
+            *err = ERR_OK;
+            return 1;
+        }
+        if (r == DnsCache::MISS) {
+            return 0; // Let lwIP query the server
+        }
+    }
+    // Cached negative answer
+    *err = ERR_VAL;
+    return 1;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "lwip/ip_addr.h"
+
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+struct pbuf;
+struct ip_hdr;
+
+namespace particle {
+
+namespace net {
+
+/**
+ * Bounded cache of DNS answers shared by the local resolver and the DNS64 responder.
+ *
+ * The cache is populated from the responses received from the configured DNS servers, so that
+ * the TTLs of the upstream records are honored. Negative answers (NXDOMAIN and NODATA) are
+ * cached for the duration specified by the SOA record of the response (RFC 2308). When the cache
+ * is full, the least recently used entry is evicted.
+ *
+ * A response is only seen by the cache before lwIP's resolver matches it against its outstanding
+ * queries, so its answer is held until the resolver reports the same result for the same question
+ * (see `confirm()`). Datagrams that merely appear to come from a DNS server are never cached.
+ *
+ * All methods acquire the lwIP core lock.
+ */
+class DnsCache {
+public:
+    enum Result {
+        MISS = 0,
+        FOUND,
+        NOT_FOUND // Negative entry
+    };
+
+    static const size_t CAPACITY = 16;
+    // Maximum TTL of a positive entry in seconds
+    static const uint32_t MAX_TTL = 24 * 60 * 60;
+    // Maximum TTL of a negative entry in seconds
+    static const uint32_t MAX_NEGATIVE_TTL = 5 * 60;
+    // Maximum number of responses awaiting confirmation
+    static const size_t MAX_UNCONFIRMED = 4;
+    // Time in milliseconds after which an unconfirmed response is discarded
+    static const uint32_t UNCONFIRMED_TIMEOUT = 30000;
+
+    /**
+     * Looks up an address of the given type (`LWIP_DNS_ADDRTYPE_IPV4` or `LWIP_DNS_ADDRTYPE_IPV6`).
+     *
+     * @param name Host name.
+     * @param addrType Address type.
+     * @param addr[out] Host address.
+     * @param ttl[out] Remaining TTL of the entry in seconds.
+     */
+    Result lookup(const char* name, uint8_t addrType, ip_addr_t* addr, uint32_t* ttl = nullptr);
+
+    void addAddress(const char* name, const ip_addr_t& addr, uint32_t ttl);
+    void addNotFound(const char* name, uint8_t addrType, uint32_t ttl);
+
+    /**
+     * Parses a response message received from a DNS server. The answer is held until it's
+     * confirmed by the resolver.
+     */
+    int processResponse(const char* data, size_t size);
+
+    /**
+     * Caches the answer of a previously received response if it matches the result of a lookup
+     * performed by lwIP's resolver.
+     *
+     * @param name Host name.
+     * @param addrType Address type (`LWIP_DNS_ADDRTYPE_IPV4` or `LWIP_DNS_ADDRTYPE_IPV6`).
+     * @param addr Resolved address, or `nullptr` if the name could not be resolved.
+     */
+    void confirm(const char* name, uint8_t addrType, const ip_addr_t* addr);
+
+    /**
+     * Inspects an incoming IPv4 packet and parses its contents if it's a response from one of
+     * the configured DNS servers. The packet is not modified.
+     *
+     * This method is meant to be called from the IPv4 input hook.
+     */
+    void ip4Input(pbuf* p, const ip_hdr* iphdr);
+
+    void clear();
+
+    static DnsCache* instance();
+
+private:
+    struct Entry {
+        std::unique_ptr<char[]> name;
+        ip_addr_t addr;
+        uint32_t expiry; // Milliseconds
+        uint32_t lastUsed; // Milliseconds
+        uint8_t addrType;
+        bool found;
+    };
+
+    struct Response {
+        std::unique_ptr<char[]> name;
+        ip_addr_t addr;
+        uint32_t ttl; // Seconds
+        uint32_t received; // Milliseconds
+        uint8_t addrType; // `LWIP_DNS_ADDRTYPE_IPV4_IPV6` if the name doesn't exist
+        bool found;
+    };
+
+    Entry entries_[CAPACITY];
+    Response unconfirmed_[MAX_UNCONFIRMED];
+
+    DnsCache() = default;
+
+    void addResponse(const char* name, uint8_t addrType, const ip_addr_t* addr, uint32_t ttl);
+
+    Entry* find(const char* name, uint8_t addrType, uint32_t now);
+    Entry* add(const char* name, uint8_t addrType, uint32_t ttl, uint32_t now);
+};
+
+} // particle::net
+
+} // particle
@@ -29,6 +29,8 @@ LOG_SOURCE_CATEGORY("net.nat64")
 
 #include <lwip/ip.h>
 #include <lwip/udp.h>
+#include <lwip/tcp.h>
+#include <lwip/prot/tcp.h>
 #include <lwip/inet_chksum.h>
 #include <lwip/timeouts.h>
 #include "lwiplock.h"
@@ -44,6 +46,9 @@ L4Protocol ipProtoToL4Protocol(uint16_t proto) {
         case IP_PROTO_UDP: {
             return L4_PROTO_UDP;
         }
+        case IP_PROTO_TCP: {
+            return L4_PROTO_TCP;
+        }
         case IP_PROTO_ICMP:
         case IP6_NEXTH_ICMP6: {
             /* FIXME */
@@ -77,6 +82,17 @@ const uint32_t DEFAULT_UDP_NAT_LIFETIME = HAL_PLATFORM_BORON_CLOUD_KEEPALIVE_INT
 const uint16_t DEFAULT_UDP_NAT_MIN_PORT = 40000;
 const uint16_t DEFAULT_UDP_NAT_MAX_PORT = 49000;
 
+/* TCP_EST: 2 hours 4 minutes, TCP_TRANS: 4 minutes (as defined in [RFC6146]) */
+const uint32_t DEFAULT_TCP_EST_NAT_LIFETIME = (2 * 60 + 4) * 60 * 1000;
+const uint32_t DEFAULT_TCP_TRANS_NAT_LIFETIME = 4 * 60 * 1000;
+/* Kept below lwIP's ephemeral port range (49152-65535), so that translated sessions don't collide
+ * with the local TCP connections */
+const uint16_t DEFAULT_TCP_NAT_MIN_PORT = 31000;
+const uint16_t DEFAULT_TCP_NAT_MAX_PORT = 39999;
+
+/* IPv6 minimum MTU, used if the inside interface is not known */
+const uint16_t DEFAULT_INSIDE_MTU = 1280;
+
 /* ICMP_DEFAULT: 60 seconds (as defined in [RFC5508]) */
 const uint32_t DEFAULT_ICMP_NAT_LIFETIME = 60 * 1000;
 const uint16_t DEFAULT_ICMP_NAT_MIN_ID = 0;
@@ -89,6 +105,86 @@ const size_t DEFAULT_SESSION_CLEANUP_TIMEOUT = 1000;
 
 static_assert(MEMP_NUM_SYS_TIMEOUT > LWIP_NUM_SYS_TIMEOUT_INTERNAL, "An extra timeout should be allocated for NAT64 service. Increase MEMP_NUM_SYS_TIMEOUT");
 
+uint32_t timerLifetime(SessionTimer timer) {
+    switch (timer) {
+        case SESSION_TIMER_UDP: {
+            return DEFAULT_UDP_NAT_LIFETIME;
+        }
+        case SESSION_TIMER_TCP_EST: {
+            return DEFAULT_TCP_EST_NAT_LIFETIME;
+        }
+        case SESSION_TIMER_TCP_TRANS: {
+            return DEFAULT_TCP_TRANS_NAT_LIFETIME;
+        }
+        default: {
+            return DEFAULT_ICMP_NAT_LIFETIME;
+        }
+    }
+}
+
+SessionTimer tcpStateTimer(TcpState state) {
+    switch (state) {
+        case TCP_STATE_ESTABLISHED:
+        case TCP_STATE_V4_FIN_RCV:
+        case TCP_STATE_V6_FIN_RCV: {
+            return SESSION_TIMER_TCP_EST;
+        }
+        default: {
+            return SESSION_TIMER_TCP_TRANS;
+        }
+    }
+}
+
+#if !CHECKSUM_GEN_TCP
+template <typename AddrT, typename DerivedT>
+size_t addressSize(const IpTransportAddressGeneric<AddrT, DerivedT>& addr) {
+    return addr.isV6() ? sizeof(ip6_addr_p_t) : sizeof(ip4_addr_p_t);
+}
+
+/* Updates the checksum of a TCP segment after its addresses and ports have been translated. The
+ * pseudo-headers of IPv4 and IPv6 only differ in the addresses as far as the checksum is concerned
+ */
+template <typename SrcT, typename DstT, typename NewSrcT, typename NewDstT>
+void updateTcpChecksum(tcp_hdr* tcphdr, const SrcT& src, const DstT& dst, const NewSrcT& newSrc, const NewDstT& newDst) {
+    uint16_t chksum = tcphdr->chksum;
+    chksum = updateChecksum(chksum, &src.address(), addressSize(src), &newSrc.address(), addressSize(newSrc));
+    chksum = updateChecksum(chksum, &dst.address(), addressSize(dst), &newDst.address(), addressSize(newDst));
+    const uint16_t ports[] = { lwip_htons(src.port()), lwip_htons(dst.port()) };
+    const uint16_t newPorts[] = { lwip_htons(newSrc.port()), lwip_htons(newDst.port()) };
+    tcphdr->chksum = updateChecksum(chksum, ports, sizeof(ports), newPorts, sizeof(newPorts));
+}
+#endif /* !CHECKSUM_GEN_TCP */
+
+/* FNV-1a over 32-bit words */
+uint32_t hashWord(uint32_t h, uint32_t w) {
+    return (h ^ w) * 16777619u;
+}
+
+uint32_t bibHash(const Ip6TransportAddress& addr, L4Protocol proto) {
+    uint32_t h = 2166136261u;
+    for (unsigned i = 0; i < 4; ++i) {
+        h = hashWord(h, addr.address().addr[i]);
+    }
+    return hashWord(hashWord(h, addr.l4Id()), proto);
+}
+
+uint32_t bibHash(const Ip4TransportAddress& addr, L4Protocol proto) {
+    uint32_t h = hashWord(2166136261u, addr.address().addr);
+    return hashWord(hashWord(h, addr.l4Id()), proto);
+}
+
+/* Sessions are keyed by the remote IPv4 transport address, which for the IPv6 side is embedded
+ * in the last 32 bits of the destination address
+ */
+uint32_t sessionHash(const BibEntry* bib, uint32_t remoteAddr, uint16_t remotePort) {
+    uint32_t h = hashWord(2166136261u, (uint32_t)(uintptr_t)bib);
+    return hashWord(hashWord(h, remoteAddr), remotePort);
+}
+
+uint32_t sessionHash(const SessionEntry* sess, const BibEntry* bib) {
+    return sessionHash(bib, sess->dst6().address().addr[3], sess->dst6().port());
+}
+
 } /* anonymous */
 
 Nat64::Nat64() {
@@ -96,6 +192,7 @@ Nat64::Nat64() {
     unsigned int rVal;
     particle::Random::genSecure((char*)&rVal, sizeof(rVal));
     udpNextPort_ = rVal % (DEFAULT_UDP_NAT_MAX_PORT - DEFAULT_UDP_NAT_MIN_PORT) + DEFAULT_UDP_NAT_MIN_PORT;
+    tcpNextPort_ = (rVal >> 16) % (DEFAULT_TCP_NAT_MAX_PORT - DEFAULT_TCP_NAT_MIN_PORT) + DEFAULT_TCP_NAT_MIN_PORT;
 }
 
 Nat64::~Nat64() {
@@ -232,14 +329,24 @@ int Nat64::natInput(const ip_addr_t* src, const ip_addr_t* dst, L4Protocol proto
     srcAddr.setAddress(*src);
     dstAddr.setAddress(*dst);
 
-    uint32_t protoLifetime = 0;
+    uint8_t tcpFlags = 0;
 
     switch (proto) {
         case L4_PROTO_UDP: {
             udp_hdr* udphdr = (udp_hdr*)p->payload;
             srcAddr.setPort(lwip_ntohs(udphdr->src));
             dstAddr.setPort(lwip_ntohs(udphdr->dest));
-            protoLifetime = DEFAULT_UDP_NAT_LIFETIME;
+            break;
+        }
+        case L4_PROTO_TCP: {
+            if (p->len < TCP_HLEN) {
+                /* Unhandled */
+                return 0;
+            }
+            tcp_hdr* tcphdr = (tcp_hdr*)p->payload;
+            srcAddr.setPort(lwip_ntohs(tcphdr->src));
+            dstAddr.setPort(lwip_ntohs(tcphdr->dest));
+            tcpFlags = TCPH_FLAGS(tcphdr);
             break;
         }
         default: {
@@ -248,7 +355,7 @@ int Nat64::natInput(const ip_addr_t* src, const ip_addr_t* dst, L4Protocol proto
         }
     }
 
-    LOG_DEBUG(TRACE, "NAT64 input (%s) %s#%u -> %s#%u", proto == L4_PROTO_UDP ? "UDP" : "ICMP",
+    LOG_DEBUG(TRACE, "NAT64 input (%s) %s#%u -> %s#%u", proto == L4_PROTO_UDP ? "UDP" : (proto == L4_PROTO_TCP ? "TCP" : "ICMP"),
               IPADDR_NTOA(&srcAddr.address()), srcAddr.l4Id(),
               IPADDR_NTOA(&dstAddr.address()), dstAddr.l4Id());
 
@@ -257,8 +364,11 @@ int Nat64::natInput(const ip_addr_t* src, const ip_addr_t* dst, L4Protocol proto
         return 0;
     }
 
+    /* TCP state is only created by a SYN from the IPv6 side */
+    const bool tcpSyn = (tcpFlags & (TCP_SYN | TCP_RST | TCP_ACK)) == TCP_SYN;
+
     auto bib = lookupBib(srcAddr, dstAddr, proto);
-    if (!bib) {
+    if (!bib && (proto != L4_PROTO_TCP || tcpSyn)) {
         LOG_DEBUG(TRACE, "No BIB found, trying to create one");
         /* Not BIB found. Try to create a new one. */
         bib = addBib(srcAddr, dstAddr, proto);
@@ -271,16 +381,7 @@ int Nat64::natInput(const ip_addr_t* src, const ip_addr_t* dst, L4Protocol proto
                   IP6ADDR_NTOA(&bib->src6().address()), bib->src6().l4Id(),
                   IP4ADDR_NTOA(&bib->dst4().address()), bib->dst4().l4Id());
         /* Lookup session */
-        session = bib->lookupSession(srcAddr, dstAddr);
-
-        /* FIXME: flag to enable full-cone NAT */
-        if (!session && dstAddr.isV6()) {
-            /* Attempt to create a new session */
-            LOG_DEBUG(TRACE, "No matching session found, trying to create one");
-            session = bib->addSession(dstAddr, protoLifetime, *pool_);
-        } else if (!session && dstAddr.isV4()) {
-            LOG_DEBUG(WARN, "Not creating a new session, full-cone NAT is not enabled");
-        }
+        session = lookupSession(bib, srcAddr, dstAddr);
 
         if (session) {
             LOG_DEBUG(TRACE, "Session %s#%u <-> %s#%u, %s#%u <-> %s#%u, %lums",
@@ -288,8 +389,30 @@ int Nat64::natInput(const ip_addr_t* src, const ip_addr_t* dst, L4Protocol proto
                       IP6ADDR_NTOA(&session->dst6().address()), session->dst6().l4Id(),
                       IP4ADDR_NTOA(&session->src4().address()), session->src4().l4Id(),
                       IP4ADDR_NTOA(&session->dst4().address()), session->dst4().l4Id(),
-                      session->lifetime());
-            session->setLifetime(protoLifetime);
+                      session->expiry() - now_);
+            if (proto == L4_PROTO_TCP) {
+                trackTcpSession(session, srcAddr.isV6(), tcpFlags);
+            } else {
+                refreshSession(session, session->timer());
+            }
+        } else if (dstAddr.isV6() && proto == L4_PROTO_TCP && !tcpSyn) {
+            LOG_DEBUG(TRACE, "Not creating a new TCP session for a non-SYN segment");
+        } else if (dstAddr.isV6()) {
+            /* FIXME: flag to enable full-cone NAT */
+            /* Attempt to create a new session */
+            LOG_DEBUG(TRACE, "No matching session found, trying to create one");
+            if (proto == L4_PROTO_TCP) {
+                session = addSession(bib, dstAddr, tcpStateTimer(TCP_STATE_V6_INIT));
+            } else {
+                session = addSession(bib, dstAddr, proto == L4_PROTO_UDP ? SESSION_TIMER_UDP : SESSION_TIMER_ICMP);
+            }
+        } else if (dstAddr.isV4()) {
+            LOG_DEBUG(WARN, "Not creating a new session, full-cone NAT is not enabled");
+        }
+
+        if (bib->empty()) {
+            /* Failed to create the first session of a new BIB */
+            removeBib(bib);
         }
     } else {
         LOG_DEBUG(TRACE, "No matching BIB");
@@ -307,6 +430,9 @@ int Nat64::natInput(const ip_addr_t* src, const ip_addr_t* dst, L4Protocol proto
         /* Consume */
         return 1;
     }
+    if (proto == L4_PROTO_TCP && (tcpFlags & TCP_SYN)) {
+        clampTcpMss(q);
+    }
     if (srcAddr.isV6()) {
         /* IPv6 -> IPv4 */
         if (proto == L4_PROTO_UDP) {
@@ -317,6 +443,16 @@ int Nat64::natInput(const ip_addr_t* src, const ip_addr_t* dst, L4Protocol proto
 #if CHECKSUM_GEN_UDP
             udphdr->chksum = inet_chksum_pseudo(q, IP_PROTO_UDP, q->tot_len, &session->src4().address(), &session->dst4().address());
 #endif /* CHECKSUM_GEN_UDP */
+        } else if (proto == L4_PROTO_TCP) {
+            tcp_hdr* tcphdr = (tcp_hdr*)q->payload;
+            tcphdr->src = lwip_htons(session->src4().port());
+            tcphdr->dest = lwip_htons(session->dst4().port());
+#if CHECKSUM_GEN_TCP
+            tcphdr->chksum = 0x0000;
+            tcphdr->chksum = inet_chksum_pseudo(q, IP_PROTO_TCP, q->tot_len, &session->src4().address(), &session->dst4().address());
+#else
+            updateTcpChecksum(tcphdr, session->src6(), session->dst6(), session->src4(), session->dst4());
+#endif /* CHECKSUM_GEN_TCP */
         }
 
         ip6_hdr* ip6hdr = (ip6_hdr*)ipheader;
@@ -340,6 +476,16 @@ int Nat64::natInput(const ip_addr_t* src, const ip_addr_t* dst, L4Protocol proto
 #if CHECKSUM_GEN_UDP
             udphdr->chksum = ip6_chksum_pseudo(q, IP_PROTO_UDP, q->tot_len, &session->dst6().address(), &session->src6().address());
 #endif /* CHECKSUM_GEN_UDP */
+        } else if (proto == L4_PROTO_TCP) {
+            tcp_hdr* tcphdr = (tcp_hdr*)q->payload;
+            tcphdr->src = lwip_htons(session->dst6().port());
+            tcphdr->dest = lwip_htons(session->src6().port());
+#if CHECKSUM_GEN_TCP
+            tcphdr->chksum = 0x0000;
+            tcphdr->chksum = ip6_chksum_pseudo(q, IP_PROTO_TCP, q->tot_len, &session->dst6().address(), &session->src6().address());
+#else
+            updateTcpChecksum(tcphdr, session->dst4(), session->src4(), session->dst6(), session->src6());
+#endif /* CHECKSUM_GEN_TCP */
         }
 
         ip_hdr* ip4hdr = (ip_hdr*)ipheader;
@@ -412,19 +558,17 @@ bool Nat64::filter(const IpTransportAddress& src, const IpTransportAddress& dst,
 }
 
 BibEntry* Nat64::lookupBib(const IpTransportAddress& src, const IpTransportAddress& dst, L4Protocol proto) {
-    BibTable& tbl = proto == L4_PROTO_UDP ? udpBibTable_ : icmpBibTable_;
     const IpTransportAddress& addr = src.isV6() ? src : dst;
-    for (auto entry = tbl.front(); entry != nullptr; entry = entry->next) {
-        if (entry->matches(addr)) {
-            return entry;
-        }
+    auto pred = [&addr, proto](const BibEntry* entry) {
+        return entry->matches(addr, proto);
+    };
+    if (addr.isV6()) {
+        return bib6Index_.find(bibHash(Ip6TransportAddress(addr), proto), pred);
     }
-    return nullptr;
+    return bib4Index_.find(bibHash(Ip4TransportAddress(addr), proto), pred);
 }
 
 BibEntry* Nat64::addBib(const IpTransportAddress& src, const IpTransportAddress& dst, L4Protocol proto) {
-    BibTable& tbl = proto == L4_PROTO_UDP ? udpBibTable_ : icmpBibTable_;
-
     if (src.isV4()) {
         LOG_DEBUG(TRACE, "Not creating a new BIB for a connection initiated from IPv4 side");
         return nullptr;
@@ -447,8 +591,9 @@ BibEntry* Nat64::addBib(const IpTransportAddress& src, const IpTransportAddress&
                     if (pool_) {
                         BibEntry* bib = static_cast<BibEntry*>(pool_->alloc(NAT64_ENTRY_SIZE));
                         if (bib) {
-                            new (bib) BibEntry(src, src4);
-                            tbl.pushFront(bib);
+                            new (bib) BibEntry(src, src4, proto);
+                            bib6Index_.insert(bib, bibHash(bib->src6(), proto));
+                            bib4Index_.insert(bib, bibHash(bib->dst4(), proto));
                             return bib;
                         }
                     }
@@ -466,6 +611,8 @@ BibEntry* Nat64::addBib(const IpTransportAddress& src, const IpTransportAddress&
 bool Nat64::findNextL4Id(Ip4TransportAddress& src, L4Protocol proto) {
     if (proto == L4_PROTO_UDP) {
         return findNextUdpPort(src);
+    } else if (proto == L4_PROTO_TCP) {
+        return findNextTcpPort(src);
     } else if (proto == L4_PROTO_ICMP) {
         return findNextIcmpId(src);
     }
@@ -488,6 +635,21 @@ bool Nat64::findNextUdpPort(Ip4TransportAddress& src) {
     return false;
 }
 
+bool Nat64::findNextTcpPort(Ip4TransportAddress& src) {
+    uint16_t port = tcpNextPort_;
+    do {
+        src.setPort(port);
+        if (!lookupBib(src, src, L4_PROTO_TCP)) {
+            tcpNextPort_ = nextBoundId(port, DEFAULT_TCP_NAT_MIN_PORT, DEFAULT_TCP_NAT_MAX_PORT);
+            return true;
+        }
+
+        port = nextBoundId(port, DEFAULT_TCP_NAT_MIN_PORT, DEFAULT_TCP_NAT_MAX_PORT);
+    } while(port != tcpNextPort_);
+
+    return false;
+}
+
 bool Nat64::findNextIcmpId(Ip4TransportAddress& src) {
     uint16_t id = icmpNextId_;
     do {
@@ -503,34 +665,110 @@ bool Nat64::findNextIcmpId(Ip4TransportAddress& src) {
     return false;
 }
 
-void Nat64::timeout(uint32_t dt) {
-    for (auto bib = udpBibTable_.front(), p = static_cast<BibEntry*>(nullptr); bib != nullptr;) {
-        if (bib->timeout(dt, *pool_)) {
-            LOG_DEBUG(TRACE, "UDP BIB %s#%u <-> %s#%u timed out",
-                      IP6ADDR_NTOA(&bib->src6().address()), bib->src6().l4Id(),
-                      IP4ADDR_NTOA(&bib->dst4().address()), bib->dst4().l4Id());
-
-            auto popped = udpBibTable_.pop(bib, p);
-            bib = popped->next;
-            pool_->free(popped);
-        } else {
-            p = bib;
-            bib = bib->next;
+void Nat64::removeBib(BibEntry* bib) {
+    bib6Index_.remove(bib, bibHash(bib->src6(), bib->proto()));
+    bib4Index_.remove(bib, bibHash(bib->dst4(), bib->proto()));
+    pool_->free(bib);
+}
+
+SessionEntry* Nat64::lookupSession(BibEntry* bib, const IpTransportAddress& src, const IpTransportAddress& dst) {
+    uint32_t hash = 0;
+    if (src.isV6()) {
+        hash = sessionHash(bib, ip_2_ip6(&dst.address())->addr[3], dst.port());
+    } else {
+        hash = sessionHash(bib, ip_2_ip4(&src.address())->addr, src.port());
+    }
+    return sessionIndex_.find(hash, [bib, &src, &dst](const SessionEntry* sess) {
+        return sess->matches(bib, src, dst);
+    });
+}
+
+SessionEntry* Nat64::addSession(BibEntry* bib, const Ip6TransportAddress& dst, SessionTimer timer) {
+    auto sess = static_cast<SessionEntry*>(pool_->alloc(NAT64_ENTRY_SIZE));
+    if (!sess) {
+        LOG_DEBUG(TRACE, "Failed to allocate new session");
+        return nullptr;
+    }
+
+    new (sess) SessionEntry(bib, dst);
+    sess->setTimer(timer);
+    sess->setExpiry(now_ + timerLifetime(timer));
+    sessionIndex_.insert(sess, sessionHash(sess, bib));
+    sessionTimers_[timer].pushBack(sess);
+    bib->sessionAdded();
+    return sess;
+}
+
+void Nat64::refreshSession(SessionEntry* sess, SessionTimer timer) {
+    sessionTimers_[sess->timer()].remove(sess);
+    sess->setTimer(timer);
+    sess->setExpiry(now_ + timerLifetime(timer));
+    sessionTimers_[timer].pushBack(sess);
+}
+
+void Nat64::removeSession(SessionEntry* sess) {
+    auto bib = sess->bib();
+    sessionIndex_.remove(sess, sessionHash(sess, bib));
+    sessionTimers_[sess->timer()].remove(sess);
+    bib->sessionRemoved();
+    pool_->free(sess);
+}
+
+void Nat64::trackTcpSession(SessionEntry* sess, bool fromV6, uint8_t flags) {
+    const TcpState prevState = sess->tcpState();
+    const TcpState state = tcpNextState(prevState, fromV6, flags);
+
+    /* The lifetime of a closing or reset connection is not extended by further segments */
+    if (state == prevState && (state == TCP_STATE_V4_FIN_V6_FIN_RCV || state == TCP_STATE_TRANS)) {
+        return;
+    }
+
+    if (state != prevState) {
+        LOG_DEBUG(TRACE, "TCP session state %d -> %d", (int)prevState, (int)state);
+        sess->setTcpState(state);
+    }
+    refreshSession(sess, tcpStateTimer(state));
+}
+
+void Nat64::clampTcpMss(pbuf* p) const {
+    /* Segments translated to the inside must fit into its MTU without fragmentation */
+    uint16_t mtu = DEFAULT_INSIDE_MTU;
+    if (rule_ && rule_->inside()) {
+#if LWIP_ND6_ALLOW_RA_UPDATES
+        const uint16_t insideMtu = rule_->inside()->mtu6;
+#else
+        const uint16_t insideMtu = rule_->inside()->mtu;
+#endif /* LWIP_ND6_ALLOW_RA_UPDATES */
+        if (insideMtu >= DEFAULT_INSIDE_MTU) {
+            mtu = insideMtu;
         }
     }
+    const uint16_t maxMss = mtu - IP6_HLEN - TCP_HLEN;
 
-    for (auto bib = icmpBibTable_.front(), p = static_cast<BibEntry*>(nullptr); bib != nullptr;) {
-        if (bib->timeout(dt, *pool_)) {
-            LOG_DEBUG(TRACE, "ICMP BIB %s#%u <-> %s#%u timed out",
-                      IP6ADDR_NTOA(&bib->src6().address()), bib->src6().l4Id(),
-                      IP4ADDR_NTOA(&bib->dst4().address()), bib->dst4().l4Id());
+    if (tcpClampMss((uint8_t*)p->payload, p->len, maxMss)) {
+        LOG_DEBUG(TRACE, "Clamped TCP MSS to %u", maxMss);
+    }
+}
 
-            auto popped = udpBibTable_.pop(bib, p);
-            bib = popped->next;
-            pool_->free(popped);
-        } else {
-            p = bib;
-            bib = bib->next;
+void Nat64::timeout(uint32_t dt) {
+    now_ += dt;
+
+    /* Only the expired sessions at the front of the lists are visited */
+    for (auto& list: sessionTimers_) {
+        for (auto s = list.front(); s != nullptr && s->expired(now_); s = list.front()) {
+            LOG_DEBUG(TRACE, "Session timed out %s#%u <-> %s#%u, %s#%u <-> %s#%u",
+                      IP6ADDR_NTOA(&s->src6().address()), s->src6().l4Id(),
+                      IP6ADDR_NTOA(&s->dst6().address()), s->dst6().l4Id(),
+                      IP4ADDR_NTOA(&s->src4().address()), s->src4().l4Id(),
+                      IP4ADDR_NTOA(&s->dst4().address()), s->dst4().l4Id());
+            auto bib = s->bib();
+            removeSession(s);
+            if (bib->empty()) {
+                LOG_DEBUG(TRACE, "BIB %s#%u <-> %s#%u timed out",
+                          IP6ADDR_NTOA(&bib->src6().address()), bib->src6().l4Id(),
+                          IP4ADDR_NTOA(&bib->dst4().address()), bib->dst4().l4Id());
+                removeBib(bib);
+            }
         }
     }
 }
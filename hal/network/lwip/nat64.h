@@ -121,11 +121,46 @@ enum L4Protocol {
     L4_PROTO_NONE = 0,
     /* Both ICMPv4 and ICMPv6 */
     L4_PROTO_ICMP = 1,
-    /* Unsupported */
-    /* L4_PROTO_TCP  = 6, */
+    L4_PROTO_TCP  = 6,
     L4_PROTO_UDP  = 17
 };
 
+/* TCP session states (RFC 6146, 3.5.2). Only connections initiated from the IPv6 side are supported. */
+enum TcpState {
+    TCP_STATE_V6_INIT = 0,
+    TCP_STATE_ESTABLISHED,
+    TCP_STATE_V4_FIN_RCV,
+    TCP_STATE_V6_FIN_RCV,
+    TCP_STATE_V4_FIN_V6_FIN_RCV,
+    TCP_STATE_TRANS
+};
+
+/* Session lifetime classes. Sessions of the same class have the same lifetime and are expired in
+ * the order they were last refreshed.
+ */
+enum SessionTimer {
+    SESSION_TIMER_UDP = 0,
+    SESSION_TIMER_ICMP,
+    SESSION_TIMER_TCP_TRANS,
+    SESSION_TIMER_TCP_EST,
+    SESSION_TIMER_COUNT
+};
+
+/* Returns the state of a TCP session after a segment with the given flags has been received from
+ * the IPv6 or IPv4 side.
+ */
+TcpState tcpNextState(TcpState state, bool fromV6, uint8_t flags);
+
+/* Reduces the value of the MSS option of a TCP segment to maxMss, if necessary, and updates the
+ * checksum of the segment accordingly. Returns true if the segment was modified.
+ */
+bool tcpClampMss(uint8_t* segment, size_t size, uint16_t maxMss);
+
+/* Incrementally updates an Internet checksum after a part of the checksummed data has been replaced
+ * (RFC 1624). The sizes of the data must be even. The checksum is in network byte order.
+ */
+uint16_t updateChecksum(uint16_t chksum, const void* oldData, size_t oldSize, const void* newData, size_t newSize);
+
 class Rule {
 public:
     Rule(netif* in, netif* out);
@@ -143,8 +178,6 @@ class BibEntry;
 class SessionEntry;
 class RuleEntry;
 
-using BibTable = particle::IntrusiveList<BibEntry>;
-using SessionTable = particle::IntrusiveList<SessionEntry>;
 using RuleTable = particle::IntrusiveList<RuleEntry>;
 
 template <typename DerivedT>
@@ -153,29 +186,47 @@ public:
     DerivedT* next;
 };
 
-class BibEntry : public ListNode<BibEntry> {
+/* Fixed-size hash index of entries chained via a member pointer. Entries are not owned by the index. */
+template <typename EntryT, EntryT* EntryT::*NextT, size_t SizeT>
+class HashIndex {
 public:
-    BibEntry(const Ip6TransportAddress& src6, const Ip4TransportAddress& dst4);
+    void insert(EntryT* entry, uint32_t hash);
+    bool remove(EntryT* entry, uint32_t hash);
+
+    template <typename PredT>
+    EntryT* find(uint32_t hash, PredT pred) const;
+
+private:
+    EntryT* buckets_[SizeT] = {};
+};
+
+class BibEntry {
+public:
+    BibEntry(const Ip6TransportAddress& src6, const Ip4TransportAddress& dst4, L4Protocol proto);
 
     const Ip6TransportAddress& src6() const;
     const Ip4TransportAddress& dst4() const;
+    L4Protocol proto() const;
 
-    bool matches(const IpTransportAddress& addr) const;
+    bool matches(const IpTransportAddress& addr, L4Protocol proto) const;
     bool empty() const;
 
-    SessionEntry* lookupSession(const IpTransportAddress& src, const IpTransportAddress& dst);
-    SessionEntry* addSession(const Ip6TransportAddress& dst, uint32_t lifetime, particle::SimpleAllocator& allocator);
+    void sessionAdded();
+    void sessionRemoved();
 
-    bool timeout(uint32_t dt, particle::SimpleAllocator& allocator);
+    /* Hash chains of the IPv6 and IPv4 indexes */
+    BibEntry* next6;
+    BibEntry* next4;
 
 private:
     Ip6TransportAddress src6_;
     Ip4TransportAddress dst4_;
 
-    SessionTable sessions_;
+    uint8_t proto_;
+    uint16_t sessionCount_;
 };
 
-class SessionEntry : public ListNode<SessionEntry> {
+class SessionEntry {
 public:
     SessionEntry(BibEntry* bib, const Ip6TransportAddress& dst6);
 
@@ -186,18 +237,46 @@ public:
     const Ip4TransportAddress& src4() const;
     Ip4TransportAddress dst4() const;
 
-    bool matches(const IpTransportAddress& src, const IpTransportAddress& dst);
+    bool matches(const BibEntry* bib, const IpTransportAddress& src, const IpTransportAddress& dst) const;
+
+    void setExpiry(uint32_t expiry);
+    uint32_t expiry() const;
+    bool expired(uint32_t now) const;
+
+    SessionTimer timer() const;
+    void setTimer(SessionTimer timer);
 
-    uint32_t setLifetime(uint32_t lifetime);
-    uint32_t lifetime() const;
+    TcpState tcpState() const;
+    void setTcpState(TcpState state);
 
-    bool timeout(uint32_t dt);
+    /* Hash chain of the session index */
+    SessionEntry* next;
+    /* Links of the expiry list */
+    SessionEntry* prevExpiry;
+    SessionEntry* nextExpiry;
 
 private:
     BibEntry* bib_;
     Ip6TransportAddress dst6_;
 
-    uint32_t lifetime_;
+    uint32_t expiry_;
+    uint8_t timer_;
+    uint8_t tcpState_;
+};
+
+/* Sessions of the same lifetime class ordered by their expiration time. As all sessions of a
+ * class have the same lifetime, a session that is refreshed is simply moved to the back of the list.
+ */
+class SessionExpiryList {
+public:
+    void pushBack(SessionEntry* sess);
+    void remove(SessionEntry* sess);
+
+    SessionEntry* front() const;
+
+private:
+    SessionEntry* front_ = nullptr;
+    SessionEntry* back_ = nullptr;
 };
 
 static const size_t NAT64_ENTRY_SIZE = std::max(sizeof(BibEntry), sizeof(SessionEntry));
@@ -222,9 +301,19 @@ protected:
 
     BibEntry* lookupBib(const IpTransportAddress& src, const IpTransportAddress& dst, L4Protocol proto);
     BibEntry* addBib(const IpTransportAddress& src, const IpTransportAddress& dst, L4Protocol proto);
+    void removeBib(BibEntry* bib);
+
+    SessionEntry* lookupSession(BibEntry* bib, const IpTransportAddress& src, const IpTransportAddress& dst);
+    SessionEntry* addSession(BibEntry* bib, const Ip6TransportAddress& dst, SessionTimer timer);
+    void refreshSession(SessionEntry* sess, SessionTimer timer);
+    void removeSession(SessionEntry* sess);
+    void trackTcpSession(SessionEntry* sess, bool fromV6, uint8_t flags);
+
+    void clampTcpMss(pbuf* p) const;
 
     bool findNextL4Id(Ip4TransportAddress& src, L4Protocol proto);
     bool findNextUdpPort(Ip4TransportAddress& src);
+    bool findNextTcpPort(Ip4TransportAddress& src);
     bool findNextIcmpId(Ip4TransportAddress& src);
 
     void timeout(uint32_t dt);
@@ -243,11 +332,22 @@ private:
     /* Defaults to 64:ff9b::/96 */
     ip6_addr_t pref64_;
 
-    BibTable udpBibTable_;
+    /* Number of hash buckets in each index */
+    static const size_t INDEX_SIZE = 32;
+
+    HashIndex<BibEntry, &BibEntry::next6, INDEX_SIZE> bib6Index_;
+    HashIndex<BibEntry, &BibEntry::next4, INDEX_SIZE> bib4Index_;
+    HashIndex<SessionEntry, &SessionEntry::next, INDEX_SIZE> sessionIndex_;
+
+    SessionExpiryList sessionTimers_[SESSION_TIMER_COUNT];
+
     uint16_t udpNextPort_;
-    BibTable icmpBibTable_;
+    uint16_t tcpNextPort_;
     uint16_t icmpNextId_;
 
+    /* Time in milliseconds advanced by the session timer */
+    uint32_t now_ = 0;
+
     std::unique_ptr<SimpleAllocedPool> pool_;
 };
 
@@ -407,10 +507,47 @@ inline netif* Rule::outside() const {
     return outside_;
 }
 
+/* HashIndex */
+template <typename EntryT, EntryT* EntryT::*NextT, size_t SizeT>
+inline void HashIndex<EntryT, NextT, SizeT>::insert(EntryT* entry, uint32_t hash) {
+    EntryT*& bucket = buckets_[hash % SizeT];
+    entry->*NextT = bucket;
+    bucket = entry;
+}
+
+template <typename EntryT, EntryT* EntryT::*NextT, size_t SizeT>
+inline bool HashIndex<EntryT, NextT, SizeT>::remove(EntryT* entry, uint32_t hash) {
+    for (EntryT** e = &buckets_[hash % SizeT]; *e != nullptr; e = &((*e)->*NextT)) {
+        if (*e == entry) {
+            *e = entry->*NextT;
+            entry->*NextT = nullptr;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename EntryT, EntryT* EntryT::*NextT, size_t SizeT>
+template <typename PredT>
+inline EntryT* HashIndex<EntryT, NextT, SizeT>::find(uint32_t hash, PredT pred) const {
+    for (EntryT* e = buckets_[hash % SizeT]; e != nullptr; e = e->*NextT) {
+        if (pred(e)) {
+            return e;
+        }
+    }
+
+    return nullptr;
+}
+
 /* BibEntry */
-inline BibEntry::BibEntry(const Ip6TransportAddress& src6, const Ip4TransportAddress& dst4)
-        : src6_(src6),
-          dst4_(dst4) {
+inline BibEntry::BibEntry(const Ip6TransportAddress& src6, const Ip4TransportAddress& dst4, L4Protocol proto)
+        : next6(nullptr),
+          next4(nullptr),
+          src6_(src6),
+          dst4_(dst4),
+          proto_(proto),
+          sessionCount_(0) {
 }
 
 inline const Ip6TransportAddress& BibEntry::src6() const {
@@ -421,7 +558,15 @@ inline const Ip4TransportAddress& BibEntry::dst4() const {
     return dst4_;
 }
 
-inline bool BibEntry::matches(const IpTransportAddress& addr) const {
+inline L4Protocol BibEntry::proto() const {
+    return (L4Protocol)proto_;
+}
+
+inline bool BibEntry::matches(const IpTransportAddress& addr, L4Protocol proto) const {
+    if (proto != this->proto()) {
+        return false;
+    }
+
     if (addr.isV4()) {
         return dst4() == addr;
     } else if (addr.isV6()) {
@@ -432,59 +577,27 @@ inline bool BibEntry::matches(const IpTransportAddress& addr) const {
 }
 
 inline bool BibEntry::empty() const {
-    return sessions_.front() == nullptr;
+    return sessionCount_ == 0;
 }
 
-inline SessionEntry* BibEntry::lookupSession(const IpTransportAddress& src, const IpTransportAddress& dst) {
-    for (auto* s = sessions_.front(); s != nullptr; s = s->next) {
-        if (s->matches(src, dst)) {
-            return s;
-        }
-    }
-
-    return nullptr;
+inline void BibEntry::sessionAdded() {
+    ++sessionCount_;
 }
 
-inline SessionEntry* BibEntry::addSession(const Ip6TransportAddress& dst, uint32_t lifetime, particle::SimpleAllocator& allocator) {
-    auto sess = (SessionEntry*)allocator.alloc(NAT64_ENTRY_SIZE);
-    if (sess) {
-        new(sess) SessionEntry(this, dst);
-        sess->setLifetime(lifetime);
-        sessions_.pushFront(sess);
-        return sess;
-    }
-
-    LOG_DEBUG(TRACE, "Failed to allocate new session");
-
-    return nullptr;
-}
-
-inline bool BibEntry::timeout(uint32_t dt, particle::SimpleAllocator& allocator) {
-    using namespace particle::net;
-    for (auto s = sessions_.front(), p = static_cast<SessionEntry*>(nullptr); s != nullptr;) {
-        if (s->timeout(dt)) {
-            LOG_DEBUG(TRACE, "Session timed out %s#%u <-> %s#%u, %s#%u <-> %s#%u",
-                      IP6ADDR_NTOA(&s->src6().address()), s->src6().l4Id(),
-                      IP6ADDR_NTOA(&s->dst6().address()), s->dst6().l4Id(),
-                      IP4ADDR_NTOA(&s->src4().address()), s->src4().l4Id(),
-                      IP4ADDR_NTOA(&s->dst4().address()), s->dst4().l4Id());
-            auto popped = sessions_.pop(s, p);
-            s = popped->next;
-            allocator.free(popped);
-        } else {
-            p = s;
-            s = s->next;
-        }
-    }
-
-    return empty();
+inline void BibEntry::sessionRemoved() {
+    --sessionCount_;
 }
 
 /* SessionEntry */
 inline SessionEntry::SessionEntry(BibEntry* bib, const Ip6TransportAddress& dst6)
-        : bib_(bib),
+        : next(nullptr),
+          prevExpiry(nullptr),
+          nextExpiry(nullptr),
+          bib_(bib),
           dst6_(dst6),
-          lifetime_(0) {
+          expiry_(0),
+          timer_(SESSION_TIMER_UDP),
+          tcpState_(TCP_STATE_V6_INIT) {
 }
 
 inline BibEntry* SessionEntry::bib() {
@@ -510,7 +623,11 @@ inline Ip4TransportAddress SessionEntry::dst4() const {
     return Ip4TransportAddress(addr, dst6().port());
 }
 
-inline bool SessionEntry::matches(const IpTransportAddress& src, const IpTransportAddress& dst) {
+inline bool SessionEntry::matches(const BibEntry* bib, const IpTransportAddress& src, const IpTransportAddress& dst) const {
+    if (bib != bib_) {
+        return false;
+    }
+
     if (src.isV6()) {
         return src6() == src && dst6() == dst;
     } else if (src.isV4()) {
@@ -520,22 +637,63 @@ inline bool SessionEntry::matches(const IpTransportAddress& src, const IpTranspo
     return false;
 }
 
-inline uint32_t SessionEntry::setLifetime(uint32_t lifetime) {
-    std::swap(lifetime_, lifetime);
-    return lifetime;
+inline void SessionEntry::setExpiry(uint32_t expiry) {
+    expiry_ = expiry;
+}
+
+inline uint32_t SessionEntry::expiry() const {
+    return expiry_;
+}
+
+inline bool SessionEntry::expired(uint32_t now) const {
+    return (int32_t)(now - expiry_) >= 0;
+}
+
+inline SessionTimer SessionEntry::timer() const {
+    return (SessionTimer)timer_;
+}
+
+inline void SessionEntry::setTimer(SessionTimer timer) {
+    timer_ = timer;
+}
+
+inline TcpState SessionEntry::tcpState() const {
+    return (TcpState)tcpState_;
 }
 
-inline uint32_t SessionEntry::lifetime() const {
-    return lifetime_;
+inline void SessionEntry::setTcpState(TcpState state) {
+    tcpState_ = state;
 }
 
-inline bool SessionEntry::timeout(uint32_t dt) {
-    if (lifetime() <= dt) {
-        setLifetime(0);
-        return true;
+/* SessionExpiryList */
+inline void SessionExpiryList::pushBack(SessionEntry* sess) {
+    sess->prevExpiry = back_;
+    sess->nextExpiry = nullptr;
+    if (back_) {
+        back_->nextExpiry = sess;
+    } else {
+        front_ = sess;
     }
-    setLifetime(lifetime() - dt);
-    return false;
+    back_ = sess;
+}
+
+inline void SessionExpiryList::remove(SessionEntry* sess) {
+    if (sess->prevExpiry) {
+        sess->prevExpiry->nextExpiry = sess->nextExpiry;
+    } else {
+        front_ = sess->nextExpiry;
+    }
+    if (sess->nextExpiry) {
+        sess->nextExpiry->prevExpiry = sess->prevExpiry;
+    } else {
+        back_ = sess->prevExpiry;
+    }
+    sess->prevExpiry = nullptr;
+    sess->nextExpiry = nullptr;
+}
+
+inline SessionEntry* SessionExpiryList::front() const {
+    return front_;
 }
 
 } } } /* particle::net::nat */
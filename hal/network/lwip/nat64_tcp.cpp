@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nat64.h"
+
+#include <lwip/prot/tcp.h>
+
+using namespace particle::net::nat;
+
+namespace {
+
+const uint8_t TCP_OPT_END = 0;
+const uint8_t TCP_OPT_NOP = 1;
+const uint8_t TCP_OPT_MSS = 2;
+
+uint32_t addWords(uint32_t sum, const void* data, size_t size, bool negate) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        uint16_t w = 0;
+        memcpy(&w, p + i, sizeof(w));
+        sum += negate ? (uint16_t)~w : w;
+    }
+    return sum;
+}
+
+} // unnamed
+
+TcpState particle::net::nat::tcpNextState(TcpState state, bool fromV6, uint8_t flags) {
+    if (flags & TCP_RST) {
+        return (state != TCP_STATE_V6_INIT) ? TCP_STATE_TRANS : state;
+    }
+    switch (state) {
+        case TCP_STATE_V6_INIT: {
+            if (!fromV6 && (flags & TCP_SYN)) {
+                return TCP_STATE_ESTABLISHED;
+            }
+            break;
+        }
+        case TCP_STATE_ESTABLISHED: {
+            if (flags & TCP_FIN) {
+                return fromV6 ? TCP_STATE_V6_FIN_RCV : TCP_STATE_V4_FIN_RCV;
+            }
+            break;
+        }
+        case TCP_STATE_V4_FIN_RCV: {
+            if (fromV6 && (flags & TCP_FIN)) {
+                return TCP_STATE_V4_FIN_V6_FIN_RCV;
+            }
+            break;
+        }
+        case TCP_STATE_V6_FIN_RCV: {
+            if (!fromV6 && (flags & TCP_FIN)) {
+                return TCP_STATE_V4_FIN_V6_FIN_RCV;
+            }
+            break;
+        }
+        case TCP_STATE_TRANS: {
+            return TCP_STATE_ESTABLISHED;
+        }
+        default: {
+            break;
+        }
+    }
+    return state;
+}
+
+bool particle::net::nat::tcpClampMss(uint8_t* segment, size_t size, uint16_t maxMss) {
+    if (size < TCP_HLEN) {
+        return false;
+    }
+    tcp_hdr* tcphdr = (tcp_hdr*)segment;
+    const size_t hlen = TCPH_HDRLEN_BYTES(tcphdr);
+    if (hlen < TCP_HLEN || hlen > size) {
+        return false;
+    }
+
+    uint8_t* opt = segment + TCP_HLEN;
+    const uint8_t* end = segment + hlen;
+    while (opt < end && *opt != TCP_OPT_END) {
+        if (*opt == TCP_OPT_NOP) {
+            ++opt;
+            continue;
+        }
+        if (end - opt < 2 || opt[1] < 2 || opt[1] > end - opt) {
+            break;
+        }
+        if (opt[0] == TCP_OPT_MSS && opt[1] == 4) {
+            const uint16_t mss = ((uint16_t)opt[2] << 8) | opt[3];
+            if (mss <= maxMss) {
+                return false;
+            }
+            /* The option is not necessarily aligned to a 16-bit boundary, so the checksum is
+             * updated for the aligned words that contain the value
+             */
+            const size_t offs = (opt + 2 - segment) & ~(size_t)1;
+            const size_t n = (opt + 4 - segment) - offs + ((opt + 4 - segment) & 1);
+            uint8_t oldData[4] = {};
+            memcpy(oldData, segment + offs, n);
+            opt[2] = maxMss >> 8;
+            opt[3] = maxMss & 0xff;
+            tcphdr->chksum = updateChecksum(tcphdr->chksum, oldData, n, segment + offs, n);
+            return true;
+        }
+        opt += opt[1];
+    }
+    return false;
+}
+
+uint16_t particle::net::nat::updateChecksum(uint16_t chksum, const void* oldData, size_t oldSize, const void* newData, size_t newSize) {
+    /* HC' = ~(~HC + ~m + m') (RFC 1624, 3) */
+    uint32_t sum = (uint16_t)~chksum;
+    sum = addWords(sum, oldData, oldSize, true /* negate */);
+    sum = addWords(sum, newData, newSize, false /* negate */);
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return ~sum;
+}
@@ -23,17 +23,74 @@
 
 /* netdb_hal_impl.h should get included from netdb_hal.h automagically */
 #include "netdb_hal.h"
+#include "dns_cache.h"
 #include <lwip/sockets.h>
 #include <errno.h>
 #include <algorithm>
 
+using particle::net::DnsCache;
+
+namespace {
+
+uint8_t familyToAddrType(int family) {
+    return (family == AF_INET6) ? LWIP_DNS_ADDRTYPE_IPV6 : LWIP_DNS_ADDRTYPE_IPV4;
+}
+
+/* Let the DNS cache know the result of a lookup performed by lwIP's resolver */
+void confirmHostent(const char* name, const struct hostent* h) {
+    if (name && h && h->h_addr_list && h->h_addr_list[0]) {
+        /* lwIP stores ip_addr_t in the address list */
+        const auto addr = (const ip_addr_t*)h->h_addr_list[0];
+        DnsCache::instance()->confirm(name, familyToAddrType(h->h_addrtype), addr);
+    }
+}
+
+void confirmAddrinfo(const char* name, int family, int ret, const struct addrinfo* ai) {
+    if (!name) {
+        return;
+    }
+    if (ret != 0) {
+        if (ret == EAI_FAIL && (family == AF_INET || family == AF_INET6)) {
+            DnsCache::instance()->confirm(name, familyToAddrType(family), nullptr);
+        }
+        return;
+    }
+    for (; ai; ai = ai->ai_next) {
+        ip_addr_t addr = {};
+        if (ai->ai_family == AF_INET) {
+            IP_SET_TYPE_VAL(addr, IPADDR_TYPE_V4);
+            inet_addr_to_ip4addr(ip_2_ip4(&addr), &((const struct sockaddr_in*)ai->ai_addr)->sin_addr);
+        } else if (ai->ai_family == AF_INET6) {
+            IP_SET_TYPE_VAL(addr, IPADDR_TYPE_V6);
+            inet6_addr_to_ip6addr(ip_2_ip6(&addr), &((const struct sockaddr_in6*)ai->ai_addr)->sin6_addr);
+        } else {
+            continue;
+        }
+        DnsCache::instance()->confirm(name, familyToAddrType(ai->ai_family), &addr);
+    }
+}
+
+int getAddrInfo(const char* hostname, const char* servname, const struct addrinfo* hints, struct addrinfo** res) {
+    const int ret = lwip_getaddrinfo(hostname, servname, hints, res);
+    confirmAddrinfo(hostname, hints ? hints->ai_family : AF_UNSPEC, ret, (ret == 0) ? *res : nullptr);
+    return ret;
+}
+
+} /* anonymous */
+
 struct hostent* netdb_gethostbyname(const char *name) {
-    return lwip_gethostbyname(name);
+    struct hostent* h = lwip_gethostbyname(name);
+    confirmHostent(name, h);
+    return h;
 }
 
 int netdb_gethostbyname_r(const char* name, struct hostent* ret, char* buf,
                           size_t buflen, struct hostent** result, int* h_errnop) {
-    return lwip_gethostbyname_r(name, ret, buf, buflen, result, h_errnop);
+    const int r = lwip_gethostbyname_r(name, ret, buf, buflen, result, h_errnop);
+    if (r == 0 && result) {
+        confirmHostent(name, *result);
+    }
+    return r;
 }
 
 void netdb_freeaddrinfo(struct addrinfo* ai) {
@@ -48,12 +105,12 @@ int netdb_getaddrinfo(const char* hostname, const char* servname,
 
         /* First perform a lookup with AF_INET6 */
         h.ai_family = AF_INET6;
-        int rinet6 = lwip_getaddrinfo(hostname, servname, &h, res);
+        int rinet6 = getAddrInfo(hostname, servname, &h, res);
 
         /* Next perform a lookup with AF_INET */
         h.ai_family = AF_INET;
         /* FIXME: expects that there is either 1 or 0 results from the previous call */
-        int rinet = lwip_getaddrinfo(hostname, servname, &h, rinet6 == 0 && *res ? &((*res)->ai_next) : res);
+        int rinet = getAddrInfo(hostname, servname, &h, rinet6 == 0 && *res ? &((*res)->ai_next) : res);
 
         if (rinet6 == 0 || rinet == 0) {
             return 0;
@@ -61,7 +118,7 @@ int netdb_getaddrinfo(const char* hostname, const char* servname,
 
         return std::max(rinet, rinet6);
     }
-    return lwip_getaddrinfo(hostname, servname, hints, res);
+    return getAddrInfo(hostname, servname, hints, res);
 }
 
 int netdb_getnameinfo(const struct sockaddr* sa, socklen_t salen, char* host,
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "netstatapi.h"
+#include "lwiplock.h"
+#include "system_error.h"
+#include <lwip/stats.h>
+#include <lwip/memp.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace particle::net;
+
+int netstat_get_info(netstat_info* info, void* reserved) {
+    if (!info || info->size < sizeof(info->size)) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    netstat_info s = {};
+    s.size = info->size;
+    {
+        LwipTcpIpCoreLock lk;
+#if MEMP_STATS
+        const auto pool = lwip_stats.memp[MEMP_PBUF_POOL];
+        if (pool) {
+            s.pbuf_pool_size = pool->avail;
+            s.pbuf_pool_used = pool->used;
+            s.pbuf_pool_max = pool->max;
+            s.pbuf_pool_errors = pool->err;
+        }
+#endif // MEMP_STATS
+#if MEM_STATS
+        s.heap_used = lwip_stats.mem.used;
+        s.heap_max = lwip_stats.mem.max;
+        s.heap_errors = lwip_stats.mem.err;
+#endif // MEM_STATS
+#if TCP_STATS
+        s.tcp_sent = lwip_stats.tcp.xmit;
+        s.tcp_received = lwip_stats.tcp.recv;
+        s.tcp_dropped = lwip_stats.tcp.drop;
+#endif // TCP_STATS
+#if MIB2_STATS
+        s.tcp_retransmits = lwip_stats.mib2.tcpretranssegs;
+#endif // MIB2_STATS
+    }
+    // Older callers may pass a smaller structure
+    memcpy(info, &s, std::min<size_t>(info->size, sizeof(s)));
+    return 0;
+}
@@ -18,6 +18,7 @@
 #include "resolvapi.h"
 #include "lwiplock.h"
 #include "ipsockaddr.h"
+#include "dns_cache.h"
 #include <lwip/dns.h>
 #include "logging.h"
 
@@ -190,6 +191,8 @@ int resolv_event_handler_del(resolv_event_handler_cookie_t cookie) {
 
 void dns_list_change_callback_handler(u8_t numdns, const ip_addr_t *dnsserver) {
     LOG(INFO, "DNS server list changed");
+    /* Cached answers may be specific to the previous servers */
+    DnsCache::instance()->clear();
     for (EventHandlerList* h = s_eventHandlerList; h != nullptr; h = h->next) {
         if (h->handler) {
             /* FIXME */
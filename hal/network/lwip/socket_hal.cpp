@@ -94,3 +94,20 @@ int sock_fcntl(int s, int cmd, ...) {
   va_end(vl);
   return lwip_fcntl(s, cmd, val);
 }
+
+int sock_poll(struct pollfd* fds, nfds_t nfds, int timeout) {
+  return lwip_poll(fds, nfds, timeout);
+}
+
+int sock_select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds,
+                struct timeval* timeout) {
+  return lwip_select(nfds, readfds, writefds, exceptfds, timeout);
+}
+
+ssize_t sock_sendmsg(int s, const struct msghdr* msg, int flags) {
+  return lwip_sendmsg(s, msg, flags);
+}
+
+ssize_t sock_recvmsg(int s, struct msghdr* msg, int flags) {
+  return lwip_recvmsg(s, msg, flags);
+}
@@ -99,6 +99,28 @@ int AtParser::execCommand(unsigned timeout, const char* fmt, ...) {
     return cmd.exec();
 }
 
+int AtParser::queueCommand(const char* cmd, unsigned flags, CommandCallback callback, void* data) {
+    CHECK_TRUE(p_, SYSTEM_ERROR_INVALID_STATE);
+    return p_->queueCommand(cmd, 0 /* timeout */, flags, callback, data);
+}
+
+int AtParser::queueCommand(unsigned timeout, const char* cmd, unsigned flags, CommandCallback callback, void* data) {
+    CHECK_TRUE(p_, SYSTEM_ERROR_INVALID_STATE);
+    CHECK_TRUE(timeout > 0, SYSTEM_ERROR_INVALID_ARGUMENT);
+    return p_->queueCommand(cmd, timeout, flags, callback, data);
+}
+
+int AtParser::processQueue() {
+    CHECK_TRUE(p_, SYSTEM_ERROR_INVALID_STATE);
+    return p_->processQueue();
+}
+
+void AtParser::clearQueue() {
+    if (p_) {
+        p_->clearQueue();
+    }
+}
+
 int AtParser::addUrcHandler(const char* prefix, UrcHandler handler, void* data) {
     CHECK_TRUE(p_, SYSTEM_ERROR_INVALID_STATE);
     return p_->addUrcHandler(prefix, handler, data);
@@ -203,6 +203,36 @@ public:
      * @see `addUrcHandler()`
      */
     typedef int(*UrcHandler)(AtResponseReader* reader, const char* prefix, void* data);
+    /**
+     * The signature of a function invoked by the parser when a queued AT command completes.
+     *
+     * @param result One of the values defined by `AtResponse::Result`, or a negative result code
+     *        in case of an error.
+     * @param errorCode Error code reported via the "+CME ERROR" or "+CMS ERROR" result code.
+     * @param data User data.
+     *
+     * @see `queueCommand()`
+     */
+    typedef void(*CommandCallback)(int result, int errorCode, void* data);
+
+    /**
+     * Flags for queued AT commands.
+     *
+     * @see `queueCommand()`
+     */
+    enum CommandFlag {
+        /**
+         * The command can be combined with adjacent commands that have this flag set into a single
+         * command line, e.g. "AT+CREG=2;+CGREG=2". Such a command needs to use the extended syntax
+         * and should not produce any information text other than known URCs.
+         *
+         * Only idempotent commands, such as read commands and set commands that assign fixed
+         * values to parameters, can be combined. The final result code of a failed command line
+         * doesn't identify the failed command, so the commands are resent one by one and the
+         * commands preceding the failed one get executed twice.
+         */
+        COMBINE = 0x01
+    };
 
     /**
      * Constructs a parser object.
@@ -316,6 +346,74 @@ public:
      * @see `AtParserConfig::commandTimeout()`
      */
     int execCommand(unsigned timeout, const char* fmt, ...);
+    /**
+     * Adds an AT command to the command queue.
+     *
+     * Queued commands are sent to the DCE by `processQueue()`. Adjacent commands that have the
+     * `COMBINE` flag set are sent as a single command line, which saves a round-trip per command:
+     *
+     * ```cpp
+     * parser.queueCommand("AT+CREG=2", AtParser::COMBINE);
+     * parser.queueCommand("AT+CGREG=2", AtParser::COMBINE);
+     * parser.queueCommand("AT+COPS=0,2", 0, copsDone, this);
+     * const int r = parser.processQueue(); // "AT+CREG=2;+CGREG=2", "AT+COPS=0,2"
+     * ```
+     *
+     * The information text sent by the DCE in response to a queued command is discarded, unless
+     * it is handled by one of the registered URC handlers.
+     *
+     * Do not set the `COMBINE` flag for commands that can't be executed more than once without
+     * side effects, such as "AT+COPS=0" or "AT+CGACT=1,1": if the command line fails, every
+     * command of the line is resent up to the failed one.
+     *
+     * @param cmd Command string.
+     * @param flags Command flags (a combination of the values defined by `CommandFlag`).
+     * @param callback Callback function invoked when the command completes.
+     * @param data User data.
+     * @return `0` on success, or a negative result code in case of an error.
+     *
+     * @see `processQueue()`
+     */
+    int queueCommand(const char* cmd, unsigned flags = 0, CommandCallback callback = nullptr, void* data = nullptr);
+    /**
+     * Adds an AT command to the command queue.
+     *
+     * This method is similar to `queueCommand(const char* cmd, ...)`, but it also overrides
+     * the default command timeout.
+     *
+     * @param timeout Timeout in milliseconds.
+     * @param cmd Command string.
+     * @param flags Command flags (a combination of the values defined by `CommandFlag`).
+     * @param callback Callback function invoked when the command completes.
+     * @param data User data.
+     * @return `0` on success, or a negative result code in case of an error.
+     *
+     * @see `processQueue()`
+     * @see `AtParserConfig::commandTimeout()`
+     */
+    int queueCommand(unsigned timeout, const char* cmd, unsigned flags = 0, CommandCallback callback = nullptr,
+            void* data = nullptr);
+    /**
+     * Sends the queued AT commands and waits for their completion.
+     *
+     * The commands are sent in the order they were queued. The processing stops at the first
+     * command that doesn't complete with `AtResponse::OK`, and the remaining commands are
+     * cancelled. If a combined command line fails, its commands are resent one by one in order to
+     * determine which of them has failed. The commands that are resent after having succeeded as
+     * part of the command line need to be idempotent (see `AtParser::COMBINE`).
+     *
+     * @return `AtResponse::OK` if all commands have completed successfully, the final result code
+     *         of the failed command, or a negative result code in case of an error.
+     *
+     * @see `queueCommand()`
+     */
+    int processQueue();
+    /**
+     * Cancels the queued AT commands.
+     *
+     * The callbacks of the cancelled commands are invoked with `SYSTEM_ERROR_CANCELLED`.
+     */
+    void clearQueue();
     /**
      * Registers an URC handler.
      *
@@ -100,6 +100,26 @@ size_t findNewline(const char* data, size_t size) {
     return size;
 }
 
+size_t findNewlineOrDelim(const char* data, size_t size, char delim) {
+    for (size_t i = 0; i < size; ++i) {
+        if (isNewline(data[i]) || data[i] == delim) {
+            return i;
+        }
+    }
+    return size;
+}
+
+// Returns true if the command uses the extended syntax ("AT+<name>...")
+bool isExtendedCommand(const char* cmd, size_t size) {
+    return (size > 3 && tolower(cmd[0]) == 'a' && tolower(cmd[1]) == 't' && cmd[2] == '+');
+}
+
+inline void completeCommand(AtParser::CommandCallback callback, int result, int errorCode, void* data) {
+    if (callback) {
+        callback(result, errorCode, data);
+    }
+}
+
 inline system_tick_t millis() {
     return HAL_Timer_Get_Milli_Seconds();
 }
@@ -205,18 +225,15 @@ int AtParserImpl::readResult(int* errorCode) {
 }
 
 int AtParserImpl::readLine(char* data, size_t size) {
-    int ret = 0;
-    if (checkStatus(StatusFlag::URC_HANDLER)) {
-        ret = readLine(data, size, nullptr /* timeout */);
-    } else if (!checkStatus(StatusFlag::READY)) {
-        ret = readRespLine(data, size);
-    } else {
-        ret = SYSTEM_ERROR_INVALID_STATE;
-    }
-    if (ret < 0) {
-        error(ret);
-    }
-    return ret;
+    return read(data, size, ReadMode::LINE, 0 /* delim */);
+}
+
+int AtParserImpl::readUntil(char* data, size_t size, char delim) {
+    return read(data, size, ReadMode::UNTIL, delim);
+}
+
+int AtParserImpl::readData(char* data, size_t size) {
+    return read(data, size, ReadMode::DATA, 0 /* delim */);
 }
 
 int AtParserImpl::nextLine() {
@@ -275,6 +292,91 @@ int AtParserImpl::hasNextLine(bool* hasLine) {
     return 0;
 }
 
+int AtParserImpl::queueCommand(const char* cmd, unsigned timeout, unsigned flags, AtParser::CommandCallback callback,
+        void* data) {
+    const size_t cmdSize = strlen(cmd);
+    if (cmdSize == 0) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    if (!isExtendedCommand(cmd, cmdSize)) {
+        flags &= ~AtParser::COMBINE; // Only extended syntax commands can be combined
+    }
+    QueuedCommand c = {};
+    c.cmd.reset(new(std::nothrow) char[cmdSize + 1]);
+    if (!c.cmd) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    memcpy(c.cmd.get(), cmd, cmdSize + 1);
+    c.cmdSize = cmdSize;
+    c.timeout = timeout;
+    c.flags = flags;
+    c.callback = callback;
+    c.data = data;
+    if (!cmdQueue_.append(std::move(c))) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    return 0;
+}
+
+int AtParserImpl::processQueue() {
+    if (!checkStatus(StatusFlag::READY)) {
+        return SYSTEM_ERROR_BUSY;
+    }
+    int ret = AtResponse::OK;
+    while (!cmdQueue_.isEmpty()) {
+        // Take the commands out of the queue, so that the callbacks can queue more commands
+        const size_t count = combinedCount();
+        Vector<QueuedCommand> cmds;
+        if (!cmds.reserve(count)) {
+            ret = SYSTEM_ERROR_NO_MEMORY;
+            break;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            cmds.append(cmdQueue_.takeFirst());
+        }
+        int errorCode = 0;
+        ret = execQueued(cmds.data(), count, &errorCode);
+        size_t failed = 0; // Index of the failed command
+        if (ret > 0 && count > 1) {
+            // The DCE stops processing a command line at the first failed command. Resend the
+            // commands one by one to find out which of them has failed
+            for (failed = 0; failed < count; ++failed) {
+                ret = execQueued(&cmds.at(failed), 1, &errorCode);
+                if (ret != AtResponse::OK) {
+                    break;
+                }
+            }
+        }
+        if (ret == AtResponse::OK) {
+            for (const auto& c: cmds) {
+                completeCommand(c.callback, AtResponse::OK, 0, c.data);
+            }
+            continue;
+        }
+        // In case of an I/O error, the status of the remaining commands is unknown
+        for (size_t i = 0; i < count; ++i) {
+            const auto& c = cmds.at(i);
+            if (i < failed) {
+                completeCommand(c.callback, AtResponse::OK, 0, c.data);
+            } else if (i == failed || ret < 0) {
+                completeCommand(c.callback, ret, errorCode, c.data);
+            } else {
+                completeCommand(c.callback, SYSTEM_ERROR_CANCELLED, 0, c.data);
+            }
+        }
+        break;
+    }
+    clearQueue();
+    return ret;
+}
+
+void AtParserImpl::clearQueue() {
+    while (!cmdQueue_.isEmpty()) {
+        const auto c = cmdQueue_.takeFirst();
+        completeCommand(c.callback, SYSTEM_ERROR_CANCELLED, 0, c.data);
+    }
+}
+
 int AtParserImpl::addUrcHandler(const char* prefix, AtParser::UrcHandler handler, void* data) {
     const size_t prefixSize = strlen(prefix);
     if (prefixSize == 0 || prefixSize > INPUT_BUF_SIZE) {
@@ -286,9 +388,15 @@ int AtParserImpl::addUrcHandler(const char* prefix, AtParser::UrcHandler handler
     h.prefixSize = prefixSize;
     h.callback = handler;
     h.data = data;
-    if (!urcHandlers_.append(std::move(h))) {
+    // Keep the handlers sorted by prefix
+    int i = 0;
+    while (i < urcHandlers_.size() && strcmp(urcHandlers_.at(i).prefix, prefix) < 0) {
+        ++i;
+    }
+    if (!urcHandlers_.insert(i, std::move(h))) {
         return SYSTEM_ERROR_NO_MEMORY;
     }
+    resetUrcMatch();
     return 0;
 }
 
@@ -296,6 +404,7 @@ void AtParserImpl::removeUrcHandler(const char* prefix) {
     for (int i = 0; i < urcHandlers_.size(); ++i) {
         if (strcmp(urcHandlers_.at(i).prefix, prefix) == 0) {
             urcHandlers_.removeAt(i);
+            resetUrcMatch();
             break;
         }
     }
@@ -315,12 +424,13 @@ int AtParserImpl::processUrc(unsigned timeout) {
             ++urcCount;
             break;
         }
-        PARSER_CHECK(readLine(nullptr, 0, &timeout));
+        PARSER_CHECK(readLine(nullptr, 0, ReadMode::LINE, 0 /* delim */, &timeout));
     }
     return urcCount;
 }
 
 void AtParserImpl::reset() {
+    bufOffs_ = 0;
     bufPos_ = 0;
     cmdSize_ = 0;
     cmdTimeout_ = 0;
@@ -328,14 +438,34 @@ void AtParserImpl::reset() {
     respSize_ = 0;
     errorCode_ = 0;
     result_ = AtResponse::OK;
-    status_ = StatusFlag::READY | StatusFlag::LINE_BEGIN;
+    status_ = StatusFlag::READY | StatusFlag::LINE_END;
+    resetUrcMatch();
 }
 
 bool AtParserImpl::isConfigValid(const AtParserConfig& conf) {
     return (conf.stream() != nullptr && conf.commandTimeout() > 0 && conf.streamTimeout() > 0);
 }
 
-int AtParserImpl::readRespLine(char* data, size_t size) {
+int AtParserImpl::read(char* data, size_t size, ReadMode mode, char delim) {
+    int ret = 0;
+    if (checkStatus(StatusFlag::URC_HANDLER)) {
+        if (mode == ReadMode::DATA) {
+            ret = readData(data, size, nullptr /* timeout */);
+        } else {
+            ret = readLine(data, size, mode, delim, nullptr /* timeout */);
+        }
+    } else if (!checkStatus(StatusFlag::READY)) {
+        ret = readRespLine(data, size, mode, delim);
+    } else {
+        ret = SYSTEM_ERROR_INVALID_STATE;
+    }
+    if (ret < 0) {
+        error(ret);
+    }
+    return ret;
+}
+
+int AtParserImpl::readRespLine(char* data, size_t size, ReadMode mode, char delim) {
     if (checkStatus(StatusFlag::HAS_RESULT)) {
         return SYSTEM_ERROR_END_OF_STREAM;
     }
@@ -343,6 +473,10 @@ int AtParserImpl::readRespLine(char* data, size_t size) {
         CHECK(waitEcho());
         setStatus(StatusFlag::HAS_ECHO);
     }
+    if (mode == ReadMode::DATA) {
+        // Binary data is not checked for result codes and URCs
+        return readData(data, size, &cmdTimeout_);
+    }
     size_t bytesRead = 0;
     for (;;) {
         if (checkStatus(StatusFlag::LINE_BEGIN)) {
@@ -352,7 +486,7 @@ int AtParserImpl::readRespLine(char* data, size_t size) {
             }
         }
         if (!checkStatus(StatusFlag::LINE_END)) {
-            bytesRead = CHECK(readLine(data, size, &cmdTimeout_));
+            bytesRead = CHECK(readLine(data, size, mode, delim, &cmdTimeout_));
             break;
         }
         CHECK(nextLine(&cmdTimeout_));
@@ -374,6 +508,49 @@ int AtParserImpl::waitEcho() {
     return 0;
 }
 
+int AtParserImpl::execQueued(const QueuedCommand* cmds, size_t count, int* errorCode) {
+    CHECK(newCommand());
+    unsigned timeout = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const auto& c = cmds[i];
+        if (i == 0) {
+            PARSER_CHECK(write(c.cmd.get(), c.cmdSize));
+        } else {
+            // "AT+<name>" is appended to the command line as ";+<name>"
+            PARSER_CHECK(write(";", 1));
+            PARSER_CHECK(write(c.cmd.get() + 2, c.cmdSize - 2));
+        }
+        timeout += (c.timeout > 0) ? c.timeout : conf_.commandTimeout();
+    }
+    commandTimeout(timeout);
+    PARSER_CHECK(sendCommand());
+    const int ret = PARSER_CHECK(readResult(errorCode));
+    resetCommand();
+    return ret;
+}
+
+size_t AtParserImpl::combinedCount() const {
+    const auto& first = cmdQueue_.first();
+    if (!(first.flags & AtParser::COMBINE)) {
+        return 1;
+    }
+    size_t lineSize = first.cmdSize;
+    size_t count = 1;
+    for (; count < (size_t)cmdQueue_.size(); ++count) {
+        const auto& c = cmdQueue_.at(count);
+        if (!(c.flags & AtParser::COMBINE)) {
+            break;
+        }
+        // Keep the command line short enough for the echo to be verified in full
+        const size_t n = lineSize + c.cmdSize - 1;
+        if (n > CMD_BUF_SIZE) {
+            break;
+        }
+        lineSize = n;
+    }
+    return count;
+}
+
 int AtParserImpl::parseLine(unsigned flags, unsigned* timeout) {
     int ret = ParseResult::NO_MATCH;
     for (;;) {
@@ -414,7 +591,7 @@ int AtParserImpl::parseLine(unsigned flags, unsigned* timeout) {
                 conf_.logEnabled(false); // Do not log the command echo
             }
             // Read and discard remaining characters of the line
-            const int r = readLine(nullptr, 0, timeout);
+            const int r = readLine(nullptr, 0, ReadMode::LINE, 0 /* delim */, timeout);
             conf_.logEnabled(logEnabled);
             CHECK(r);
             break;
@@ -426,7 +603,9 @@ int AtParserImpl::parseLine(unsigned flags, unsigned* timeout) {
 }
 
 int AtParserImpl::parseResult() {
-    if (bufPos_ == 0) {
+    char* const data = buf_ + bufOffs_;
+    const size_t size = bufSize();
+    if (size == 0) {
         return ParseResult::READ_MORE;
     }
     // Look for a result code that matches the buffer contents
@@ -434,8 +613,8 @@ int AtParserImpl::parseResult() {
     size_t maxSize = 0;
     for (size_t i = 0; i < RESULT_CODE_COUNT; ++i) {
         const ResultCode& r2 = RESULT_CODES[i];
-        const size_t n = std::min(bufPos_, r2.strSize);
-        if (memcmp(buf_, r2.str, n) == 0 && n > maxSize) {
+        const size_t n = std::min(size, r2.strSize);
+        if (memcmp(data, r2.str, n) == 0 && n > maxSize) {
             r = &r2;
             maxSize = n;
         }
@@ -443,20 +622,20 @@ int AtParserImpl::parseResult() {
     if (!r) {
         return ParseResult::NO_MATCH;
     }
-    if (bufPos_ < r->strSize + 1) {
+    if (size < r->strSize + 1) {
         return ParseResult::READ_MORE;
     }
-    char c = buf_[r->strSize]; // Separator character
+    char c = data[r->strSize]; // Separator character
     if (r->val == AtResponse::CME_ERROR || r->val == AtResponse::CMS_ERROR) {
         // "+CME ERROR" or "+CMS ERROR" should be followed by ':'
         if (c != ':') {
             return ParseResult::NO_MATCH;
         }
-        if (bufPos_ < r->strSize + 2) {
+        if (size < r->strSize + 2) {
             return ParseResult::READ_MORE;
         }
-        const auto codeStr = buf_ + r->strSize + 1; // First character after ':'
-        const size_t codeStrSize = bufPos_ - r->strSize - 1;
+        const auto codeStr = data + r->strSize + 1; // First character after ':'
+        const size_t codeStrSize = size - r->strSize - 1;
         const size_t n = findNewline(codeStr, codeStrSize);
         if (n == codeStrSize) {
             return ParseResult::READ_MORE;
@@ -487,76 +666,139 @@ int AtParserImpl::parseResult() {
 }
 
 int AtParserImpl::parseUrc(const UrcHandler** handler) {
-    if (bufPos_ == 0) {
-        return ParseResult::READ_MORE;
-    }
-    // Look for an URC prefix that matches the buffer contents
-    const UrcHandler* h = nullptr;
-    size_t maxSize = 0;
-    for (size_t i = 0; i < (size_t)urcHandlers_.size(); ++i) {
-        const UrcHandler& h2 = urcHandlers_.at(i);
-        const size_t n = std::min(bufPos_, h2.prefixSize);
-        if (memcmp(buf_, h2.prefix, n) == 0 && n > maxSize) {
-            h = &h2;
-            maxSize = n;
+    // Continue matching from where the previous call stopped, so that every character of the line
+    // is examined only once
+    const char* const data = bufData();
+    const size_t size = bufSize();
+    auto& m = urcMatch_;
+    for (;;) {
+        // A prefix that is fully matched sorts before the longer prefixes in the range
+        while (m.begin < m.end && urcHandlers_.at(m.begin).prefixSize == m.size) {
+            m.handler = m.begin++;
+        }
+        if (m.begin == m.end) {
+            break;
+        }
+        if (m.size == size) {
+            return ParseResult::READ_MORE;
         }
+        const char c = data[m.size];
+        while (m.begin < m.end && urcHandlers_.at(m.begin).prefix[m.size] != c) {
+            ++m.begin;
+        }
+        size_t end = m.begin;
+        while (end < m.end && urcHandlers_.at(end).prefix[m.size] == c) {
+            ++end;
+        }
+        m.end = end;
+        ++m.size;
     }
-    if (!h) {
+    if (m.handler < 0) {
         return ParseResult::NO_MATCH;
     }
-    if (bufPos_ < h->prefixSize) {
-        return ParseResult::READ_MORE;
-    }
-    *handler = h;
+    *handler = &urcHandlers_.at(m.handler);
     return ParseResult::PARSED_URC;
 }
 
+void AtParserImpl::resetUrcMatch() {
+    urcMatch_.begin = 0;
+    urcMatch_.end = urcHandlers_.size();
+    urcMatch_.size = 0;
+    urcMatch_.handler = -1;
+}
+
 int AtParserImpl::parseEcho() {
-    if (bufPos_ == 0) {
+    const size_t size = bufSize();
+    if (size == 0) {
         return ParseResult::READ_MORE;
     }
     // Check if the command line matches the buffer contents
-    size_t n = std::min(bufPos_, cmdSize_);
-    if (memcmp(buf_, cmdData_, n) != 0) {
+    size_t n = std::min(size, cmdSize_);
+    if (memcmp(bufData(), cmdData_, n) != 0) {
         return ParseResult::NO_MATCH;
     }
     n = std::min(cmdSize_, INPUT_BUF_SIZE);
-    if (bufPos_ < n) {
+    if (size < n) {
         return ParseResult::READ_MORE;
     }
     return ParseResult::PARSED_ECHO;
 }
 
-int AtParserImpl::readLine(char* data, size_t size, unsigned* timeout) {
+int AtParserImpl::readLine(char* data, size_t size, ReadMode mode, char delim, unsigned* timeout) {
     size_t bytesRead = 0;
     for (;;) {
-        size_t n = findNewline(buf_, bufPos_);
+        size_t n = (mode == ReadMode::UNTIL) ? findNewlineOrDelim(bufData(), bufSize(), delim) :
+                findNewline(bufData(), bufSize());
         if (data && n > size) {
             n = size;
         }
         if (n > 0) {
             clearStatus(StatusFlag::LINE_BEGIN);
-            respSize_ += appendToBuf(respData_ + respSize_, RESP_BUF_SIZE - respSize_, buf_, n);
+            appendResp(bufData(), n);
             if (data) {
-                memcpy(data, buf_, n);
+                memcpy(data, bufData(), n);
                 data += n;
                 size -= n;
             }
             bytesRead += n;
-            bufPos_ -= n;
+            consume(n);
         }
-        if (bufPos_ > 0) {
-            memmove(buf_, buf_ + n, bufPos_);
-            if (isNewline(buf_[0])) {
+        if (bufSize() > 0) {
+            const char c = *bufData();
+            if (isNewline(c)) {
                 setStatus(StatusFlag::LINE_END);
                 if (conf_.logEnabled()) {
                     logRespLine(respData_, respSize_);
                 }
                 respSize_ = 0;
+            } else if (mode == ReadMode::UNTIL && c == delim) {
+                clearStatus(StatusFlag::LINE_BEGIN);
+                appendResp(&c, 1);
+                consume(1);
             }
             break;
         }
-        CHECK(readMore(timeout));
+        if (data && size > 0) {
+            // The input buffer is empty, read directly into the destination buffer. Only the data
+            // following the end of the line needs to be moved to the input buffer
+            const size_t n = CHECK(readStream(data, std::min(size, INPUT_BUF_SIZE), timeout));
+            const size_t lineSize = (mode == ReadMode::UNTIL) ? findNewlineOrDelim(data, n, delim) :
+                    findNewline(data, n);
+            memcpy(buf_, data + lineSize, n - lineSize);
+            bufOffs_ = 0;
+            bufPos_ = n - lineSize;
+            if (lineSize > 0) {
+                clearStatus(StatusFlag::LINE_BEGIN);
+                appendResp(data, lineSize);
+                data += lineSize;
+                size -= lineSize;
+                bytesRead += lineSize;
+            }
+        } else {
+            CHECK(readMore(timeout));
+        }
+    }
+    return bytesRead;
+}
+
+int AtParserImpl::readData(char* data, size_t size, unsigned* timeout) {
+    if (checkStatus(StatusFlag::LINE_END)) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    // Consume the buffered data first
+    size_t bytesRead = std::min(size, bufSize());
+    if (data) {
+        memcpy(data, bufData(), bytesRead);
+    }
+    consume(bytesRead);
+    while (bytesRead < size) {
+        // The input buffer is empty at this point
+        const auto dest = data ? data + bytesRead : buf_;
+        const size_t n = data ? size - bytesRead : std::min(size - bytesRead, INPUT_BUF_SIZE);
+        bytesRead += CHECK(readStream(dest, n, timeout));
+    }
+    if (size > 0) {
+        clearStatus(StatusFlag::LINE_BEGIN);
     }
     return bytesRead;
 }
@@ -564,9 +806,9 @@ int AtParserImpl::readLine(char* data, size_t size, unsigned* timeout) {
 int AtParserImpl::nextLine(unsigned* timeout) {
     size_t bytesRead = 0;
     for (;;) {
-        size_t n = findNewline(buf_, bufPos_);
-        respSize_ += appendToBuf(respData_ + respSize_, RESP_BUF_SIZE - respSize_, buf_, n);
-        if (n < bufPos_) {
+        size_t n = findNewline(bufData(), bufSize());
+        appendResp(bufData(), n);
+        if (n < bufSize()) {
             setStatus(StatusFlag::LINE_END);
             if (conf_.logEnabled()) {
                 logRespLine(respData_, respSize_);
@@ -574,21 +816,20 @@ int AtParserImpl::nextLine(unsigned* timeout) {
             respSize_ = 0;
             do {
                 ++n;
-            } while (n < bufPos_ && isNewline(buf_[n]));
+            } while (n < bufSize() && isNewline(bufData()[n]));
         }
         if (n > 0) {
             clearStatus(StatusFlag::LINE_BEGIN);
             bytesRead += n;
-            bufPos_ -= n;
+            consume(n);
         }
-        if (bufPos_ > 0) {
-            memmove(buf_, buf_ + n, bufPos_);
-        } else {
+        if (bufSize() == 0) {
             CHECK(readMore(timeout));
         }
-        if (checkStatus(StatusFlag::LINE_END) && !isNewline(buf_[0])) {
+        if (checkStatus(StatusFlag::LINE_END) && !isNewline(*bufData())) {
             clearStatus(StatusFlag::LINE_END);
             setStatus(StatusFlag::LINE_BEGIN);
+            resetUrcMatch();
             break;
         }
     }
@@ -596,11 +837,23 @@ int AtParserImpl::nextLine(unsigned* timeout) {
 }
 
 int AtParserImpl::readMore(unsigned* timeout) {
+    if (bufOffs_ > 0) {
+        // Move the unprocessed data to the beginning of the buffer
+        memmove(buf_, buf_ + bufOffs_, bufSize());
+        bufPos_ -= bufOffs_;
+        bufOffs_ = 0;
+    }
     assert(bufPos_ < INPUT_BUF_SIZE);
+    const size_t bytesRead = CHECK(readStream(buf_ + bufPos_, INPUT_BUF_SIZE - bufPos_, timeout));
+    bufPos_ += bytesRead;
+    return bytesRead;
+}
+
+int AtParserImpl::readStream(char* data, size_t size, unsigned* timeout) {
     const auto strm = conf_.stream();
     size_t bytesRead = 0;
     for (;;) {
-        bytesRead = CHECK(strm->read(buf_ + bufPos_, INPUT_BUF_SIZE - bufPos_));
+        bytesRead = CHECK(strm->read(data, size));
         if (bytesRead > 0) {
             break;
         }
@@ -622,10 +875,24 @@ int AtParserImpl::readMore(unsigned* timeout) {
             *timeout -= t;
         }
     }
-    bufPos_ += bytesRead;
     return bytesRead;
 }
 
+void AtParserImpl::consume(size_t size) {
+    bufOffs_ += size;
+    if (bufOffs_ == bufPos_) {
+        bufOffs_ = 0;
+        bufPos_ = 0;
+    }
+}
+
+void AtParserImpl::appendResp(const char* data, size_t size) {
+    // The response data is only needed for logging
+    if (conf_.logEnabled()) {
+        respSize_ += appendToBuf(respData_ + respSize_, RESP_BUF_SIZE - respSize_, data, size);
+    }
+}
+
 int AtParserImpl::flushCommand(unsigned* timeout) {
     if (!checkStatus(StatusFlag::FLUSH_CMD)) {
         return 0;
@@ -24,6 +24,8 @@
 
 #include "spark_wiring_vector.h"
 
+#include <memory>
+
 #define PARSER_CHECK(_expr) \
         ({ \
             const auto _ret = _expr; \
@@ -61,10 +63,16 @@ public:
 
     int readResult(int* errorCode);
     int readLine(char* data, size_t size);
+    int readUntil(char* data, size_t size, char delim);
+    int readData(char* data, size_t size);
     int nextLine();
     int hasNextLine(bool* hasLine);
     bool atLineEnd() const;
 
+    int queueCommand(const char* cmd, unsigned timeout, unsigned flags, AtParser::CommandCallback callback, void* data);
+    int processQueue();
+    void clearQueue();
+
     int addUrcHandler(const char* prefix, AtParser::UrcHandler handler, void* data);
     void removeUrcHandler(const char* prefix);
     int processUrc(unsigned timeout);
@@ -96,6 +104,12 @@ private:
         PARSE_ECHO = 0x04 // Parse the command echo
     };
 
+    enum class ReadMode {
+        LINE, // Read until the end of the line
+        UNTIL, // Read until the delimiter character or the end of the line
+        DATA // Read binary data
+    };
+
     enum ParseResult {
         NO_MATCH, // No match found
         PARSED_RESULT, // Parsed a final result code
@@ -111,11 +125,31 @@ private:
         void* data; // User data
     };
 
+    struct QueuedCommand {
+        std::unique_ptr<char[]> cmd; // Command string
+        size_t cmdSize; // Size of the command string
+        unsigned timeout; // Command timeout, or 0 if the default timeout should be used
+        unsigned flags; // Command flags
+        AtParser::CommandCallback callback; // Completion callback
+        void* data; // User data
+    };
+
+    // State of the URC prefix matching. The handlers are sorted by prefix, so that the handlers
+    // whose prefixes match the beginning of the line form a contiguous range that gets narrowed
+    // down as more characters of the line become available
+    struct UrcMatch {
+        size_t begin; // First handler in the range
+        size_t end; // Past-the-end handler in the range
+        size_t size; // Number of matched characters
+        int handler; // Longest fully matched prefix, or -1
+    };
+
     const char* const cmdTerm_; // Command terminator string
     const size_t cmdTermSize_; // Size of the command terminator string
 
     char buf_[INPUT_BUF_SIZE]; // Input buffer
-    size_t bufPos_; // Number of bytes in the input buffer
+    size_t bufOffs_; // Offset of the unprocessed data in the input buffer
+    size_t bufPos_; // End of the data in the input buffer
 
     char cmdData_[CMD_BUF_SIZE]; // Command data
     size_t cmdSize_; // Size of the command data
@@ -129,24 +163,38 @@ private:
     unsigned cmdTimeout_; // Command timeout
     unsigned status_; // Status flags
 
-    Vector<UrcHandler> urcHandlers_; // URC handlers
+    Vector<UrcHandler> urcHandlers_; // URC handlers sorted by prefix
+    UrcMatch urcMatch_; // State of the URC prefix matching for the current line
+    Vector<QueuedCommand> cmdQueue_; // Queued commands
     AtParserConfig conf_; // Parser settings
 
-    int readRespLine(char* data, size_t size);
+    int read(char* data, size_t size, ReadMode mode, char delim);
+    int readRespLine(char* data, size_t size, ReadMode mode, char delim);
     int waitEcho();
 
+    int execQueued(const QueuedCommand* cmds, size_t count, int* errorCode);
+    size_t combinedCount() const;
+
     int parseLine(unsigned flags, unsigned* timeout);
     int parseResult();
     int parseUrc(const UrcHandler** handler);
+    void resetUrcMatch();
     int parseEcho();
 
-    int readLine(char* data, size_t size, unsigned* timeout);
+    int readLine(char* data, size_t size, ReadMode mode, char delim, unsigned* timeout);
+    int readData(char* data, size_t size, unsigned* timeout);
     int nextLine(unsigned* timeout);
     int readMore(unsigned* timeout);
+    int readStream(char* data, size_t size, unsigned* timeout);
+    void consume(size_t size);
+    void appendResp(const char* data, size_t size);
 
     int flushCommand(unsigned* timeout);
     int write(const char* data, size_t* size, unsigned* timeout);
 
+    const char* bufData() const;
+    size_t bufSize() const;
+
     void setStatus(unsigned flags);
     void clearStatus(unsigned flags);
     unsigned checkStatus(unsigned flags) const;
@@ -174,6 +222,14 @@ inline const AtParserConfig& AtParserImpl::config() const {
     return conf_;
 }
 
+inline const char* AtParserImpl::bufData() const {
+    return buf_ + bufOffs_;
+}
+
+inline size_t AtParserImpl::bufSize() const {
+    return bufPos_ - bufOffs_;
+}
+
 inline void AtParserImpl::setStatus(unsigned flags) {
     status_ |= flags;
 }
@@ -135,6 +135,28 @@ int AtResponseReader::vscanf(const char* fmt, va_list args) {
     return n;
 }
 
+int AtResponseReader::readUntil(char* data, size_t size, char delim) {
+    if (!parser_) {
+        return error(SYSTEM_ERROR_INVALID_STATE);
+    }
+    const int n = parser_->readUntil(data, size, delim);
+    if (n < 0) {
+        return error(n);
+    }
+    return n;
+}
+
+int AtResponseReader::read(char* data, size_t size) {
+    if (!parser_) {
+        return error(SYSTEM_ERROR_INVALID_STATE);
+    }
+    const int n = parser_->readData(data, size);
+    if (n < 0) {
+        return error(n);
+    }
+    return n;
+}
+
 int AtResponseReader::readLine(char* buf, size_t size, size_t offs) {
     for (;;) {
         const int n = parser_->readLine(buf + offs, size - offs - 1);
@@ -114,6 +114,46 @@ public:
      * @see `readLine()`
      */
     int vscanf(const char* fmt, va_list args);
+    /**
+     * Reads the current line up to the specified delimiter character.
+     *
+     * This method reads up to `size` characters of the current line, stopping at the delimiter
+     * or at the end of the line. The delimiter is consumed but not stored in the buffer. Unlike
+     * `readLine()`, this method doesn't null-terminate the output. It is typically used to read
+     * the header of a line that is followed by binary data:
+     *
+     * ```cpp
+     * int handleData(AtResponseReader* reader, const char* prefix, void* data) {
+     *     char buf[32];
+     *     const int n = CHECK(reader->readUntil(buf, sizeof(buf), ':')); // "+IPD,<size>:"
+     *     ...
+     *     CHECK(reader->read(dataBuf, dataSize));
+     *     ...
+     * }
+     * ```
+     *
+     * @param data Destination buffer.
+     * @param size Buffer size.
+     * @param delim Delimiter character.
+     * @return Number of characters read, or a negative result code in case of an error.
+     *
+     * @see `read()`
+     */
+    int readUntil(char* data, size_t size, char delim);
+    /**
+     * Reads binary data.
+     *
+     * This method reads exactly `size` bytes of the current line. Newline characters contained in
+     * the data are not interpreted by the parser. The data is read from the underlying stream
+     * directly into the destination buffer, bypassing the parser's input buffer where possible.
+     *
+     * @param data Destination buffer. If `nullptr`, the data is discarded.
+     * @param size Number of bytes to read.
+     * @return Number of bytes read, or a negative result code in case of an error.
+     *
+     * @see `readUntil()`
+     */
+    int read(char* data, size_t size);
     /**
      * Returns the result code of the first failed operation.
      */
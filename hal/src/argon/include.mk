@@ -9,5 +9,7 @@ ifneq (,$(findstring platform,$(DEPENDENCIES)))
 INCLUDE_DIRS += $(HAL_MODULE_PATH)/network/lwip/esp32
 endif
 
+# Wi-Fi links benefit from larger TCP windows
+LWIP_MEMORY_PROFILE ?= HIGH_THROUGHPUT
 
 include $(TARGET_HAL_PATH)/src/nRF52840/include.mk
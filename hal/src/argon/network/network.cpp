@@ -21,6 +21,7 @@
 #include "openthread/lwip_openthreadif.h"
 #include "wiznet/wiznetif.h"
 #include "nat64.h"
+#include "dns_cache.h"
 #include <mutex>
 #include <memory>
 #include <nrf52840.h>
@@ -187,6 +188,9 @@ int lwip_hook_ip6_forward_pre_routing(struct pbuf* p, struct ip6_hdr* ip6hdr, st
 }
 
 int lwip_hook_ip4_input_pre_upper_layers(struct pbuf* p, const struct ip_hdr* iphdr, struct netif* inp) {
+    /* Cache the answers from the upstream DNS servers */
+    DnsCache::instance()->ip4Input(p, iphdr);
+
     auto nat64 = BorderRouterManager::instance()->getNat64();
     if (nat64) {
         int r = nat64->ip4Input(p, (ip_hdr*)iphdr, inp);
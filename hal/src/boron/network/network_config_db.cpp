@@ -19,6 +19,12 @@
 
 #include "cellular_network_manager.h"
 
+#include "file_util.h"
+#include "scope_guard.h"
+#include "check.h"
+
+#include "core_hal.h"
+
 #include <cstring>
 
 namespace particle {
@@ -43,6 +49,21 @@ const size_t NETWORK_CONFIG_SIZE = sizeof(NETWORK_CONFIG) / sizeof(NETWORK_CONFI
 
 const size_t MCC_SIZE = 3;
 
+const auto MODEM_CONFIG_FILE = "/sys/modem_config.bin";
+
+// Format version of the modem configuration file
+const uint32_t MODEM_CONFIG_VERSION = 1;
+
+struct ModemConfigFile {
+    uint32_t version;
+    ModemConfigRecord conf;
+    uint32_t crc; // CRC-32 of the preceding fields
+};
+
+uint32_t modemConfigFileCrc(const ModemConfigFile& f) {
+    return HAL_Core_Compute_CRC32((const uint8_t*)&f, offsetof(ModemConfigFile, crc));
+}
+
 } // unnamed
 
 CellularNetworkConfig networkConfigForImsi(const char* imsi, size_t size) {
@@ -64,4 +85,62 @@ CellularNetworkConfig networkConfigForImsi(const char* imsi, size_t size) {
     return CellularNetworkConfig();
 }
 
+int loadModemConfig(ModemConfigRecord* conf) {
+    const auto fs = filesystem_get_instance(nullptr);
+    CHECK_TRUE(fs, SYSTEM_ERROR_FILE);
+    fs::FsLock lock(fs);
+    CHECK(filesystem_mount(fs));
+    lfs_file_t file = {};
+    CHECK(openFile(&file, MODEM_CONFIG_FILE, LFS_O_RDONLY));
+    SCOPE_GUARD({
+        lfs_file_close(&fs->instance, &file);
+    });
+    ModemConfigFile f = {};
+    const int r = lfs_file_read(&fs->instance, &file, &f, sizeof(f));
+    if (r == 0) {
+        return SYSTEM_ERROR_NOT_FOUND;
+    }
+    CHECK_TRUE(r == sizeof(f) && f.version == MODEM_CONFIG_VERSION && f.crc == modemConfigFileCrc(f),
+            SYSTEM_ERROR_BAD_DATA);
+    *conf = f.conf;
+    return 0;
+}
+
+int saveModemConfig(const ModemConfigRecord& conf) {
+    ModemConfigFile f = {};
+    f.version = MODEM_CONFIG_VERSION;
+    memcpy(&f.conf, &conf, sizeof(conf));
+    f.crc = modemConfigFileCrc(f);
+    // Avoid rewriting the file if the configuration hasn't changed
+    ModemConfigRecord current = {};
+    if (loadModemConfig(&current) == 0 && memcmp(&current, &conf, sizeof(conf)) == 0) {
+        return 0;
+    }
+    const auto fs = filesystem_get_instance(nullptr);
+    CHECK_TRUE(fs, SYSTEM_ERROR_FILE);
+    fs::FsLock lock(fs);
+    CHECK(filesystem_mount(fs));
+    lfs_file_t file = {};
+    CHECK(openFile(&file, MODEM_CONFIG_FILE, LFS_O_WRONLY));
+    SCOPE_GUARD({
+        lfs_file_close(&fs->instance, &file);
+    });
+    int r = lfs_file_truncate(&fs->instance, &file, 0);
+    CHECK_TRUE(r == LFS_ERR_OK, SYSTEM_ERROR_FILE);
+    r = lfs_file_write(&fs->instance, &file, &f, sizeof(f));
+    CHECK_TRUE(r == sizeof(f), SYSTEM_ERROR_FILE);
+    LOG(TRACE, "Updated file: %s", MODEM_CONFIG_FILE);
+    return 0;
+}
+
+int removeModemConfig() {
+    const auto fs = filesystem_get_instance(nullptr);
+    CHECK_TRUE(fs, SYSTEM_ERROR_FILE);
+    fs::FsLock lock(fs);
+    CHECK(filesystem_mount(fs));
+    const int r = lfs_remove(&fs->instance, MODEM_CONFIG_FILE);
+    CHECK_TRUE(r == LFS_ERR_OK || r == LFS_ERR_NOENT, SYSTEM_ERROR_FILE);
+    return 0;
+}
+
 } // particle
@@ -18,11 +18,45 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 
 namespace particle {
 
 class CellularNetworkConfig;
 
+/**
+ * Last known good configuration of the modem.
+ */
+struct ModemConfigRecord {
+    enum Flag {
+        RAT_CONFIGURED = 0x01 // Radio access technology and power saving settings have been applied
+    };
+
+    uint32_t configHash; // Hash of the client settings the modem has been configured with
+    uint32_t flags; // Configuration flags
+    char firmwareVersion[32]; // Modem firmware version
+    char iccid[32]; // ICCID of the SIM card
+    char imsi[16]; // IMSI of the SIM card, or an empty string if unknown
+};
+
+/**
+ * Returns `true` if the cached configuration can be used instead of the full initialization of
+ * the modem, i.e. it was recorded for the same client settings, modem firmware and SIM card.
+ *
+ * @param cached Cached configuration.
+ * @param current Current client settings hash, modem firmware version and ICCID of the SIM card.
+ */
+inline bool isModemConfigCurrent(const ModemConfigRecord& cached, const ModemConfigRecord& current) {
+    return cached.configHash == current.configHash && current.firmwareVersion[0] && current.iccid[0] &&
+            strncmp(cached.firmwareVersion, current.firmwareVersion, sizeof(current.firmwareVersion)) == 0 &&
+            strncmp(cached.iccid, current.iccid, sizeof(current.iccid)) == 0;
+}
+
 CellularNetworkConfig networkConfigForImsi(const char* imsi, size_t size);
 
+int loadModemConfig(ModemConfigRecord* conf);
+int saveModemConfig(const ModemConfigRecord& conf);
+int removeModemConfig();
+
 } // particle
@@ -324,10 +324,7 @@ NcpConnectionState SaraNcpClient::connectionState() {
 int SaraNcpClient::getFirmwareVersionString(char* buf, size_t size) {
     const NcpClientLock lock(this);
     CHECK(checkParser());
-    auto resp = parser_.sendCommand("AT+CGMR");
-    CHECK_PARSER(resp.readLine(buf, size));
-    const int r = CHECK_PARSER(resp.readResult());
-    CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
+    CHECK(readFirmwareVersion(buf, size));
     return 0;
 }
 
@@ -641,6 +638,10 @@ int SaraNcpClient::waitReady() {
         if (r != SYSTEM_ERROR_NONE) {
             LOG(ERROR, "Failed to perform early initialization");
             ready_ = false;
+            if (modemConfCached_) {
+                // Perform the full initialization next time
+                removeModemConfig();
+            }
         }
     } else {
         LOG(ERROR, "No response from NCP");
@@ -751,6 +752,14 @@ int SaraNcpClient::selectSimCard() {
     // int r = CHECK_PARSER(parser_.execCommand("AT+CMEE=1"));
     // CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
 
+    if (!reset && simCardChecked_) {
+        // The SIM card has already been waited for while validating the cached configuration
+        return modemConf_.iccid[0] ? 0 : SYSTEM_ERROR_UNKNOWN;
+    }
+    return waitSimCard();
+}
+
+int SaraNcpClient::waitSimCard() {
     int simState = 0;
     for (unsigned i = 0; i < 10; ++i) {
         simState = checkSimCard();
@@ -770,8 +779,13 @@ int SaraNcpClient::changeBaudRate(unsigned int baud) {
 }
 
 int SaraNcpClient::initReady() {
-    // Select either internal or external SIM card slot depending on the configuration
-    CHECK(selectSimCard());
+    if (!restoreModemConfig()) {
+        // Select either internal or external SIM card slot depending on the configuration
+        CHECK(selectSimCard());
+        if (!modemConf_.firmwareVersion[0]) {
+            CHECK(readFirmwareVersion(modemConf_.firmwareVersion, sizeof(modemConf_.firmwareVersion)));
+        }
+    }
 
     // Just in case disconnect
     int r = CHECK_PARSER(parser_.execCommand("AT+COPS=2,2"));
@@ -790,43 +804,48 @@ int SaraNcpClient::initReady() {
     }
 
     if (ncpId() == MESH_NCP_SARA_R410) {
-        // Force Cat M1-only mode
-        auto resp = parser_.sendCommand("AT+URAT?");
-        unsigned selectAct = 0, preferAct1 = 0, preferAct2 = 0;
-        r = CHECK_PARSER(resp.scanf("+URAT: %u,%u,%u", &selectAct, &preferAct1, &preferAct2));
-        CHECK_PARSER_OK(resp.readResult());
-        if (selectAct != 7 || (r >= 2 && preferAct1 != 7) || (r >= 3 && preferAct2 != 7)) { // 7: LTE Cat M1
-            // This is a persistent setting
-            CHECK_PARSER_OK(parser_.execCommand("AT+URAT=7"));
-        }
-        // Force eDRX mode to be disabled. AT+CEDRXS=0 doesn't seem disable eDRX completely, so
-        // so we're disabling it for each reported RAT individually
-        Vector<unsigned> acts;
-        resp = parser_.sendCommand("AT+CEDRXS?");
-        while (resp.hasNextLine()) {
-            unsigned act = 0;
-            r = resp.scanf("+CEDRXS: %u", &act);
-            if (r == 1) { // Ignore scanf() errors
-                CHECK_TRUE(acts.append(act), SYSTEM_ERROR_NO_MEMORY);
+        // All of the settings below are persistent
+        if (!(modemConf_.flags & ModemConfigRecord::RAT_CONFIGURED)) {
+            // Force Cat M1-only mode
+            auto resp = parser_.sendCommand("AT+URAT?");
+            unsigned selectAct = 0, preferAct1 = 0, preferAct2 = 0;
+            r = CHECK_PARSER(resp.scanf("+URAT: %u,%u,%u", &selectAct, &preferAct1, &preferAct2));
+            CHECK_PARSER_OK(resp.readResult());
+            if (selectAct != 7 || (r >= 2 && preferAct1 != 7) || (r >= 3 && preferAct2 != 7)) { // 7: LTE Cat M1
+                // This is a persistent setting
+                CHECK_PARSER_OK(parser_.execCommand("AT+URAT=7"));
             }
-        }
-        CHECK_PARSER_OK(resp.readResult());
-        int lastError = AtResponse::OK;
-        for (unsigned act: acts) {
-            // This command may fail for unknown reason. eDRX mode is a persistent setting and, eventually,
-            // it will get applied for each RAT during subsequent re-initialization attempts
-            r = CHECK_PARSER(parser_.execCommand("AT+CEDRXS=3,%u", act)); // 3: Disable the use of eDRX
-            if (r != AtResponse::OK) {
-                lastError = r;
+            // Force eDRX mode to be disabled. AT+CEDRXS=0 doesn't seem disable eDRX completely, so
+            // so we're disabling it for each reported RAT individually
+            Vector<unsigned> acts;
+            resp = parser_.sendCommand("AT+CEDRXS?");
+            while (resp.hasNextLine()) {
+                unsigned act = 0;
+                r = resp.scanf("+CEDRXS: %u", &act);
+                if (r == 1) { // Ignore scanf() errors
+                    CHECK_TRUE(acts.append(act), SYSTEM_ERROR_NO_MEMORY);
+                }
+            }
+            CHECK_PARSER_OK(resp.readResult());
+            int lastError = AtResponse::OK;
+            for (unsigned act: acts) {
+                // This command may fail for unknown reason. eDRX mode is a persistent setting and, eventually,
+                // it will get applied for each RAT during subsequent re-initialization attempts
+                r = CHECK_PARSER(parser_.execCommand("AT+CEDRXS=3,%u", act)); // 3: Disable the use of eDRX
+                if (r != AtResponse::OK) {
+                    lastError = r;
+                }
             }
+            CHECK_PARSER_OK(lastError);
+            // Force Power Saving mode to be disabled for good measure
+            CHECK_PARSER_OK(parser_.execCommand("AT+CPSMS=0"));
+            modemConf_.flags |= ModemConfigRecord::RAT_CONFIGURED;
         }
-        CHECK_PARSER_OK(lastError);
-        // Force Power Saving mode to be disabled for good measure
-        CHECK_PARSER_OK(parser_.execCommand("AT+CPSMS=0"));
     } else {
         // Power saving
         CHECK_PARSER_OK(parser_.execCommand("AT+UPSV=0"));
     }
+    storeModemConfig();
 
     // Send AT+CMUX and initialize multiplexer
     r = CHECK_PARSER(parser_.execCommand("AT+CMUX=0,0,,1509,,,,,"));
@@ -892,23 +911,87 @@ int SaraNcpClient::checkSimCard() {
     r = CHECK_PARSER(resp.readResult());
     CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
     if (!strcmp(code, "READY")) {
-        r = parser_.execCommand("AT+CCID");
+        auto resp = parser_.sendCommand("AT+CCID");
+        char iccid[sizeof(modemConf_.iccid)] = {};
+        r = CHECK_PARSER(resp.scanf("+CCID: %31s", iccid));
+        CHECK_TRUE(r == 1, SYSTEM_ERROR_AT_RESPONSE_UNEXPECTED);
+        r = CHECK_PARSER(resp.readResult());
         CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
+        memcpy(modemConf_.iccid, iccid, sizeof(iccid));
         return 0;
     }
     return SYSTEM_ERROR_UNKNOWN;
 }
 
+int SaraNcpClient::readFirmwareVersion(char* buf, size_t size) {
+    auto resp = parser_.sendCommand("AT+CGMR");
+    CHECK_PARSER(resp.readLine(buf, size));
+    const int r = CHECK_PARSER(resp.readResult());
+    CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
+    return 0;
+}
+
+bool SaraNcpClient::restoreModemConfig() {
+    modemConf_ = ModemConfigRecord();
+    modemConf_.configHash = modemConfigHash();
+    modemConfCached_ = false;
+    simCardChecked_ = false;
+    ModemConfigRecord conf = {};
+    if (loadModemConfig(&conf) < 0 || conf.configHash != modemConf_.configHash) {
+        return false;
+    }
+    // The SIM card selection is a persistent setting, so there's no need to query and reapply it
+    // as long as the modem firmware and SIM card are the same as when the configuration was
+    // recorded
+    if (readFirmwareVersion(modemConf_.firmwareVersion, sizeof(modemConf_.firmwareVersion)) < 0) {
+        return false;
+    }
+    if (strcmp(conf.firmwareVersion, modemConf_.firmwareVersion) == 0) {
+        // The SIM card state is reflected in modemConf_.iccid, so the result can be ignored here.
+        // selectSimCard() won't wait for the SIM card again unless it has to reset the modem
+        waitSimCard();
+        simCardChecked_ = true;
+    }
+    if (!isModemConfigCurrent(conf, modemConf_)) {
+        LOG(TRACE, "Modem firmware or SIM card has changed, performing full initialization");
+        return false;
+    }
+    LOG(TRACE, "Using cached modem configuration");
+    modemConf_ = conf;
+    modemConfCached_ = true;
+    return true;
+}
+
+void SaraNcpClient::storeModemConfig() {
+    const int r = saveModemConfig(modemConf_);
+    if (r < 0) {
+        LOG(ERROR, "Unable to save modem configuration: %d", r);
+    }
+}
+
+uint32_t SaraNcpClient::modemConfigHash() const {
+    // Format version of the cached configuration needs to be updated whenever the initialization
+    // sequence changes in a way that affects the persistent settings of the modem
+    const uint32_t data[] = { 1 /* Version */, (uint32_t)conf_.ncpIdentifier(), (uint32_t)conf_.simType() };
+    return HAL_Core_Compute_CRC32((const uint8_t*)data, sizeof(data));
+}
+
 int SaraNcpClient::configureApn(const CellularNetworkConfig& conf) {
     netConf_ = conf;
     if (!netConf_.isValid()) {
         // Look for network settings based on IMSI
-        char buf[32] = {};
-        auto resp = parser_.sendCommand("AT+CIMI");
-        CHECK_PARSER(resp.readLine(buf, sizeof(buf)));
-        const int r = CHECK_PARSER(resp.readResult());
-        CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
-        netConf_ = networkConfigForImsi(buf, strlen(buf));
+        auto& imsi = modemConf_.imsi;
+        if (!imsi[0]) {
+            auto resp = parser_.sendCommand("AT+CIMI");
+            CHECK_PARSER(resp.readLine(imsi, sizeof(imsi)));
+            const int r = CHECK_PARSER(resp.readResult());
+            if (r != AtResponse::OK) {
+                imsi[0] = '\0';
+                return SYSTEM_ERROR_AT_NOT_OK;
+            }
+            storeModemConfig();
+        }
+        netConf_ = networkConfigForImsi(imsi, strlen(imsi));
     }
     // FIXME: for now IPv4 context only
     auto resp = parser_.sendCommand("AT+CGDCONT=1,\"IP\",\"%s%s\"",
@@ -922,10 +1005,13 @@ int SaraNcpClient::configureApn(const CellularNetworkConfig& conf) {
 int SaraNcpClient::registerNet() {
     int r = 0;
     if (conf_.ncpIdentifier() != MESH_NCP_SARA_R410) {
-        r = CHECK_PARSER(parser_.execCommand("AT+CREG=2"));
-        CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
-        r = CHECK_PARSER(parser_.execCommand("AT+CGREG=2"));
-        CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
+        // Both commands are sent as a single command line
+        SCOPE_GUARD({
+            parser_.clearQueue(); // Don't leave the first command queued if the second one can't be queued
+        });
+        CHECK(parser_.queueCommand("AT+CREG=2", AtParser::COMBINE));
+        CHECK(parser_.queueCommand("AT+CGREG=2", AtParser::COMBINE));
+        CHECK_PARSER_OK(parser_.processQueue());
     } else {
         r = CHECK_PARSER(parser_.execCommand("AT+CEREG=2"));
         CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
@@ -939,10 +1025,7 @@ int SaraNcpClient::registerNet() {
     // CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
 
     if (conf_.ncpIdentifier() != MESH_NCP_SARA_R410) {
-        r = CHECK_PARSER(parser_.execCommand("AT+CREG?"));
-        CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
-        r = CHECK_PARSER(parser_.execCommand("AT+CGREG?"));
-        CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
+        CHECK(queryRegistrationState());
     } else {
         r = CHECK_PARSER(parser_.execCommand("AT+CEREG?"));
         CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
@@ -954,6 +1037,18 @@ int SaraNcpClient::registerNet() {
     return 0;
 }
 
+int SaraNcpClient::queryRegistrationState() {
+    // The registration status is reported via the same lines as the respective URCs, so both
+    // queries can be sent as a single command line
+    SCOPE_GUARD({
+        parser_.clearQueue();
+    });
+    CHECK(parser_.queueCommand("AT+CREG?", AtParser::COMBINE));
+    CHECK(parser_.queueCommand("AT+CGREG?", AtParser::COMBINE));
+    CHECK_PARSER_OK(parser_.processQueue());
+    return 0;
+}
+
 void SaraNcpClient::ncpState(NcpState state) {
     if (ncpState_ == NcpState::DISABLED) {
         return;
@@ -1081,8 +1176,7 @@ int SaraNcpClient::processEventsImpl() {
         regCheckTime_ = millis();
     });
     if (conf_.ncpIdentifier() != MESH_NCP_SARA_R410) {
-        CHECK_PARSER_OK(parser_.execCommand("AT+CREG?"));
-        CHECK_PARSER_OK(parser_.execCommand("AT+CGREG?"));
+        CHECK(queryRegistrationState());
     } else {
         CHECK_PARSER_OK(parser_.execCommand("AT+CEREG?"));
     }
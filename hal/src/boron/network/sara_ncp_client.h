@@ -23,6 +23,7 @@
 #include "platform_ncp.h"
 
 #include "at_parser.h"
+#include "network_config_db.h"
 
 #include "spark_wiring_thread.h"
 #include "gsm0710muxer/channel_stream.h"
@@ -78,6 +79,9 @@ private:
     std::unique_ptr<particle::MuxerChannelStream<decltype(muxer_)> > muxerAtStream_;
     CellularNetworkConfig netConf_;
     CellularGlobalIdentity cgi_ = {};
+    ModemConfigRecord modemConf_ = {};
+    bool modemConfCached_ = false;
+    bool simCardChecked_ = false;
 
     enum class RegistrationState {
         NotRegistered = 0,
@@ -97,9 +101,15 @@ private:
     int initReady();
     int waitAtResponse(unsigned int timeout, unsigned int period = 1000);
     int selectSimCard();
+    int waitSimCard();
     int checkSimCard();
+    int readFirmwareVersion(char* buf, size_t size);
+    bool restoreModemConfig();
+    void storeModemConfig();
+    uint32_t modemConfigHash() const;
     int configureApn(const CellularNetworkConfig& conf);
     int registerNet();
+    int queryRegistrationState();
     int changeBaudRate(unsigned int baud);
     static int muxChannelStateCb(uint8_t channel, decltype(muxer_)::ChannelState oldState,
             decltype(muxer_)::ChannelState newState, void* ctx);
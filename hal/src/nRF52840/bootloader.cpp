@@ -6,7 +6,7 @@
 #include "module_info.h"
 #include "bootloader_hal.h"
 #include "ota_flash_hal_impl.h"
-#include "miniz.h"
+#include "decompress_stream.h"
 #include "stream.h"
 #include "check.h"
 #include "ota_flash_hal_impl.h"
@@ -54,100 +54,6 @@ public:
 	}
 };
 
-class Deflator {
-
-	tinfl_decompressor inflator;
-
-public:
-	Deflator() {
-		tinfl_init(&inflator);
-	}
-
-	/**
-	 * @param in_buffer [in] The input (compressed) data
-	 * @param in_length [in,out] The number of bytes available in the input stream. When 0, indicates the end of stream. On return, is the number of bytes consumed from the input buffer.
-	 * @param out_buffer [in] The output (uncomprssed) data
-	 * @param out_length [in,out] The number of bytes available in the output buffer.  On return, it is the number of bytes written to the output buffer.
-	 * Returns >0 if more data is needed on input or more data available for output.
-	 * Returns 0 when the compression is done
-	 * Returns <0 on error
-	 */
-	tinfl_status write(const char* in_buffer, size_t& in_length, char* out_buffer, char* next_buffer, size_t& out_length, bool hasMore);
-
-};
-
-tinfl_status Deflator::write(const char* in_buffer, size_t& in_length, char* out_buffer, char* next_buffer, size_t& out_length, bool hasMore) {
-    const int flags = (hasMore ? TINFL_FLAG_HAS_MORE_INPUT : 0) | 0;
-	tinfl_status status = tinfl_decompress(&inflator, (const mz_uint8*)in_buffer, &in_length, (mz_uint8*)out_buffer, (mz_uint8*)next_buffer, &out_length, flags);
-	return status;
-}
-
-
-class DecompressStream : public OutputStream {
-	Deflator deflator_;
-	char* buffer_;
-	size_t length_;
-	OutputStream& output_;
-	size_t out_offset_;
-
-public:
-
-	DecompressStream(char* buffer, size_t length, OutputStream& output)
-: buffer_(buffer), length_(length), output_(output), out_offset_(0) {}
-
-	/**
-	 * Write to the stream.
-	 * @param buffer The compressed data to decompress
-	 * @param length	The amount of data to write
-	 * @returns The number of bytes written from the buffer.
-	 */
-	int write(const char* buffer, size_t length) override;
-
-	int flush() override {
-		int result = write(buffer_, 0);
-		output_.flush();
-		return result;
-	}
-
-	int availForWrite() override {
-		return length_-out_offset_;
-	}
-
-	int waitEvent(unsigned flags, unsigned timeout = 0) override {
-		return 0;
-	}
-
-};
-
-/**
- * Write to the stream.
- * @param buffer The compressed data to decompress
- * @param length	The amount of data to write
- * @returns The number of bytes written from the buffer.
- */
-int DecompressStream::write(const char* buffer, const size_t length)  {
-	bool hasMore = length;
-	size_t consumed = 0;
-	tinfl_status status;
-	do {
-		size_t out_length = length_-out_offset_;
-		size_t in_length = length-consumed;
-		status = deflator_.write(buffer+consumed, in_length, this->buffer_, this->buffer_+out_offset_, out_length, hasMore);
-		if (status<0) {
-			return SYSTEM_ERROR_BAD_DATA;
-		}
-		consumed += in_length;
-		if (out_length) {
-			output_.writeAll(this->buffer_+out_offset_, out_length);
-			out_offset_ = (out_offset_ + out_length) % length_;
-		}
-	}
-	while (status == TINFL_STATUS_HAS_MORE_OUTPUT);
-
-	// exit when Done, or there is an error
-	return (status<TINFL_STATUS_DONE) ? status : consumed;
-}
-
 } // namespace particle
 
 #ifdef HAL_REPLACE_BOOTLOADER_OTA
@@ -55,6 +55,7 @@
 #include "gpio_hal.h"
 #include "exflash_hal.h"
 #include "flash_common.h"
+#include "eeprom_hal.h"
 #include <nrf_pwm.h>
 #include "concurrent_hal.h"
 
@@ -442,6 +443,11 @@ void HAL_Core_System_Reset(void) {
 }
 
 void HAL_Core_System_Reset_Ex(int reason, uint32_t data, void *reserved) {
+    if (!HAL_IsISR() && !__get_PRIMASK() && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+        // Write pending EEPROM changes to the filesystem
+        hal_eeprom_flush(0, NULL);
+    }
+
     if (HAL_Feature_Get(FEATURE_RESET_INFO)) {
         // Save reset info to backup registers
         HAL_Core_Write_Backup_Register(BKP_DR_02, reason);
@@ -542,6 +548,9 @@ int HAL_Core_Enter_Stop_Mode_Ext(const uint16_t* pins, size_t pins_count, const
         }
     }
 
+    // Write pending EEPROM changes to the filesystem
+    hal_eeprom_flush(HAL_EEPROM_FLUSH_SLEEP, NULL);
+
     // Detach USB
     HAL_USB_Detach();
 
@@ -964,6 +973,9 @@ int HAL_Core_Execute_Standby_Mode_Ext(uint32_t flags, void* reserved) {
         return SYSTEM_ERROR_NOT_SUPPORTED;
     }
 
+    // Write pending EEPROM changes to the filesystem
+    hal_eeprom_flush(HAL_EEPROM_FLUSH_SLEEP, NULL);
+
     // Make sure we acquire exflash lock BEFORE going into a critical section
     hal_exflash_lock();
 
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decompress_stream.h"
+
+#include "system_error.h"
+
+namespace particle {
+
+tinfl_status Deflator::write(const char* in_buffer, size_t& in_length, char* out_buffer, char* next_buffer, size_t& out_length, bool hasMore) {
+    const int flags = (hasMore ? TINFL_FLAG_HAS_MORE_INPUT : 0) | 0;
+	tinfl_status status = tinfl_decompress(&inflator, (const mz_uint8*)in_buffer, &in_length, (mz_uint8*)out_buffer, (mz_uint8*)next_buffer, &out_length, flags);
+	return status;
+}
+
+
+/**
+ * Write to the stream.
+ * @param buffer The compressed data to decompress
+ * @param length	The amount of data to write
+ * @returns The number of bytes written from the buffer.
+ */
+int DecompressStream::write(const char* buffer, const size_t length)  {
+	if (done_) {
+		// No data is expected after the end of the compressed stream
+		return length ? SYSTEM_ERROR_BAD_DATA : 0;
+	}
+	bool hasMore = length;
+	size_t consumed = 0;
+	tinfl_status status;
+	do {
+		size_t out_length = length_-out_offset_;
+		size_t in_length = length-consumed;
+		status = deflator_.write(buffer+consumed, in_length, this->buffer_, this->buffer_+out_offset_, out_length, hasMore);
+		if (status<0) {
+			return SYSTEM_ERROR_BAD_DATA;
+		}
+		consumed += in_length;
+		if (out_length) {
+			const int error = output_.writeAll(this->buffer_+out_offset_, out_length);
+			if (error<0) {
+				return error;
+			}
+			out_offset_ = (out_offset_ + out_length) % length_;
+		}
+	}
+	while (status == TINFL_STATUS_HAS_MORE_OUTPUT);
+
+	if (status == TINFL_STATUS_DONE) {
+		done_ = true;
+		if (consumed < length) {
+			// Trailing data after the end of the compressed stream
+			return SYSTEM_ERROR_BAD_DATA;
+		}
+	} else if (length && !consumed) {
+		// The caller would keep retrying the same data
+		return SYSTEM_ERROR_BAD_DATA;
+	}
+
+	// exit when Done, or there is an error
+	return (status<TINFL_STATUS_DONE) ? status : consumed;
+}
+
+} // namespace particle
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "miniz.h"
+#include "stream.h"
+
+namespace particle {
+
+class Deflator {
+
+	tinfl_decompressor inflator;
+
+public:
+	Deflator() {
+		tinfl_init(&inflator);
+	}
+
+	/**
+	 * @param in_buffer [in] The input (compressed) data
+	 * @param in_length [in,out] The number of bytes available in the input stream. When 0, indicates the end of stream. On return, is the number of bytes consumed from the input buffer.
+	 * @param out_buffer [in] The output (uncomprssed) data
+	 * @param out_length [in,out] The number of bytes available in the output buffer.  On return, it is the number of bytes written to the output buffer.
+	 * Returns >0 if more data is needed on input or more data available for output.
+	 * Returns 0 when the compression is done
+	 * Returns <0 on error
+	 */
+	tinfl_status write(const char* in_buffer, size_t& in_length, char* out_buffer, char* next_buffer, size_t& out_length, bool hasMore);
+
+};
+
+class DecompressStream : public OutputStream {
+	Deflator deflator_;
+	char* buffer_;
+	size_t length_;
+	OutputStream& output_;
+	size_t out_offset_;
+	bool done_;
+
+public:
+
+	/**
+	 * @param buffer The sliding window used by the decompressor. Must be at least
+	 * TINFL_LZ_DICT_SIZE bytes long and the size must be a power of 2.
+	 */
+	DecompressStream(char* buffer, size_t length, OutputStream& output)
+: buffer_(buffer), length_(length), output_(output), out_offset_(0), done_(false) {}
+
+	/**
+	 * Write to the stream.
+	 * @param buffer The compressed data to decompress
+	 * @param length	The amount of data to write
+	 * @returns The number of bytes written from the buffer, or SYSTEM_ERROR_BAD_DATA if the data
+	 * is invalid or continues past the end of the compressed stream.
+	 */
+	int write(const char* buffer, size_t length) override;
+
+	int flush() override {
+		int result = write(buffer_, 0);
+		const int error = output_.flush();
+		return (error<0) ? error : result;
+	}
+
+	/**
+	 * Returns {@code true} if the end of the compressed stream has been reached.
+	 */
+	bool done() const {
+		return done_;
+	}
+
+	int availForWrite() override {
+		return length_-out_offset_;
+	}
+
+	int waitEvent(unsigned flags, unsigned timeout = 0) override {
+		return 0;
+	}
+
+};
+
+} // namespace particle
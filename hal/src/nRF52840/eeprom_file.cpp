@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "eeprom_file.h"
+#include "timer_hal.h"
+#include "system_error.h"
+#include "logging.h"
+#include "service_debug.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace particle {
+
+using namespace particle::fs;
+
+namespace {
+
+const uint32_t DEFAULT_FLUSH_DELAY = 0; // Write-through
+const uint32_t DEFAULT_MAX_PENDING_SIZE = 256;
+
+} // namespace
+
+EepromFile::EepromFile() {
+    init();
+}
+
+EepromFile::~EepromFile() {
+    deinit();
+}
+
+ssize_t EepromFile::read(size_t offset, uint8_t* buffer, size_t size) {
+    FsLock lk(fs_);
+    size = std::min(size, EEPROM_FILE_SIZE - offset);
+    memcpy(buffer, data_ + offset, size);
+    return size;
+}
+
+ssize_t EepromFile::write(size_t offset, const uint8_t* buffer, size_t size) {
+    FsLock lk(fs_);
+    size = std::min(size, EEPROM_FILE_SIZE - offset);
+    if (!memcmp(data_ + offset, buffer, size)) {
+        return size;
+    }
+    memcpy(data_ + offset, buffer, size);
+    addDirtyRange(offset, size);
+    if (policy_.delay == 0 || pendingSize() > policy_.max_pending_size) {
+        int r = flush(0);
+        if (r < 0) {
+            return r;
+        }
+    }
+    return size;
+}
+
+ssize_t EepromFile::recreate() {
+    FsLock lk(fs_);
+
+    LOG_DEBUG(INFO, "Initializing empty EEPROM");
+    /* Fill with 0xff for compatibility with raw flash EEPROM */
+    memset(data_, 0xff, sizeof(data_));
+    dirtyCount_ = 0;
+
+    return writeFile();
+}
+
+int EepromFile::flush(int flags) {
+    FsLock lk(fs_);
+
+    if (!dirtyCount_) {
+        return 0;
+    }
+    if ((flags & HAL_EEPROM_FLUSH_SLEEP) && !(policy_.flags & HAL_EEPROM_FLUSH_POLICY_BEFORE_SLEEP)) {
+        return 0;
+    }
+    if ((flags & HAL_EEPROM_FLUSH_IF_DUE) && HAL_Timer_Get_Milli_Seconds() - dirtyTime_ < policy_.delay &&
+            pendingSize() <= policy_.max_pending_size) {
+        return 0;
+    }
+
+    size_t logSize = logSize_;
+    for (unsigned i = 0; i < dirtyCount_; ++i) {
+        logSize += sizeof(LogRecord) + dirty_[i].size;
+    }
+    int r = 0;
+    if (logSize <= EEPROM_LOG_MAX_SIZE) {
+        r = appendLog();
+    }
+    if (logSize > EEPROM_LOG_MAX_SIZE || r < 0) {
+        /* Rewriting the EEPROM file also discards any incomplete records in the log file */
+        r = writeFile();
+    }
+    if (r < 0) {
+        LOG_DEBUG(ERROR, "Failed to write to EEPROM: %d", r);
+        return r;
+    }
+
+    dirtyCount_ = 0;
+
+    return 0;
+}
+
+bool EepromFile::hasPendingChanges() {
+    FsLock lk(fs_);
+    return dirtyCount_ > 0;
+}
+
+int EepromFile::setFlushPolicy(const hal_eeprom_flush_policy& policy) {
+    FsLock lk(fs_);
+    policy_.flags = policy.flags;
+    policy_.delay = policy.delay;
+    policy_.max_pending_size = policy.max_pending_size;
+    return flush(HAL_EEPROM_FLUSH_IF_DUE);
+}
+
+void EepromFile::getFlushPolicy(hal_eeprom_flush_policy* policy) {
+    FsLock lk(fs_);
+    policy->flags = policy_.flags;
+    policy->delay = policy_.delay;
+    policy->max_pending_size = policy_.max_pending_size;
+}
+
+void EepromFile::addDirtyRange(size_t offset, size_t size) {
+    if (!dirtyCount_) {
+        dirtyTime_ = HAL_Timer_Get_Milli_Seconds();
+    }
+    size_t start = offset;
+    size_t end = offset + size;
+    /* Merge with the overlapping and adjacent ranges */
+    unsigned i = 0;
+    while (i < dirtyCount_) {
+        const Range& r = dirty_[i];
+        if (r.offset <= end && start <= (size_t)r.offset + r.size) {
+            start = std::min(start, (size_t)r.offset);
+            end = std::max(end, (size_t)r.offset + r.size);
+            std::copy(dirty_ + i + 1, dirty_ + dirtyCount_, dirty_ + i);
+            --dirtyCount_;
+        } else {
+            ++i;
+        }
+    }
+    i = 0;
+    while (i < dirtyCount_ && dirty_[i].offset < start) {
+        ++i;
+    }
+    std::copy_backward(dirty_ + i, dirty_ + dirtyCount_, dirty_ + dirtyCount_ + 1);
+    dirty_[i].offset = start;
+    dirty_[i].size = end - start;
+    ++dirtyCount_;
+    if (dirtyCount_ > MAX_DIRTY_RANGES) {
+        /* Merge the two closest ranges, which may include the new one */
+        unsigned j = 0;
+        for (unsigned k = 1; k < dirtyCount_ - 1; ++k) {
+            if (dirty_[k + 1].offset - dirty_[k].offset - dirty_[k].size <
+                    dirty_[j + 1].offset - dirty_[j].offset - dirty_[j].size) {
+                j = k;
+            }
+        }
+        dirty_[j].size = dirty_[j + 1].offset + dirty_[j + 1].size - dirty_[j].offset;
+        std::copy(dirty_ + j + 2, dirty_ + dirtyCount_, dirty_ + j + 1);
+        --dirtyCount_;
+    }
+}
+
+size_t EepromFile::pendingSize() const {
+    size_t size = 0;
+    for (unsigned i = 0; i < dirtyCount_; ++i) {
+        size += dirty_[i].size;
+    }
+    return size;
+}
+
+int EepromFile::appendLog() {
+    lfs_file_t file = {};
+    /* Any log file that exists at this point belongs to a previous generation */
+    const int flags = logSize_ ? LFS_O_APPEND : LFS_O_TRUNC;
+    int r = lfs_file_open(lfs(), &file, EEPROM_LOG_FILE_PATH, LFS_O_WRONLY | LFS_O_CREAT | flags);
+    if (r < 0) {
+        return r;
+    }
+    if (!logSize_) {
+        const LogHeader h = { .generation = generation_ };
+        r = lfs_file_write(lfs(), &file, &h, sizeof(h));
+    }
+    for (unsigned i = 0; i < dirtyCount_ && r >= 0; ++i) {
+        const Range& range = dirty_[i];
+        const LogRecord rec = { .offset = range.offset, .size = range.size };
+        r = lfs_file_write(lfs(), &file, &rec, sizeof(rec));
+        if (r >= 0) {
+            r = lfs_file_write(lfs(), &file, data_ + range.offset, range.size);
+        }
+    }
+    if (r >= 0) {
+        r = lfs_file_size(lfs(), &file);
+    }
+    /* The appended records are committed atomically when the file is closed */
+    const int r2 = lfs_file_close(lfs(), &file);
+    if (r < 0) {
+        return r;
+    }
+    if (r2 < 0) {
+        return r2;
+    }
+    logSize_ = r;
+    return 0;
+}
+
+int EepromFile::writeFile() {
+    lfs_file_t file = {};
+    int r = lfs_file_open(lfs(), &file, EEPROM_FILE_PATH, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    if (r < 0) {
+        return r;
+    }
+    const uint32_t generation = generation_ + 1;
+    r = lfs_file_write(lfs(), &file, data_, sizeof(data_));
+    if (r >= 0) {
+        r = lfs_file_write(lfs(), &file, &generation, sizeof(generation));
+    }
+    const int r2 = lfs_file_close(lfs(), &file);
+    if (r < 0) {
+        return r;
+    }
+    if (r2 < 0) {
+        return r2;
+    }
+    generation_ = generation;
+    logSize_ = 0;
+    /* The log file no longer matches the generation of the EEPROM file, so it won't be replayed
+     * if the device resets before the log file is removed */
+    r = lfs_remove(lfs(), EEPROM_LOG_FILE_PATH);
+    if (r < 0 && r != LFS_ERR_NOENT) {
+        return r;
+    }
+    return 0;
+}
+
+int EepromFile::readFile() {
+    lfs_file_t file = {};
+    int r = lfs_file_open(lfs(), &file, EEPROM_FILE_PATH, LFS_O_RDONLY);
+    if (r < 0) {
+        return r;
+    }
+    memset(data_, 0xff, sizeof(data_));
+    r = lfs_file_read(lfs(), &file, data_, sizeof(data_));
+    if (r >= 0) {
+        /* The EEPROM file written by older firmware has no generation counter */
+        generation_ = 0;
+        const int r2 = lfs_file_read(lfs(), &file, &generation_, sizeof(generation_));
+        if (r2 != sizeof(generation_)) {
+            generation_ = 0;
+        }
+    }
+    lfs_file_close(lfs(), &file);
+    if (r < 0) {
+        return r;
+    }
+    logSize_ = 0;
+    /* Apply the changes from the log file */
+    r = lfs_file_open(lfs(), &file, EEPROM_LOG_FILE_PATH, LFS_O_RDONLY);
+    if (r == LFS_ERR_NOENT) {
+        return 0;
+    }
+    if (r < 0) {
+        return writeFile();
+    }
+    LogHeader h = {};
+    r = lfs_file_read(lfs(), &file, &h, sizeof(h));
+    if (r != sizeof(h) || h.generation != generation_) {
+        lfs_file_close(lfs(), &file);
+        LOG_DEBUG(WARN, "Discarding stale EEPROM log file");
+        return writeFile();
+    }
+    logSize_ = sizeof(h);
+    const lfs_soff_t fileSize = lfs_file_size(lfs(), &file);
+    for (;;) {
+        LogRecord rec = {};
+        r = lfs_file_read(lfs(), &file, &rec, sizeof(rec));
+        if (r != sizeof(rec)) {
+            break;
+        }
+        /* Don't apply a partially written record */
+        if (rec.offset + rec.size > EEPROM_FILE_SIZE ||
+                logSize_ + sizeof(rec) + rec.size > (size_t)fileSize) {
+            r = SYSTEM_ERROR_BAD_DATA;
+            break;
+        }
+        r = lfs_file_read(lfs(), &file, data_ + rec.offset, rec.size);
+        if (r != rec.size) {
+            r = SYSTEM_ERROR_BAD_DATA;
+            break;
+        }
+        logSize_ += sizeof(rec) + rec.size;
+    }
+    lfs_file_close(lfs(), &file);
+    if (r != 0) {
+        /* Remove the invalid records */
+        LOG_DEBUG(WARN, "Invalid EEPROM log file");
+        return writeFile();
+    }
+    return 0;
+}
+
+void EepromFile::init() {
+    fs_ = filesystem_get_instance(nullptr);
+    SPARK_ASSERT(fs_);
+
+    FsLock lk(fs_);
+    SPARK_ASSERT(!filesystem_mount(fs_));
+
+    LOG_DEBUG(INFO, "Filesystem mounted");
+
+    policy_.size = sizeof(policy_);
+    policy_.flags = HAL_EEPROM_FLUSH_POLICY_BEFORE_SLEEP;
+    policy_.delay = DEFAULT_FLUSH_DELAY;
+    policy_.max_pending_size = DEFAULT_MAX_PENDING_SIZE;
+
+    int r = lfs_mkdir(lfs(), EEPROM_DIR_PATH);
+    SPARK_ASSERT((r == 0 || r == LFS_ERR_EXIST));
+
+    /* Check that /sys/eeprom.bin exists */
+    r = readFile();
+
+    if (r) {
+        SPARK_ASSERT(recreate() == 0);
+    }
+}
+
+void EepromFile::deinit() {
+    FsLock lk(fs_);
+
+    flush(0);
+    filesystem_unmount(fs_);
+}
+
+} // namespace particle
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "eeprom_hal.h"
+#include "eeprom_hal_impl.h"
+#include "filesystem.h"
+#include "system_tick_hal.h"
+
+#include <sys/types.h>
+
+namespace particle {
+
+/*
+ * The RAM copy of the EEPROM contents is updated immediately, while the changed ranges are
+ * written to the filesystem according to the flush policy. By default, every change is written
+ * immediately. A flush appends the changed ranges to a log file, so that frequently updated values
+ * don't cause the entire EEPROM file to be rewritten every time. When the log file becomes too
+ * large, the EEPROM file is rewritten and the log file is removed.
+ *
+ * The EEPROM file is followed by a generation counter that is incremented every time the file is
+ * rewritten, and the log file starts with the generation of the EEPROM file it applies to. A log
+ * file left behind by a reset that happened while the EEPROM file was being rewritten is ignored.
+ */
+class EepromFile {
+public:
+    EepromFile();
+    ~EepromFile();
+
+    ssize_t read(size_t offset, uint8_t* buffer, size_t size);
+    ssize_t write(size_t offset, const uint8_t* buffer, size_t size);
+    ssize_t recreate();
+
+    int flush(int flags);
+    bool hasPendingChanges();
+
+    int setFlushPolicy(const hal_eeprom_flush_policy& policy);
+    void getFlushPolicy(hal_eeprom_flush_policy* policy);
+
+private:
+    struct LogHeader {
+        uint32_t generation;
+    } __attribute__((packed));
+
+    struct LogRecord {
+        uint16_t offset;
+        uint16_t size;
+        // Followed by record data
+    } __attribute__((packed));
+
+    struct Range {
+        uint16_t offset;
+        uint16_t size;
+    };
+
+    static const unsigned MAX_DIRTY_RANGES = 8;
+
+    uint8_t data_[EEPROM_FILE_SIZE];
+    Range dirty_[MAX_DIRTY_RANGES + 1]; // Sorted by offset, non-adjacent. One extra slot for the range being added
+    unsigned dirtyCount_ = 0;
+    system_tick_t dirtyTime_ = 0; // Time of the first unflushed change
+    size_t logSize_ = 0;
+    uint32_t generation_ = 0; // Generation of the EEPROM file
+    hal_eeprom_flush_policy policy_ = {};
+    filesystem_t* fs_ = nullptr;
+
+    void addDirtyRange(size_t offset, size_t size);
+    size_t pendingSize() const;
+
+    int appendLog();
+    int writeFile();
+    int readFile();
+
+    void init();
+    void deinit();
+
+    lfs_t* lfs() {
+        return &fs_->instance;
+    }
+};
+
+} // namespace particle
@@ -22,3 +22,6 @@
 
 #define EEPROM_DIR_PATH             "/sys"
 #define EEPROM_FILE_PATH            "/sys/eeprom.bin"
+/* Changes are appended to the log file until it reaches EEPROM_LOG_MAX_SIZE bytes */
+#define EEPROM_LOG_FILE_PATH        "/sys/eeprom.log"
+#define EEPROM_LOG_MAX_SIZE         (1024)
@@ -26,6 +26,10 @@ INCLUDE_DIRS += $(HAL_MODULE_PATH)/network/ncp
 INCLUDE_DIRS += $(HAL_MODULE_PATH)/network/ncp/at_parser
 endif
 
+# lwIP memory profile: LOW_RAM, BALANCED or HIGH_THROUGHPUT (see lwip/lwipopts.h)
+LWIP_MEMORY_PROFILE ?= BALANCED
+CFLAGS += -DLWIP_MEMORY_PROFILE=LWIP_MEMORY_PROFILE_$(LWIP_MEMORY_PROFILE)
+
 HAL_LINK ?= $(findstring hal,$(MAKE_DEPENDENCIES))
 
 HAL_DEPS = third_party/lwip third_party/freertos third_party/openthread third_party/wiznet_driver gsm0710muxer
@@ -18,6 +18,8 @@
 #ifndef HAL_LWIP_LWIPHOOKS_H
 #define HAL_LWIP_LWIPHOOKS_H
 
+#include "lwip/err.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -42,6 +44,11 @@ int lwip_hook_ip6_forward_post_routing(struct pbuf* p, struct ip6_hdr* ip6hdr, s
 struct netif* lwip_hook_ip6_route(const ip6_addr_t* src, const ip6_addr_t* dst);
 #endif /* LWIP_IPV6 */
 
+/* DNS hooks */
+#if LWIP_DNS
+int lwip_hook_netconn_external_resolve(const char* name, ip_addr_t* addr, u8_t addrtype, err_t* err);
+#endif /* LWIP_DNS */
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -444,6 +451,6 @@ struct netif* lwip_hook_ip6_route(const ip6_addr_t* src, const ip6_addr_t* dst);
  * err must also be checked to determine if the hook consumed the query, but
  * the query failed
  */
-// #define LWIP_HOOK_NETCONN_EXTERNAL_RESOLVE(name, addr, addrtype, err)
+#define LWIP_HOOK_NETCONN_EXTERNAL_RESOLVE(name, addr, addrtype, err) lwip_hook_netconn_external_resolve(name, addr, addrtype, err)
 
 #endif /* HAL_LWIP_LWIPHOOKS_H */
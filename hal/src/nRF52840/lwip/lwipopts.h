@@ -111,6 +111,59 @@ void sys_unlock_tcpip_core(void);
 #endif /* LWIP_TCPIP_CORE_LOCKING */
 #endif /* !NO_SYS */
 
+/*
+   ------------------------------------
+   ---------- Memory profiles ---------
+   ------------------------------------
+*/
+
+/**
+ * LWIP_MEMORY_PROFILE: a set of buffer sizes trading RAM usage for TCP throughput.
+ * The profile is selected at build time with the LWIP_MEMORY_PROFILE make variable,
+ * see hal/src/nRF52840/include.mk.
+ *
+ * LWIP_MEMORY_PROFILE_LOW_RAM: minimal TCP windows, out-of-order segments are dropped.
+ * LWIP_MEMORY_PROFILE_BALANCED: default buffer sizes.
+ * LWIP_MEMORY_PROFILE_HIGH_THROUGHPUT: larger TCP windows and pbuf pool, out-of-order
+ *   segments are queued up to a third of the pbuf pool per connection.
+ *
+ * The profiles don't bound the heap usage of the stack: with MEM_LIBC_MALLOC==1 the heap
+ * memory is allocated with malloc() and MEM_SIZE has no effect. The heap usage is only
+ * observed, via the net:heap:max diagnostic source.
+ */
+#define LWIP_MEMORY_PROFILE_LOW_RAM           0
+#define LWIP_MEMORY_PROFILE_BALANCED          1
+#define LWIP_MEMORY_PROFILE_HIGH_THROUGHPUT   2
+
+#ifndef LWIP_MEMORY_PROFILE
+#define LWIP_MEMORY_PROFILE                   LWIP_MEMORY_PROFILE_BALANCED
+#endif /* LWIP_MEMORY_PROFILE */
+
+#if LWIP_MEMORY_PROFILE == LWIP_MEMORY_PROFILE_LOW_RAM
+#define LWIP_PROFILE_PBUF_POOL_SIZE           8
+#define LWIP_PROFILE_MEMP_NUM_TCP_SEG         8
+#define LWIP_PROFILE_TCP_WND_MSS              2
+#define LWIP_PROFILE_TCP_SND_BUF_MSS          2
+#define LWIP_PROFILE_TCP_QUEUE_OOSEQ          0
+#define LWIP_PROFILE_TCP_OOSEQ_MAX_PBUFS      0
+#elif LWIP_MEMORY_PROFILE == LWIP_MEMORY_PROFILE_BALANCED
+#define LWIP_PROFILE_PBUF_POOL_SIZE           16
+#define LWIP_PROFILE_MEMP_NUM_TCP_SEG         16
+#define LWIP_PROFILE_TCP_WND_MSS              4
+#define LWIP_PROFILE_TCP_SND_BUF_MSS          2
+#define LWIP_PROFILE_TCP_QUEUE_OOSEQ          1
+#define LWIP_PROFILE_TCP_OOSEQ_MAX_PBUFS      0 /* No limit */
+#elif LWIP_MEMORY_PROFILE == LWIP_MEMORY_PROFILE_HIGH_THROUGHPUT
+#define LWIP_PROFILE_PBUF_POOL_SIZE           24
+#define LWIP_PROFILE_MEMP_NUM_TCP_SEG         32
+#define LWIP_PROFILE_TCP_WND_MSS              6
+#define LWIP_PROFILE_TCP_SND_BUF_MSS          4
+#define LWIP_PROFILE_TCP_QUEUE_OOSEQ          1
+#define LWIP_PROFILE_TCP_OOSEQ_MAX_PBUFS      8
+#else
+#error "Unsupported LWIP_MEMORY_PROFILE"
+#endif /* LWIP_MEMORY_PROFILE */
+
 /*
    ------------------------------------
    ---------- Memory options ----------
@@ -141,7 +194,7 @@ void sys_unlock_tcpip_core(void);
  * MEM_SIZE: the size of the heap memory. If the application will send
  * a lot of data that needs to be copied, this should be set high.
  */
-/* FIXME */
+/* FIXME: not used with MEM_LIBC_MALLOC==1 */
 #define MEM_SIZE                        (10 * 1024)
 
 /**
@@ -252,7 +305,7 @@ void sys_unlock_tcpip_core(void);
  * MEMP_NUM_TCP_SEG: the number of simultaneously queued TCP segments.
  * (requires the LWIP_TCP option)
  */
-#define MEMP_NUM_TCP_SEG                16
+#define MEMP_NUM_TCP_SEG                LWIP_PROFILE_MEMP_NUM_TCP_SEG
 
 /**
  * MEMP_NUM_ALTCP_PCB: the number of simultaneously active altcp layer pcbs.
@@ -348,7 +401,7 @@ void sys_unlock_tcpip_core(void);
 /**
  * PBUF_POOL_SIZE: the number of buffers in the pbuf pool.
  */
-#define PBUF_POOL_SIZE                  16
+#define PBUF_POOL_SIZE                  LWIP_PROFILE_PBUF_POOL_SIZE
 
 /*
    ---------------------------------
@@ -774,7 +827,7 @@ void sys_unlock_tcpip_core(void);
  * with scaling applied. Maximum window value in the TCP header
  * will be TCP_WND >> TCP_RCV_SCALE
  */
-#define TCP_WND                         (4 * TCP_MSS)
+#define TCP_WND                         (LWIP_PROFILE_TCP_WND_MSS * TCP_MSS)
 
 /**
  * TCP_MAXRTX: Maximum number of retransmissions of data segments.
@@ -790,7 +843,7 @@ void sys_unlock_tcpip_core(void);
  * TCP_QUEUE_OOSEQ==1: TCP will queue segments that arrive out of order.
  * Define to 0 if your device is low on memory.
  */
-#define TCP_QUEUE_OOSEQ                 (LWIP_TCP)
+#define TCP_QUEUE_OOSEQ                 (LWIP_TCP && LWIP_PROFILE_TCP_QUEUE_OOSEQ)
 
 /**
  * LWIP_TCP_SACK_OUT==1: TCP will support sending selective acknowledgements (SACKs).
@@ -833,7 +886,7 @@ void sys_unlock_tcpip_core(void);
  * TCP_SND_BUF: TCP sender buffer space (bytes).
  * To achieve good performance, this should be at least 2 * TCP_MSS.
  */
-#define TCP_SND_BUF                     (2 * TCP_MSS)
+#define TCP_SND_BUF                     (LWIP_PROFILE_TCP_SND_BUF_MSS * TCP_MSS)
 
 /**
  * TCP_SND_QUEUELEN: TCP sender buffer space (pbufs). This must be at least
@@ -881,7 +934,7 @@ void sys_unlock_tcpip_core(void);
  * pcb if TCP_OOSEQ_BYTES_LIMIT is not defined. Default is 0 (no limit).
  * Only valid for TCP_QUEUE_OOSEQ==1.
  */
-#define TCP_OOSEQ_MAX_PBUFS             0
+#define TCP_OOSEQ_MAX_PBUFS             LWIP_PROFILE_TCP_OOSEQ_MAX_PBUFS
 
 /**
  * TCP_OOSEQ_PBUFS_LIMIT(pcb): Return the maximum number of pbufs to be queued
@@ -1433,6 +1486,12 @@ void sys_unlock_tcpip_core(void);
  */
 #define LWIP_STATS_DISPLAY              1
 
+/**
+ * LWIP_STATS_LARGE==1: Use 32 bits counter instead of 16.
+ * The counters are exposed as diagnostics, see netstatapi.h
+ */
+#define LWIP_STATS_LARGE                1
+
 /**
  * LINK_STATS==1: Enable link stats.
  */
@@ -1478,8 +1537,9 @@ void sys_unlock_tcpip_core(void);
 
 /**
  * MEM_STATS==1: Enable mem.c stats.
+ * lwIP keeps track of the heap usage with MEM_LIBC_MALLOC==1 as well
  */
-#define MEM_STATS                       ((MEM_LIBC_MALLOC == 0) && (MEM_USE_POOLS == 0))
+#define MEM_STATS                       (MEM_USE_POOLS == 0)
 
 /**
  * MEMP_STATS==1: Enable memp.c pool stats.
@@ -1518,8 +1578,9 @@ void sys_unlock_tcpip_core(void);
 
 /**
  * MIB2_STATS==1: Stats for SNMP MIB2.
+ * Enabled for the TCP retransmission counter, see netstatapi.h
  */
-#define MIB2_STATS                      0
+#define MIB2_STATS                      1
 
 #else
 
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ota_flash_hal_impl.h"
+#include "ota_module.h"
+#include "flash_mal.h"
+#include "flash_common.h"
+#include "exflash_hal.h"
+#include "module_info.h"
+#include "delta_patch.h"
+#include "decompress_stream.h"
+#include "stream.h"
+#include "system_error.h"
+#include "logging.h"
+#include "check.h"
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <cstring>
+
+LOG_SOURCE_CATEGORY("hal.ota")
+
+using namespace particle;
+
+namespace {
+
+const size_t BLOCK_SIZE = 256;
+
+// Writes data sequentially to an erased area of the external flash
+class ExFlashOutputStream: public OutputStream {
+public:
+    ExFlashOutputStream(uintptr_t addr, size_t size) :
+            start_(addr),
+            addr_(addr),
+            end_(addr + size) {
+    }
+
+    int write(const char* data, size_t size) override {
+        if (size > end_ - addr_) {
+            return SYSTEM_ERROR_TOO_LARGE;
+        }
+        if (hal_exflash_write(addr_, (const uint8_t*)data, size) != 0) {
+            return SYSTEM_ERROR_IO;
+        }
+        addr_ += size;
+        return size;
+    }
+
+    int flush() override {
+        return 0;
+    }
+
+    int availForWrite() override {
+        return end_ - addr_;
+    }
+
+    size_t written() const {
+        return addr_ - start_;
+    }
+
+    int waitEvent(unsigned flags, unsigned timeout) override {
+        return 0;
+    }
+
+private:
+    uintptr_t start_;
+    uintptr_t addr_;
+    uintptr_t end_;
+};
+
+int erase_exflash(uintptr_t addr, size_t size) {
+    if (hal_exflash_erase_sector(addr, CEIL_DIV(size, sFLASH_PAGESIZE)) != 0) {
+        return SYSTEM_ERROR_IO;
+    }
+    return 0;
+}
+
+int copy_exflash(uintptr_t src, uintptr_t dest, size_t size) {
+    uint8_t buf[BLOCK_SIZE];
+    while (size > 0) {
+        const size_t n = std::min(size, sizeof(buf));
+        if (hal_exflash_read(src, buf, n) != 0 || hal_exflash_write(dest, buf, n) != 0) {
+            return SYSTEM_ERROR_IO;
+        }
+        src += n;
+        dest += n;
+        size -= n;
+    }
+    return 0;
+}
+
+// Feeds data stored in the external flash to a stream
+int read_exflash(uintptr_t addr, size_t size, OutputStream* strm) {
+    uint8_t buf[BLOCK_SIZE];
+    while (size > 0) {
+        const size_t n = std::min(size, sizeof(buf));
+        if (hal_exflash_read(addr, buf, n) != 0) {
+            return SYSTEM_ERROR_IO;
+        }
+        CHECK(strm->writeAll((const char*)buf, n));
+        addr += n;
+        size -= n;
+    }
+    return 0;
+}
+
+// Finds the installed module a delta patch applies to
+const module_info_t* find_source_module(const module_encoded_header_t& header) {
+    const module_bounds_t* bounds = find_module_bounds(header.source_function, header.source_index, HAL_PLATFORM_MCU_DEFAULT);
+    if (!bounds) {
+        return nullptr;
+    }
+    hal_module_t module;
+    if (!fetch_module(&module, bounds, true, MODULE_VALIDATION_INTEGRITY) ||
+            !(module.validity_result & MODULE_VALIDATION_INTEGRITY) ||
+            memcmp(module.suffix->sha, header.source_sha, sizeof(header.source_sha)) != 0) {
+        return nullptr;
+    }
+    return module.info;
+}
+
+} // unnamed
+
+int decode_ota_module() {
+    const uintptr_t ota_addr = EXTERNAL_FLASH_OTA_ADDRESS;
+    module_encoded_header_t header = {};
+    if (hal_exflash_read(ota_addr, (uint8_t*)&header, sizeof(header)) != 0) {
+        return SYSTEM_ERROR_IO;
+    }
+    if (header.magic != MODULE_ENCODED_MAGIC) {
+        return 0; // Regular module
+    }
+    const uint16_t supported_flags = MODULE_ENCODED_FLAG_DELTA | MODULE_ENCODED_FLAG_COMPRESSED;
+    if (header.size < sizeof(header) || !header.flags || (header.flags & ~supported_flags)) {
+        LOG(ERROR, "Unsupported module encoding: %04x", (unsigned)header.flags);
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+    // The encoded image is moved to the end of the OTA region, so that the decoded module can be
+    // written to the start of the region
+    const size_t encoded_size = header.size + header.payload_size;
+    const size_t moved_size = CEIL_DIV(encoded_size, sFLASH_PAGESIZE) * sFLASH_PAGESIZE;
+    if (encoded_size < header.payload_size || moved_size > EXTERNAL_FLASH_OTA_LENGTH ||
+            encoded_size > EXTERNAL_FLASH_OTA_LENGTH - moved_size ||
+            header.decoded_size > EXTERNAL_FLASH_OTA_LENGTH - moved_size) {
+        LOG(ERROR, "Encoded module is too large");
+        return SYSTEM_ERROR_TOO_LARGE;
+    }
+
+    // Set up the decoding stages: payload -> inflate -> delta patch -> flash
+    ExFlashOutputStream dest(ota_addr, header.decoded_size);
+    OutputStream* strm = &dest;
+    std::unique_ptr<DeltaPatchStream> patch;
+    if (header.flags & MODULE_ENCODED_FLAG_DELTA) {
+        const module_info_t* source = find_source_module(header);
+        if (!source) {
+            LOG(ERROR, "Source module not found");
+            return SYSTEM_ERROR_NOT_FOUND;
+        }
+        patch.reset(new(std::nothrow) DeltaPatchStream((const uint8_t*)source->module_start_address,
+                module_length(source) + sizeof(module_info_crc_t), strm));
+        if (!patch) {
+            return SYSTEM_ERROR_NO_MEMORY;
+        }
+        strm = patch.get();
+    }
+    std::unique_ptr<char[]> window;
+    std::unique_ptr<DecompressStream> inflate;
+    if (header.flags & MODULE_ENCODED_FLAG_COMPRESSED) {
+        window.reset(new(std::nothrow) char[TINFL_LZ_DICT_SIZE]);
+        if (window) {
+            inflate.reset(new(std::nothrow) DecompressStream(window.get(), TINFL_LZ_DICT_SIZE, *strm));
+        }
+        if (!inflate) {
+            return SYSTEM_ERROR_NO_MEMORY;
+        }
+        strm = inflate.get();
+    }
+
+    const uintptr_t moved_addr = ota_addr + EXTERNAL_FLASH_OTA_LENGTH - moved_size;
+    CHECK(erase_exflash(moved_addr, moved_size));
+    CHECK(copy_exflash(ota_addr, moved_addr, encoded_size));
+    CHECK(erase_exflash(ota_addr, header.decoded_size));
+
+    LOG(INFO, "Decoding OTA module, encoding: %04x, %u bytes", (unsigned)header.flags, (unsigned)header.payload_size);
+    CHECK(read_exflash(moved_addr + header.size, header.payload_size, strm));
+    CHECK(strm->flush());
+    if ((inflate && !inflate->done()) || (patch && !patch->done()) || dest.written() != header.decoded_size) {
+        LOG(ERROR, "Invalid encoded module");
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    return 0;
+}
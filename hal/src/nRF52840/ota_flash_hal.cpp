@@ -385,6 +385,16 @@ int HAL_FLASH_OTA_Validate(hal_module_t* mod, bool userDepsOptional, module_vali
 {
     hal_module_t module;
 
+    // An encoded module is decoded the first time it's validated
+    const int ret = decode_ota_module();
+    if (ret < 0) {
+        LOG(ERROR, "Unable to decode OTA module: %d", ret);
+        if (mod) {
+            memset(mod, 0, sizeof(hal_module_t));
+        }
+        return 1;
+    }
+
     bool module_fetched = fetch_module(&module, &module_ota, userDepsOptional, flags);
 
     if (mod) 
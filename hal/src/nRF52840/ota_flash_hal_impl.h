@@ -70,5 +70,13 @@ int fetch_system_properties(key_value* storage, int keyCount);
  */
 int add_system_properties(hal_system_info_t* info, bool create, size_t additional);
 
+/**
+ * Decodes an encoded module image stored in the OTA region (see module_encoded_header_t),
+ * replacing it with the module it describes. Does nothing if the OTA region contains
+ * a regular module.
+ * @return 0 on success, or a negative result code.
+ */
+int decode_ota_module();
+
 #endif
 
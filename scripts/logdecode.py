@@ -0,0 +1,385 @@
+#!/usr/bin/env python3
+#
+# Decoder for the output of spark::BinaryStreamLogHandler.
+#
+# Extracting the string table from the firmware's ELF files (can be done at build time by running
+# `make logfmt` in the module's directory):
+#
+#   logdecode.py extract system-part1.elf user-part.elf -o firmware.logfmt.json
+#
+# Decoding a log captured from a serial port or RTT:
+#
+#   logdecode.py decode -t firmware.logfmt.json log.bin
+#   cat /dev/ttyUSB0 | logdecode.py decode -e system-part1.elf -e user-part.elf
+#
+# The format strings are identified by their addresses, so the string table must be extracted
+# from the same build of the firmware that produced the log.
+
+import argparse
+import bisect
+import json
+import re
+import struct
+import sys
+
+# Record types
+MESSAGE = 1
+TEXT_MESSAGE = 2
+WRITE = 3
+
+# Attribute flags
+HAS_TIME = 0x01
+HAS_CATEGORY = 0x02
+HAS_FILE = 0x04
+HAS_LINE = 0x08
+HAS_FUNCTION = 0x10
+HAS_CODE = 0x20
+HAS_DETAILS = 0x40
+
+LEVEL_NAMES = [(60, 'PANIC'), (50, 'ERROR'), (40, 'WARN'), (30, 'INFO'), (1, 'TRACE')]
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+EM_X86_64 = 62
+
+# Sizes of the C types on the supported targets
+TYPE_SIZES = {
+    4: {'int': 4, 'long': 4, 'long long': 8, 'intmax': 8, 'size': 4, 'ptrdiff': 4, 'double': 8,
+        'long double': 8, 'pointer': 4},
+    8: {'int': 4, 'long': 8, 'long long': 8, 'intmax': 8, 'size': 8, 'ptrdiff': 8, 'double': 8,
+        'long double': 16, 'pointer': 8}
+}
+
+SPEC_RE = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|q|j|z|t|L)?([diouxXcspfFeEgGaAn%])')
+
+
+def fnv1a(s):
+    h = 2166136261
+    for b in s.encode('utf-8', 'surrogateescape'):
+        h = ((h ^ b) * 16777619) & 0xffffffff
+    return h
+
+
+def read_elf_strings(path):
+    """Returns the pointer size and a list of (address, string) tuples for all null-terminated
+    strings found in the allocated sections of an ELF file"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:4] != b'\x7fELF':
+        raise ValueError('%s is not an ELF file' % path)
+    is64 = data[4] == 2
+    endian = '<' if data[5] == 1 else '>'
+    if is64:
+        machine, = struct.unpack_from(endian + 'H', data, 18)
+        shoff, = struct.unpack_from(endian + 'Q', data, 40)
+        shentsize, shnum = struct.unpack_from(endian + 'HH', data, 58)
+    else:
+        machine, = struct.unpack_from(endian + 'H', data, 18)
+        shoff, = struct.unpack_from(endian + 'I', data, 32)
+        shentsize, shnum = struct.unpack_from(endian + 'HH', data, 46)
+    strings = []
+    for i in range(shnum):
+        offs = shoff + i * shentsize
+        if is64:
+            _, sh_type, sh_flags, sh_addr, sh_offset, sh_size = struct.unpack_from(endian + 'IIQQQQ', data, offs)
+        else:
+            _, sh_type, sh_flags, sh_addr, sh_offset, sh_size = struct.unpack_from(endian + 'IIIIII', data, offs)
+        if not (sh_flags & SHF_ALLOC) or sh_type == SHT_NOBITS or not sh_addr:
+            continue
+        sect = data[sh_offset:sh_offset + sh_size]
+        for m in re.finditer(rb'[\t\n\r\x20-\x7e\x80-\xff]+\x00', sect):
+            s = m.group()[:-1].decode('utf-8', 'surrogateescape')
+            strings.append((sh_addr + m.start(), s))
+    ptr_size = 8 if is64 and machine == EM_X86_64 else 4
+    return ptr_size, strings
+
+
+class StringTable:
+    def __init__(self):
+        self.addrs = []
+        self.strings = []
+        self.categories = {}
+        self.pointer_size = 4
+
+    def add(self, strings):
+        items = dict(zip(self.addrs, self.strings))
+        items.update(strings)
+        self.addrs = sorted(items)
+        self.strings = [items[a] for a in self.addrs]
+        for s in self.strings:
+            self.categories.setdefault(fnv1a(s), s)
+
+    def load_elf(self, path):
+        self.pointer_size, strings = read_elf_strings(path)
+        self.add(strings)
+
+    def load_json(self, path):
+        with open(path) as f:
+            t = json.load(f)
+        self.pointer_size = t['pointerSize']
+        self.add((int(a, 16), s) for a, s in t['strings'])
+
+    def save_json(self, path):
+        t = {
+            'version': 1,
+            'pointerSize': self.pointer_size,
+            'strings': [['0x%x' % a, s] for a, s in zip(self.addrs, self.strings)]
+        }
+        with open(path, 'w') as f:
+            json.dump(t, f, indent=1)
+
+    def string(self, addr):
+        # The linker may merge a string with the tail of a longer one
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i >= 0:
+            offs = addr - self.addrs[i]
+            s = self.strings[i]
+            if offs <= len(s):
+                return s[offs:]
+        return None
+
+    def category(self, h):
+        return self.categories.get(h, '#%08x' % h)
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def bytes(self, n):
+        if self.pos + n > len(self.data):
+            raise IndexError('Unexpected end of record')
+        b = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return b
+
+    def rest(self):
+        b = self.data[self.pos:]
+        self.pos = len(self.data)
+        return b
+
+    def varint(self):
+        val = 0
+        shift = 0
+        while True:
+            b = self.byte()
+            val |= (b & 0x7f) << shift
+            if not b & 0x80:
+                return val
+            shift += 7
+
+    def uint32(self):
+        return struct.unpack('<I', self.bytes(4))[0]
+
+    def int(self, size, signed):
+        return int.from_bytes(self.bytes(size), 'little', signed=signed)
+
+    def string(self):
+        end = self.data.index(b'\x00', self.pos)
+        s = self.data[self.pos:end].decode('utf-8', 'replace')
+        self.pos = end + 1
+        return s
+
+    def float(self, size):
+        b = self.bytes(size)
+        if size == 8:
+            return struct.unpack('<d', b)[0]
+        # x87 extended precision
+        mant = int.from_bytes(b[:8], 'little')
+        se = int.from_bytes(b[8:10], 'little')
+        exp = se & 0x7fff
+        sign = -1.0 if se & 0x8000 else 1.0
+        if exp == 0x7fff:
+            return sign * float('inf') if not mant << 1 & 0xffffffffffffffff else float('nan')
+        return sign * mant * 2.0 ** (exp - 16383 - 63)
+
+
+def format_message(fmt, args, sizes):
+    r = Reader(args)
+    out = []
+    pos = 0
+    for m in SPEC_RE.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, length, conv = m.groups()
+        if width == '*':
+            width = str(r.int(4, True))
+        if prec == '*':
+            prec = str(r.int(4, True))
+        spec = '%' + flags + (width or '') + ('.' + prec if prec is not None else '')
+        if conv == '%':
+            out.append('%')
+        elif conv == 'n':
+            pass
+        elif conv == 's':
+            out.append((spec + 's') % r.string())
+        elif conv == 'p':
+            out.append('0x%x' % r.int(sizes['pointer'], False))
+        elif conv in 'fFeEgGaA':
+            val = r.float(sizes['long double' if length == 'L' else 'double'])
+            if conv in 'aA':
+                s = val.hex()
+                out.append(s.upper() if conv == 'A' else s)
+            else:
+                out.append((spec + conv) % val)
+        else:
+            size = sizes[{None: 'int', 'hh': 'int', 'h': 'int', 'l': 'long', 'll': 'long long', 'q': 'long long',
+                          'j': 'intmax', 'z': 'size', 't': 'ptrdiff'}[length]]
+            signed = conv in 'dic'
+            val = r.int(size, signed)
+            if length == 'hh':
+                val = val & 0xff if not signed else (val & 0xff) - ((val & 0x80) << 1)
+            elif length == 'h':
+                val = val & 0xffff if not signed else (val & 0xffff) - ((val & 0x8000) << 1)
+            if conv == 'c':
+                out.append((spec + 's') % chr(val & 0xff))
+            else:
+                out.append((spec + ('d' if conv in 'iu' else conv)) % val)
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+
+def level_name(level):
+    for val, name in LEVEL_NAMES:
+        if level >= val:
+            return name
+    return str(level)
+
+
+def func_name(s):
+    # Strip return and argument types, same as the device does
+    s = s.split('(', 1)[0]
+    return s.rsplit(' ', 1)[-1]
+
+
+def decode_record(rec, table):
+    r = Reader(rec)
+    rtype = r.byte()
+    level = r.byte()
+    flags = r.byte()
+    if rtype == WRITE:
+        return r.rest().decode('utf-8', 'replace')
+    line = []
+    if flags & HAS_TIME:
+        line.append('%010u ' % r.varint())
+    if flags & HAS_CATEGORY:
+        line.append('[%s] ' % table.category(r.uint32()))
+    if flags & HAS_FILE:
+        addr = r.varint()
+        s = table.string(addr)
+        line.append(s.rsplit('/', 1)[-1] if s is not None else '0x%x' % addr)
+    if flags & HAS_LINE:
+        line.append(':%d' % r.varint())
+    if flags & HAS_FILE:
+        line.append(', ' if flags & HAS_FUNCTION else ': ')
+    if flags & HAS_FUNCTION:
+        addr = r.varint()
+        s = table.string(addr)
+        line.append('%s(): ' % (func_name(s) if s is not None else '0x%x' % addr))
+    code = None
+    details = None
+    if flags & HAS_CODE:
+        v = r.varint()
+        code = (v >> 1) ^ -(v & 1)
+    if flags & HAS_DETAILS:
+        details = r.string()
+    line.append(level_name(level) + ': ')
+    if rtype == MESSAGE:
+        addr = r.varint()
+        fmt = table.string(addr)
+        if fmt is None:
+            line.append('<unknown format string 0x%x> %s' % (addr, r.rest().hex()))
+        else:
+            line.append(format_message(fmt, r.rest(), TYPE_SIZES[table.pointer_size]))
+    elif rtype == TEXT_MESSAGE:
+        line.append(r.rest().decode('utf-8', 'replace'))
+    else:
+        raise ValueError('Unknown record type: %d' % rtype)
+    if code is not None or details is not None:
+        attrs = []
+        if code is not None:
+            attrs.append('code = %d' % code)
+        if details is not None:
+            attrs.append('details = %s' % details)
+        line.append(' [%s]' % ', '.join(attrs))
+    return ''.join(line) + '\n'
+
+
+def cobs_decode(frame):
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame) + 1:
+            raise ValueError('Invalid COBS frame')
+        out += frame[i + 1:i + code]
+        i += code
+        if code < 0xff and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_stream(f, table, out):
+    buf = bytearray()
+    while True:
+        chunk = f.read1(4096) if hasattr(f, 'read1') else f.read(4096)
+        if not chunk:
+            break
+        buf += chunk
+        while True:
+            end = buf.find(b'\x00')
+            if end < 0:
+                break
+            frame = bytes(buf[:end])
+            del buf[:end + 1]
+            if not frame:
+                continue
+            try:
+                out.write(decode_record(cobs_decode(frame), table))
+            except (ValueError, IndexError) as e:
+                out.write('<invalid record: %s>\n' % e)
+            out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decoder for the binary log format')
+    sub = parser.add_subparsers(dest='cmd')
+    p = sub.add_parser('extract', help='Extract the string table from ELF files')
+    p.add_argument('elf', nargs='+', help='ELF file')
+    p.add_argument('-o', '--output', required=True, help='Output file')
+    p = sub.add_parser('decode', help='Decode a binary log')
+    p.add_argument('-t', '--table', action='append', default=[], help='String table extracted with the extract command')
+    p.add_argument('-e', '--elf', action='append', default=[], help='ELF file')
+    p.add_argument('input', nargs='?', help='Input file (default: stdin)')
+    args = parser.parse_args()
+    table = StringTable()
+    if args.cmd == 'extract':
+        for path in args.elf:
+            table.load_elf(path)
+        table.save_json(args.output)
+    elif args.cmd == 'decode':
+        if not args.table and not args.elf:
+            parser.error('No string table or ELF file specified')
+        for path in args.table:
+            table.load_json(path)
+        for path in args.elf:
+            table.load_elf(path)
+        if args.input:
+            with open(args.input, 'rb') as f:
+                decode_stream(f, table, sys.stdout)
+        else:
+            decode_stream(sys.stdin.buffer, table, sys.stdout)
+    else:
+        parser.print_help()
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
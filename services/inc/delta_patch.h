@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "stream.h"
+
+#include <cstdint>
+
+namespace particle {
+
+/**
+ * Output stream applying a binary delta patch to a source image.
+ *
+ * The patch data written to the stream is a sequence of commands. Each command starts with
+ * a command byte followed by little-endian 32-bit arguments:
+ *
+ * - `END`: marks the end of the patch.
+ * - `COPY <offset> <length>`: copies `length` bytes of the source image starting at `offset`.
+ * - `ADD <offset> <length> <data...>`: outputs `length` bytes, each being the sum of a byte of
+ *   the source image starting at `offset` and the respective byte of the data.
+ * - `INSERT <length> <data...>`: outputs `length` bytes of the data as is.
+ *
+ * The reconstructed image is written to the destination stream as the patch is processed, so the
+ * amount of RAM used doesn't depend on the size of the images.
+ */
+class DeltaPatchStream: public OutputStream {
+public:
+    enum Command {
+        END = 0,
+        COPY = 1,
+        ADD = 2,
+        INSERT = 3
+    };
+
+    DeltaPatchStream(const uint8_t* source, size_t sourceSize, OutputStream* dest);
+
+    int write(const char* data, size_t size) override;
+    int flush() override;
+    int availForWrite() override;
+    int waitEvent(unsigned flags, unsigned timeout = 0) override;
+
+    bool done() const {
+        return state_ == State::DONE;
+    }
+
+    size_t written() const {
+        return written_;
+    }
+
+private:
+    enum class State {
+        COMMAND,
+        ARGUMENTS,
+        DATA,
+        DONE
+    };
+
+    static const size_t BUFFER_SIZE = 128;
+
+    const uint8_t* source_;
+    size_t sourceSize_;
+    OutputStream* dest_;
+    size_t written_;
+    State state_;
+    uint8_t cmd_;
+    uint8_t args_[8];
+    size_t argSize_;
+    size_t argOffs_;
+    size_t srcOffs_;
+    size_t dataLeft_;
+    uint8_t buf_[BUFFER_SIZE];
+    size_t bufSize_;
+    int error_;
+
+    int startCommand();
+    int output(const uint8_t* data, size_t size);
+    int flushBuffer();
+    int fail(int error);
+};
+
+} // particle
@@ -56,6 +56,13 @@
 #define DIAG_NAME_CLOUD_REPEATED_MESSAGES "coap:resend"
 #define DIAG_NAME_CLOUD_UNACKNOWLEDGED_MESSAGES "coap:unack"
 #define DIAG_NAME_CLOUD_RATE_LIMITED_EVENTS "pub:limit"
+#define DIAG_NAME_CLOUD_PUBLISH_QUEUE_DEPTH "pub:queue"
+#define DIAG_NAME_CLOUD_DROPPED_EVENTS "pub:drop"
+#define DIAG_NAME_NETWORK_PBUF_POOL_USED "net:pbuf:used"
+#define DIAG_NAME_NETWORK_PBUF_POOL_MAX "net:pbuf:max"
+#define DIAG_NAME_NETWORK_PBUF_POOL_ERRORS "net:pbuf:err"
+#define DIAG_NAME_NETWORK_HEAP_MAX "net:heap:max"
+#define DIAG_NAME_NETWORK_TCP_RETRANSMITS "net:tcp:rexmit"
 #define DIAG_NAME_SYSTEM_TOTAL_RAM "sys:tram"
 #define DIAG_NAME_SYSTEM_USED_RAM "sys:uram"
 
@@ -93,6 +100,11 @@ typedef enum diag_id {
     DIAG_ID_NETWORK_CELLULAR_CELL_GLOBAL_IDENTITY_MOBILE_NETWORK_CODE = 41, // net:cell:cgi:mnc
     DIAG_ID_NETWORK_CELLULAR_CELL_GLOBAL_IDENTITY_LOCATION_AREA_CODE = 42, // net:cell:cgi:lac
     DIAG_ID_NETWORK_CELLULAR_CELL_GLOBAL_IDENTITY_CELL_ID = 43, // net:cell:cgi:ci
+    DIAG_ID_NETWORK_PBUF_POOL_USED = 46, // net:pbuf:used
+    DIAG_ID_NETWORK_PBUF_POOL_MAX = 47, // net:pbuf:max
+    DIAG_ID_NETWORK_PBUF_POOL_ERRORS = 48, // net:pbuf:err
+    DIAG_ID_NETWORK_HEAP_MAX = 49, // net:heap:max
+    DIAG_ID_NETWORK_TCP_RETRANSMITS = 50, // net:tcp:rexmit
     DIAG_ID_CLOUD_CONNECTION_STATUS = 10, // cloud:stat
     DIAG_ID_CLOUD_CONNECTION_ERROR_CODE = 13, // cloud:err
     DIAG_ID_CLOUD_DISCONNECTS = 14, // cloud:dconn
@@ -101,6 +113,8 @@ typedef enum diag_id {
     DIAG_ID_CLOUD_REPEATED_MESSAGES = 21, // coap:resend
     DIAG_ID_CLOUD_UNACKNOWLEDGED_MESSAGES = 22, // coap:unack
     DIAG_ID_CLOUD_RATE_LIMITED_EVENTS = 20, // pub:throttle
+    DIAG_ID_CLOUD_PUBLISH_QUEUE_DEPTH = 44, // pub:queue
+    DIAG_ID_CLOUD_DROPPED_EVENTS = 45, // pub:drop
     DIAG_ID_SYSTEM_TOTAL_RAM = 25, // sys:tram
     DIAG_ID_SYSTEM_USED_RAM = 26, // sys:uram
     DIAG_ID_USER = 32768 // Base value for application-specific source IDs
@@ -22,6 +22,7 @@
 #if (defined(HAL_PLATFORM_FILESYSTEM) && HAL_PLATFORM_FILESYSTEM == 1)
 
 #include <stdint.h>
+#include <stddef.h>
 #include "service_debug.h"
 #include "system_error.h"
 #include "filesystem.h"
@@ -31,12 +32,20 @@ namespace particle {
 namespace fs {
 
 /**
- * Implements a queue on top of a file.
+ * Implements a persistent queue on top of the filesystem.
+ *
+ * Entries are appended to a sequence of segment files ("<path>.0", "<path>.1", ...). A segment
+ * is never modified after an entry has been written to it: instead, the position of the front
+ * entry is stored in a separate cursor file ("<path>.head"). Segments that have been fully
+ * consumed are removed by `compact()`. The file handles of the head and tail segments are kept
+ * open between calls, so that pushing and popping an entry takes a constant amount of work
+ * regardless of the number of entries in the queue.
+ *
+ * A queue file created by an earlier version of this class is converted to the first segment
+ * of the queue when the queue is accessed for the first time.
  */
 class FileQueue {
-
 public:
-
     struct __attribute__((__packed__)) QueueEntry {
         enum Flags {
             ACTIVE = 1<<0,		// when this bit is set the entry is active. When the bit is reset, the entry is not valid and can ce ignored.
@@ -47,42 +56,32 @@ public:
 
     };
 
-    FileQueue(const char* path) : path_(path)
-    {
-    }
-
-    ~FileQueue() {
-
-    }
-
-    int _open() {
-        auto fs = filesystem_get_instance(nullptr);
-        SPARK_ASSERT(fs);
-
-        FsLock lk(fs);
-        fs_ = fs;
+    /**
+     * Size of a segment file after which a new segment is started.
+     */
+    static const size_t SEGMENT_SIZE = 4096;
+    /**
+     * Number of consumed segments after which `popFront()` compacts the queue.
+     */
+    static const unsigned MAX_CONSUMED_SEGMENTS = 4;
 
-        SPARK_ASSERT(!filesystem_mount(fs_));
-        return 0;
-    }
+    explicit FileQueue(const char* path);
+    ~FileQueue();
 
     /**
      * Add an entry to the back of the queue.
+     *
+     * @param item Entry data.
+     * @param size Size of the entry data.
+     * @param sync If `false`, the entry is not flushed to the filesystem until `sync()` is called.
+     *        This allows adding a batch of entries with a single flush.
      */
-    int pushBack(void* item, uint16_t size) {
-        // append a new item to the file
-        FsLock lk(fs_);
-        _open();
-        int ret = lfs_file_open(lfs(), &write_file_, path_, LFS_O_WRONLY | LFS_O_APPEND | LFS_O_CREAT);
-        if (ret>=0) {
-            QueueEntry entry = { .size = uint16_t(size+sizeof(QueueEntry)), .flags = QueueEntry::ACTIVE };
-            ret = file_write(&write_file_, &entry, sizeof(entry));
-            ret = preserve_error(file_write(&write_file_, item, size), ret);
-            ret = preserve_error(lfs_file_close(lfs(), &write_file_), ret);   // always close even if there are other errors
-        }
-        LOG(INFO, "add item to file queue %s, size %d, result %d", path_, size, ret);
-        return ret;
-    }
+    int pushBack(const void* item, uint16_t size, bool sync = true);
+
+    /**
+     * Flush the entries added with `pushBack(item, size, false)` to the filesystem.
+     */
+    int sync();
 
     /**
      * Retrieve the front queue entry in the file.
@@ -93,136 +92,71 @@ public:
      * as will fit into the buffer is copied.
      * @return SYSTEM_ERROR_NOT_FOUND when there is no such entry.
      */
-    int front(QueueEntry& entry, void* buffer, uint16_t length) {
-        FsLock lk(fs_);
-        int ret = _front(entry, true);
-        if (ret>=0) {
-            int remaining = entry.size-sizeof(entry);
-        	if (remaining>length) {
-        		LOG(ERROR,  "Buffer length %d is too small. Need at least %d", length, remaining);
-        		ret = LFS_ERR_INVAL;
-        	} else {
-        		ret = lfs_file_read(lfs(), &read_file_, buffer, remaining);
-				if (ret!=int(remaining)) {
-					LOG(ERROR, "Incomplete queue record. Expected length %d but read %d", remaining, ret);
-					clear();
-					ret = LFS_ERR_IO;
-				} else {
-					ret = 0;	// no error
-					LOG(INFO, "Retrieved entry from file queue, size %d", entry.size);
-				}
-        	}
-            ret = preserve_error(lfs_file_close(lfs(), &read_file_), ret);
-        }
-        return ret;
-    }
+    int front(QueueEntry& entry, void* buffer, uint16_t length);
 
     /**
-     * Locate the offset in the file of the first non-expired entry
-     * and retrieve the entry.
+     * Remove the front item in the queue.
+     */
+    int popFront();
+
+    /**
+     * Remove the segment files that have been fully consumed.
      *
-     * @return >=0 when the entry was successfully retrieved.
-     * <0 for an error condition.
+     * This method can be called when the system is idle in order to reduce the amount of work
+     * done by `popFront()`.
      */
-    int _front(QueueEntry& entry, bool keepOpen) {
-        _open();
-        int ret = lfs_file_open(lfs(), &read_file_, path_, LFS_O_RDONLY);
-        if (!ret) {
-			while (!ret) {
-				ret = lfs_file_read(lfs(), &read_file_, &entry, sizeof(entry));
-				if (ret==sizeof(QueueEntry)) {
-					ret = 0; 	// all good
-					if (entry.flags & QueueEntry::ACTIVE) {
-						break;
-					}
-				} else {
-					ret = LFS_ERR_IO;
-					break;	// problem reading
-				}
-				ret = lfs_file_seek(lfs(), &read_file_, entry.size-sizeof(entry), LFS_SEEK_CUR);
-				if (ret>=0) {
-					ret = 0;
-				}
-			}
-			if (ret || !keepOpen) {
-				ret = preserve_error(lfs_file_close(lfs(), &read_file_), ret);
-			}
-        }
-        return ret;
-    }
+    int compact();
 
     /**
-     * Remove the front item in the queue. This is done by clearing the ACTIVE flag in the queue entry.
+     * Remove all entries from the queue.
      */
-    int popFront() {
-        FsLock lk(fs_);
-        QueueEntry entry;
-        int ret = _front(entry, true);
-        // file position points to the start of the file data for the first ACTIVE entry.
-        int offset = lfs_file_tell(lfs(), &read_file_);
-        ret = lfs_file_close(lfs(), &read_file_);
-
-        bool isLast = false;
-        if (ret>=0) {
-            int ret = lfs_file_open(lfs(), &read_file_, path_, LFS_O_RDWR);
-            if (!ret) {
-                offset -= sizeof(entry);	// offset is at the start of the entry
-                ret = lfs_file_seek(lfs(), &read_file_, offset, LFS_SEEK_SET);
-                if (ret>=0) ret = 0;
-                entry.flags &= ~QueueEntry::ACTIVE;
-                if (!ret) {
-                	ret = lfs_file_write(lfs(), &read_file_, &entry, sizeof(entry));
-                	if (ret==sizeof(entry))
-                		ret = 0;
-                }
-                lfs_soff_t length = lfs_file_size(lfs(), &read_file_);
-                isLast = (length>=0 && length==(offset+entry.size));
-                ret = preserve_error(lfs_file_close(lfs(), &read_file_), ret);
-            }
-        }
-        if (isLast && !ret) {
-        	LOG(INFO, "Removed last entry from file queue, deleting file %s", path_);
-            // when the last entry has been cleared remove the file
-            ret = clear();
-        }
-        return ret;
-    }
+    int clear();
 
-    int clear() {
-    	FsLock lk(fs_);
-    	return lfs_remove(lfs(), path_);
-    }
+    // This class is non-copyable
+    FileQueue(const FileQueue&) = delete;
+    FileQueue& operator=(const FileQueue&) = delete;
 
 private:
+    // Contents of the cursor file
+    struct __attribute__((__packed__)) Cursor {
+        uint32_t magick;
+        uint32_t firstSegment; // Oldest segment that hasn't been removed yet
+        uint32_t headSegment; // Segment containing the front entry
+        uint32_t headOffset; // Offset of the front entry in the head segment
+        uint32_t tailSegment; // Segment new entries are appended to
+    };
 
-    int file_write(lfs_file* file, void* data, uint16_t size) {
-		int ret = lfs_file_write(lfs(), file, data, size);
-		if (ret<0) {
-			LOG(ERROR, "Error writing %d bytes to file %s: error %d", size, path_, ret);
-		}
-		else if (ret!=size) {
-			LOG(ERROR, "wrote only %d bytes to file %s, expected %d bytes to be written", ret, path_, size);
-			ret = LFS_ERR_IO;
-		}
-		else {
-			ret = 0;
-		}
-		return ret;
-	}
+    filesystem_t* fs_;
+    const char* path_;
+    Cursor cur_;
+    lfs_file_t readFile_; // Head segment
+    lfs_file_t writeFile_; // Tail segment
+    lfs_soff_t readFileSize_; // Size of the head segment when it was opened
+    lfs_soff_t writeFileSize_; // Size of the tail segment
+    bool readFileOpen_;
+    bool writeFileOpen_;
+    bool writeFileDirty_; // The tail segment has unsynced data
+    bool open_;
+
+    int open();
+
+    int findFront(QueueEntry* entry);
+    int openReadFile();
+    int openWriteFile();
+    void closeReadFile();
+    int closeWriteFile();
+    int removeSegments(uint32_t first, uint32_t last);
+
+    int loadCursor();
+    int saveCursor();
+    int migrate();
+
+    int segmentPath(char* buf, size_t size, uint32_t segment) const;
+    int cursorPath(char* buf, size_t size) const;
 
     lfs_t* lfs() {
-        _open();
         return &fs_->instance;
     }
-
-    static int preserve_error(int first, int second) {
-    	return first<0 ? first : second;
-    }
-
-    filesystem_t* fs_ = nullptr;
-    lfs_file_t read_file_ = {};
-    lfs_file_t write_file_ = {};
-    const char* path_;
 };
 
 } // fs
@@ -193,6 +193,11 @@ typedef void (*log_write_callback_type)(const char *data, size_t size, int level
 // Callback invoked to check whether logging is enabled for particular level and category (used by log_enabled())
 typedef int (*log_enabled_callback_type)(int level, const char *category, void *reserved);
 
+// Callback for message-based logging with deferred formatting (used by log_message()). The callback
+// receives the format string and its arguments instead of the formatted message
+typedef void (*log_message_deferred_callback_type)(const char *fmt, va_list args, int level, const char *category,
+        const LogAttributes *attr, void *reserved);
+
 // Generates log message
 void log_message(int level, const char *category, LogAttributes *attr, void *reserved, const char *fmt, ...);
 
@@ -222,6 +227,10 @@ const char* log_level_name(int level, void *reserved);
 void log_set_callbacks(log_message_callback_type log_msg, log_write_callback_type log_write,
         log_enabled_callback_type log_enabled, void *reserved);
 
+// Sets the callback for message-based logging with deferred formatting. When set, this callback is
+// used by log_message() instead of the message callback
+void log_set_deferred_callback(log_message_deferred_callback_type log_msg_deferred, void *reserved);
+
 extern void HAL_Delay_Microseconds(uint32_t delay);
 
 #ifdef __cplusplus
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace particle {
+
+/**
+ * Lock-free ring buffer of variable-sized records with multiple producers and a single consumer.
+ *
+ * A producer reserves space for a record with `acquire()`, fills it in and publishes it with
+ * `commit()`. Records are consumed in the order they were reserved: the consumer gets the oldest
+ * record with `peek()` and frees it with `release()`. A record that has been reserved but not
+ * committed yet blocks the consumer until it is committed.
+ *
+ * Every record is preceded by a header holding its size and state. The payload of a record is
+ * contiguous and aligned to the size of a pointer. If a record doesn't fit at the end of the
+ * buffer, the remaining space is skipped.
+ */
+class MpscRingBuffer {
+public:
+    MpscRingBuffer() :
+            buf_(nullptr),
+            mask_(0),
+            head_(0),
+            tail_(0) {
+    }
+
+    ~MpscRingBuffer() {
+        destroy();
+    }
+
+    /**
+     * Allocates the buffer. The size is rounded up to a power of two.
+     */
+    bool init(size_t size) {
+        destroy();
+        size_t capacity = MIN_CAPACITY;
+        while (capacity < size) {
+            capacity <<= 1;
+        }
+        buf_ = (char*)calloc(1, capacity);
+        if (!buf_) {
+            return false;
+        }
+        mask_ = capacity - 1;
+        head_.store(0);
+        tail_.store(0);
+        return true;
+    }
+
+    void destroy() {
+        free(buf_);
+        buf_ = nullptr;
+        mask_ = 0;
+    }
+
+    /**
+     * Reserves space for a record. Returns `nullptr` if the buffer is full.
+     *
+     * This method can be called concurrently by multiple threads.
+     */
+    void* acquire(size_t size) {
+        if (!buf_) {
+            return nullptr;
+        }
+        const uint32_t capacity = mask_ + 1;
+        const uint32_t need = (HEADER_SIZE + size + HEADER_SIZE - 1) & ~(HEADER_SIZE - 1);
+        if (need > capacity / 2) {
+            return nullptr;
+        }
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t offs = 0;
+        uint32_t skip = 0;
+        for (;;) {
+            const uint32_t tail = tail_.load(std::memory_order_acquire);
+            offs = head & mask_;
+            skip = (capacity - offs < need) ? capacity - offs : 0;
+            if (skip + need > capacity - (head - tail)) {
+                return nullptr;
+            }
+            if (head_.compare_exchange_weak(head, head + skip + need, std::memory_order_acq_rel,
+                    std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        if (skip) {
+            storeHeader(offs, skip | PADDING | COMMITTED);
+            offs = 0;
+        }
+        // The header is published without the COMMITTED flag until the record is filled in
+        __atomic_store_n(header(offs), need, __ATOMIC_RELAXED);
+        return buf_ + offs + HEADER_SIZE;
+    }
+
+    /**
+     * Publishes a record reserved with `acquire()`.
+     */
+    void commit(void* data) {
+        const uint32_t offs = (char*)data - buf_ - HEADER_SIZE;
+        storeHeader(offs, *header(offs) | COMMITTED);
+    }
+
+    /**
+     * Returns the oldest committed record, or `nullptr` if there is none. The size of the payload
+     * can be larger than the size passed to `acquire()` due to alignment.
+     *
+     * This method must only be called by the consumer.
+     */
+    void* peek(size_t* size = nullptr) {
+        for (;;) {
+            const uint32_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail == head_.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            const uint32_t offs = tail & mask_;
+            const uint32_t h = __atomic_load_n(header(offs), __ATOMIC_ACQUIRE);
+            if (!(h & COMMITTED)) {
+                return nullptr;
+            }
+            if (h & PADDING) {
+                releaseAt(tail, h & SIZE_MASK);
+                continue;
+            }
+            if (size) {
+                *size = (h & SIZE_MASK) - HEADER_SIZE;
+            }
+            return buf_ + offs + HEADER_SIZE;
+        }
+    }
+
+    /**
+     * Frees the record returned by `peek()`.
+     *
+     * This method must only be called by the consumer.
+     */
+    void release() {
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        const uint32_t h = *header(tail & mask_);
+        releaseAt(tail, h & SIZE_MASK);
+    }
+
+    bool isEmpty() const {
+        return tail_.load(std::memory_order_relaxed) == head_.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const {
+        return buf_ ? mask_ + 1 : 0;
+    }
+
+    // This class is non-copyable
+    MpscRingBuffer(const MpscRingBuffer&) = delete;
+    MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+private:
+    enum HeaderFlag: uint32_t {
+        COMMITTED = 0x80000000,
+        PADDING = 0x40000000,
+        SIZE_MASK = 0x3fffffff
+    };
+
+    // The header occupies a pointer-aligned slot, only the first 32 bits of which are used
+    static const uint32_t HEADER_SIZE = (sizeof(void*) > sizeof(uint32_t)) ? sizeof(void*) : sizeof(uint32_t);
+    static const size_t MIN_CAPACITY = 64;
+
+    char* buf_;
+    uint32_t mask_;
+    std::atomic<uint32_t> head_; // Position up to which the space has been reserved by the producers
+    std::atomic<uint32_t> tail_; // Position of the oldest record
+
+    uint32_t* header(uint32_t offs) const {
+        return (uint32_t*)(buf_ + offs);
+    }
+
+    void storeHeader(uint32_t offs, uint32_t h) {
+        __atomic_store_n(header(offs), h, __ATOMIC_RELEASE);
+    }
+
+    void releaseAt(uint32_t tail, uint32_t size) {
+        // Producers rely on the free space being zeroed, so that a header that has been reserved
+        // but not written yet is never seen as committed
+        memset(buf_ + (tail & mask_), 0, size);
+        tail_.store(tail + size, std::memory_order_release);
+    }
+};
+
+} // particle
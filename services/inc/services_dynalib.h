@@ -110,6 +110,8 @@ DYNALIB_FN(55, services, pb_encode_varint, bool(pb_ostream_t*, pb_uint64_t))
 # define BASE_IDX 40
 #endif
 
+DYNALIB_FN(BASE_IDX + 0, services, log_set_deferred_callback, void(log_message_deferred_callback_type, void*))
+
 DYNALIB_END(services)
 
 #endif	/* SERVICES_DYNALIB_H */
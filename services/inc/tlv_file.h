@@ -19,12 +19,17 @@
 #define SERVICES_TLV_FILE_H
 
 #include "filesystem.h"
+#include "spark_wiring_vector.h"
 #include <stdio.h>
 
 namespace particle { namespace services { namespace settings {
 
 static constexpr uint32_t TLV_FILE_MAGICK = 0x714f11e5;
 static constexpr uint32_t TLV_HEADER_MAGICK = 0x4ead;
+/* Deleted entries keep their header magick and length, so that older firmware can still skip them,
+ * and get their key replaced with this one. The original key is kept in the reserved field */
+static constexpr uint16_t TLV_DELETED_KEY = 0xffff;
+static constexpr uint16_t TLV_FILE_VERSION = 1;
 
 class TlvFile {
 public:
@@ -47,6 +52,27 @@ public:
     int add(uint16_t key, const uint8_t* value, uint16_t length);
     int del(uint16_t key, int index = -1);
 
+    /**
+     * Start a batch of changes.
+     *
+     * Changes made with `set()`, `add()` and `del()` are not written to the storage until
+     * `commitChanges()` is called, which allows applying them with a single footer update
+     * and a single sync.
+     */
+    int beginChanges();
+    int commitChanges();
+    int abandonChanges();
+
+    /**
+     * Remove deleted entries from the file.
+     *
+     * Deleted entries are removed automatically when they take more space than the remaining
+     * entries in the file.
+     */
+    int compact();
+
+    static const size_t MIN_COMPACTION_SIZE = 256;
+
 private:
     struct FileFooter {
         uint32_t reserved;  /* CRC32? */
@@ -65,6 +91,12 @@ private:
     } __attribute__((__packed__));
     static_assert(sizeof(TlvHeader) == sizeof(uint32_t) * 2, "sizeof(TlvHeader) != 8");
 
+    struct IndexEntry {
+        uint32_t offset;
+        uint16_t key;
+        uint16_t length;
+    };
+
 private:
     lfs_t* lfs();
 
@@ -74,7 +106,13 @@ private:
 
     int mkdir(char* dir);
 
-    ssize_t find(uint16_t key, int index, uint16_t* dataSize);
+    int buildIndex();
+    int find(uint16_t key, int index) const;
+    int addEntry(uint16_t key, const uint8_t* value, uint16_t length);
+    int delEntry(int i);
+    int commit();
+    int revert();
+    int writeFooter(uint32_t dataSize);
     int readFooter(FileFooter& footer);
 
     ssize_t seek(ssize_t offset, int whence = SEEK_SET);
@@ -87,6 +125,16 @@ private:
     bool open_ = false;
     filesystem_t* fs_ = nullptr;
     lfs_file_t file_ = {};
+
+    /* Live entries in the order they appear in the file */
+    Vector<IndexEntry> index_;
+    /* Entries deleted since the last commit */
+    Vector<IndexEntry> deleted_;
+    uint32_t dataSize_ = 0;
+    uint32_t committedSize_ = 0;
+    uint32_t garbageSize_ = 0;
+    bool batch_ = false;
+    bool dirty_ = false;
 };
 
 } } } /* namespace particle::services::settings */
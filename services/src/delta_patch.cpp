@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "delta_patch.h"
+
+#include "system_error.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace particle {
+
+namespace {
+
+inline uint32_t readUint32Le(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline bool inRange(size_t offs, size_t size, size_t totalSize) {
+    return offs <= totalSize && size <= totalSize - offs;
+}
+
+} // unnamed
+
+DeltaPatchStream::DeltaPatchStream(const uint8_t* source, size_t sourceSize, OutputStream* dest) :
+        source_(source),
+        sourceSize_(sourceSize),
+        dest_(dest),
+        written_(0),
+        state_(State::COMMAND),
+        cmd_(0),
+        argSize_(0),
+        argOffs_(0),
+        srcOffs_(0),
+        dataLeft_(0),
+        bufSize_(0),
+        error_(0) {
+}
+
+int DeltaPatchStream::write(const char* data, size_t size) {
+    if (error_ < 0) {
+        return error_;
+    }
+    const auto d = (const uint8_t*)data;
+    size_t offs = 0;
+    while (offs < size) {
+        switch (state_) {
+        case State::COMMAND: {
+            cmd_ = d[offs++];
+            switch (cmd_) {
+            case Command::END:
+                state_ = State::DONE;
+                CHECK(flushBuffer());
+                break;
+            case Command::COPY:
+            case Command::ADD:
+                argSize_ = 8;
+                break;
+            case Command::INSERT:
+                argSize_ = 4;
+                break;
+            default:
+                return fail(SYSTEM_ERROR_BAD_DATA);
+            }
+            if (state_ != State::DONE) {
+                argOffs_ = 0;
+                state_ = State::ARGUMENTS;
+            }
+            break;
+        }
+        case State::ARGUMENTS: {
+            const size_t n = std::min(argSize_ - argOffs_, size - offs);
+            memcpy(args_ + argOffs_, d + offs, n);
+            argOffs_ += n;
+            offs += n;
+            if (argOffs_ == argSize_) {
+                CHECK(startCommand());
+            }
+            break;
+        }
+        case State::DATA: {
+            const size_t n = std::min(dataLeft_, size - offs);
+            if (cmd_ == Command::ADD) {
+                for (size_t i = 0; i < n; ++i) {
+                    if (bufSize_ == BUFFER_SIZE) {
+                        CHECK(flushBuffer());
+                    }
+                    buf_[bufSize_++] = source_[srcOffs_++] + d[offs + i];
+                }
+                written_ += n;
+            } else {
+                CHECK(output(d + offs, n));
+            }
+            offs += n;
+            dataLeft_ -= n;
+            if (!dataLeft_) {
+                state_ = State::COMMAND;
+            }
+            break;
+        }
+        case State::DONE:
+        default:
+            // Unexpected data after the end of the patch
+            return fail(SYSTEM_ERROR_BAD_DATA);
+        }
+    }
+    return size;
+}
+
+int DeltaPatchStream::flush() {
+    if (error_ < 0) {
+        return error_;
+    }
+    CHECK(flushBuffer());
+    const int ret = dest_->flush();
+    if (ret < 0) {
+        return fail(ret);
+    }
+    return 0;
+}
+
+int DeltaPatchStream::availForWrite() {
+    return (state_ == State::DONE) ? 0 : BUFFER_SIZE;
+}
+
+int DeltaPatchStream::waitEvent(unsigned flags, unsigned timeout) {
+    return 0;
+}
+
+int DeltaPatchStream::startCommand() {
+    state_ = State::COMMAND;
+    switch (cmd_) {
+    case Command::COPY: {
+        const size_t offs = readUint32Le(args_);
+        const size_t size = readUint32Le(args_ + 4);
+        if (!inRange(offs, size, sourceSize_)) {
+            return fail(SYSTEM_ERROR_OUT_OF_RANGE);
+        }
+        CHECK(output(source_ + offs, size));
+        break;
+    }
+    case Command::ADD: {
+        srcOffs_ = readUint32Le(args_);
+        dataLeft_ = readUint32Le(args_ + 4);
+        if (!inRange(srcOffs_, dataLeft_, sourceSize_)) {
+            return fail(SYSTEM_ERROR_OUT_OF_RANGE);
+        }
+        if (dataLeft_) {
+            state_ = State::DATA;
+        }
+        break;
+    }
+    case Command::INSERT: {
+        dataLeft_ = readUint32Le(args_);
+        if (dataLeft_) {
+            state_ = State::DATA;
+        }
+        break;
+    }
+    default:
+        return fail(SYSTEM_ERROR_BAD_DATA);
+    }
+    return 0;
+}
+
+int DeltaPatchStream::output(const uint8_t* data, size_t size) {
+    // Keep the output in order with the data buffered by the ADD command
+    CHECK(flushBuffer());
+    const int ret = dest_->writeAll((const char*)data, size);
+    if (ret < 0) {
+        return fail(ret);
+    }
+    written_ += size;
+    return 0;
+}
+
+int DeltaPatchStream::flushBuffer() {
+    if (bufSize_) {
+        const int ret = dest_->writeAll((const char*)buf_, bufSize_);
+        if (ret < 0) {
+            return fail(ret);
+        }
+        bufSize_ = 0;
+    }
+    return 0;
+}
+
+int DeltaPatchStream::fail(int error) {
+    error_ = error;
+    return error;
+}
+
+} // particle
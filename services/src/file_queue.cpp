@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hal_platform.h"
+
+#if (defined(HAL_PLATFORM_FILESYSTEM) && HAL_PLATFORM_FILESYSTEM == 1)
+
+#include "file_queue.h"
+
+#include "check.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace particle {
+
+namespace fs {
+
+namespace {
+
+const uint32_t CURSOR_MAGICK = 0x51465631; // "QFV1"
+
+const size_t MAX_PATH_SIZE = 64;
+
+const char* const SEGMENT_SUFFIX = ".%u";
+const char* const CURSOR_SUFFIX = ".head";
+
+} // unnamed
+
+FileQueue::FileQueue(const char* path) :
+        fs_(nullptr),
+        path_(path),
+        cur_(),
+        readFile_(),
+        writeFile_(),
+        readFileSize_(0),
+        writeFileSize_(0),
+        readFileOpen_(false),
+        writeFileOpen_(false),
+        writeFileDirty_(false),
+        open_(false) {
+}
+
+FileQueue::~FileQueue() {
+    if (open_) {
+        FsLock lk(fs_);
+        closeReadFile();
+        closeWriteFile();
+    }
+}
+
+int FileQueue::pushBack(const void* item, uint16_t size, bool sync) {
+    const size_t entrySize = size + sizeof(QueueEntry);
+    CHECK_TRUE(entrySize <= 0xffff, SYSTEM_ERROR_TOO_LARGE);
+    FsLock lk(filesystem_get_instance(nullptr));
+    CHECK(open());
+    if (!writeFileOpen_) {
+        CHECK(openWriteFile());
+    }
+    if (writeFileSize_ > 0 && writeFileSize_ + entrySize > SEGMENT_SIZE) {
+        // Start a new segment. The cursor is updated before the segment is created, so that
+        // a segment file never exists beyond the tail segment recorded in the cursor file
+        CHECK(closeWriteFile());
+        ++cur_.tailSegment;
+        CHECK(saveCursor());
+        CHECK(openWriteFile());
+    }
+    const QueueEntry entry = { .size = (uint16_t)entrySize, .flags = QueueEntry::ACTIVE };
+    int r = lfs_file_write(lfs(), &writeFile_, &entry, sizeof(entry));
+    if (r == (int)sizeof(entry) && size > 0) {
+        r = lfs_file_write(lfs(), &writeFile_, item, size) + sizeof(entry);
+    }
+    if (r != (int)entrySize) {
+        LOG(ERROR, "Unable to write to file queue %s: %d", path_, r);
+        // Any incomplete entry will be discarded by the reader
+        closeWriteFile();
+        return SYSTEM_ERROR_FILE;
+    }
+    writeFileSize_ += entrySize;
+    writeFileDirty_ = true;
+    if (sync) {
+        return this->sync();
+    }
+    return 0;
+}
+
+int FileQueue::sync() {
+    FsLock lk(filesystem_get_instance(nullptr));
+    if (!writeFileOpen_ || !writeFileDirty_) {
+        return 0;
+    }
+    const int r = lfs_file_sync(lfs(), &writeFile_);
+    CHECK_TRUE(r == LFS_ERR_OK, SYSTEM_ERROR_FILE);
+    writeFileDirty_ = false;
+    if (readFileOpen_ && cur_.headSegment == cur_.tailSegment) {
+        // A handle opened before the file was modified doesn't see the new data and may refer
+        // to blocks that are no longer used by the file
+        closeReadFile();
+    }
+    return 0;
+}
+
+int FileQueue::front(QueueEntry& entry, void* buffer, uint16_t length) {
+    FsLock lk(filesystem_get_instance(nullptr));
+    CHECK(open());
+    CHECK(findFront(&entry));
+    const size_t size = entry.size - sizeof(QueueEntry);
+    if (size > length) {
+        LOG(ERROR, "Buffer length %d is too small. Need at least %d", (int)length, (int)size);
+        return SYSTEM_ERROR_TOO_LARGE;
+    }
+    const int r = lfs_file_read(lfs(), &readFile_, buffer, size);
+    CHECK_TRUE(r == (int)size, SYSTEM_ERROR_FILE);
+    return 0;
+}
+
+int FileQueue::popFront() {
+    FsLock lk(filesystem_get_instance(nullptr));
+    CHECK(open());
+    QueueEntry entry = {};
+    CHECK(findFront(&entry));
+    cur_.headOffset += entry.size;
+    if (cur_.headSegment == cur_.tailSegment) {
+        const lfs_soff_t size = writeFileOpen_ ? writeFileSize_ : readFileSize_;
+        if (cur_.headOffset >= (uint32_t)size) {
+            LOG(TRACE, "Removed last entry from file queue %s", path_);
+            return clear();
+        }
+    }
+    CHECK(saveCursor());
+    if (cur_.headSegment - cur_.firstSegment > MAX_CONSUMED_SEGMENTS) {
+        CHECK(compact());
+    }
+    return 0;
+}
+
+int FileQueue::compact() {
+    FsLock lk(filesystem_get_instance(nullptr));
+    CHECK(open());
+    if (cur_.firstSegment == cur_.headSegment) {
+        return 0;
+    }
+    // Segments that no longer belong to the queue are ignored by the reader, so they can be
+    // removed before the cursor is updated
+    CHECK(removeSegments(cur_.firstSegment, cur_.headSegment));
+    cur_.firstSegment = cur_.headSegment;
+    CHECK(saveCursor());
+    return 0;
+}
+
+int FileQueue::clear() {
+    FsLock lk(filesystem_get_instance(nullptr));
+    CHECK(open());
+    closeReadFile();
+    closeWriteFile();
+    CHECK(removeSegments(cur_.firstSegment, cur_.tailSegment + 1));
+    // The cursor file is removed last, so that it's still valid if the operation is interrupted
+    char path[MAX_PATH_SIZE] = {};
+    CHECK(cursorPath(path, sizeof(path)));
+    const int r = lfs_remove(lfs(), path);
+    CHECK_TRUE(r == LFS_ERR_OK || r == LFS_ERR_NOENT, SYSTEM_ERROR_FILE);
+    cur_ = { .magick = CURSOR_MAGICK };
+    return 0;
+}
+
+int FileQueue::open() {
+    if (open_) {
+        return 0;
+    }
+    fs_ = filesystem_get_instance(nullptr);
+    CHECK_TRUE(fs_, SYSTEM_ERROR_FILE);
+    CHECK(filesystem_mount(fs_));
+    const int r = loadCursor();
+    if (r < 0) {
+        if (r != SYSTEM_ERROR_NOT_FOUND) {
+            LOG(ERROR, "Invalid cursor file for file queue %s", path_);
+        }
+        cur_ = { .magick = CURSOR_MAGICK };
+        CHECK(migrate());
+    }
+    open_ = true;
+    return 0;
+}
+
+int FileQueue::findFront(QueueEntry* entry) {
+    for (;;) {
+        if (!readFileOpen_) {
+            const int r = openReadFile();
+            if (r == SYSTEM_ERROR_NOT_FOUND && cur_.headSegment != cur_.tailSegment) {
+                ++cur_.headSegment;
+                cur_.headOffset = 0;
+                continue;
+            }
+            CHECK(r);
+        }
+        if (cur_.headOffset + sizeof(QueueEntry) > (uint32_t)readFileSize_) {
+            if (cur_.headSegment != cur_.tailSegment) {
+                closeReadFile();
+                ++cur_.headSegment;
+                cur_.headOffset = 0;
+                continue;
+            }
+            if (writeFileOpen_ && writeFileSize_ > readFileSize_) {
+                // More entries have been added to the segment since it was opened for reading
+                CHECK(sync());
+                closeReadFile();
+                continue;
+            }
+            return SYSTEM_ERROR_NOT_FOUND;
+        }
+        lfs_soff_t pos = lfs_file_seek(lfs(), &readFile_, cur_.headOffset, LFS_SEEK_SET);
+        CHECK_TRUE(pos == (lfs_soff_t)cur_.headOffset, SYSTEM_ERROR_FILE);
+        int r = lfs_file_read(lfs(), &readFile_, entry, sizeof(QueueEntry));
+        CHECK_TRUE(r == (int)sizeof(QueueEntry), SYSTEM_ERROR_FILE);
+        if (entry->size < sizeof(QueueEntry) || cur_.headOffset + entry->size > (uint32_t)readFileSize_) {
+            LOG(ERROR, "Incomplete queue record in file queue %s", path_);
+            if (cur_.headSegment != cur_.tailSegment) {
+                // Skip the rest of the segment
+                cur_.headOffset = readFileSize_;
+                continue;
+            }
+            clear();
+            return SYSTEM_ERROR_NOT_FOUND;
+        }
+        if (entry->flags & QueueEntry::ACTIVE) {
+            return 0;
+        }
+        // Entries removed by an earlier version of this class are marked as inactive
+        cur_.headOffset += entry->size;
+    }
+}
+
+int FileQueue::openReadFile() {
+    char path[MAX_PATH_SIZE] = {};
+    CHECK(segmentPath(path, sizeof(path), cur_.headSegment));
+    const int r = lfs_file_open(lfs(), &readFile_, path, LFS_O_RDONLY);
+    if (r == LFS_ERR_NOENT) {
+        return SYSTEM_ERROR_NOT_FOUND;
+    }
+    CHECK_TRUE(r == LFS_ERR_OK, SYSTEM_ERROR_FILE);
+    readFileSize_ = lfs_file_size(lfs(), &readFile_);
+    if (readFileSize_ < 0) {
+        lfs_file_close(lfs(), &readFile_);
+        return SYSTEM_ERROR_FILE;
+    }
+    readFileOpen_ = true;
+    return 0;
+}
+
+int FileQueue::openWriteFile() {
+    char path[MAX_PATH_SIZE] = {};
+    CHECK(segmentPath(path, sizeof(path), cur_.tailSegment));
+    const int r = lfs_file_open(lfs(), &writeFile_, path, LFS_O_WRONLY | LFS_O_APPEND | LFS_O_CREAT);
+    CHECK_TRUE(r == LFS_ERR_OK, SYSTEM_ERROR_FILE);
+    writeFileSize_ = lfs_file_size(lfs(), &writeFile_);
+    if (writeFileSize_ < 0) {
+        lfs_file_close(lfs(), &writeFile_);
+        return SYSTEM_ERROR_FILE;
+    }
+    writeFileOpen_ = true;
+    writeFileDirty_ = false;
+    return 0;
+}
+
+void FileQueue::closeReadFile() {
+    if (readFileOpen_) {
+        lfs_file_close(lfs(), &readFile_);
+        readFileOpen_ = false;
+    }
+}
+
+int FileQueue::closeWriteFile() {
+    if (!writeFileOpen_) {
+        return 0;
+    }
+    const int r = lfs_file_close(lfs(), &writeFile_);
+    writeFileOpen_ = false;
+    CHECK_TRUE(r == LFS_ERR_OK, SYSTEM_ERROR_FILE);
+    if (writeFileDirty_) {
+        writeFileDirty_ = false;
+        if (cur_.headSegment == cur_.tailSegment) {
+            closeReadFile();
+        }
+    }
+    return 0;
+}
+
+int FileQueue::removeSegments(uint32_t first, uint32_t last) {
+    char path[MAX_PATH_SIZE] = {};
+    for (uint32_t i = first; i != last; ++i) {
+        CHECK(segmentPath(path, sizeof(path), i));
+        const int r = lfs_remove(lfs(), path);
+        CHECK_TRUE(r == LFS_ERR_OK || r == LFS_ERR_NOENT, SYSTEM_ERROR_FILE);
+    }
+    return 0;
+}
+
+int FileQueue::loadCursor() {
+    char path[MAX_PATH_SIZE] = {};
+    CHECK(cursorPath(path, sizeof(path)));
+    lfs_file_t file = {};
+    int r = lfs_file_open(lfs(), &file, path, LFS_O_RDONLY);
+    if (r == LFS_ERR_NOENT) {
+        return SYSTEM_ERROR_NOT_FOUND;
+    }
+    CHECK_TRUE(r == LFS_ERR_OK, SYSTEM_ERROR_FILE);
+    Cursor cur = {};
+    r = lfs_file_read(lfs(), &file, &cur, sizeof(cur));
+    lfs_file_close(lfs(), &file);
+    CHECK_TRUE(r == (int)sizeof(cur), SYSTEM_ERROR_BAD_DATA);
+    CHECK_TRUE(cur.magick == CURSOR_MAGICK, SYSTEM_ERROR_BAD_DATA);
+    CHECK_TRUE(cur.headSegment - cur.firstSegment <= cur.tailSegment - cur.firstSegment, SYSTEM_ERROR_BAD_DATA);
+    cur_ = cur;
+    return 0;
+}
+
+int FileQueue::saveCursor() {
+    char path[MAX_PATH_SIZE] = {};
+    CHECK(cursorPath(path, sizeof(path)));
+    lfs_file_t file = {};
+    // LittleFS doesn't update the file contents on the storage until the file is closed, so
+    // the cursor file is replaced atomically
+    int r = lfs_file_open(lfs(), &file, path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    CHECK_TRUE(r == LFS_ERR_OK, SYSTEM_ERROR_FILE);
+    r = lfs_file_write(lfs(), &file, &cur_, sizeof(cur_));
+    const int r2 = lfs_file_close(lfs(), &file);
+    CHECK_TRUE(r == (int)sizeof(cur_) && r2 == LFS_ERR_OK, SYSTEM_ERROR_FILE);
+    return 0;
+}
+
+int FileQueue::migrate() {
+    lfs_info info = {};
+    if (lfs_stat(lfs(), path_, &info) != LFS_ERR_OK) {
+        return 0;
+    }
+    // Entries that have been removed from the old queue file are marked as inactive and will
+    // be skipped when the queue is read for the first time
+    char path[MAX_PATH_SIZE] = {};
+    CHECK(segmentPath(path, sizeof(path), 0));
+    const int r = lfs_rename(lfs(), path_, path);
+    CHECK_TRUE(r == LFS_ERR_OK, SYSTEM_ERROR_FILE);
+    LOG(INFO, "Converted file queue %s", path_);
+    return saveCursor();
+}
+
+int FileQueue::segmentPath(char* buf, size_t size, uint32_t segment) const {
+    const size_t n = strlen(path_);
+    CHECK_TRUE(n < size, SYSTEM_ERROR_TOO_LARGE);
+    memcpy(buf, path_, n);
+    const int r = snprintf(buf + n, size - n, SEGMENT_SUFFIX, (unsigned)segment);
+    CHECK_TRUE(r > 0 && (size_t)r < size - n, SYSTEM_ERROR_TOO_LARGE);
+    return 0;
+}
+
+int FileQueue::cursorPath(char* buf, size_t size) const {
+    const size_t n = strlen(path_);
+    const size_t n2 = strlen(CURSOR_SUFFIX);
+    CHECK_TRUE(n + n2 < size, SYSTEM_ERROR_TOO_LARGE);
+    memcpy(buf, path_, n);
+    memcpy(buf + n, CURSOR_SUFFIX, n2 + 1);
+    return 0;
+}
+
+} // fs
+
+} // particle
+
+#endif // HAL_PLATFORM_FILESYSTEM
@@ -67,6 +67,7 @@ namespace {
 volatile log_message_callback_type log_msg_callback = 0;
 volatile log_write_callback_type log_write_callback = 0;
 volatile log_enabled_callback_type log_enabled_callback = 0;
+volatile log_message_deferred_callback_type log_msg_deferred_callback = 0;
 
 } // namespace
 
@@ -77,15 +78,25 @@ void log_set_callbacks(log_message_callback_type log_msg, log_write_callback_typ
     log_enabled_callback = log_enabled;
 }
 
+void log_set_deferred_callback(log_message_deferred_callback_type log_msg_deferred, void *reserved) {
+    log_msg_deferred_callback = log_msg_deferred;
+}
+
 void log_message_v(int level, const char *category, LogAttributes *attr, void *reserved, const char *fmt, va_list args) {
+    const log_message_deferred_callback_type msg_deferred_callback = log_msg_deferred_callback;
     const log_message_callback_type msg_callback = log_msg_callback;
-    if (!msg_callback && (!log_compat_callback || level < log_compat_level)) {
+    if (!msg_deferred_callback && !msg_callback && (!log_compat_callback || level < log_compat_level)) {
         return;
     }
     // Set default attributes
     if (!attr->has_time) {
         LOG_ATTR_SET(*attr, time, HAL_Timer_Get_Milli_Seconds());
     }
+    if (msg_deferred_callback) {
+        // The message will be formatted by the callback
+        msg_deferred_callback(fmt, args, level, category, attr, 0);
+        return;
+    }
     char buf[LOG_MAX_STRING_LENGTH];
     if (msg_callback) {
         const int n = vsnprintf(buf, sizeof(buf), fmt, args);
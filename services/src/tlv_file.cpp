@@ -98,6 +98,26 @@ int TlvFile::sync() {
     return SYSTEM_ERROR_INVALID_STATE;
 }
 
+uint16_t TlvFile::currentVersion() const {
+    return TLV_FILE_VERSION;
+}
+
+int TlvFile::fileVersion() {
+    FsLock lk(fs_);
+
+    if (!open_) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+
+    FileFooter footer;
+    int ret = readFooter(footer);
+    if (ret < 0) {
+        return ret;
+    }
+
+    return footer.version;
+}
+
 ssize_t TlvFile::size() {
     FsLock lk(fs_);
 
@@ -119,14 +139,14 @@ ssize_t TlvFile::get(uint16_t key, uint8_t* value, uint16_t length, int index) {
         return SYSTEM_ERROR_INVALID_ARGUMENT;
     }
 
-    uint16_t dataSize;
     ssize_t ret = SYSTEM_ERROR_NOT_FOUND;
-    ssize_t pos = find(key, index, &dataSize);
-    if (pos >= 0) {
+    int i = find(key, index);
+    if (i >= 0) {
         /* Found it */
-        const size_t toRead = std::min(length, dataSize);
+        const IndexEntry& entry = index_[i];
+        const size_t toRead = std::min(length, entry.length);
         if (toRead) {
-            ret = seek(pos + sizeof(TlvHeader));
+            ret = seek(entry.offset + sizeof(TlvHeader));
             if (ret >= 0) {
                 ret = read(value, toRead);
             }
@@ -143,13 +163,22 @@ int TlvFile::set(uint16_t key, const uint8_t* value, uint16_t length, int index)
         return SYSTEM_ERROR_INVALID_STATE;
     }
 
-    /* Delete previous entry */
+    /* Delete previous entry and add the new one as a single change */
+    const bool batch = batch_;
+    batch_ = true;
     int ret = del(key, index);
-    if (!(ret == 0 || ret == SYSTEM_ERROR_NOT_FOUND)) {
+    if (ret == 0 || ret == SYSTEM_ERROR_NOT_FOUND) {
+        ret = add(key, value, length);
+    }
+    batch_ = batch;
+    if (ret < 0) {
+        if (!batch_) {
+            revert();
+        }
         return ret;
     }
 
-    return add(key, value, length);
+    return batch_ ? 0 : commit();
 }
 
 int TlvFile::add(uint16_t key, const uint8_t* value, uint16_t length) {
@@ -159,133 +188,158 @@ int TlvFile::add(uint16_t key, const uint8_t* value, uint16_t length) {
         return SYSTEM_ERROR_INVALID_STATE;
     }
 
-    FileFooter footer;
-    int ret = readFooter(footer);
+    int ret = addEntry(key, value, length);
     if (ret < 0) {
+        if (!batch_) {
+            revert();
+        }
         return ret;
     }
-    ssize_t pos = footer.size;
 
-    if (pos < 0) {
-        return pos;
-    }
+    return batch_ ? 0 : commit();
+}
 
-    ret = seek(pos);
-    if (ret < 0) {
-        return ret;
+int TlvFile::del(uint16_t key, int index) {
+    FsLock lk(fs_);
+
+    if (!open_) {
+        return SYSTEM_ERROR_INVALID_STATE;
     }
 
-    TlvHeader header = {};
-    header.magick = TLV_HEADER_MAGICK;
-    header.key = key;
-    header.length = length;
+    int ret = 0;
+    bool found = false;
 
-    /* Write entry header */
-    ret = write((const uint8_t*)&header, sizeof(header));
-    if (ret < 0) {
-        return ret;
+    for (;;) {
+        const int i = find(key, index);
+        if (i < 0) {
+            if (i != SYSTEM_ERROR_NOT_FOUND || !found) {
+                ret = i;
+            }
+            break;
+        }
+
+        ret = delEntry(i);
+        if (ret < 0) {
+            break;
+        }
+
+        found = true;
+
+        if (index >= 0) {
+            break;
+        }
     }
-    /* Write data */
-    ret = write((const uint8_t*)value, length);
+
     if (ret < 0) {
+        if (!batch_ && dirty_) {
+            revert();
+        }
         return ret;
     }
-    /* Write file footer */
-    footer.magick = TLV_FILE_MAGICK;
-    footer.size += sizeof(header) + length;
-    ret = write((const uint8_t*)&footer, sizeof(footer));
-    if (ret < 0) {
-        return ret;
+
+    return batch_ ? 0 : commit();
+}
+
+int TlvFile::beginChanges() {
+    FsLock lk(fs_);
+
+    if (!open_ || batch_) {
+        return SYSTEM_ERROR_INVALID_STATE;
     }
 
-    return sync();
+    batch_ = true;
+
+    return 0;
 }
 
-int TlvFile::del(uint16_t key, int index) {
+int TlvFile::commitChanges() {
     FsLock lk(fs_);
 
-    if (!open_) {
+    if (!open_ || !batch_) {
         return SYSTEM_ERROR_INVALID_STATE;
     }
 
-    int ret = 0;
+    batch_ = false;
 
-    for (;;) {
-        uint16_t dataSize = 0;
-        ssize_t pos = find(key, index, &dataSize);
-        if (pos < 0) {
-            return pos;
-        }
+    return commit();
+}
 
-        /* FIXME: this will only work on LittleFS. Provide a different implementation later
-         * when filesystem API is finalized and TlvFile implementation is refactored not to use
-         * LittleFS API.
-         */
-        const ssize_t fileSize = size();
+int TlvFile::abandonChanges() {
+    FsLock lk(fs_);
 
-        FileFooter footer;
-        ret = readFooter(footer);
+    if (!open_ || !batch_) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
 
-        while (ret == 0) {
-            lfs_file_t f;
-            ret = lfs_file_open(lfs(), &f, path_, LFS_O_RDONLY);
-            if (ret) {
-                break;
-            }
+    batch_ = false;
 
-            size_t wpos = pos;
-            size_t rpos = wpos + sizeof(TlvHeader) + dataSize;
+    return revert();
+}
 
-            ret = seek(wpos);
-            if (ret < 0) {
-                break;
-            }
+int TlvFile::compact() {
+    FsLock lk(fs_);
 
-            ret = lfs_file_seek(lfs(), &f, rpos, LFS_SEEK_SET);
-            if (ret < 0) {
-                break;
-            }
+    if (!open_ || batch_) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
 
-            for (; rpos < footer.size && ret > 0; ++wpos, ++rpos) {
-                uint8_t tmp;
-                ret = lfs_file_read(lfs(), &f, &tmp, sizeof(tmp));
-                if (ret < 0) {
-                    break;
-                }
+    if (garbageSize_ == 0) {
+        return 0;
+    }
 
-                ret = write(&tmp, sizeof(tmp));
-                if (ret < 0) {
-                    break;
-                }
-            }
+    /* The second handle sees the file as it was before any of the writes below are synced */
+    lfs_file_t f;
+    int ret = lfs_file_open(lfs(), &f, path_, LFS_O_RDONLY);
+    if (ret) {
+        return ret;
+    }
 
-            if (ret > 0) {
-                /* Write footer */
-                footer.size -= sizeof(TlvHeader) + dataSize;
-                ret = write((const uint8_t*)&footer, sizeof(footer));
-                if (ret < 0) {
-                    break;
-                }
-                /* Truncate */
-                ret = lfs_file_truncate(lfs(), &file_, fileSize - (sizeof(TlvHeader) + dataSize));
-                if (ret < 0) {
-                    break;
+    uint32_t wpos = 0;
+    for (int i = 0; i < index_.size() && ret >= 0; ++i) {
+        IndexEntry& entry = index_[i];
+        const size_t entrySize = sizeof(TlvHeader) + entry.length;
+        if (entry.offset != wpos) {
+            ret = lfs_file_seek(lfs(), &f, entry.offset, LFS_SEEK_SET);
+            if (ret >= 0) {
+                ret = seek(wpos);
+            }
+            for (size_t n = 0; n < entrySize && ret >= 0;) {
+                uint8_t buf[32];
+                const size_t chunkSize = std::min(sizeof(buf), entrySize - n);
+                ret = lfs_file_read(lfs(), &f, buf, chunkSize);
+                if (ret == (int)chunkSize) {
+                    ret = write(buf, chunkSize);
+                } else if (ret >= 0) {
+                    ret = SYSTEM_ERROR_BAD_DATA;
                 }
-                ret = sync();
+                n += chunkSize;
             }
-
-            lfs_file_close(lfs(), &f);
-
-            break;
+            entry.offset = wpos;
         }
+        wpos += entrySize;
+    }
 
+    lfs_file_close(lfs(), &f);
 
-        if (ret || index >= 0) {
-            break;
-        }
+    if (ret >= 0) {
+        ret = writeFooter(wpos);
+    }
+    if (ret >= 0) {
+        ret = lfs_file_truncate(lfs(), &file_, wpos + sizeof(FileFooter));
+    }
+    if (ret >= 0) {
+        ret = lfs_file_sync(lfs(), &file_);
+    }
+    if (ret < 0) {
+        revert();
+        return ret;
     }
 
-    return ret;
+    dataSize_ = committedSize_ = wpos;
+    garbageSize_ = 0;
+    dirty_ = false;
+
+    return 0;
 }
 
 lfs_t* TlvFile::lfs() {
@@ -309,12 +363,18 @@ int TlvFile::open() {
     open_ = true;
     FileFooter footer = {};
 
-    if (!validate()) {
+    if (!validate() && !buildIndex()) {
         goto open_done;
     }
 
     footer.magick = TLV_FILE_MAGICK;
     footer.size = 0;
+    footer.version = TLV_FILE_VERSION;
+
+    index_.clear();
+    deleted_.clear();
+    dataSize_ = committedSize_ = garbageSize_ = 0;
+    batch_ = dirty_ = false;
 
     /* Validation failed, create anew */
     r = lfs_file_truncate(lfs(), &file_, 0);
@@ -364,6 +424,8 @@ int TlvFile::close() {
     /* Close */
 
     open_ = false;
+    batch_ = false;
+    dirty_ = false;
 
     return lfs_file_close(lfs(), &file_);
 }
@@ -408,14 +470,10 @@ ssize_t TlvFile::read(uint8_t* buf, size_t length) {
 }
 
 ssize_t TlvFile::write(const uint8_t* buf, size_t length) {
+    /* Failed writes are discarded by revert() */
     ssize_t r = lfs_file_write(lfs(), &file_, buf, length);
-    if (r < 0) {
-        /* Write operation failed. sync() should discard this cached write */
-        if (sync()) {
-            /* If sync fails, try to reopen the file */
-            close();
-            open();
-        }
+    if (r >= 0 && r != (ssize_t)length) {
+        r = SYSTEM_ERROR_FILE;
     }
 
     return r;
@@ -441,16 +499,16 @@ int TlvFile::readFooter(FileFooter& footer) {
     return SYSTEM_ERROR_BAD_DATA;
 }
 
-ssize_t TlvFile::find(uint16_t key, int index, uint16_t* dataSize) {
+int TlvFile::buildIndex() {
     FileFooter footer;
     int r = readFooter(footer);
     if (r) {
         return r;
     }
 
-    ssize_t candidatePos = -1;
-    int candidateIdx = -1;
-    uint16_t candidateSize = 0;
+    index_.clear();
+    deleted_.clear();
+    garbageSize_ = 0;
 
     TlvHeader header;
     for (ssize_t pos = 0; pos >= 0 && (pos + sizeof(TlvHeader)) <= footer.size;) {
@@ -464,32 +522,205 @@ ssize_t TlvFile::find(uint16_t key, int index, uint16_t* dataSize) {
             return SYSTEM_ERROR_BAD_DATA;
         }
 
-        if (header.magick != TLV_HEADER_MAGICK) {
+        if (header.magick == TLV_HEADER_MAGICK && header.key == TLV_DELETED_KEY) {
+            garbageSize_ += sizeof(TlvHeader) + header.length;
+        } else if (header.magick == TLV_HEADER_MAGICK) {
+            IndexEntry entry = {};
+            entry.offset = pos;
+            entry.key = header.key;
+            entry.length = header.length;
+            if (!index_.append(entry)) {
+                return SYSTEM_ERROR_NO_MEMORY;
+            }
+        } else {
             /* Attempt to recover */
             pos += sizeof(uint16_t);
+            garbageSize_ += sizeof(uint16_t);
             continue;
         }
 
-        if (header.key == key) {
-            candidatePos = pos;
+        pos += sizeof(TlvHeader) + header.length;
+    }
+
+    dataSize_ = committedSize_ = footer.size;
+    dirty_ = false;
+
+    return 0;
+}
+
+int TlvFile::find(uint16_t key, int index) const {
+    int candidate = -1;
+    int candidateIdx = -1;
+
+    for (int i = 0; i < index_.size(); ++i) {
+        if (index_[i].key == key) {
+            candidate = i;
             ++candidateIdx;
-            candidateSize = header.length;
             if (index >= 0 && candidateIdx >= index) {
                 break;
             }
         }
-
-        pos += sizeof(TlvHeader) + header.length;
     }
 
     if ((index >= 0 && candidateIdx == index) || (index < 0 && candidateIdx >= 0)) {
-        if (dataSize) {
-            *dataSize = candidateSize;
-        }
-        return candidatePos;
+        return candidate;
     }
 
     return SYSTEM_ERROR_NOT_FOUND;
 }
 
+int TlvFile::addEntry(uint16_t key, const uint8_t* value, uint16_t length) {
+    if (key == TLV_DELETED_KEY) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    IndexEntry entry = {};
+    entry.offset = dataSize_;
+    entry.key = key;
+    entry.length = length;
+    if (!index_.reserve(index_.size() + 1)) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+
+    TlvHeader header = {};
+    header.magick = TLV_HEADER_MAGICK;
+    header.key = key;
+    header.length = length;
+
+    /* Entries are written over the footer, which is rewritten on commit */
+    dirty_ = true;
+    ssize_t ret = seek(dataSize_);
+    if (ret < 0) {
+        return ret;
+    }
+    /* Write entry header */
+    ret = write((const uint8_t*)&header, sizeof(header));
+    if (ret < 0) {
+        return ret;
+    }
+    /* Write data */
+    ret = write(value, length);
+    if (ret < 0) {
+        return ret;
+    }
+
+    dataSize_ += sizeof(header) + length;
+    index_.append(entry);
+
+    return 0;
+}
+
+int TlvFile::delEntry(int i) {
+    const IndexEntry& entry = index_[i];
+    if (!deleted_.reserve(deleted_.size() + 1)) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+
+    /* The entry is invalidated in place rather than recorded separately, so that the file can
+     * still be read by older firmware */
+    TlvHeader header = {};
+    header.magick = TLV_HEADER_MAGICK;
+    header.key = TLV_DELETED_KEY;
+    header.length = entry.length;
+    header.reserved = entry.key;
+
+    dirty_ = true;
+    ssize_t ret = seek(entry.offset);
+    if (ret < 0) {
+        return ret;
+    }
+    ret = write((const uint8_t*)&header, sizeof(header));
+    if (ret < 0) {
+        return ret;
+    }
+
+    garbageSize_ += sizeof(TlvHeader) + entry.length;
+    deleted_.append(entry);
+    index_.removeAt(i);
+
+    return 0;
+}
+
+int TlvFile::commit() {
+    if (!dirty_) {
+        return 0;
+    }
+
+    int ret = writeFooter(dataSize_);
+    if (ret >= 0) {
+        ret = lfs_file_sync(lfs(), &file_);
+    }
+    if (ret < 0) {
+        revert();
+        return ret;
+    }
+
+    committedSize_ = dataSize_;
+    deleted_.clear();
+    dirty_ = false;
+
+    if (garbageSize_ >= MIN_COMPACTION_SIZE && garbageSize_ >= dataSize_ - garbageSize_) {
+        /* Not critical if this fails */
+        compact();
+    }
+
+    return 0;
+}
+
+int TlvFile::revert() {
+    int ret = 0;
+    /* Restore the headers of the committed entries that have been deleted */
+    for (int i = 0; i < deleted_.size() && ret >= 0; ++i) {
+        const IndexEntry& entry = deleted_[i];
+        if (entry.offset >= committedSize_) {
+            continue;
+        }
+        TlvHeader header = {};
+        header.magick = TLV_HEADER_MAGICK;
+        header.key = entry.key;
+        header.length = entry.length;
+        ret = seek(entry.offset);
+        if (ret >= 0) {
+            ret = write((const uint8_t*)&header, sizeof(header));
+        }
+    }
+    deleted_.clear();
+    /* Restore the footer at the end of the committed data and discard everything past it */
+    if (ret >= 0) {
+        ret = writeFooter(committedSize_);
+    }
+    if (ret >= 0) {
+        ret = lfs_file_truncate(lfs(), &file_, committedSize_ + sizeof(FileFooter));
+    }
+    if (ret >= 0) {
+        ret = lfs_file_sync(lfs(), &file_);
+    }
+    if (ret < 0) {
+        /* Reopen just in case */
+        close();
+        return open();
+    }
+
+    return buildIndex();
+}
+
+int TlvFile::writeFooter(uint32_t dataSize) {
+    FileFooter footer = {};
+    footer.magick = TLV_FILE_MAGICK;
+    footer.size = dataSize;
+    footer.version = TLV_FILE_VERSION;
+
+    ssize_t ret = seek(dataSize);
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = write((const uint8_t*)&footer, sizeof(footer));
+    if (ret < 0) {
+        return ret;
+    }
+
+    return 0;
+}
+
 #endif /* HAL_PLATFORM_FILESYSTEM == 1 */
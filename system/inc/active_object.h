@@ -27,6 +27,9 @@
 #include <mutex>
 #include <thread>
 #include <future>
+#include <new>
+#include <utility>
+#include <cstdint>
 
 #include "channel.h"
 #include "concurrent_hal.h"
@@ -71,6 +74,40 @@ public:
 
 };
 
+/**
+ * Size of a block of the task pool. Tasks that are larger than this are allocated on the heap.
+ */
+#ifndef ACTIVE_OBJECT_TASK_BLOCK_SIZE
+#define ACTIVE_OBJECT_TASK_BLOCK_SIZE 48
+#endif
+
+/**
+ * Number of blocks in the task pool (32 maximum). The pool is shared by all active objects.
+ */
+#ifndef ACTIVE_OBJECT_TASK_BLOCK_COUNT
+#define ACTIVE_OBJECT_TASK_BLOCK_COUNT 8
+#endif
+
+/**
+ * Number of semaphores that are kept around for synchronous tasks.
+ */
+#ifndef ACTIVE_OBJECT_SEMAPHORE_CACHE_SIZE
+#define ACTIVE_OBJECT_SEMAPHORE_CACHE_SIZE 4
+#endif
+
+/**
+ * Usage statistics of the task pool.
+ */
+struct ActiveObjectTaskPoolStats
+{
+    uint16_t used; // Number of blocks in use
+    uint16_t peak; // Maximum number of blocks that were in use at the same time
+    uint32_t exhausted; // Number of tasks allocated on the heap because all blocks were in use
+    uint32_t oversized; // Number of tasks allocated on the heap because they didn't fit in a block
+};
+
+class ActiveObjectBase;
+
 /**
  * A message passed to an active object.
  */
@@ -86,17 +123,18 @@ public:
 /**
  * Abstract task. Subclasses must define invoke() and task_complete()
  */
-template <typename T, typename C>
+template <typename F, typename C>
 class AbstractTask : public Message
 {
 protected:
     /**
-     * The function to invoke to retrieve the future result.
+     * The function to invoke to retrieve the future result. The function object is stored
+     * inline, so that the task can be created without additional allocations.
      */
-    std::function<T(void)> work;
+    F work;
 
 public:
-    inline AbstractTask(const std::function<T()>& fn_) : work(std::move(fn_)) {}
+    inline AbstractTask(F&& fn_) : work(std::move(fn_)) {}
 
     void operator()() override {
         C* that = ((C*)this);
@@ -107,20 +145,19 @@ public:
 };
 
 /**
- * An asynchronous task. Disposes itself when complete.
+ * An asynchronous task. Returns itself to the task pool of its active object when complete.
  */
-template <typename T>
-class AsyncTask : public AbstractTask<T, AsyncTask<T>>
+template <typename F>
+class AsyncTask : public AbstractTask<F, AsyncTask<F>>
 {
-    using super = AbstractTask<T,AsyncTask<T>>;
+    using super = AbstractTask<F, AsyncTask<F>>;
+
+    ActiveObjectBase* owner;
 
 public:
-    inline AsyncTask(const std::function<T()>& fn_) :  super(fn_) {}
+    inline AsyncTask(F&& fn_, ActiveObjectBase* owner_) : super(std::move(fn_)), owner(owner_) {}
 
-    inline void task_complete()
-    {
-        delete this;
-    }
+    inline void task_complete();
 
     inline void invoke()
     {
@@ -132,13 +169,14 @@ public:
 /**
  * Promises. these are used for synchronous tasks.
  */
-template<typename T, typename C> class AbstractPromise : public AbstractTask<T,C>
+template<typename F, typename C> class AbstractPromise : public AbstractTask<F,C>
 {
 
     os_semaphore_t complete;
+    bool owns_semaphore;
 
 protected:
-    using task = AbstractTask<T, C>;
+    using task = AbstractTask<F, C>;
 
     void wait_complete()
     {
@@ -147,9 +185,17 @@ protected:
 
 public:
 
-    AbstractPromise(const std::function<T()>& fn_) : task(fn_), complete(nullptr)
+    /**
+     * Constructs a promise. If no semaphore is provided, the promise creates its own semaphore.
+     */
+    AbstractPromise(F&& fn_, os_semaphore_t semaphore=nullptr) : task(std::move(fn_)), complete(semaphore),
+            owns_semaphore(false)
     {
-        os_semaphore_create(&complete, 1, 0);
+        if (!complete)
+        {
+            os_semaphore_create(&complete, 1, 0);
+            owns_semaphore = true;
+        }
     }
 
     virtual ~AbstractPromise()
@@ -159,11 +205,11 @@ public:
 
     inline void dispose()
     {
-        if (complete)
+        if (complete && owns_semaphore)
         {
             os_semaphore_destroy(complete);
-            complete = nullptr;
         }
+        complete = nullptr;
     }
 
     inline void task_complete()
@@ -177,7 +223,7 @@ public:
  * A promise that executes a function and returns the function result as the future
  * value.
  */
-template<typename T> class SystemPromise : public AbstractPromise<T, SystemPromise<T>>
+template<typename T, typename F=std::function<T()>> class SystemPromise : public AbstractPromise<F, SystemPromise<T, F>>
 {
     /**
      * The result retrieved from the function.
@@ -185,7 +231,7 @@ template<typename T> class SystemPromise : public AbstractPromise<T, SystemPromi
      */
     T result;
 
-    using super = AbstractPromise<T, SystemPromise<T>>;
+    using super = AbstractPromise<F, SystemPromise<T, F>>;
     friend typename super::task;
 
     void invoke()
@@ -195,7 +241,7 @@ template<typename T> class SystemPromise : public AbstractPromise<T, SystemPromi
 
 public:
 
-    SystemPromise(const std::function<T()>& fn_) : super(fn_) {}
+    SystemPromise(F&& fn_, os_semaphore_t semaphore=nullptr) : super(std::move(fn_), semaphore), result() {}
     virtual ~SystemPromise() = default;
 
     /**
@@ -211,9 +257,9 @@ public:
 /**
  * Specialization of SystemPromise that waits for execution of a function returning void.
  */
-template<> class SystemPromise<void> : public AbstractPromise<void, SystemPromise<void>>
+template<typename F> class SystemPromise<void, F> : public AbstractPromise<F, SystemPromise<void, F>>
 {
-    using super = AbstractPromise<void, SystemPromise<void>>;
+    using super = AbstractPromise<F, SystemPromise<void, F>>;
     friend typename super::task;
 
     inline void invoke()
@@ -223,7 +269,7 @@ template<> class SystemPromise<void> : public AbstractPromise<void, SystemPromis
 
 public:
 
-    SystemPromise(const std::function<void()>& fn_) : super(fn_) {}
+    SystemPromise(F&& fn_, os_semaphore_t semaphore=nullptr) : super(std::move(fn_), semaphore) {}
     virtual ~SystemPromise() = default;
 
     void get()
@@ -265,6 +311,23 @@ protected:
     virtual bool take(Item& item)=0;
     virtual bool put(Item& item)=0;
 
+    /**
+     * Allocates memory for a task. The memory is taken from a pool of fixed-size blocks, or from
+     * the heap if the task is too large or all blocks are in use.
+     *
+     * These methods are virtual so that the tasks created in the application module are allocated
+     * by the system module.
+     */
+    virtual void* allocate_task(size_t size);
+    virtual void free_task(void* ptr);
+
+    /**
+     * Returns a semaphore for a synchronous task. The semaphores are cached, so that a synchronous
+     * call doesn't need to create a new one.
+     */
+    virtual os_semaphore_t acquire_semaphore();
+    virtual void release_semaphore(os_semaphore_t semaphore);
+
     void set_thread(std::thread&& thread)
     {
         this->_thread.swap(thread);
@@ -279,6 +342,8 @@ protected:
 
     void start_thread();
 
+    template<typename F> friend class AsyncTask;
+
 public:
 
     ActiveObjectBase(const ActiveObjectConfiguration& config) : configuration(config), started(false) {}
@@ -297,20 +362,63 @@ public:
         return started;
     }
 
-    template<typename R> void invoke_async(const std::function<R(void)>& work)
+    /**
+     * Queues a function for asynchronous execution on this active object's thread.
+     *
+     * The function object is stored in the task, which is allocated from the task pool.
+     */
+    template<typename F> void invoke_async(F work)
     {
-        auto task = new AsyncTask<R>(work);
-        if (task)
+        void* mem = allocate_task(sizeof(AsyncTask<F>));
+        if (mem)
         {
-			Item message = task;
-			if (!put(message))
-				delete task;
+            auto task = new(mem) AsyncTask<F>(std::move(work), this);
+            Item message = task;
+            if (!put(message))
+            {
+                task->~AsyncTask<F>();
+                free_task(mem);
+            }
         }
-	}
+    }
 
-    template<typename R> SystemPromise<R>* invoke_future(const std::function<R(void)>& work)
+    /**
+     * Executes a function on this active object's thread and waits for its result.
+     *
+     * The task is allocated on the caller's stack. If the task cannot be queued, a
+     * value-initialized result is returned.
+     */
+    template<typename F> auto invoke_sync(F work) -> decltype(work())
     {
-        auto promise = new SystemPromise<R>(work);
+        using R = decltype(work());
+        struct SemaphoreGuard
+        {
+            ActiveObjectBase* owner;
+            os_semaphore_t semaphore;
+            ~SemaphoreGuard() { if (semaphore) owner->release_semaphore(semaphore); }
+        } guard = { this, acquire_semaphore() };
+        if (!guard.semaphore)
+        {
+            return R();
+        }
+        SystemPromise<R, F> promise(std::move(work), guard.semaphore);
+        Item message = &promise;
+        if (!put(message))
+        {
+            return R();
+        }
+        return promise.get();
+    }
+
+    /**
+     * Queues a function for execution on this active object's thread. The returned promise
+     * is allocated on the heap and must be deleted by the caller.
+     *
+     * Prefer {@code invoke_sync()}, which doesn't allocate.
+     */
+    template<typename F> SystemPromise<decltype(std::declval<F>()()), F>* invoke_future(F work)
+    {
+        auto promise = new SystemPromise<decltype(std::declval<F>()()), F>(std::move(work));
         if (promise)
         {
 			Item message = promise;
@@ -323,8 +431,21 @@ public:
         return promise;
     }
 
+    /**
+     * Retrieves the usage statistics of the task pool.
+     */
+    static void task_pool_stats(ActiveObjectTaskPoolStats* stats);
+
 };
 
+template <typename F>
+inline void AsyncTask<F>::task_complete()
+{
+    ActiveObjectBase* const owner_ = owner;
+    this->~AsyncTask();
+    owner_->free_task(this);
+}
+
 
 template <size_t queue_size=50>
 class ActiveObjectChannel : public ActiveObjectBase
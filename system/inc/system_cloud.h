@@ -182,6 +182,12 @@ typedef struct {
     void* handler_data;
 } spark_send_event_data;
 
+// Additional parameters for spark_subscribe()
+typedef struct {
+    size_t size;
+    uint32_t flags; // EventHandlerFlag. If VIEW is set, the handler is an EventViewHandler
+} spark_subscribe_data;
+
 /**
  * @brief Publish vitals information
  *
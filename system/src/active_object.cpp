@@ -25,9 +25,71 @@
 #if PLATFORM_THREADING
 
 #include <string.h>
+#include <stdlib.h>
+#include <atomic>
 #include "concurrent_hal.h"
 #include "timer_hal.h"
 
+namespace {
+
+const size_t TASK_BLOCK_SIZE = ACTIVE_OBJECT_TASK_BLOCK_SIZE;
+const size_t TASK_BLOCK_COUNT = ACTIVE_OBJECT_TASK_BLOCK_COUNT;
+const size_t SEMAPHORE_CACHE_SIZE = ACTIVE_OBJECT_SEMAPHORE_CACHE_SIZE;
+
+static_assert(TASK_BLOCK_COUNT > 0 && TASK_BLOCK_COUNT <= 32, "Invalid number of task blocks");
+static_assert(SEMAPHORE_CACHE_SIZE <= 32, "Invalid size of the semaphore cache");
+
+union TaskBlock {
+    char data[TASK_BLOCK_SIZE];
+    max_align_t align;
+};
+
+TaskBlock g_taskBlocks[TASK_BLOCK_COUNT];
+// Bit N is set if block N is in use
+std::atomic<uint32_t> g_taskBlockMask(0);
+std::atomic<uint32_t> g_taskBlockPeak(0);
+std::atomic<uint32_t> g_taskPoolExhausted(0);
+std::atomic<uint32_t> g_taskPoolOversized(0);
+
+os_semaphore_t g_semaphores[SEMAPHORE_CACHE_SIZE] = {};
+// Bit N is set if semaphore N is in use
+std::atomic<uint32_t> g_semaphoreMask(0);
+
+inline uint32_t maskForCount(size_t count) {
+    return (count < 32) ? ((1u << count) - 1) : 0xffffffffu;
+}
+
+// Atomically sets a clear bit in the mask and returns its index, or -1 if all bits are set
+int acquireBit(std::atomic<uint32_t>& mask, size_t count, uint32_t* newMask = nullptr) {
+    uint32_t m = mask.load(std::memory_order_relaxed);
+    for (;;) {
+        const uint32_t free = ~m & maskForCount(count);
+        if (!free) {
+            return -1;
+        }
+        const int bit = __builtin_ctz(free);
+        const uint32_t m2 = m | (1u << bit);
+        if (mask.compare_exchange_weak(m, m2, std::memory_order_acquire, std::memory_order_relaxed)) {
+            if (newMask) {
+                *newMask = m2;
+            }
+            return bit;
+        }
+    }
+}
+
+inline void releaseBit(std::atomic<uint32_t>& mask, int bit) {
+    mask.fetch_and(~(1u << bit), std::memory_order_release);
+}
+
+void updatePeak(uint32_t count) {
+    uint32_t peak = g_taskBlockPeak.load(std::memory_order_relaxed);
+    while (count > peak && !g_taskBlockPeak.compare_exchange_weak(peak, count, std::memory_order_relaxed)) {
+    }
+}
+
+} // unnamed
+
 void ActiveObjectBase::start_thread()
 {
     // prevent the started thread from running until the thread id has been assigned
@@ -80,6 +142,82 @@ void ActiveObjectBase::run_active_object(ActiveObjectBase* object)
     object->run();
 }
 
+void* ActiveObjectBase::allocate_task(size_t size)
+{
+    if (size <= TASK_BLOCK_SIZE)
+    {
+        uint32_t mask = 0;
+        const int block = acquireBit(g_taskBlockMask, TASK_BLOCK_COUNT, &mask);
+        if (block >= 0)
+        {
+            updatePeak(__builtin_popcount(mask));
+            return &g_taskBlocks[block];
+        }
+        g_taskPoolExhausted.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        g_taskPoolOversized.fetch_add(1, std::memory_order_relaxed);
+    }
+    return malloc(size);
+}
+
+void ActiveObjectBase::free_task(void* ptr)
+{
+    const auto block = (TaskBlock*)ptr;
+    if (block >= g_taskBlocks && block < g_taskBlocks + TASK_BLOCK_COUNT)
+    {
+        releaseBit(g_taskBlockMask, block - g_taskBlocks);
+    }
+    else
+    {
+        free(ptr);
+    }
+}
+
+os_semaphore_t ActiveObjectBase::acquire_semaphore()
+{
+    os_semaphore_t semaphore = nullptr;
+    const int index = acquireBit(g_semaphoreMask, SEMAPHORE_CACHE_SIZE);
+    if (index >= 0)
+    {
+        // Cached semaphores are created on first use and never destroyed
+        if (!g_semaphores[index] && os_semaphore_create(&g_semaphores[index], 1, 0) != 0)
+        {
+            g_semaphores[index] = nullptr;
+            releaseBit(g_semaphoreMask, index);
+            return nullptr;
+        }
+        semaphore = g_semaphores[index];
+    }
+    else if (os_semaphore_create(&semaphore, 1, 0) != 0)
+    {
+        semaphore = nullptr;
+    }
+    return semaphore;
+}
+
+void ActiveObjectBase::release_semaphore(os_semaphore_t semaphore)
+{
+    for (size_t i = 0; i < SEMAPHORE_CACHE_SIZE; ++i)
+    {
+        if (g_semaphores[i] == semaphore)
+        {
+            releaseBit(g_semaphoreMask, i);
+            return;
+        }
+    }
+    os_semaphore_destroy(semaphore);
+}
+
+void ActiveObjectBase::task_pool_stats(ActiveObjectTaskPoolStats* stats)
+{
+    stats->used = __builtin_popcount(g_taskBlockMask.load(std::memory_order_relaxed));
+    stats->peak = g_taskBlockPeak.load(std::memory_order_relaxed);
+    stats->exhausted = g_taskPoolExhausted.load(std::memory_order_relaxed);
+    stats->oversized = g_taskPoolOversized.load(std::memory_order_relaxed);
+}
+
 #endif // PLATFORM_THREADING
 
 void ISRTaskQueue::enqueue(Task* task) {
@@ -108,7 +108,13 @@ bool spark_subscribe(const char *eventName, EventHandler handler, void* handler_
 {
     SYSTEM_THREAD_CONTEXT_SYNC(spark_subscribe(eventName, handler, handler_data, scope, deviceID, reserved));
     auto event_scope = convert(scope);
-    bool success = spark_protocol_add_event_handler(sp, eventName, handler, event_scope, deviceID, handler_data);
+    bool success = false;
+    const auto d = static_cast<const spark_subscribe_data*>(reserved);
+    if (d && d->size >= sizeof(spark_subscribe_data) && (d->flags & EventHandlerFlag::VIEW)) {
+        success = spark_protocol_add_event_view_handler(sp, eventName, (EventViewHandler)handler, event_scope, deviceID, handler_data);
+    } else {
+        success = spark_protocol_add_event_handler(sp, eventName, handler, event_scope, deviceID, handler_data);
+    }
     if (success && spark_cloud_flag_connected())
     {
         register_event(eventName, event_scope, deviceID);
@@ -30,6 +30,9 @@ namespace {
 
 uint16_t cloud_udp_port = PORT_COAPS; // default Particle Cloud UDP port
 
+// Maximum number of buffers that can be sent as a single datagram
+const size_t CLOUD_SEND_MAX_IO_VECTORS = 4;
+
 } /* anonymous */
 
 /* FIXME: */
@@ -213,6 +216,32 @@ int Spark_Send_UDP(const unsigned char* buf, uint32_t buflen, void* reserved)
     return system_cloud_send(buf, buflen, 0);
 }
 
+#if HAL_USE_SOCKET_HAL_POSIX
+
+int Spark_Send_UDP_Vector(const SparkIoVector* vec, size_t count, void* reserved)
+{
+    if (SPARK_WLAN_RESET || SPARK_WLAN_SLEEP || spark_cloud_socket_closed() || cloud_socket_aborted)
+    {
+        LOG(TRACE, "SPARK_WLAN_RESET || SPARK_WLAN_SLEEP || spark_cloud_socket_closed() || cloud_socket_aborted");
+        //break from any blocking loop
+        return -1;
+    }
+
+    iovec iov[CLOUD_SEND_MAX_IO_VECTORS];
+    if (count > sizeof(iov) / sizeof(iov[0]))
+    {
+        return SYSTEM_ERROR_TOO_LARGE;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        iov[i].iov_base = const_cast<void*>(vec[i].data);
+        iov[i].iov_len = vec[i].size;
+    }
+    return system_cloud_send_vector(iov, count, 0);
+}
+
+#endif /* HAL_USE_SOCKET_HAL_POSIX */
+
 int Spark_Receive_UDP(unsigned char *buf, uint32_t buflen, void* reserved)
 {
     if (SPARK_WLAN_RESET || SPARK_WLAN_SLEEP || spark_cloud_socket_closed() || cloud_socket_aborted)
@@ -23,6 +23,7 @@
 #include "hal_platform.h"
 #include "ota_flash_hal.h"
 #include "socket_hal.h"
+#include "spark_protocol_functions.h"
 #include <type_traits>
 
 #ifdef __cplusplus
@@ -36,6 +37,9 @@ typedef enum {
 int system_cloud_connect(int protocol, const ServerAddress* address, sockaddr* saddrCache);
 int system_cloud_disconnect(int flags);
 int system_cloud_send(const uint8_t* buf, size_t buflen, int flags);
+#if HAL_USE_SOCKET_HAL_POSIX
+int system_cloud_send_vector(const struct iovec* iov, size_t iovcnt, int flags);
+#endif /* HAL_USE_SOCKET_HAL_POSIX */
 int system_cloud_recv(uint8_t* buf, size_t buflen, int flags);
 int system_cloud_is_connected(void* reserved);
 int system_internet_test(void* reserved);
@@ -61,6 +65,9 @@ int Spark_Receive(unsigned char *buf, uint32_t buflen, void* reserved);
 #if HAL_PLATFORM_CLOUD_UDP
 int Spark_Send_UDP(const unsigned char* buf, uint32_t buflen, void* reserved);
 int Spark_Receive_UDP(unsigned char *buf, uint32_t buflen, void* reserved);
+#if HAL_USE_SOCKET_HAL_POSIX
+int Spark_Send_UDP_Vector(const SparkIoVector* vec, size_t count, void* reserved);
+#endif /* HAL_USE_SOCKET_HAL_POSIX */
 #endif /* HAL_PLATFORM_CLOUD_UDP */
 
 /**
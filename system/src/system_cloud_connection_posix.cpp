@@ -297,6 +297,15 @@ int system_cloud_send(const uint8_t* buf, size_t buflen, int flags)
     return sock_send(s_state.socket, buf, buflen, 0);
 }
 
+int system_cloud_send_vector(const struct iovec* iov, size_t iovcnt, int flags)
+{
+    (void)flags;
+    struct msghdr msg = {};
+    msg.msg_iov = const_cast<struct iovec*>(iov);
+    msg.msg_iovlen = iovcnt;
+    return sock_sendmsg(s_state.socket, &msg, 0);
+}
+
 int system_cloud_recv(uint8_t* buf, size_t buflen, int flags)
 {
     (void)flags;
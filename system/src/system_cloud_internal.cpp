@@ -51,6 +51,8 @@
 #include "str_util.h"
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <algorithm>
 
 using particle::CloudDiagnostics;
 
@@ -272,21 +274,21 @@ bool spark_function_internal(const cloud_function_descriptor* desc, void* reserv
 }
 
 
-void invokeEventHandlerInternal(uint16_t handlerInfoSize, FilteringEventHandler* handlerInfo,
+void invokeEventHandlerInternal(uint16_t handlerInfoSize, const FilteringEventHandler& handlerInfo,
                 const char* event_name, const char* data, void* reserved)
 {
-    if(handlerInfo->handler_data)
+    if(handlerInfo.handler_data)
     {
-        EventHandlerWithData handler = (EventHandlerWithData) handlerInfo->handler;
-        handler(handlerInfo->handler_data, event_name, data);
+        EventHandlerWithData handler = (EventHandlerWithData) handlerInfo.handler;
+        handler(handlerInfo.handler_data, event_name, data);
     }
     else
     {
-        handlerInfo->handler(event_name, data);
+        handlerInfo.handler(event_name, data);
     }
 }
 
-void invokeEventHandlerString(uint16_t handlerInfoSize, FilteringEventHandler* handlerInfo,
+void invokeEventHandlerString(uint16_t handlerInfoSize, const FilteringEventHandler& handlerInfo,
                 const String& name, const String& data, void* reserved)
 {
     invokeEventHandlerInternal(handlerInfoSize, handlerInfo, name.c_str(), data.c_str(), reserved);
@@ -299,19 +301,69 @@ bool is_system_handler(uint16_t handlerInfoSize, FilteringEventHandler* handlerI
     return handlerInfo->handler==SystemEvents;
 }
 
+void invokeEventViewHandler(const FilteringEventHandler& handlerInfo, EventView* view)
+{
+    EventViewHandler handler = (EventViewHandler) handlerInfo.handler;
+    handler(handlerInfo.handler_data, view);
+}
+
+void invokeRetainedEventViewHandler(const FilteringEventHandler& handlerInfo, EventView* view)
+{
+    invokeEventViewHandler(handlerInfo, view);
+    event_view_release(view);
+}
+
+void invokeRetainedEventViewHandlerAsync(const FilteringEventHandler& handlerInfo, EventView* view)
+{
+    APPLICATION_THREAD_CONTEXT_ASYNC(invokeRetainedEventViewHandler(handlerInfo, view));
+    invokeRetainedEventViewHandler(handlerInfo, view);
+}
+
+bool is_event_view_handler(FilteringEventHandler* handlerInfo, void* reserved)
+{
+    // The flags field occupies what used to be padding, so the size of the handler info can't
+    // tell whether it's set. Callers that predate the view handlers always pass NULL as the
+    // reserved argument, while the view of the event is passed for a view handler
+    return reserved && (handlerInfo->flags & EventHandlerFlag::VIEW);
+}
+
 void invokeEventHandler(uint16_t handlerInfoSize, FilteringEventHandler* handlerInfo,
                 const char* event_name, const char* event_data, void* reserved)
 {
-    if (is_system_handler(handlerInfoSize, handlerInfo) || system_thread_get_state(NULL)==spark::feature::DISABLED)
+    // The handler info is only valid for the duration of this call, the asynchronous
+    // calls below capture a copy of it
+    FilteringEventHandler handler = {};
+    memcpy(&handler, handlerInfo, std::min<size_t>(handlerInfoSize, sizeof(handler)));
+    if (is_event_view_handler(handlerInfo, reserved))
     {
-        invokeEventHandlerInternal(handlerInfoSize, handlerInfo, event_name, event_data, reserved);
+        const auto view = static_cast<EventView*>(reserved);
+        if (system_thread_get_state(NULL)==spark::feature::DISABLED)
+        {
+            invokeEventViewHandler(handler, view);
+        }
+        else
+        {
+            // Keep a reference to the event instead of copying the name and data. The event
+            // buffer is shared by all the handlers of the event
+            const auto retained = event_view_retain(view);
+            if (!retained)
+            {
+                LOG(ERROR, "Unable to dispatch event");
+                return;
+            }
+            invokeRetainedEventViewHandlerAsync(handler, retained);
+        }
+    }
+    else if (is_system_handler(handlerInfoSize, handlerInfo) || system_thread_get_state(NULL)==spark::feature::DISABLED)
+    {
+        invokeEventHandlerInternal(handlerInfoSize, handler, event_name, event_data, reserved);
     }
     else
     {
         // copy the buffers to dynamically allocated storage.
         String name(event_name);
         String data(event_data);
-        APPLICATION_THREAD_CONTEXT_ASYNC(invokeEventHandlerString(handlerInfoSize, handlerInfo, name, data, reserved));
+        APPLICATION_THREAD_CONTEXT_ASYNC(invokeEventHandlerString(handlerInfoSize, handler, name, data, reserved));
     }
 }
 
@@ -801,6 +853,9 @@ void Spark_Protocol_Init(void)
             callbacks.transport_context = &g_system_cloud_session_data;
             callbacks.save = Spark_Save;
             callbacks.restore = Spark_Restore;
+#if HAL_USE_SOCKET_HAL_POSIX
+            callbacks.send_vector = Spark_Send_UDP_Vector;
+#endif
         }
         else
 #endif
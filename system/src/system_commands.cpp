@@ -134,6 +134,8 @@ void fetchAndExecuteCommand(system_tick_t currentTime) {
     if (spark_cloud_flag_connected() && !persistCommands.front(entry, &g_cmd, sizeof(g_cmd)) && !g_cmd.execute()) {
         g_cmdPending = true;
     } else {
+        // Remove the consumed parts of the queue while there's nothing else to do
+        persistCommands.compact();
         nextCommandTime = currentTime + DELAY_BETWEEN_COMMAND_CHECKS;
     }
 }
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hal_platform.h"
+
+#if HAL_PLATFORM_LWIP
+
+#include "netstatapi.h"
+#include "check.h"
+#include "spark_wiring_diagnostics.h"
+
+namespace
+{
+
+using namespace particle;
+
+// Exposes one of the network stack counters. These are meant for sizing the lwIP memory
+// profiles (see lwipopts.h) from field data
+class NetstatDiagnosticData : public AbstractIntegerDiagnosticData
+{
+public:
+    NetstatDiagnosticData(uint16_t id, const char* name, uint32_t netstat_info::*field)
+        : AbstractIntegerDiagnosticData(id, name),
+          field_(field)
+    {
+    }
+
+    virtual int get(IntType& val)
+    {
+        netstat_info info = {};
+        info.size = sizeof(info);
+        CHECK(netstat_get_info(&info, nullptr));
+        val = static_cast<IntType>(info.*field_);
+        return SYSTEM_ERROR_NONE;
+    }
+
+private:
+    uint32_t netstat_info::*field_;
+};
+
+NetstatDiagnosticData g_pbufPoolUsedDiagData(DIAG_ID_NETWORK_PBUF_POOL_USED,
+        DIAG_NAME_NETWORK_PBUF_POOL_USED, &netstat_info::pbuf_pool_used);
+NetstatDiagnosticData g_pbufPoolMaxDiagData(DIAG_ID_NETWORK_PBUF_POOL_MAX,
+        DIAG_NAME_NETWORK_PBUF_POOL_MAX, &netstat_info::pbuf_pool_max);
+NetstatDiagnosticData g_pbufPoolErrorsDiagData(DIAG_ID_NETWORK_PBUF_POOL_ERRORS,
+        DIAG_NAME_NETWORK_PBUF_POOL_ERRORS, &netstat_info::pbuf_pool_errors);
+NetstatDiagnosticData g_heapMaxDiagData(DIAG_ID_NETWORK_HEAP_MAX,
+        DIAG_NAME_NETWORK_HEAP_MAX, &netstat_info::heap_max);
+NetstatDiagnosticData g_tcpRetransmitsDiagData(DIAG_ID_NETWORK_TCP_RETRANSMITS,
+        DIAG_NAME_NETWORK_TCP_RETRANSMITS, &netstat_info::tcp_retransmits);
+
+} // namespace
+
+#endif // HAL_PLATFORM_LWIP
@@ -35,6 +35,7 @@
 #include "wlan_hal.h"
 #include "delay_hal.h"
 #include "timer_hal.h"
+#include "eeprom_hal.h"
 #include "rgbled.h"
 #include "service_debug.h"
 #include "cellular_hal.h"
@@ -464,6 +465,7 @@ void Spark_Idle_Events(bool force_events/*=false*/)
 // FIXME: there should be a separate feature macro
 #if HAL_PLATFORM_FILESYSTEM
         particle::system::fetchAndExecuteCommand(millis());
+        hal_eeprom_flush(HAL_EEPROM_FLUSH_IF_DUE, nullptr);
 #endif // HAL_PLATFORM_FILESYSTEM
     }
     else
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include "at_parser.h"
+#include "at_response.h"
+#include "stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace particle::bench;
+using namespace particle;
+
+namespace {
+
+// Stream that replays the same input data every time it's rewound
+class ReplayStream: public Stream {
+public:
+    explicit ReplayStream(const char* data) :
+            data_(data),
+            size_(strlen(data)),
+            pos_(0) {
+    }
+
+    void rewind() {
+        pos_ = 0;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    int read(char* data, size_t size) override {
+        const size_t n = std::min(size, size_ - pos_);
+        memcpy(data, data_ + pos_, n);
+        pos_ += n;
+        return n;
+    }
+
+    int peek(char* data, size_t size) override {
+        const size_t n = std::min(size, size_ - pos_);
+        memcpy(data, data_ + pos_, n);
+        return n;
+    }
+
+    int skip(size_t size) override {
+        const size_t n = std::min(size, size_ - pos_);
+        pos_ += n;
+        return n;
+    }
+
+    int availForRead() override {
+        return size_ - pos_;
+    }
+
+    int write(const char* data, size_t size) override {
+        return size;
+    }
+
+    int flush() override {
+        return 0;
+    }
+
+    int availForWrite() override {
+        return 1024;
+    }
+
+    int waitEvent(unsigned flags, unsigned timeout) override {
+        if ((flags & READABLE) && pos_ >= size_) {
+            return SYSTEM_ERROR_TIMEOUT;
+        }
+        return flags;
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t pos_;
+};
+
+// Response to AT+COPS=?
+const char MULTILINE_RESPONSE[] =
+        "\r\n+COPS: (2,\"AT&T\",\"AT&T\",\"310410\",7),(1,\"T-Mobile\",\"T-Mobile\",\"310260\",7),,(0,1,2,3,4),(0,2)\r\n"
+        "+UCGED: 2\r\n"
+        "6,4,310,410,5110,4,1,29,-67,-10\r\n"
+        "+CESQ: 99,99,255,255,20,45\r\n"
+        "+CGDCONT: 1,\"IP\",\"broadband\",\"10.170.27.159\",0,0,0,0\r\n"
+        "\r\nOK\r\n";
+
+const char URC_DATA[] =
+        "\r\n+CEREG: 5,\"2C07\",\"0A1B2C3D\",7\r\n"
+        "\r\n+UUSORD: 0,512\r\n"
+        "\r\n+CIEV: 2,3\r\n"
+        "\r\n+UUSOCL: 1\r\n";
+
+int urcHandler(AtResponseReader* reader, const char* prefix, void* data) {
+    char buf[64];
+    const int n = reader->readLine(buf, sizeof(buf));
+    if (n >= 0) {
+        ++*(unsigned*)data;
+    }
+    return 0;
+}
+
+} // unnamed
+
+BENCHMARK(at_parser, read_response_lines) {
+    ReplayStream strm(MULTILINE_RESPONSE);
+    AtParser parser;
+    if (parser.init(AtParserConfig().stream(&strm).commandTimeout(1000).streamTimeout(100).echoEnabled(false)
+            .logEnabled(false)) != 0) {
+        state.fail("Unable to initialize parser");
+        return;
+    }
+    char buf[128];
+    while (state.keepRunning()) {
+        strm.rewind();
+        auto resp = parser.sendCommand("AT+COPS=?");
+        unsigned lines = 0;
+        while (resp.hasNextLine()) {
+            if (resp.readLine(buf, sizeof(buf)) >= 0) {
+                ++lines;
+            }
+        }
+        if (resp.readResult() != AtResponse::OK || lines != 5) {
+            state.fail("Unexpected response");
+        }
+    }
+    state.setBytesPerOp(strm.size());
+}
+
+BENCHMARK(at_parser, process_urcs) {
+    ReplayStream strm(URC_DATA);
+    AtParser parser;
+    if (parser.init(AtParserConfig().stream(&strm).streamTimeout(100).logEnabled(false)) != 0) {
+        state.fail("Unable to initialize parser");
+        return;
+    }
+    unsigned count = 0;
+    parser.addUrcHandler("+CEREG", urcHandler, &count);
+    parser.addUrcHandler("+UUSORD", urcHandler, &count);
+    parser.addUrcHandler("+CIEV", urcHandler, &count);
+    parser.addUrcHandler("+UUSOCL", urcHandler, &count);
+    while (state.keepRunning()) {
+        strm.rewind();
+        count = 0;
+        while (strm.availForRead() > 0) {
+            if (parser.processUrc(0) < 0) {
+                state.fail("Unable to process URC");
+                break;
+            }
+        }
+        if (count != 4) {
+            state.fail("Unexpected number of URCs");
+        }
+    }
+    state.setBytesPerOp(strm.size());
+}
@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+using namespace particle::bench;
+
+struct Benchmark {
+    std::string name;
+    BenchmarkFunc func;
+};
+
+struct Result {
+    double nsPerOp;
+    double minNsPerOp;
+    double allocsPerOp;
+    double allocBytesPerOp;
+    size_t bytesPerOp;
+    uint64_t iterations;
+    const char* error;
+};
+
+struct Options {
+    const char* filter = nullptr;
+    unsigned minTimeMs = 200;
+    unsigned repetitions = 5;
+    bool csv = false;
+    bool list = false;
+};
+
+const uint64_t MAX_ITERATIONS = 1000000000;
+
+// Allocation counters
+uint64_t g_allocCount = 0;
+uint64_t g_allocBytes = 0;
+
+inline void countAlloc(size_t size) {
+    ++g_allocCount;
+    g_allocBytes += size;
+}
+
+std::vector<Benchmark>& benchmarks() {
+    static std::vector<Benchmark> b;
+    return b;
+}
+
+State runOnce(const Benchmark& b, uint64_t iterations) {
+    State state(iterations);
+    b.func(state);
+    return state;
+}
+
+Result run(const Benchmark& b, const Options& opts) {
+    Result r = {};
+    // Find the number of iterations that takes at least the minimum time
+    const double minTimeNs = opts.minTimeMs * 1e6;
+    uint64_t iterations = 1;
+    for (;;) {
+        const State s = runOnce(b, iterations);
+        if (s.error()) {
+            r.error = s.error();
+            return r;
+        }
+        const double elapsed = s.elapsedNanos();
+        if (elapsed >= minTimeNs || iterations >= MAX_ITERATIONS) {
+            break;
+        }
+        double mult = 10;
+        if (elapsed > minTimeNs / 10) {
+            mult = minTimeNs * 1.4 / elapsed;
+        }
+        iterations = std::min<uint64_t>(std::max<uint64_t>(iterations * mult, iterations + 1), MAX_ITERATIONS);
+    }
+    // Run the benchmark the requested number of times and report the median
+    std::vector<double> nsPerOp;
+    for (unsigned i = 0; i < std::max(opts.repetitions, 1u); ++i) {
+        const State s = runOnce(b, iterations);
+        if (s.error()) {
+            r.error = s.error();
+            return r;
+        }
+        nsPerOp.push_back((double)s.elapsedNanos() / iterations);
+        r.allocsPerOp = (double)s.allocStats().count / iterations;
+        r.allocBytesPerOp = (double)s.allocStats().bytes / iterations;
+        r.bytesPerOp = s.bytesPerOp();
+    }
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+    r.nsPerOp = nsPerOp[nsPerOp.size() / 2];
+    r.minNsPerOp = nsPerOp.front();
+    r.iterations = iterations;
+    return r;
+}
+
+void printUsage(const char* name) {
+    printf("Usage: %s [options] [filter]\n\n"
+            "Runs the benchmarks whose names contain the filter string.\n\n"
+            "Options:\n"
+            "  --min-time=<ms>     Minimum duration of a single run (default: 200)\n"
+            "  --repetitions=<n>   Number of runs; the median is reported (default: 5)\n"
+            "  --csv               Print the results in CSV format\n"
+            "  --list              List the benchmarks and exit\n", name);
+}
+
+bool parseUint(const char* arg, const char* prefix, unsigned* val) {
+    const size_t n = strlen(prefix);
+    if (strncmp(arg, prefix, n) != 0) {
+        return false;
+    }
+    *val = strtoul(arg + n, nullptr, 10);
+    return true;
+}
+
+} // unnamed
+
+namespace particle {
+
+namespace bench {
+
+AllocStats allocStats() {
+    return { g_allocCount, g_allocBytes };
+}
+
+State::State(uint64_t iterations) :
+        elapsed_(0),
+        startAllocs_(),
+        allocs_(),
+        iterations_(iterations),
+        count_(0),
+        bytesPerOp_(0),
+        error_(nullptr),
+        running_(false) {
+}
+
+void State::start() {
+    resume();
+}
+
+void State::stop() {
+    pause();
+}
+
+void State::pause() {
+    if (running_) {
+        elapsed_ += Clock::now() - startTime_;
+        const AllocStats a = bench::allocStats();
+        allocs_.count += a.count - startAllocs_.count;
+        allocs_.bytes += a.bytes - startAllocs_.bytes;
+        running_ = false;
+    }
+}
+
+void State::resume() {
+    if (!running_) {
+        startAllocs_ = bench::allocStats();
+        running_ = true;
+        startTime_ = Clock::now();
+    }
+}
+
+void State::fail(const char* msg) {
+    if (!error_) {
+        error_ = msg;
+    }
+    // Stop the benchmark loop
+    count_ = iterations_;
+}
+
+Registrar::Registrar(const char* group, const char* name, BenchmarkFunc func) {
+    benchmarks().push_back({ std::string(group) + "/" + name, func });
+}
+
+} // particle::bench
+
+} // particle
+
+#if defined(__GLIBC__)
+
+// Count all heap allocations, including the ones made by the C code
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+    countAlloc(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    countAlloc(n * size);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    countAlloc(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+} // extern "C"
+
+#else
+
+void* operator new(size_t size) {
+    countAlloc(size);
+    void* p = malloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    countAlloc(size);
+    return malloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+#endif // !defined(__GLIBC__)
+
+int main(int argc, char** argv) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (parseUint(arg, "--min-time=", &opts.minTimeMs) || parseUint(arg, "--repetitions=", &opts.repetitions)) {
+            continue;
+        }
+        if (strcmp(arg, "--csv") == 0) {
+            opts.csv = true;
+        } else if (strcmp(arg, "--list") == 0) {
+            opts.list = true;
+        } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg[0] == '-' || opts.filter) {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            opts.filter = arg;
+        }
+    }
+    auto& b = benchmarks();
+    std::sort(b.begin(), b.end(), [](const Benchmark& b1, const Benchmark& b2) {
+        return b1.name < b2.name;
+    });
+    if (opts.csv) {
+        printf("name,iterations,ns_per_op,min_ns_per_op,allocs_per_op,alloc_bytes_per_op,bytes_per_op\n");
+    } else if (!opts.list) {
+        printf("%-40s %12s %12s %12s %10s %12s %10s\n", "Benchmark", "Iterations", "ns/op", "min ns/op",
+                "allocs/op", "alloc B/op", "bytes/op");
+    }
+    int failed = 0;
+    for (const auto& bench: b) {
+        if (opts.filter && bench.name.find(opts.filter) == std::string::npos) {
+            continue;
+        }
+        if (opts.list) {
+            printf("%s\n", bench.name.c_str());
+            continue;
+        }
+        const Result r = run(bench, opts);
+        if (r.error) {
+            fprintf(stderr, "%s: %s\n", bench.name.c_str(), r.error);
+            ++failed;
+            continue;
+        }
+        if (opts.csv) {
+            printf("%s,%llu,%.2f,%.2f,%.2f,%.2f,%u\n", bench.name.c_str(), (unsigned long long)r.iterations,
+                    r.nsPerOp, r.minNsPerOp, r.allocsPerOp, r.allocBytesPerOp, (unsigned)r.bytesPerOp);
+        } else {
+            printf("%-40s %12llu %12.1f %12.1f %10.2f %12.1f %10u\n", bench.name.c_str(),
+                    (unsigned long long)r.iterations, r.nsPerOp, r.minNsPerOp, r.allocsPerOp, r.allocBytesPerOp,
+                    (unsigned)r.bytesPerOp);
+        }
+        fflush(stdout);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace particle {
+
+namespace bench {
+
+class State;
+
+typedef void(*BenchmarkFunc)(State& state);
+
+/**
+ * Allocation counters.
+ *
+ * The counters are updated by the global allocation functions defined in bench.cpp.
+ */
+struct AllocStats {
+    uint64_t count;
+    uint64_t bytes;
+};
+
+AllocStats allocStats();
+
+/**
+ * Benchmark state.
+ *
+ * A benchmark function performs its setup, then runs the measured operation in a loop for as
+ * long as `keepRunning()` returns `true`:
+ *
+ * ```
+ * BENCHMARK(ringbuffer, put_get) {
+ *     // Setup
+ *     while (state.keepRunning()) {
+ *         // Measured operation
+ *     }
+ * }
+ * ```
+ *
+ * The time and allocations are only counted between the first and the last call to
+ * `keepRunning()`, and outside of the sections enclosed in `pause()` and `resume()`.
+ */
+class State {
+public:
+    explicit State(uint64_t iterations);
+
+    bool keepRunning() {
+        if (count_ < iterations_) {
+            if (count_++ == 0) {
+                start();
+            }
+            return true;
+        }
+        stop();
+        return false;
+    }
+
+    void pause();
+    void resume();
+
+    /**
+     * Sets the number of bytes copied (or encoded, parsed, etc.) by a single operation.
+     */
+    void setBytesPerOp(size_t bytes) {
+        bytesPerOp_ = bytes;
+    }
+
+    /**
+     * Marks the benchmark as failed.
+     */
+    void fail(const char* msg);
+
+    uint64_t iterations() const {
+        return iterations_;
+    }
+
+    uint64_t elapsedNanos() const {
+        return elapsed_.count();
+    }
+
+    const AllocStats& allocStats() const {
+        return allocs_;
+    }
+
+    size_t bytesPerOp() const {
+        return bytesPerOp_;
+    }
+
+    const char* error() const {
+        return error_;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point startTime_;
+    std::chrono::nanoseconds elapsed_;
+    AllocStats startAllocs_;
+    AllocStats allocs_;
+    uint64_t iterations_;
+    uint64_t count_;
+    size_t bytesPerOp_;
+    const char* error_;
+    bool running_;
+
+    void start();
+    void stop();
+};
+
+/**
+ * Registers a benchmark function. Use the `BENCHMARK()` macro instead of this class.
+ */
+class Registrar {
+public:
+    Registrar(const char* group, const char* name, BenchmarkFunc func);
+};
+
+/**
+ * Prevents the compiler from optimizing away the computation of the given value.
+ */
+template<typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * Prevents the compiler from optimizing away or reordering memory writes.
+ */
+inline void clobberMemory() {
+    asm volatile("" : : : "memory");
+}
+
+} // particle::bench
+
+} // particle
+
+#define BENCHMARK(_group, _name) \
+        static void bench_##_group##_##_name(::particle::bench::State& state); \
+        static const ::particle::bench::Registrar bench_##_group##_##_name##_registrar(#_group, #_name, \
+                bench_##_group##_##_name); \
+        static void bench_##_group##_##_name(::particle::bench::State& state)
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include "subscriptions.h"
+#include "messages.h"
+#include "coap.h"
+
+#include <cstring>
+
+using namespace particle::bench;
+using namespace particle::protocol;
+
+namespace {
+
+const char SHORT_EVENT_NAME[] = "temp";
+const char LONG_EVENT_NAME[] = "sensors/outdoor/north/temperature";
+const char EVENT_DATA[] = "{\"t\":21.5,\"h\":48,\"p\":1013.2,\"ts\":1565000000}";
+
+// Message channel that doesn't send anything
+class NullMessageChannel: public MessageChannel {
+public:
+    ProtocolError receive(Message& message) override {
+        return NO_ERROR;
+    }
+
+    ProtocolError send(Message& msg) override {
+        return NO_ERROR;
+    }
+
+    ProtocolError command(Command cmd, void* arg) override {
+        return NO_ERROR;
+    }
+
+    bool is_unreliable() override {
+        return false;
+    }
+
+    ProtocolError establish(uint32_t& flags, uint32_t app_state_crc) override {
+        return NO_ERROR;
+    }
+
+    ProtocolError create(Message& message, size_t minimum_size) override {
+        return NO_ERROR;
+    }
+
+    ProtocolError response(Message& original, Message& response, size_t required) override {
+        return NO_ERROR;
+    }
+
+    ProtocolError notify_established() override {
+        return NO_ERROR;
+    }
+};
+
+unsigned g_handlerCalls = 0;
+
+void eventHandler(void* data, const char* name, const char* payload) {
+    ++g_handlerCalls;
+}
+
+void benchEvent(State& state, const char* name, const char* data) {
+    uint8_t buf[256];
+    size_t size = 0;
+    uint16_t id = 0;
+    while (state.keepRunning()) {
+        size = Messages::event(buf, id++, name, data, 60, EventType::PUBLIC, false);
+        doNotOptimize(buf);
+    }
+    state.setBytesPerOp(size);
+}
+
+void benchHandleEvent(State& state, const char* name, unsigned handlerCount) {
+    static const char* const FILTERS[] = { "", "sensors", "sensors/outdoor", "sensors/indoor", "temp", "status",
+            "alarm", "sensors/outdoor/north/temperature", "config", "fw" };
+    static char handlerData[64];
+    Subscriptions subscriptions;
+    for (unsigned i = 0; i < handlerCount; ++i) {
+        const char* filter = FILTERS[i % (sizeof(FILTERS) / sizeof(FILTERS[0]))];
+        if (subscriptions.add_event_handler(filter, (EventHandler)eventHandler, &handlerData[i],
+                SubscriptionScope::FIREHOSE, nullptr) != NO_ERROR) {
+            state.fail("Unable to add event handler");
+            return;
+        }
+    }
+    NullMessageChannel channel;
+    uint8_t msg[256];
+    const size_t size = Messages::event(msg, 0x1234, name, EVENT_DATA, 60, EventType::PUBLIC, false);
+    uint8_t buf[sizeof(msg) + 1];
+    g_handlerCalls = 0;
+    while (state.keepRunning()) {
+        // The message buffer is modified by handle_event()
+        memcpy(buf, msg, size);
+        Message message(buf, sizeof(buf) - 1, size);
+        message.decode_id();
+        if (subscriptions.handle_event(message, nullptr, channel) != NO_ERROR) {
+            state.fail("Unable to handle event");
+        }
+    }
+    if (!g_handlerCalls) {
+        state.fail("No handlers were called");
+    }
+    state.setBytesPerOp(size);
+    subscriptions.remove_event_handlers(nullptr);
+}
+
+} // unnamed
+
+BENCHMARK(messages, event_short) {
+    benchEvent(state, SHORT_EVENT_NAME, "21.5");
+}
+
+BENCHMARK(messages, event_long) {
+    benchEvent(state, LONG_EVENT_NAME, EVENT_DATA);
+}
+
+BENCHMARK(coap, encode_options) {
+    uint8_t buf[128];
+    size_t size = 0;
+    while (state.keepRunning()) {
+        uint8_t* p = buf;
+        p += CoAP::header(p, CoAPType::CON, CoAPCode::POST, 0, nullptr, 0x1234);
+        p += CoAP::uri_path(p, CoAPOption::NONE, "E");
+        p += CoAP::uri_path(p, CoAPOption::URI_PATH, LONG_EVENT_NAME);
+        p += CoAP::uri_query(p, CoAPOption::URI_PATH, "u=1&f=2");
+        size = p - buf;
+        doNotOptimize(buf);
+    }
+    state.setBytesPerOp(size);
+}
+
+BENCHMARK(coap, decode_options) {
+    uint8_t buf[128];
+    uint8_t* p = buf;
+    p += CoAP::header(p, CoAPType::CON, CoAPCode::POST, 0, nullptr, 0x1234);
+    p += CoAP::uri_path(p, CoAPOption::NONE, "e");
+    p += CoAP::uri_path(p, CoAPOption::URI_PATH, "sensors");
+    p += CoAP::uri_path(p, CoAPOption::URI_PATH, "outdoor");
+    p += CoAP::uri_path(p, CoAPOption::URI_PATH, "a-rather-long-path-segment-name");
+    p += CoAP::uri_query(p, CoAPOption::URI_PATH, "u=1&f=2");
+    *p++ = 0xff;
+    const uint8_t* const end = p;
+    size_t total = 0;
+    while (state.keepRunning()) {
+        total = 0;
+        unsigned char* opt = buf + 4;
+        while (opt < end && *opt != 0xff) {
+            const size_t len = CoAP::option_decode(&opt);
+            total += len;
+            opt += len;
+        }
+        doNotOptimize(total);
+    }
+    state.setBytesPerOp(end - buf);
+}
+
+BENCHMARK(subscriptions, handle_event_1) {
+    benchHandleEvent(state, SHORT_EVENT_NAME, 1);
+}
+
+BENCHMARK(subscriptions, handle_event_10) {
+    benchHandleEvent(state, LONG_EVENT_NAME, 10);
+}
+
+BENCHMARK(subscriptions, handle_event_50) {
+    benchHandleEvent(state, LONG_EVENT_NAME, 50);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include <sys/types.h> // ssize_t
+
+#include "ringbuffer.h"
+
+#include <cstring>
+
+using namespace particle::bench;
+using particle::services::RingBuffer;
+
+namespace {
+
+const size_t RING_BUFFER_SIZE = 1024;
+
+// Moves data through the ring buffer using chunks of the given size
+void benchPutGet(State& state, size_t chunkSize) {
+    char storage[RING_BUFFER_SIZE];
+    char src[RING_BUFFER_SIZE] = {};
+    char dest[RING_BUFFER_SIZE];
+    RingBuffer<char> rb(storage, sizeof(storage));
+    while (state.keepRunning()) {
+        if (rb.put(src, chunkSize) != (ssize_t)chunkSize || rb.get(dest, chunkSize) != (ssize_t)chunkSize) {
+            state.fail("Unexpected ring buffer size");
+        }
+        doNotOptimize(dest);
+    }
+    state.setBytesPerOp(chunkSize * 2);
+}
+
+} // unnamed
+
+BENCHMARK(ringbuffer, put_get_byte) {
+    char storage[RING_BUFFER_SIZE];
+    RingBuffer<char> rb(storage, sizeof(storage));
+    char c = 0;
+    while (state.keepRunning()) {
+        if (rb.put(c) != 1 || rb.get(&c) != 1) {
+            state.fail("Unexpected ring buffer size");
+        }
+        doNotOptimize(c);
+    }
+    state.setBytesPerOp(2);
+}
+
+BENCHMARK(ringbuffer, put_get_64) {
+    benchPutGet(state, 64);
+}
+
+BENCHMARK(ringbuffer, put_get_300) {
+    // Not a divisor of the buffer size, so that some of the operations wrap around
+    benchPutGet(state, 300);
+}
+
+BENCHMARK(ringbuffer, acquire_consume_64) {
+    // Zero-copy access to the buffer
+    char storage[RING_BUFFER_SIZE];
+    RingBuffer<char> rb(storage, sizeof(storage));
+    const size_t chunkSize = 64;
+    while (state.keepRunning()) {
+        rb.acquireBegin();
+        char* p = rb.acquire(chunkSize);
+        if (!p) {
+            state.fail("Unable to acquire buffer");
+            break;
+        }
+        p[0] = 1;
+        rb.acquireCommit(chunkSize);
+        const char* c = rb.consume(chunkSize);
+        if (!c) {
+            state.fail("Unable to consume buffer");
+            break;
+        }
+        doNotOptimize(c[0]);
+        rb.consumeCommit(chunkSize);
+    }
+    state.setBytesPerOp(0);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include "spark_wiring_json.h"
+#include "spark_wiring_string.h"
+
+#include <cstring>
+
+using namespace particle::bench;
+
+namespace {
+
+const char SMALL_JSON[] = "{\"t\":21.5,\"h\":48,\"on\":true}";
+
+const char LARGE_JSON[] =
+        "{\"device\":\"e00fce68a1b2c3d4e5f60718\",\"fw\":\"1.4.0\",\"uptime\":86400,"
+        "\"net\":{\"rssi\":-67,\"qual\":42,\"tech\":\"LTE Cat-M1\",\"cell\":[310,410,12345,6789]},"
+        "\"sensors\":[{\"id\":1,\"t\":21.5,\"h\":48.2},{\"id\":2,\"t\":19.75,\"h\":51.0},"
+        "{\"id\":3,\"t\":-3.5,\"h\":88.9}],\"flags\":[true,false,null],\"note\":\"escaped \\\"quotes\\\" here\"}";
+
+// Parses a JSON document and visits all of its top-level values
+void benchParse(State& state, const char* json, bool copy) {
+    const size_t size = strlen(json);
+    char buf[512];
+    while (state.keepRunning()) {
+        spark::JSONValue v;
+        if (copy) {
+            v = spark::JSONValue::parseCopy(json, size);
+        } else {
+            // The document is modified by the parser
+            memcpy(buf, json, size);
+            v = spark::JSONValue::parse(buf, size);
+        }
+        spark::JSONObjectIterator it(v);
+        while (it.next()) {
+            doNotOptimize(it.value().type());
+        }
+        if (!v.isValid()) {
+            state.fail("Unable to parse JSON");
+        }
+    }
+    state.setBytesPerOp(size);
+}
+
+} // unnamed
+
+BENCHMARK(json, parse_small) {
+    benchParse(state, SMALL_JSON, false);
+}
+
+BENCHMARK(json, parse_large) {
+    benchParse(state, LARGE_JSON, false);
+}
+
+BENCHMARK(json, parse_copy_large) {
+    benchParse(state, LARGE_JSON, true);
+}
+
+BENCHMARK(string, concat_chars) {
+    size_t size = 0;
+    while (state.keepRunning()) {
+        String s;
+        for (int i = 0; i < 32; ++i) {
+            s += 'x';
+        }
+        size = s.length();
+        doNotOptimize(s.c_str());
+    }
+    state.setBytesPerOp(size);
+}
+
+BENCHMARK(string, concat_strings) {
+    size_t size = 0;
+    while (state.keepRunning()) {
+        String s("device=");
+        s += "e00fce68a1b2c3d4e5f60718";
+        s += "&t=";
+        s += 21;
+        s += "&h=";
+        s += String(48.25, 2);
+        s += "&status=";
+        s += String("online");
+        size = s.length();
+        doNotOptimize(s.c_str());
+    }
+    state.setBytesPerOp(size);
+}
+
+BENCHMARK(string, concat_reserved) {
+    size_t size = 0;
+    while (state.keepRunning()) {
+        String s;
+        s.reserve(64);
+        s += "device=";
+        s += "e00fce68a1b2c3d4e5f60718";
+        s += "&t=";
+        s += 21;
+        s += "&status=online";
+        size = s.length();
+        doNotOptimize(s.c_str());
+    }
+    state.setBytesPerOp(size);
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decompress_stream.h"
+#include "system_error.h"
+#include "catch.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+using namespace particle;
+
+namespace {
+
+// Raw deflate stream of plainText() compressed with a 512-byte window:
+// zlib.compressobj(9, zlib.DEFLATED, -9)
+const uint8_t COMPRESSED[] = {
+    0x9d, 0xcb, 0xc7, 0x11, 0xc2, 0x30, 0x10, 0x40, 0xd1, 0x3b, 0x55, 0x6c, 0x05, 0xcc, 0x2a, 0x4b,
+    0xd4, 0xe0, 0x23, 0x0d, 0x10, 0x0c, 0x98, 0x60, 0x81, 0xc1, 0xa4, 0xea, 0x61, 0x86, 0x0a, 0xf8,
+    0xe7, 0x37, 0xaf, 0xe9, 0xfa, 0x56, 0x54, 0x75, 0x26, 0xf3, 0x5d, 0x2b, 0x97, 0xb1, 0x5b, 0x1d,
+    0x64, 0x39, 0xd4, 0x47, 0x2f, 0x9b, 0xfa, 0x94, 0xfd, 0x78, 0x3a, 0x5f, 0xa5, 0xde, 0xdb, 0x41,
+    0x6e, 0x5f, 0x3e, 0x2e, 0xde, 0x2f, 0x59, 0xd7, 0xed, 0x74, 0xd2, 0xfc, 0x9a, 0x61, 0xcd, 0xb2,
+    0xe6, 0x58, 0xf3, 0xac, 0x05, 0xd6, 0x22, 0x6b, 0x89, 0xb5, 0xcc, 0x5a, 0x41, 0xcd, 0x28, 0x6b,
+    0x86, 0x35, 0xcb, 0x9a, 0x63, 0xcd, 0xb3, 0x16, 0x58, 0x8b, 0xac, 0x25, 0xd6, 0x32, 0x6b, 0x05,
+    0x35, 0xab, 0xac, 0x19, 0xd6, 0x2c, 0x6b, 0x8e, 0x35, 0xcf, 0x5a, 0x60, 0x2d, 0xb2, 0x96, 0x58,
+    0xcb, 0xac, 0x15, 0xd4, 0x9c, 0xb2, 0x66, 0x58, 0xb3, 0xac, 0x39, 0xd6, 0x3c, 0x6b, 0x81, 0xb5,
+    0xc8, 0x5a, 0x62, 0x2d, 0xb3, 0x56, 0x50, 0xf3, 0xca, 0x9a, 0x61, 0xcd, 0xb2, 0xe6, 0x58, 0xf3,
+    0xac, 0x05, 0xd6, 0x22, 0x6b, 0x89, 0xb5, 0xcc, 0x5a, 0x41, 0x2d, 0x28, 0x6b, 0x86, 0x35, 0xcb,
+    0x9a, 0x63, 0xcd, 0xb3, 0x16, 0x58, 0x8b, 0xac, 0x25, 0xd6, 0x32, 0x6b, 0x05, 0xb5, 0xa8, 0xac,
+    0x19, 0xd6, 0x2c, 0x6b, 0xee, 0xcf, 0xf6, 0x01,
+};
+
+std::string plainText() {
+    std::string s;
+    for (int i = 0; i < 64; ++i) {
+        char line[64] = {};
+        snprintf(line, sizeof(line), "Line %03d: The quick brown fox jumps over the lazy dog.\n", i);
+        s += line;
+    }
+    return s;
+}
+
+class StringOutputStream: public OutputStream {
+public:
+    int write(const char* data, size_t size) override {
+        str.append(data, size);
+        return size;
+    }
+
+    int flush() override {
+        return 0;
+    }
+
+    int availForWrite() override {
+        return 1024;
+    }
+
+    int waitEvent(unsigned flags, unsigned timeout) override {
+        return 0;
+    }
+
+    std::string str;
+};
+
+std::string compressed(const std::string& trailer = std::string()) {
+    return std::string((const char*)COMPRESSED, sizeof(COMPRESSED)) + trailer;
+}
+
+} // namespace
+
+TEST_CASE("DecompressStream") {
+    char window[TINFL_LZ_DICT_SIZE] = {};
+    StringOutputStream out;
+    DecompressStream strm(window, sizeof(window), out);
+
+    SECTION("the data is decompressed in a single write") {
+        const auto data = compressed();
+        CHECK(strm.write(data.data(), data.size()) == (int)data.size());
+        CHECK(strm.flush() == 0);
+        CHECK(strm.done());
+        CHECK(out.str == plainText());
+    }
+
+    SECTION("the data is decompressed in small writes") {
+        const auto data = compressed();
+        for (size_t offs = 0; offs < data.size(); offs += 7) {
+            const size_t n = std::min<size_t>(7, data.size() - offs);
+            REQUIRE(strm.writeAll(data.data() + offs, n) == (int)n);
+        }
+        CHECK(strm.flush() == 0);
+        CHECK(strm.done());
+        CHECK(out.str == plainText());
+    }
+
+    SECTION("trailing data in the same write is rejected") {
+        const auto data = compressed("trailer");
+        CHECK(strm.write(data.data(), data.size()) == SYSTEM_ERROR_BAD_DATA);
+        CHECK(strm.done());
+    }
+
+    SECTION("trailing data in a separate write is rejected") {
+        const auto data = compressed();
+        REQUIRE(strm.write(data.data(), data.size()) == (int)data.size());
+        REQUIRE(strm.done());
+        CHECK(strm.write("x", 1) == SYSTEM_ERROR_BAD_DATA);
+        CHECK(strm.flush() == 0);
+        CHECK(out.str == plainText());
+    }
+
+    SECTION("writing all of the data fails instead of retrying the trailing data") {
+        const auto data = compressed(std::string(100, '\0'));
+        CHECK(strm.writeAll(data.data(), data.size()) == SYSTEM_ERROR_BAD_DATA);
+    }
+
+    SECTION("a truncated stream is not reported as done") {
+        const auto data = compressed();
+        REQUIRE(strm.write(data.data(), data.size() - 10) == (int)data.size() - 10);
+        strm.flush();
+        CHECK(!strm.done());
+        CHECK(out.str.size() < plainText().size());
+    }
+}
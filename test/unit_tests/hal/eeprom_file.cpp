@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "eeprom_file.h"
+#include "catch.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace particle;
+
+namespace {
+
+struct Record {
+    uint16_t offset;
+    std::string data;
+
+    bool operator==(const Record& r) const {
+        return offset == r.offset && data == r.data;
+    }
+};
+
+std::ostream& operator<<(std::ostream& strm, const Record& r) {
+    return strm << "{ " << r.offset << ", \"" << r.data << "\" }";
+}
+
+std::unique_ptr<EepromFile> openEeprom() {
+    return std::unique_ptr<EepromFile>(new EepromFile());
+}
+
+void setFlushPolicy(EepromFile* eeprom, uint32_t delay, uint32_t maxPendingSize) {
+    hal_eeprom_flush_policy policy = {};
+    policy.size = sizeof(policy);
+    policy.delay = delay;
+    policy.max_pending_size = maxPendingSize;
+    REQUIRE(eeprom->setFlushPolicy(policy) == 0);
+}
+
+void write(EepromFile* eeprom, size_t offset, const std::string& data) {
+    REQUIRE(eeprom->write(offset, (const uint8_t*)data.data(), data.size()) == (ssize_t)data.size());
+}
+
+std::string read(EepromFile* eeprom, size_t offset, size_t size) {
+    std::string s(size, '\0');
+    REQUIRE(eeprom->read(offset, (uint8_t*)&s[0], size) == (ssize_t)size);
+    return s;
+}
+
+// Returns the generation counter that follows the contents of the EEPROM file
+uint32_t fileGeneration() {
+    const auto d = test::readFile(EEPROM_FILE_PATH);
+    REQUIRE(d.size() == EEPROM_FILE_SIZE + sizeof(uint32_t));
+    uint32_t gen = 0;
+    memcpy(&gen, d.data() + EEPROM_FILE_SIZE, sizeof(gen));
+    return gen;
+}
+
+std::string fileData(size_t offset, size_t size) {
+    const auto d = test::readFile(EEPROM_FILE_PATH);
+    REQUIRE(d.size() >= offset + size);
+    return std::string((const char*)d.data() + offset, size);
+}
+
+bool logExists() {
+    lfs_info info = {};
+    return lfs_stat(&filesystem_get_instance(nullptr)->instance, EEPROM_LOG_FILE_PATH, &info) == 0;
+}
+
+// Parses the log file
+std::vector<Record> logRecords(uint32_t* generation = nullptr) {
+    const auto d = test::readFile(EEPROM_LOG_FILE_PATH);
+    REQUIRE(d.size() >= sizeof(uint32_t));
+    if (generation) {
+        memcpy(generation, d.data(), sizeof(uint32_t));
+    }
+    std::vector<Record> recs;
+    size_t pos = sizeof(uint32_t);
+    while (pos < d.size()) {
+        REQUIRE(d.size() - pos >= 4);
+        uint16_t offs = 0, size = 0;
+        memcpy(&offs, d.data() + pos, 2);
+        memcpy(&size, d.data() + pos + 2, 2);
+        pos += 4;
+        REQUIRE(d.size() - pos >= size);
+        recs.push_back({ offs, std::string((const char*)d.data() + pos, size) });
+        pos += size;
+    }
+    return recs;
+}
+
+void writeTestFile(const char* path, const std::string& data) {
+    const auto lfs = &filesystem_get_instance(nullptr)->instance;
+    lfs_file_t file = {};
+    REQUIRE(lfs_file_open(lfs, &file, path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) == 0);
+    REQUIRE(lfs_file_write(lfs, &file, data.data(), data.size()) == (lfs_ssize_t)data.size());
+    REQUIRE(lfs_file_close(lfs, &file) == 0);
+}
+
+std::string u16(uint16_t val) {
+    return std::string((const char*)&val, sizeof(val));
+}
+
+std::string u32(uint32_t val) {
+    return std::string((const char*)&val, sizeof(val));
+}
+
+} // namespace
+
+TEST_CASE("EepromFile") {
+    test::formatFilesystem();
+
+    SECTION("a new EEPROM is filled with 0xff") {
+        auto e = openEeprom();
+        CHECK(read(e.get(), 0, EEPROM_FILE_SIZE) == std::string(EEPROM_FILE_SIZE, '\xff'));
+        CHECK(fileGeneration() == 1);
+        CHECK_FALSE(logExists());
+    }
+
+    SECTION("changes are written immediately by default") {
+        auto e = openEeprom();
+        hal_eeprom_flush_policy policy = {};
+        e->getFlushPolicy(&policy);
+        CHECK(policy.delay == 0);
+        write(e.get(), 10, "ab");
+        CHECK_FALSE(e->hasPendingChanges());
+        uint32_t gen = 0;
+        CHECK(logRecords(&gen) == std::vector<Record>({ { 10, "ab" } }));
+        CHECK(gen == 1);
+        // Writing the same data again doesn't produce a record
+        write(e.get(), 10, "ab");
+        CHECK(logRecords().size() == 1);
+    }
+
+    SECTION("overlapping and adjacent changes are merged into one record") {
+        auto e = openEeprom();
+        setFlushPolicy(e.get(), 60000, 1024);
+        write(e.get(), 12, "cd");
+        write(e.get(), 100, "x");
+        write(e.get(), 10, "ab");
+        write(e.get(), 11, "BC");
+        write(e.get(), 50, "y");
+        CHECK(e->hasPendingChanges());
+        CHECK_FALSE(logExists());
+        REQUIRE(e->flush(0) == 0);
+        CHECK_FALSE(e->hasPendingChanges());
+        CHECK(logRecords() == std::vector<Record>({ { 10, "aBCd" }, { 50, "y" }, { 100, "x" } }));
+    }
+
+    SECTION("the closest ranges are merged when there are too many changed ranges") {
+        auto e = openEeprom();
+        setFlushPolicy(e.get(), 60000, 1024);
+        for (int i = 0; i < 8; ++i) {
+            write(e.get(), i * 100, std::string(1, 'a' + i));
+        }
+        write(e.get(), 403, "z"); // Closest to the range at offset 400
+        REQUIRE(e->flush(0) == 0);
+        const auto recs = logRecords();
+        REQUIRE(recs.size() == 8);
+        CHECK(recs[3] == Record({ 300, "d" }));
+        CHECK(recs[4] == Record({ 400, std::string("e\xff\xffz", 4) }));
+        CHECK(recs[5] == Record({ 500, "f" }));
+    }
+
+    SECTION("changes are flushed when more than max_pending_size bytes have changed") {
+        auto e = openEeprom();
+        setFlushPolicy(e.get(), 60000, 4);
+        write(e.get(), 0, "abcd");
+        CHECK(e->hasPendingChanges());
+        write(e.get(), 8, "e");
+        CHECK_FALSE(e->hasPendingChanges());
+        CHECK(logRecords() == std::vector<Record>({ { 0, "abcd" }, { 8, "e" } }));
+    }
+
+    SECTION("a sleep flush is skipped unless the policy requests it") {
+        auto e = openEeprom();
+        setFlushPolicy(e.get(), 60000, 1024);
+        write(e.get(), 0, "a");
+        REQUIRE(e->flush(HAL_EEPROM_FLUSH_SLEEP) == 0);
+        CHECK(e->hasPendingChanges());
+        REQUIRE(e->flush(HAL_EEPROM_FLUSH_IF_DUE) == 0);
+        CHECK(e->hasPendingChanges());
+        REQUIRE(e->flush(0) == 0);
+        CHECK_FALSE(e->hasPendingChanges());
+    }
+
+    SECTION("the log is replayed when the EEPROM is loaded") {
+        auto e = openEeprom();
+        write(e.get(), 10, "abc");
+        write(e.get(), 4000, "xyz");
+        write(e.get(), 11, "B");
+        e.reset();
+        test::resetFilesystem();
+        // The changes are only in the log
+        CHECK(fileData(10, 3) == "\xff\xff\xff");
+        e = openEeprom();
+        CHECK(read(e.get(), 10, 3) == "aBc");
+        CHECK(read(e.get(), 4000, 3) == "xyz");
+        CHECK(fileGeneration() == 1);
+        // New records are appended to the existing log
+        write(e.get(), 20, "d");
+        CHECK(logRecords() == std::vector<Record>({ { 10, "abc" }, { 4000, "xyz" }, { 11, "B" }, { 20, "d" } }));
+    }
+
+    SECTION("the EEPROM file is rewritten when the log becomes too large") {
+        auto e = openEeprom();
+        int i = 0;
+        while (logExists() || i == 0) {
+            write(e.get(), i * 100, std::string(100, 'a' + i));
+            ++i;
+            REQUIRE(i < 20);
+        }
+        CHECK(i == (EEPROM_LOG_MAX_SIZE - 4) / 104 + 1);
+        CHECK(fileGeneration() == 2);
+        CHECK(fileData(0, 100) == std::string(100, 'a'));
+        CHECK(fileData((i - 1) * 100, 100) == std::string(100, 'a' + i - 1));
+        e.reset();
+        e = openEeprom();
+        CHECK(read(e.get(), (i - 1) * 100, 100) == std::string(100, 'a' + i - 1));
+    }
+
+    SECTION("a log left behind by an interrupted rewrite of the EEPROM file is discarded") {
+        auto e = openEeprom();
+        write(e.get(), 0, "old");
+        e.reset();
+        // The EEPROM file was rewritten with other contents but the log wasn't removed
+        std::string data(EEPROM_FILE_SIZE, '\xff');
+        data.replace(0, 3, "new");
+        writeTestFile(EEPROM_FILE_PATH, data + u32(2));
+        REQUIRE(logExists());
+        e = openEeprom();
+        CHECK(read(e.get(), 0, 3) == "new");
+        CHECK_FALSE(logExists());
+        CHECK(fileGeneration() == 3);
+    }
+
+    SECTION("an EEPROM file without a generation counter is loaded as generation 0") {
+        std::string data(EEPROM_FILE_SIZE, '\xff');
+        data.replace(0, 3, "abc");
+        writeTestFile(EEPROM_FILE_PATH, data);
+        auto e = openEeprom();
+        CHECK(read(e.get(), 0, 3) == "abc");
+        write(e.get(), 1, "B");
+        uint32_t gen = 1;
+        CHECK(logRecords(&gen) == std::vector<Record>({ { 1, "B" } }));
+        CHECK(gen == 0);
+        e.reset();
+        e = openEeprom();
+        CHECK(read(e.get(), 0, 3) == "aBc");
+    }
+
+    SECTION("an incomplete log record is discarded") {
+        std::string data(EEPROM_FILE_SIZE, '\xff');
+        writeTestFile(EEPROM_FILE_PATH, data + u32(5));
+        writeTestFile(EEPROM_LOG_FILE_PATH, u32(5) + u16(10) + u16(2) + "ab" + u16(20) + u16(4) + "cd");
+        auto e = openEeprom();
+        CHECK(read(e.get(), 10, 2) == "ab");
+        CHECK(read(e.get(), 20, 2) == "\xff\xff");
+        // The valid records are kept in the rewritten EEPROM file
+        CHECK_FALSE(logExists());
+        CHECK(fileGeneration() == 6);
+        CHECK(fileData(10, 2) == "ab");
+    }
+
+    SECTION("a log record past the end of the EEPROM is discarded") {
+        std::string data(EEPROM_FILE_SIZE, '\xff');
+        writeTestFile(EEPROM_FILE_PATH, data + u32(1));
+        writeTestFile(EEPROM_LOG_FILE_PATH, u32(1) + u16(EEPROM_FILE_SIZE - 1) + u16(2) + "ab");
+        auto e = openEeprom();
+        CHECK(read(e.get(), EEPROM_FILE_SIZE - 1, 1) == "\xff");
+        CHECK_FALSE(logExists());
+        CHECK(fileGeneration() == 2);
+    }
+}
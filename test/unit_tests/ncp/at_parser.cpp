@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "at_parser.h"
+#include "at_response.h"
+#include "stream.h"
+#include "system_error.h"
+
+#include "catch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+using namespace particle;
+
+namespace {
+
+// Stream that emulates a DCE. Every read returns at most one chunk of the input data, so that
+// the chunks can be used to split the input at arbitrary positions
+class FakeModem: public Stream {
+public:
+    // Adds data to the input stream
+    FakeModem& input(const std::string& data) {
+        chunks_.push_back(data);
+        return *this;
+    }
+
+    // Adds a response that is sent when the next command line is received
+    FakeModem& expect(const std::string& cmd, const std::string& resp) {
+        return expect(cmd, std::vector<std::string>({ resp }));
+    }
+
+    // Adds a response that is received in several chunks
+    FakeModem& expect(const std::string& cmd, const std::vector<std::string>& resp) {
+        expected_.push_back(std::make_pair(cmd, resp));
+        return *this;
+    }
+
+    // Command lines received from the parser
+    const std::vector<std::string>& commands() const {
+        return cmds_;
+    }
+
+    int read(char* data, size_t size) override {
+        if (chunks_.empty()) {
+            return 0;
+        }
+        auto& chunk = chunks_.front();
+        const size_t n = std::min(size, chunk.size());
+        memcpy(data, chunk.data(), n);
+        chunk.erase(0, n);
+        if (chunk.empty()) {
+            chunks_.pop_front();
+        }
+        return n;
+    }
+
+    int peek(char* data, size_t size) override {
+        if (chunks_.empty()) {
+            return 0;
+        }
+        const auto& chunk = chunks_.front();
+        const size_t n = std::min(size, chunk.size());
+        memcpy(data, chunk.data(), n);
+        return n;
+    }
+
+    int skip(size_t size) override {
+        std::string data(size, '\0');
+        return read(&data[0], size);
+    }
+
+    int availForRead() override {
+        return chunks_.empty() ? 0 : chunks_.front().size();
+    }
+
+    int write(const char* data, size_t size) override {
+        for (size_t i = 0; i < size; ++i) {
+            if (data[i] != '\r') {
+                cmd_ += data[i];
+                continue;
+            }
+            cmds_.push_back(cmd_);
+            if (!expected_.empty() && expected_.front().first == cmd_) {
+                for (const auto& chunk: expected_.front().second) {
+                    input(chunk);
+                }
+                expected_.pop_front();
+            } else {
+                input("\r\nERROR\r\n");
+            }
+            cmd_.clear();
+        }
+        return size;
+    }
+
+    int flush() override {
+        return 0;
+    }
+
+    int availForWrite() override {
+        return 1024;
+    }
+
+    int waitEvent(unsigned flags, unsigned timeout) override {
+        if ((flags & READABLE) && chunks_.empty()) {
+            return SYSTEM_ERROR_TIMEOUT;
+        }
+        return flags;
+    }
+
+private:
+    std::deque<std::string> chunks_;
+    std::deque<std::pair<std::string, std::vector<std::string>>> expected_;
+    std::vector<std::string> cmds_;
+    std::string cmd_;
+};
+
+struct Urc {
+    std::string prefix;
+    std::string line;
+};
+
+int urcHandler(AtResponseReader* reader, const char* prefix, void* data) {
+    char buf[128] = {};
+    const int n = reader->readLine(buf, sizeof(buf));
+    if (n < 0) {
+        return n;
+    }
+    static_cast<std::vector<Urc>*>(data)->push_back({ prefix, buf });
+    return 0;
+}
+
+struct CommandResult {
+    int result;
+    int errorCode;
+
+    bool operator==(const CommandResult& r) const {
+        return result == r.result && errorCode == r.errorCode;
+    }
+};
+
+void commandCallback(int result, int errorCode, void* data) {
+    static_cast<std::vector<CommandResult>*>(data)->push_back({ result, errorCode });
+}
+
+void initParser(AtParser* parser, FakeModem* modem) {
+    REQUIRE(parser->init(AtParserConfig().stream(modem).commandTimeout(1000).streamTimeout(100)
+            .echoEnabled(false).logEnabled(false)) == 0);
+}
+
+std::vector<std::string> readLines(AtResponse* resp) {
+    std::vector<std::string> lines;
+    while (resp->hasNextLine()) {
+        char buf[128] = {};
+        REQUIRE(resp->readLine(buf, sizeof(buf)) >= 0);
+        lines.push_back(buf);
+    }
+    return lines;
+}
+
+void processUrcs(AtParser* parser) {
+    // The number of iterations is limited in case the parser keeps reporting the same URC
+    for (int i = 0; i < 100; ++i) {
+        const int r = parser->processUrc(0);
+        if (r == SYSTEM_ERROR_WOULD_BLOCK) {
+            return;
+        }
+        REQUIRE(r >= 0);
+    }
+    FAIL("Parser didn't stop processing URCs");
+}
+
+} // namespace
+
+TEST_CASE("AtParser") {
+    FakeModem modem;
+    AtParser parser;
+    initParser(&parser, &modem);
+    std::vector<Urc> urcs;
+    std::vector<CommandResult> results;
+
+    SECTION("the newline preceding the first response is not read as a separate line") {
+        modem.expect("AT+CSQ", "\r\n+CSQ: 15,99\r\n\r\nOK\r\n");
+        auto resp = parser.sendCommand("AT+CSQ");
+        CHECK(readLines(&resp) == std::vector<std::string>({ "+CSQ: 15,99" }));
+        CHECK(resp.readResult() == AtResponse::OK);
+    }
+
+    SECTION("the longest matching URC prefix is selected") {
+        REQUIRE(parser.addUrcHandler("+UUSO", urcHandler, &urcs) == 0);
+        REQUIRE(parser.addUrcHandler("+UUSORD", urcHandler, &urcs) == 0);
+        REQUIRE(parser.addUrcHandler("+UUSORF", urcHandler, &urcs) == 0);
+        REQUIRE(parser.addUrcHandler("+CIEV", urcHandler, &urcs) == 0);
+        modem.input("\r\n+UUSORD: 0,12\r\n")
+                .input("\r\n+UUSOCL: 1\r\n")
+                .input("\r\n+UUSORF: 2,8\r\n")
+                .input("\r\n+UUS: 3\r\n")
+                .input("\r\n+CIEV: 2,3\r\n");
+        processUrcs(&parser);
+        REQUIRE(urcs.size() == 4);
+        CHECK(urcs[0].prefix == "+UUSORD");
+        CHECK(urcs[0].line == "+UUSORD: 0,12");
+        CHECK(urcs[1].prefix == "+UUSO");
+        CHECK(urcs[1].line == "+UUSOCL: 1");
+        CHECK(urcs[2].prefix == "+UUSORF");
+        CHECK(urcs[2].line == "+UUSORF: 2,8");
+        CHECK(urcs[3].prefix == "+CIEV");
+        CHECK(urcs[3].line == "+CIEV: 2,3");
+    }
+
+    SECTION("a URC split across reads is matched") {
+        REQUIRE(parser.addUrcHandler("+UUSORD", urcHandler, &urcs) == 0);
+        REQUIRE(parser.addUrcHandler("+UUSOCL", urcHandler, &urcs) == 0);
+        modem.input("\r\n+U").input("USO").input("RD: 0").input(",12\r").input("\n\r\n+UUSOC").input("L: 1\r\n");
+        processUrcs(&parser);
+        REQUIRE(urcs.size() == 2);
+        CHECK(urcs[0].prefix == "+UUSORD");
+        CHECK(urcs[0].line == "+UUSORD: 0,12");
+        CHECK(urcs[1].prefix == "+UUSOCL");
+        CHECK(urcs[1].line == "+UUSOCL: 1");
+    }
+
+    SECTION("a URC received during a command response is not returned as part of the response") {
+        REQUIRE(parser.addUrcHandler("+CIEV", urcHandler, &urcs) == 0);
+        modem.expect("AT+COPS?", "\r\n+CIEV: 2,3\r\n+COPS: 0,0,\"AT&T\",7\r\n\r\n+CIEV: 3,1\r\n\r\nOK\r\n");
+        auto resp = parser.sendCommand("AT+COPS?");
+        CHECK(readLines(&resp) == std::vector<std::string>({ "+COPS: 0,0,\"AT&T\",7" }));
+        CHECK(resp.readResult() == AtResponse::OK);
+        REQUIRE(urcs.size() == 2);
+        CHECK(urcs[0].line == "+CIEV: 2,3");
+        CHECK(urcs[1].line == "+CIEV: 3,1");
+    }
+
+    SECTION("a line that begins like a URC prefix is returned as part of the response") {
+        REQUIRE(parser.addUrcHandler("+CIEV", urcHandler, &urcs) == 0);
+        modem.expect("AT+CIND?", "\r\n+CIND: 1,2\r\n\r\nOK\r\n");
+        auto resp = parser.sendCommand("AT+CIND?");
+        CHECK(readLines(&resp) == std::vector<std::string>({ "+CIND: 1,2" }));
+        CHECK(resp.readResult() == AtResponse::OK);
+        CHECK(urcs.empty());
+    }
+
+    SECTION("binary data following a delimiter is read as is") {
+        modem.expect("AT+USORD=0,6", std::string("\r\n+USORD: 0,6,\"\r\nOK\0\r\"\r\n\r\nOK\r\n", 31));
+        auto resp = parser.sendCommand("AT+USORD=0,6");
+        REQUIRE(resp.hasNextLine());
+        char buf[32] = {};
+        CHECK(resp.readUntil(buf, sizeof(buf), '"') == 12);
+        CHECK(std::string(buf) == "+USORD: 0,6,");
+        char data[6] = {};
+        CHECK(resp.read(data, sizeof(data)) == 6);
+        CHECK(std::string(data, sizeof(data)) == std::string("\r\nOK\0\r", 6));
+        memset(buf, 0, sizeof(buf));
+        CHECK(resp.readLine(buf, sizeof(buf)) >= 0);
+        CHECK(std::string(buf) == "\"");
+        CHECK(!resp.hasNextLine());
+        CHECK(resp.readResult() == AtResponse::OK);
+    }
+
+    SECTION("binary data split across reads is read as is") {
+        modem.expect("AT+USORD=0,4", { "\r\n+USORD: 0,4,\"a", "b\r", "\nc\"\r\n\r\nOK\r\n" });
+        auto resp = parser.sendCommand("AT+USORD=0,4");
+        REQUIRE(resp.hasNextLine());
+        char buf[32] = {};
+        CHECK(resp.readUntil(buf, sizeof(buf), '"') == 12);
+        char data[4] = {};
+        CHECK(resp.read(data, sizeof(data)) == 4);
+        CHECK(std::string(data, sizeof(data)) == "ab\r\n");
+        CHECK(resp.readResult() == AtResponse::OK);
+    }
+
+    SECTION("the line is read up to the newline if the delimiter is not found") {
+        modem.expect("AT+CGMI", "\r\nu-blox\r\n\r\nOK\r\n");
+        auto resp = parser.sendCommand("AT+CGMI");
+        REQUIRE(resp.hasNextLine());
+        char buf[32] = {};
+        CHECK(resp.readUntil(buf, sizeof(buf), ',') == 6);
+        CHECK(std::string(buf) == "u-blox");
+        CHECK(!resp.hasNextLine());
+        CHECK(resp.readResult() == AtResponse::OK);
+    }
+
+    SECTION("adjacent queued commands with the COMBINE flag are sent as a single command line") {
+        REQUIRE(parser.queueCommand("AT+CREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        REQUIRE(parser.queueCommand("AT+CGREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        REQUIRE(parser.queueCommand("AT+COPS=0,2", 0, commandCallback, &results) == 0);
+        REQUIRE(parser.queueCommand("AT+CEREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        modem.expect("AT+CREG=2;+CGREG=2", "\r\nOK\r\n")
+                .expect("AT+COPS=0,2", "\r\nOK\r\n")
+                .expect("AT+CEREG=2", "\r\nOK\r\n");
+        CHECK(parser.processQueue() == AtResponse::OK);
+        CHECK(modem.commands() == std::vector<std::string>({ "AT+CREG=2;+CGREG=2", "AT+COPS=0,2", "AT+CEREG=2" }));
+        CHECK(results == std::vector<CommandResult>(4, { AtResponse::OK, 0 }));
+    }
+
+    SECTION("commands that don't use the extended syntax are not combined") {
+        REQUIRE(parser.queueCommand("ATH", AtParser::COMBINE, commandCallback, &results) == 0);
+        REQUIRE(parser.queueCommand("AT+CREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        modem.expect("ATH", "\r\nOK\r\n")
+                .expect("AT+CREG=2", "\r\nOK\r\n");
+        CHECK(parser.processQueue() == AtResponse::OK);
+        CHECK(modem.commands() == std::vector<std::string>({ "ATH", "AT+CREG=2" }));
+        CHECK(results.size() == 2);
+    }
+
+    SECTION("the commands of a failed command line are resent one by one") {
+        REQUIRE(parser.queueCommand("AT+CREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        REQUIRE(parser.queueCommand("AT+CGREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        REQUIRE(parser.queueCommand("AT+CEREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        REQUIRE(parser.queueCommand("AT+COPS=0,2", 0, commandCallback, &results) == 0);
+        modem.expect("AT+CREG=2;+CGREG=2;+CEREG=2", "\r\n+CME ERROR: 3\r\n")
+                .expect("AT+CREG=2", "\r\nOK\r\n")
+                .expect("AT+CGREG=2", "\r\n+CME ERROR: 3\r\n");
+        CHECK(parser.processQueue() == AtResponse::CME_ERROR);
+        CHECK(modem.commands() == std::vector<std::string>({ "AT+CREG=2;+CGREG=2;+CEREG=2", "AT+CREG=2", "AT+CGREG=2" }));
+        CHECK(results == std::vector<CommandResult>({ { AtResponse::OK, 0 }, { AtResponse::CME_ERROR, 3 },
+                { SYSTEM_ERROR_CANCELLED, 0 }, { SYSTEM_ERROR_CANCELLED, 0 } }));
+    }
+
+    SECTION("the commands following the failed command of a command line are not resent") {
+        REQUIRE(parser.queueCommand("AT+CREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        REQUIRE(parser.queueCommand("AT+CGREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        REQUIRE(parser.queueCommand("AT+CEREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        modem.expect("AT+CREG=2;+CGREG=2;+CEREG=2", "\r\nERROR\r\n")
+                .expect("AT+CREG=2", "\r\nERROR\r\n");
+        CHECK(parser.processQueue() == AtResponse::ERROR);
+        CHECK(modem.commands() == std::vector<std::string>({ "AT+CREG=2;+CGREG=2;+CEREG=2", "AT+CREG=2" }));
+        CHECK(results == std::vector<CommandResult>({ { AtResponse::ERROR, 0 }, { SYSTEM_ERROR_CANCELLED, 0 },
+                { SYSTEM_ERROR_CANCELLED, 0 } }));
+    }
+
+    SECTION("a command line that fails only when sent as a whole completes successfully") {
+        REQUIRE(parser.queueCommand("AT+CREG?", AtParser::COMBINE, commandCallback, &results) == 0);
+        REQUIRE(parser.queueCommand("AT+CGREG?", AtParser::COMBINE, commandCallback, &results) == 0);
+        modem.expect("AT+CREG?;+CGREG?", "\r\nERROR\r\n")
+                .expect("AT+CREG?", "\r\nOK\r\n")
+                .expect("AT+CGREG?", "\r\nOK\r\n");
+        CHECK(parser.processQueue() == AtResponse::OK);
+        CHECK(modem.commands() == std::vector<std::string>({ "AT+CREG?;+CGREG?", "AT+CREG?", "AT+CGREG?" }));
+        CHECK(results == std::vector<CommandResult>(2, { AtResponse::OK, 0 }));
+    }
+
+    SECTION("clearing the queue cancels the queued commands") {
+        REQUIRE(parser.queueCommand("AT+CREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        REQUIRE(parser.queueCommand("AT+CGREG=2", AtParser::COMBINE, commandCallback, &results) == 0);
+        parser.clearQueue();
+        CHECK(results == std::vector<CommandResult>(2, { SYSTEM_ERROR_CANCELLED, 0 }));
+        modem.expect("AT+COPS=0,2", "\r\nOK\r\n");
+        REQUIRE(parser.queueCommand("AT+COPS=0,2", 0, commandCallback, &results) == 0);
+        CHECK(parser.processQueue() == AtResponse::OK);
+        CHECK(modem.commands() == std::vector<std::string>({ "AT+COPS=0,2" }));
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "network_config_db.h"
+#include "catch.h"
+
+#include <cstring>
+
+using namespace particle;
+
+namespace {
+
+ModemConfigRecord modemConfig(uint32_t hash, const char* firmware, const char* iccid) {
+    ModemConfigRecord conf = {};
+    conf.configHash = hash;
+    strcpy(conf.firmwareVersion, firmware);
+    strcpy(conf.iccid, iccid);
+    return conf;
+}
+
+} // namespace
+
+TEST_CASE("isModemConfigCurrent()") {
+    auto cached = modemConfig(0x1234, "L0.0.00.00.05.06", "89014103211118510720");
+    cached.flags = ModemConfigRecord::RAT_CONFIGURED;
+    strcpy(cached.imsi, "310410123456789");
+
+    SECTION("the cached configuration is used if the modem and SIM card haven't changed") {
+        // The current configuration only has the fields that are known before the initialization
+        const auto current = modemConfig(0x1234, "L0.0.00.00.05.06", "89014103211118510720");
+        CHECK(isModemConfigCurrent(cached, current));
+    }
+
+    SECTION("a changed ICCID triggers the full initialization") {
+        CHECK_FALSE(isModemConfigCurrent(cached, modemConfig(0x1234, "L0.0.00.00.05.06", "89014103211118510721")));
+        // The SIM card is missing or not ready
+        CHECK_FALSE(isModemConfigCurrent(cached, modemConfig(0x1234, "L0.0.00.00.05.06", "")));
+    }
+
+    SECTION("a changed firmware version triggers the full initialization") {
+        CHECK_FALSE(isModemConfigCurrent(cached, modemConfig(0x1234, "L0.0.00.00.05.07", "89014103211118510720")));
+        CHECK_FALSE(isModemConfigCurrent(cached, modemConfig(0x1234, "L0.0.00.00.05.0", "89014103211118510720")));
+    }
+
+    SECTION("changed client settings trigger the full initialization") {
+        CHECK_FALSE(isModemConfigCurrent(cached, modemConfig(0x4321, "L0.0.00.00.05.06", "89014103211118510720")));
+    }
+
+    SECTION("an empty record never matches") {
+        const ModemConfigRecord empty = {};
+        CHECK_FALSE(isModemConfigCurrent(empty, empty));
+    }
+}
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dns_cache.h"
+#include "network_stubs.h"
+#include "system_error.h"
+#include "catch.h"
+
+#include "lwip/dns.h"
+
+#include <string>
+
+using particle::net::DnsCache;
+
+namespace {
+
+// Builder of DNS messages
+class Message {
+public:
+    explicit Message(uint16_t flags = 0x8180 /* QR, RD, RA */) {
+        u16(0x1234); // ID
+        u16(flags);
+        u16(1); // QDCOUNT
+        u16(0); // ANCOUNT
+        u16(0); // NSCOUNT
+        u16(0); // ARCOUNT
+    }
+
+    Message& question(const std::string& name, uint16_t type) {
+        this->name(name);
+        u16(type);
+        u16(1); // IN
+        return *this;
+    }
+
+    // Adds a record with the given owner name and RDATA. The record is counted in the answer
+    // or authority section depending on the value of `authority`
+    Message& record(const std::string& owner, uint16_t type, uint32_t ttl, const std::string& rdata, bool authority = false) {
+        d_.append(owner);
+        u16(type);
+        u16(1); // IN
+        u32(ttl);
+        u16(rdata.size());
+        d_.append(rdata);
+        const size_t offs = authority ? 8 : 6;
+        setU16(offs, getU16(offs) + 1);
+        return *this;
+    }
+
+    Message& name(const std::string& name) {
+        d_.append(encodeName(name));
+        return *this;
+    }
+
+    Message& u16(uint16_t val) {
+        d_.push_back(val >> 8);
+        d_.push_back(val & 0xff);
+        return *this;
+    }
+
+    Message& u32(uint32_t val) {
+        u16(val >> 16);
+        return u16(val & 0xffff);
+    }
+
+    Message& data(const std::string& data) {
+        d_.append(data);
+        return *this;
+    }
+
+    size_t size() const {
+        return d_.size();
+    }
+
+    const std::string& str() const {
+        return d_;
+    }
+
+    static std::string encodeName(const std::string& name) {
+        std::string s;
+        size_t pos = 0;
+        while (pos < name.size()) {
+            size_t end = name.find('.', pos);
+            if (end == std::string::npos) {
+                end = name.size();
+            }
+            s.push_back(end - pos);
+            s.append(name, pos, end - pos);
+            pos = end + 1;
+        }
+        s.push_back('\0');
+        return s;
+    }
+
+    static std::string pointer(size_t offs) {
+        std::string s;
+        s.push_back(0xc0 | (offs >> 8));
+        s.push_back(offs & 0xff);
+        return s;
+    }
+
+private:
+    std::string d_;
+
+    uint16_t getU16(size_t offs) const {
+        return ((uint16_t)(uint8_t)d_[offs] << 8) | (uint8_t)d_[offs + 1];
+    }
+
+    void setU16(size_t offs, uint16_t val) {
+        d_[offs] = val >> 8;
+        d_[offs + 1] = val & 0xff;
+    }
+};
+
+// Offset of the question name in a message
+const size_t QNAME_OFFSET = 12;
+
+std::string soaData(uint32_t minimum) {
+    std::string d = Message::encodeName("ns.example.com") + Message::encodeName("admin.example.com");
+    for (uint32_t val: { 1u /* SERIAL */, 7200u /* REFRESH */, 3600u /* RETRY */, 86400u /* EXPIRE */, minimum }) {
+        for (int i = 3; i >= 0; --i) {
+            d.push_back((val >> (i * 8)) & 0xff);
+        }
+    }
+    return d;
+}
+
+ip_addr_t ip4(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    ip_addr_t addr = {};
+    IP_ADDR4(&addr, a, b, c, d);
+    return addr;
+}
+
+int processResponse(const Message& m) {
+    return DnsCache::instance()->processResponse(m.str().data(), m.size());
+}
+
+// Returns the result of a lookup performed after the response has been confirmed by the resolver
+DnsCache::Result confirmAndLookup(const char* name, uint8_t addrType, const ip_addr_t* addr, uint32_t* ttl = nullptr) {
+    const auto cache = DnsCache::instance();
+    cache->confirm(name, addrType, addr);
+    ip_addr_t a = {};
+    const auto r = cache->lookup(name, addrType, &a, ttl);
+    if (r == DnsCache::FOUND) {
+        CHECK(ip_addr_cmp(&a, addr));
+    }
+    return r;
+}
+
+} // namespace
+
+TEST_CASE("DnsCache") {
+    const auto cache = DnsCache::instance();
+    cache->clear();
+    test::setMillis(1000);
+
+    SECTION("an address is cached after the response has been confirmed") {
+        Message m;
+        m.question("www.example.com", 1 /* A */);
+        m.record(Message::pointer(QNAME_OFFSET), 1 /* A */, 3600, std::string("\x01\x02\x03\x04", 4));
+        REQUIRE(processResponse(m) == 0);
+        CHECK(cache->lookup("www.example.com", LWIP_DNS_ADDRTYPE_IPV4, nullptr) == DnsCache::MISS);
+        const auto addr = ip4(1, 2, 3, 4);
+        uint32_t ttl = 0;
+        CHECK(confirmAndLookup("WWW.Example.com", LWIP_DNS_ADDRTYPE_IPV4, &addr, &ttl) == DnsCache::FOUND);
+        CHECK(ttl == 3600);
+        CHECK(cache->lookup("www.example.com", LWIP_DNS_ADDRTYPE_IPV6, nullptr) == DnsCache::MISS);
+        test::advanceMillis(3600 * 1000);
+        CHECK(cache->lookup("www.example.com", LWIP_DNS_ADDRTYPE_IPV4, nullptr) == DnsCache::MISS);
+    }
+
+    SECTION("a response that doesn't match the result of the lookup is discarded") {
+        Message m;
+        m.question("www.example.com", 1 /* A */);
+        m.record(Message::pointer(QNAME_OFFSET), 1 /* A */, 3600, std::string("\x01\x02\x03\x04", 4));
+        REQUIRE(processResponse(m) == 0);
+        const auto addr = ip4(5, 6, 7, 8);
+        CHECK(confirmAndLookup("www.example.com", LWIP_DNS_ADDRTYPE_IPV4, &addr) == DnsCache::MISS);
+        CHECK(confirmAndLookup("www.example.com", LWIP_DNS_ADDRTYPE_IPV4, nullptr) == DnsCache::MISS);
+    }
+
+    SECTION("the CNAME chain is followed and the smallest TTL is used") {
+        Message m;
+        m.question("www.example.com", 1 /* A */);
+        const size_t cnameOffs = m.size();
+        m.record(Message::pointer(QNAME_OFFSET), 5 /* CNAME */, 600, Message::encodeName("edge.cdn.net"));
+        // Points to the RDATA of the CNAME record
+        const size_t targetOffs = cnameOffs + 2 /* NAME */ + 10 /* TYPE ... RDLENGTH */;
+        m.record(Message::encodeName("unrelated.net"), 1 /* A */, 3600, std::string("\x09\x09\x09\x09", 4));
+        m.record(Message::pointer(targetOffs), 1 /* A */, 3600, std::string("\x01\x02\x03\x04", 4));
+        REQUIRE(processResponse(m) == 0);
+        const auto addr = ip4(1, 2, 3, 4);
+        uint32_t ttl = 0;
+        CHECK(confirmAndLookup("www.example.com", LWIP_DNS_ADDRTYPE_IPV4, &addr, &ttl) == DnsCache::FOUND);
+        CHECK(ttl == 600);
+    }
+
+    SECTION("a NODATA response is cached for the negative TTL of the SOA record") {
+        Message m;
+        m.question("www.example.com", 28 /* AAAA */);
+        m.record(Message::encodeName("example.com"), 6 /* SOA */, 900, soaData(120), true /* authority */);
+        REQUIRE(processResponse(m) == 0);
+        uint32_t ttl = 0;
+        CHECK(confirmAndLookup("www.example.com", LWIP_DNS_ADDRTYPE_IPV6, nullptr, &ttl) == DnsCache::NOT_FOUND);
+        CHECK(ttl == 120);
+        // Addresses of the other type are not affected
+        CHECK(cache->lookup("www.example.com", LWIP_DNS_ADDRTYPE_IPV4, nullptr) == DnsCache::MISS);
+        test::advanceMillis(120 * 1000);
+        CHECK(cache->lookup("www.example.com", LWIP_DNS_ADDRTYPE_IPV6, nullptr) == DnsCache::MISS);
+    }
+
+    SECTION("an NXDOMAIN response is cached for both address types") {
+        Message m(0x8183 /* QR, RD, RA, NXDOMAIN */);
+        m.question("nx.example.com", 1 /* A */);
+        m.record(Message::encodeName("example.com"), 6 /* SOA */, 86400, soaData(86400), true /* authority */);
+        REQUIRE(processResponse(m) == 0);
+        uint32_t ttl = 0;
+        CHECK(confirmAndLookup("nx.example.com", LWIP_DNS_ADDRTYPE_IPV4, nullptr, &ttl) == DnsCache::NOT_FOUND);
+        CHECK(ttl == (uint32_t)DnsCache::MAX_NEGATIVE_TTL);
+        CHECK(cache->lookup("nx.example.com", LWIP_DNS_ADDRTYPE_IPV6, nullptr) == DnsCache::NOT_FOUND);
+    }
+
+    SECTION("a negative response without an SOA record is not cached") {
+        Message m;
+        m.question("www.example.com", 28 /* AAAA */);
+        CHECK(processResponse(m) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(confirmAndLookup("www.example.com", LWIP_DNS_ADDRTYPE_IPV6, nullptr) == DnsCache::MISS);
+    }
+
+    SECTION("truncated messages are rejected") {
+        Message m;
+        m.question("www.example.com", 1 /* A */);
+        m.record(Message::pointer(QNAME_OFFSET), 5 /* CNAME */, 600, Message::encodeName("edge.cdn.net"));
+        m.record(Message::encodeName("edge.cdn.net"), 1 /* A */, 3600, std::string("\x01\x02\x03\x04", 4));
+        const auto& d = m.str();
+        for (size_t size = 0; size < d.size(); ++size) {
+            CATCH_CAPTURE(size);
+            CHECK(cache->processResponse(d.data(), size) == SYSTEM_ERROR_BAD_DATA);
+        }
+        const auto addr = ip4(1, 2, 3, 4);
+        CHECK(confirmAndLookup("www.example.com", LWIP_DNS_ADDRTYPE_IPV4, &addr) == DnsCache::MISS);
+    }
+
+    SECTION("a name with a compression pointer loop is rejected") {
+        // Points to itself
+        Message m1;
+        m1.data(Message::pointer(QNAME_OFFSET)).u16(1 /* A */).u16(1 /* IN */);
+        CHECK(processResponse(m1) == SYSTEM_ERROR_BAD_DATA);
+        // Points to the beginning of the name
+        Message m2;
+        m2.data("\x03" "abc" + Message::pointer(QNAME_OFFSET)).u16(1 /* A */).u16(1 /* IN */);
+        CHECK(processResponse(m2) == SYSTEM_ERROR_BAD_DATA);
+        // A record name that points to itself
+        Message m3;
+        m3.question("www.example.com", 1 /* A */);
+        m3.record(Message::pointer(m3.size()), 1 /* A */, 3600, std::string("\x01\x02\x03\x04", 4));
+        CHECK(processResponse(m3) == SYSTEM_ERROR_BAD_DATA);
+        // Points past the end of the message
+        Message m4;
+        m4.data(Message::pointer(0x3fff)).u16(1 /* A */).u16(1 /* IN */);
+        CHECK(processResponse(m4) == SYSTEM_ERROR_BAD_DATA);
+    }
+
+    SECTION("the number of compression pointers in a name is limited") {
+        // Creates a message with a question name that is reached via a chain of pointers. The
+        // message has no answers
+        const auto message = [](unsigned ptrs) {
+            Message m;
+            const size_t chainOffs = QNAME_OFFSET + 6 /* QNAME ... QCLASS */;
+            m.data(Message::pointer(chainOffs)).u16(1 /* A */).u16(1 /* IN */);
+            for (unsigned i = 1; i < ptrs; ++i) {
+                m.data(Message::pointer(m.size() + 2));
+            }
+            m.name("www.example.com");
+            return m;
+        };
+        CHECK(processResponse(message(1)) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(processResponse(message(16)) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(processResponse(message(17)) == SYSTEM_ERROR_BAD_DATA);
+    }
+
+    SECTION("a name that is too long is rejected") {
+        const std::string maxName = std::string(63, 'a') + '.' + std::string(62, 'b') + ".c";
+        REQUIRE(maxName.size() == DNS_MAX_NAME_LENGTH);
+        Message m1;
+        m1.question(maxName, 1 /* A */);
+        m1.record(Message::pointer(QNAME_OFFSET), 1 /* A */, 3600, std::string("\x01\x02\x03\x04", 4));
+        CHECK(processResponse(m1) == 0);
+        Message m2;
+        m2.question(maxName + 'c', 1 /* A */);
+        m2.record(Message::pointer(QNAME_OFFSET), 1 /* A */, 3600, std::string("\x01\x02\x03\x04", 4));
+        CHECK(processResponse(m2) == SYSTEM_ERROR_TOO_LARGE);
+    }
+
+    SECTION("a label with reserved type bits is rejected") {
+        Message m;
+        m.data(std::string("\x41" "a\0", 3)).u16(1 /* A */).u16(1 /* IN */);
+        CHECK(processResponse(m) == SYSTEM_ERROR_BAD_DATA);
+    }
+}
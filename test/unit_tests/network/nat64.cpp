@@ -0,0 +1,426 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nat64.h"
+#include "catch.h"
+
+#include "lwip/prot/tcp.h"
+
+#include <string>
+#include <vector>
+
+using namespace particle::net::nat;
+
+namespace {
+
+struct Entry {
+    explicit Entry(int key = 0) :
+            key(key),
+            next1(nullptr),
+            next2(nullptr) {
+    }
+
+    int key;
+    Entry* next1;
+    Entry* next2;
+};
+
+const size_t INDEX_SIZE = 4;
+
+typedef HashIndex<Entry, &Entry::next1, INDEX_SIZE> Index1;
+typedef HashIndex<Entry, &Entry::next2, INDEX_SIZE> Index2;
+
+// Entries with keys that differ by a multiple of INDEX_SIZE share a bucket
+template<typename IndexT>
+Entry* find(const IndexT& index, int key) {
+    return index.find(key, [key](const Entry* e) {
+        return e->key == key;
+    });
+}
+
+// Returns the order in which the sessions would be expired
+std::vector<SessionEntry*> expiryOrder(const SessionExpiryList& list) {
+    std::vector<SessionEntry*> v;
+    for (auto s = list.front(); s; s = s->nextExpiry) {
+        v.push_back(s);
+    }
+    return v;
+}
+
+// Computes an Internet checksum (RFC 1071). The result is in network byte order
+uint16_t checksum(const std::string& data) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < data.size(); i += 2) {
+        uint16_t w = 0;
+        memcpy(&w, data.data() + i, std::min<size_t>(data.size() - i, 2));
+        sum += w;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return ~sum;
+}
+
+// Creates a string from a literal that may contain null characters
+template<size_t N>
+std::string bytes(const char (&str)[N]) {
+    return std::string(str, N - 1);
+}
+
+std::string u16(uint16_t val) {
+    return std::string({ (char)(val >> 8), (char)(val & 0xff) });
+}
+
+// Creates a TCP SYN segment with the given options and a valid checksum
+std::string tcpSegment(const std::string& options, const std::string& payload = std::string()) {
+    REQUIRE(options.size() % 4 == 0);
+    tcp_hdr h = {};
+    h.src = lwip_htons(1234);
+    h.dest = lwip_htons(80);
+    TCPH_HDRLEN_FLAGS_SET(&h, (TCP_HLEN + options.size()) / 4, TCP_SYN);
+    std::string s((const char*)&h, sizeof(h));
+    s += options;
+    s += payload;
+    const uint16_t chksum = checksum(s);
+    memcpy(&s[offsetof(tcp_hdr, chksum)], &chksum, sizeof(chksum));
+    return s;
+}
+
+std::string mssOption(uint16_t mss) {
+    return "\x02\x04" + u16(mss);
+}
+
+uint16_t clampMss(std::string* segment, uint16_t maxMss, bool* clamped = nullptr) {
+    const bool r = tcpClampMss((uint8_t*)&segment->at(0), segment->size(), maxMss);
+    if (clamped) {
+        *clamped = r;
+    }
+    // The checksum of the modified segment must be valid
+    CHECK(checksum(*segment) == 0);
+    const auto pos = segment->find("\x02\x04");
+    if (pos == std::string::npos) {
+        return 0;
+    }
+    return ((uint16_t)(uint8_t)segment->at(pos + 2) << 8) | (uint8_t)segment->at(pos + 3);
+}
+
+} // namespace
+
+TEST_CASE("HashIndex") {
+    std::vector<Entry> entries;
+    for (int i = 0; i < 12; ++i) {
+        entries.emplace_back(i);
+    }
+    Index1 index;
+
+    SECTION("entries with colliding hashes can be found") {
+        for (auto& e: entries) {
+            index.insert(&e, e.key);
+        }
+        for (auto& e: entries) {
+            CHECK(find(index, e.key) == &e);
+        }
+        // An entry is only looked up in the bucket of its hash
+        CHECK(index.find(1, [](const Entry* e) { return e->key == 2; }) == nullptr);
+        CHECK(find(index, 12) == nullptr);
+    }
+
+    SECTION("removing an entry doesn't affect the other entries of the bucket") {
+        for (auto& e: entries) {
+            index.insert(&e, e.key);
+        }
+        // The bucket of the hash 0 contains the entries 8, 4, 0 in this order
+        CHECK(index.remove(&entries[4], 4));
+        CHECK(entries[4].next1 == nullptr);
+        CHECK(find(index, 4) == nullptr);
+        CHECK(find(index, 0) == &entries[0]);
+        CHECK(find(index, 8) == &entries[8]);
+        CHECK(index.remove(&entries[8], 8));
+        CHECK(find(index, 0) == &entries[0]);
+        CHECK(index.remove(&entries[0], 0));
+        CHECK(find(index, 0) == nullptr);
+        CHECK(find(index, 8) == nullptr);
+        // The other buckets are not affected
+        for (int i = 1; i < 12; ++i) {
+            if (i % INDEX_SIZE != 0) {
+                CHECK(find(index, i) == &entries[i]);
+            }
+        }
+    }
+
+    SECTION("an entry that is not in the index is not removed") {
+        index.insert(&entries[0], 0);
+        index.insert(&entries[4], 4);
+        CHECK_FALSE(index.remove(&entries[8], 8));
+        // Wrong hash
+        CHECK_FALSE(index.remove(&entries[4], 5));
+        CHECK(find(index, 0) == &entries[0]);
+        CHECK(find(index, 4) == &entries[4]);
+        CHECK(index.remove(&entries[4], 4));
+        CHECK_FALSE(index.remove(&entries[4], 4));
+    }
+
+    SECTION("a removed entry can be inserted again") {
+        index.insert(&entries[0], 0);
+        index.insert(&entries[4], 4);
+        index.insert(&entries[8], 8);
+        CHECK(index.remove(&entries[4], 4));
+        index.insert(&entries[4], 4);
+        CHECK(find(index, 0) == &entries[0]);
+        CHECK(find(index, 4) == &entries[4]);
+        CHECK(find(index, 8) == &entries[8]);
+    }
+
+    SECTION("an entry can be in multiple indexes with different hashes") {
+        Index2 index2;
+        for (auto& e: entries) {
+            index.insert(&e, e.key);
+            index2.insert(&e, e.key / INDEX_SIZE);
+        }
+        CHECK(index.remove(&entries[5], 5));
+        CHECK(find(index, 5) == nullptr);
+        CHECK(index2.find(1, [](const Entry* e) { return e->key == 5; }) == &entries[5]);
+        CHECK(find(index, 1) == &entries[1]);
+        CHECK(find(index, 9) == &entries[9]);
+    }
+}
+
+TEST_CASE("SessionExpiryList") {
+    Ip6TransportAddress addr6;
+    Ip4TransportAddress addr4;
+    BibEntry bib(addr6, addr4, L4_PROTO_UDP);
+    std::vector<SessionEntry> s(4, SessionEntry(&bib, addr6));
+    SessionExpiryList list;
+
+    SECTION("an empty list") {
+        CHECK(list.front() == nullptr);
+    }
+
+    SECTION("sessions are expired in the order they were added") {
+        for (auto& sess: s) {
+            list.pushBack(&sess);
+        }
+        CHECK(expiryOrder(list) == std::vector<SessionEntry*>({ &s[0], &s[1], &s[2], &s[3] }));
+        for (auto& sess: s) {
+            CHECK(list.front() == &sess);
+            list.remove(&sess);
+        }
+        CHECK(list.front() == nullptr);
+    }
+
+    SECTION("a refreshed session is moved to the back of the list") {
+        for (auto& sess: s) {
+            list.pushBack(&sess);
+        }
+        // Front
+        list.remove(&s[0]);
+        list.pushBack(&s[0]);
+        CHECK(expiryOrder(list) == std::vector<SessionEntry*>({ &s[1], &s[2], &s[3], &s[0] }));
+        // Middle
+        list.remove(&s[2]);
+        list.pushBack(&s[2]);
+        CHECK(expiryOrder(list) == std::vector<SessionEntry*>({ &s[1], &s[3], &s[0], &s[2] }));
+        // Back
+        list.remove(&s[2]);
+        list.pushBack(&s[2]);
+        CHECK(expiryOrder(list) == std::vector<SessionEntry*>({ &s[1], &s[3], &s[0], &s[2] }));
+    }
+
+    SECTION("sessions can be removed from any position") {
+        for (auto& sess: s) {
+            list.pushBack(&sess);
+        }
+        list.remove(&s[2]);
+        CHECK(s[2].prevExpiry == nullptr);
+        CHECK(s[2].nextExpiry == nullptr);
+        CHECK(expiryOrder(list) == std::vector<SessionEntry*>({ &s[0], &s[1], &s[3] }));
+        list.remove(&s[3]);
+        CHECK(expiryOrder(list) == std::vector<SessionEntry*>({ &s[0], &s[1] }));
+        list.remove(&s[0]);
+        CHECK(expiryOrder(list) == std::vector<SessionEntry*>({ &s[1] }));
+        // The list can be used normally after it becomes empty
+        list.remove(&s[1]);
+        CHECK(list.front() == nullptr);
+        list.pushBack(&s[3]);
+        list.pushBack(&s[0]);
+        CHECK(expiryOrder(list) == std::vector<SessionEntry*>({ &s[3], &s[0] }));
+    }
+
+    SECTION("the expiration time is compared correctly when the time counter wraps around") {
+        s[0].setExpiry(0xfffffff0);
+        CHECK_FALSE(s[0].expired(0xffffffe0));
+        CHECK(s[0].expired(0xfffffff0));
+        CHECK(s[0].expired(0x00000010));
+        s[1].setExpiry(0x00000010);
+        CHECK_FALSE(s[1].expired(0xfffffff0));
+        CHECK(s[1].expired(0x00000010));
+    }
+}
+
+TEST_CASE("tcpNextState()") {
+    const uint8_t SYN = TCP_SYN;
+    const uint8_t SYN_ACK = TCP_SYN | TCP_ACK;
+    const uint8_t ACK = TCP_ACK;
+    const uint8_t FIN = TCP_FIN | TCP_ACK;
+    const uint8_t RST = TCP_RST;
+    const bool V6 = true;
+    const bool V4 = false;
+
+    SECTION("a connection is established by a SYN from the IPv4 side") {
+        CHECK(tcpNextState(TCP_STATE_V6_INIT, V6, SYN) == TCP_STATE_V6_INIT); // Retransmission
+        CHECK(tcpNextState(TCP_STATE_V6_INIT, V6, ACK) == TCP_STATE_V6_INIT);
+        CHECK(tcpNextState(TCP_STATE_V6_INIT, V4, ACK) == TCP_STATE_V6_INIT);
+        CHECK(tcpNextState(TCP_STATE_V6_INIT, V4, SYN_ACK) == TCP_STATE_ESTABLISHED);
+        CHECK(tcpNextState(TCP_STATE_ESTABLISHED, V6, ACK) == TCP_STATE_ESTABLISHED);
+        CHECK(tcpNextState(TCP_STATE_ESTABLISHED, V4, ACK) == TCP_STATE_ESTABLISHED);
+    }
+
+    SECTION("a connection is closed by a FIN from each side") {
+        CHECK(tcpNextState(TCP_STATE_ESTABLISHED, V6, FIN) == TCP_STATE_V6_FIN_RCV);
+        CHECK(tcpNextState(TCP_STATE_V6_FIN_RCV, V6, FIN) == TCP_STATE_V6_FIN_RCV);
+        CHECK(tcpNextState(TCP_STATE_V6_FIN_RCV, V4, ACK) == TCP_STATE_V6_FIN_RCV);
+        CHECK(tcpNextState(TCP_STATE_V6_FIN_RCV, V4, FIN) == TCP_STATE_V4_FIN_V6_FIN_RCV);
+
+        CHECK(tcpNextState(TCP_STATE_ESTABLISHED, V4, FIN) == TCP_STATE_V4_FIN_RCV);
+        CHECK(tcpNextState(TCP_STATE_V4_FIN_RCV, V4, FIN) == TCP_STATE_V4_FIN_RCV);
+        CHECK(tcpNextState(TCP_STATE_V4_FIN_RCV, V6, ACK) == TCP_STATE_V4_FIN_RCV);
+        CHECK(tcpNextState(TCP_STATE_V4_FIN_RCV, V6, FIN) == TCP_STATE_V4_FIN_V6_FIN_RCV);
+
+        CHECK(tcpNextState(TCP_STATE_V4_FIN_V6_FIN_RCV, V6, ACK) == TCP_STATE_V4_FIN_V6_FIN_RCV);
+        CHECK(tcpNextState(TCP_STATE_V4_FIN_V6_FIN_RCV, V4, FIN) == TCP_STATE_V4_FIN_V6_FIN_RCV);
+    }
+
+    SECTION("a RST moves an established connection to the transitory state") {
+        for (auto state: { TCP_STATE_ESTABLISHED, TCP_STATE_V4_FIN_RCV, TCP_STATE_V6_FIN_RCV, TCP_STATE_V4_FIN_V6_FIN_RCV, TCP_STATE_TRANS }) {
+            CHECK(tcpNextState(state, V6, RST) == TCP_STATE_TRANS);
+            CHECK(tcpNextState(state, V4, RST | TCP_ACK) == TCP_STATE_TRANS);
+        }
+        // A RST doesn't establish a connection
+        CHECK(tcpNextState(TCP_STATE_V6_INIT, V4, RST) == TCP_STATE_V6_INIT);
+        CHECK(tcpNextState(TCP_STATE_V6_INIT, V4, RST | SYN) == TCP_STATE_V6_INIT);
+    }
+
+    SECTION("any other segment moves a connection in the transitory state back to the established state") {
+        CHECK(tcpNextState(TCP_STATE_TRANS, V6, ACK) == TCP_STATE_ESTABLISHED);
+        CHECK(tcpNextState(TCP_STATE_TRANS, V4, ACK) == TCP_STATE_ESTABLISHED);
+        CHECK(tcpNextState(TCP_STATE_TRANS, V4, FIN) == TCP_STATE_ESTABLISHED);
+    }
+}
+
+TEST_CASE("tcpClampMss()") {
+    const uint16_t MAX_MSS = 1280 - 40 /* IPv6 header */ - TCP_HLEN;
+
+    SECTION("the MSS option is clamped and the checksum is updated") {
+        auto s = tcpSegment(mssOption(1460));
+        bool clamped = false;
+        CHECK(clampMss(&s, MAX_MSS, &clamped) == MAX_MSS);
+        CHECK(clamped);
+    }
+
+    SECTION("an MSS that is not greater than the maximum value is not modified") {
+        auto s = tcpSegment(mssOption(MAX_MSS));
+        const auto orig = s;
+        bool clamped = true;
+        CHECK(clampMss(&s, MAX_MSS, &clamped) == MAX_MSS);
+        CHECK_FALSE(clamped);
+        CHECK(s == orig);
+    }
+
+    SECTION("the MSS option can follow other options at any alignment") {
+        const std::string opts[] = {
+            bytes("\x01") + mssOption(1460) + bytes("\x01\x01\x01"), // NOP
+            bytes("\x01\x03\x03\x07") + mssOption(1460), // NOP, window scale
+            bytes("\x04\x02\x01") + mssOption(1460) + bytes("\x00"), // SACK permitted, NOP
+            bytes("\x01\x01\x08\x0a") + std::string(8, '\x5a') + mssOption(0xffff) // NOP, NOP, timestamps
+        };
+        for (const auto& opt: opts) {
+            auto s = tcpSegment(opt, "payload");
+            bool clamped = false;
+            CHECK(clampMss(&s, MAX_MSS, &clamped) == MAX_MSS);
+            CHECK(clamped);
+        }
+    }
+
+    SECTION("a segment without a valid MSS option is not modified") {
+        const std::string opts[] = {
+            "", // No options
+            bytes("\x01\x03\x03\x07"), // No MSS option
+            bytes("\x00\x01\x01\x01") + mssOption(1460), // MSS option after the end of the option list
+            bytes("\x02\x03\x05\xb4"), // Invalid length
+            bytes("\x01\x01\x05\x06") + mssOption(1460), // MSS option is a part of another option
+            bytes("\x01\x05\x00\x00") + mssOption(1460), // Zero option length
+            bytes("\x01\x01\x01\x02") // Truncated option
+        };
+        for (const auto& opt: opts) {
+            auto s = tcpSegment(opt);
+            const auto orig = s;
+            bool clamped = true;
+            clampMss(&s, MAX_MSS, &clamped);
+            CHECK_FALSE(clamped);
+            CHECK(s == orig);
+        }
+    }
+
+    SECTION("the options are not parsed if the header length is invalid") {
+        auto s = tcpSegment(mssOption(1460));
+        const auto orig = s;
+        // Header is longer than the segment
+        CHECK_FALSE(tcpClampMss((uint8_t*)&s[0], s.size() - 1, MAX_MSS));
+        CHECK_FALSE(tcpClampMss((uint8_t*)&s[0], TCP_HLEN - 1, MAX_MSS));
+        // Header is shorter than the fixed part of the header
+        tcp_hdr* h = (tcp_hdr*)&s[0];
+        TCPH_HDRLEN_FLAGS_SET(h, 4, TCP_SYN);
+        CHECK_FALSE(tcpClampMss((uint8_t*)&s[0], s.size(), MAX_MSS));
+        TCPH_HDRLEN_FLAGS_SET(h, 6, TCP_SYN);
+        CHECK(s == orig);
+    }
+}
+
+TEST_CASE("updateChecksum()") {
+    SECTION("the checksum is updated when the addresses and ports are translated") {
+        // IPv6 pseudo-header
+        const std::string src6("\x20\x01\x0d\xb8\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01", 16);
+        const std::string dst6("\x00\x64\xff\x9b\x00\x00\x00\x00\x00\x00\x00\x00\xc0\x00\x02\x21", 16);
+        const std::string seg = tcpSegment(mssOption(1220), "some data");
+        const std::string len32 = u16(0) + u16(seg.size());
+        const std::string pseudo6 = src6 + dst6 + len32 + std::string("\x00\x00\x00\x06", 4);
+        // IPv4 pseudo-header
+        const std::string src4("\xc0\xa8\x01\x02", 4);
+        const std::string dst4("\xc0\x00\x02\x21", 4);
+        const std::string pseudo4 = src4 + dst4 + std::string("\x00\x06", 2) + u16(seg.size());
+        // Source port is translated
+        std::string seg6 = seg;
+        uint16_t chksum6 = 0;
+        memcpy(&seg6[offsetof(tcp_hdr, chksum)], &chksum6, 2);
+        chksum6 = checksum(pseudo6 + seg6);
+        memcpy(&seg6[offsetof(tcp_hdr, chksum)], &chksum6, 2);
+        std::string seg4 = seg6;
+        seg4.replace(0, 2, u16(31000));
+
+        uint16_t chksum = chksum6;
+        chksum = updateChecksum(chksum, src6.data(), src6.size(), src4.data(), src4.size());
+        chksum = updateChecksum(chksum, dst6.data(), dst6.size(), dst4.data(), dst4.size());
+        chksum = updateChecksum(chksum, seg6.data(), 2, seg4.data(), 2);
+        memcpy(&seg4[offsetof(tcp_hdr, chksum)], &chksum, 2);
+        CHECK(checksum(pseudo4 + seg4) == 0);
+        // And back
+        chksum = updateChecksum(chksum, src4.data(), src4.size(), src6.data(), src6.size());
+        chksum = updateChecksum(chksum, dst4.data(), dst4.size(), dst6.data(), dst6.size());
+        chksum = updateChecksum(chksum, seg4.data(), 2, seg6.data(), 2);
+        CHECK(chksum == chksum6);
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+// HAL and lwIP functions used by the tested networking code
+
+#include "network_stubs.h"
+
+#include "timer_hal.h"
+
+#include "lwip/dns.h"
+#include "lwip/pbuf.h"
+
+#include <cstring>
+
+namespace {
+
+uint32_t g_millis = 0;
+
+} // namespace
+
+void test::setMillis(uint32_t millis) {
+    g_millis = millis;
+}
+
+void test::advanceMillis(uint32_t millis) {
+    g_millis += millis;
+}
+
+system_tick_t HAL_Timer_Get_Milli_Seconds() {
+    return g_millis;
+}
+
+const ip_addr_t* dns_getserver(u8_t numdns) {
+    static const ip_addr_t addr = {};
+    return &addr;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf* p, void* dataptr, u16_t len, u16_t offset) {
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LWIP_LWIPOPTS_H
+#define LWIP_LWIPOPTS_H
+
+/*
+ * lwIP configuration used by the unit tests. Only the headers of the stack are used, so the
+ * relevant options are kept in sync with hal/src/nRF52840/lwip/lwipopts.h
+ */
+
+#define NO_SYS                          1
+#define LWIP_NETCONN                    0
+#define LWIP_SOCKET                     0
+
+#define LOCK_TCPIP_CORE()
+#define UNLOCK_TCPIP_CORE()
+
+#define LWIP_IPV4                       1
+#define LWIP_IPV6                       1
+#define LWIP_UDP                        1
+#define LWIP_TCP                        1
+
+#define LWIP_DNS                        1
+#define DNS_MAX_NAME_LENGTH             128
+#define DNS_MAX_SERVERS                 2
+
+#endif /* LWIP_LWIPOPTS_H */
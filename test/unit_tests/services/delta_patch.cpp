@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "delta_patch.h"
+#include "system_error.h"
+#include "timer_hal.h"
+#include "catch.h"
+
+#include <string>
+#include <vector>
+
+using namespace particle;
+
+system_tick_t HAL_Timer_Get_Milli_Seconds() {
+    return 0;
+}
+
+namespace {
+
+class StringOutputStream: public OutputStream {
+public:
+    int write(const char* data, size_t size) override {
+        str.append(data, size);
+        return size;
+    }
+
+    int flush() override {
+        return 0;
+    }
+
+    int availForWrite() override {
+        return 1024;
+    }
+
+    int waitEvent(unsigned flags, unsigned timeout) override {
+        return 0;
+    }
+
+    std::string str;
+};
+
+class Patch {
+public:
+    Patch& copy(uint32_t offs, uint32_t size) {
+        data_.push_back(DeltaPatchStream::COPY);
+        append(offs);
+        append(size);
+        return *this;
+    }
+
+    Patch& add(uint32_t offs, const std::string& diff) {
+        data_.push_back(DeltaPatchStream::ADD);
+        append(offs);
+        append(diff.size());
+        data_.insert(data_.end(), diff.begin(), diff.end());
+        return *this;
+    }
+
+    Patch& insert(const std::string& str) {
+        data_.push_back(DeltaPatchStream::INSERT);
+        append(str.size());
+        data_.insert(data_.end(), str.begin(), str.end());
+        return *this;
+    }
+
+    Patch& end() {
+        data_.push_back(DeltaPatchStream::END);
+        return *this;
+    }
+
+    const char* data() const {
+        return data_.data();
+    }
+
+    size_t size() const {
+        return data_.size();
+    }
+
+private:
+    std::vector<char> data_;
+
+    void append(uint32_t val) {
+        for (int i = 0; i < 4; ++i) {
+            data_.push_back((char)((val >> (i * 8)) & 0xff));
+        }
+    }
+};
+
+int applyPatch(const std::string& source, const Patch& patch, std::string* result, size_t blockSize) {
+    StringOutputStream out;
+    DeltaPatchStream strm((const uint8_t*)source.data(), source.size(), &out);
+    for (size_t offs = 0; offs < patch.size(); offs += blockSize) {
+        const int ret = strm.write(patch.data() + offs, std::min(blockSize, patch.size() - offs));
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    const int ret = strm.flush();
+    if (ret < 0) {
+        return ret;
+    }
+    if (!strm.done() || strm.written() != out.str.size()) {
+        return SYSTEM_ERROR_NOT_ENOUGH_DATA;
+    }
+    *result = out.str;
+    return 0;
+}
+
+} // unnamed
+
+TEST_CASE("DeltaPatchStream") {
+    const std::string source = "Hello, world!";
+    std::string result;
+
+    SECTION("reconstructs an image from the source") {
+        Patch p;
+        p.copy(0, 7).insert("brave new ").add(7, std::string("\x00\x00\x00\x00\x00\x01", 6)).end();
+        for (size_t blockSize: { 1, 3, 1024 }) {
+            REQUIRE(applyPatch(source, p, &result, blockSize) == 0);
+            CHECK(result == "Hello, brave new world\"");
+        }
+    }
+    SECTION("an empty patch produces an empty image") {
+        Patch p;
+        p.end();
+        REQUIRE(applyPatch(source, p, &result, 16) == 0);
+        CHECK(result.empty());
+    }
+    SECTION("fails if a command refers to data outside of the source image") {
+        Patch p;
+        p.copy(10, 4).end();
+        CHECK(applyPatch(source, p, &result, 16) == SYSTEM_ERROR_OUT_OF_RANGE);
+        Patch p2;
+        p2.add(0xfffffff0, "abc").end();
+        CHECK(applyPatch(source, p2, &result, 16) == SYSTEM_ERROR_OUT_OF_RANGE);
+    }
+    SECTION("fails on an unknown command") {
+        Patch p;
+        p.insert("abc");
+        std::string data(p.data(), p.size());
+        data += '\x7f';
+        StringOutputStream out;
+        DeltaPatchStream strm((const uint8_t*)source.data(), source.size(), &out);
+        CHECK(strm.write(data.data(), data.size()) == SYSTEM_ERROR_BAD_DATA);
+    }
+    SECTION("fails if the patch is incomplete") {
+        Patch p;
+        p.copy(0, 4);
+        CHECK(applyPatch(source, p, &result, 16) == SYSTEM_ERROR_NOT_ENOUGH_DATA);
+    }
+    SECTION("fails if there's data after the end of the patch") {
+        Patch p;
+        p.end().insert("abc");
+        CHECK(applyPatch(source, p, &result, 16) == SYSTEM_ERROR_BAD_DATA);
+    }
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "file_queue.h"
+#include "system_error.h"
+#include "catch.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using particle::fs::FileQueue;
+
+namespace {
+
+const char* const QUEUE_PATH = "/queue";
+
+// Entry size that fits 4 entries into a segment
+const size_t ENTRY_DATA_SIZE = FileQueue::SEGMENT_SIZE / 4 - sizeof(FileQueue::QueueEntry);
+
+std::unique_ptr<FileQueue> openQueue() {
+    return std::unique_ptr<FileQueue>(new FileQueue(QUEUE_PATH));
+}
+
+std::string entryData(int n, size_t size = ENTRY_DATA_SIZE) {
+    std::string s = "entry " + std::to_string(n);
+    s.resize(size, '.');
+    return s;
+}
+
+int push(FileQueue* q, const std::string& data, bool sync = true) {
+    return q->pushBack(data.data(), data.size(), sync);
+}
+
+// Returns the data of the front entry or an empty string if the queue is empty
+std::string front(FileQueue* q) {
+    FileQueue::QueueEntry entry = {};
+    std::vector<char> buf(FileQueue::SEGMENT_SIZE);
+    const int r = q->front(entry, buf.data(), buf.size());
+    if (r == SYSTEM_ERROR_NOT_FOUND) {
+        return std::string();
+    }
+    REQUIRE(r == 0);
+    return std::string(buf.data(), entry.size - sizeof(FileQueue::QueueEntry));
+}
+
+std::string pop(FileQueue* q) {
+    const auto s = front(q);
+    REQUIRE(!s.empty());
+    REQUIRE(q->popFront() == 0);
+    return s;
+}
+
+bool fileExists(const std::string& path) {
+    lfs_info info = {};
+    return lfs_stat(&filesystem_get_instance(nullptr)->instance, path.c_str(), &info) == 0;
+}
+
+std::string segmentPath(unsigned segment) {
+    return std::string(QUEUE_PATH) + "." + std::to_string(segment);
+}
+
+// Returns the indices of the existing segment files
+std::vector<unsigned> segments() {
+    std::vector<unsigned> segs;
+    for (unsigned i = 0; i < 32; ++i) {
+        if (fileExists(segmentPath(i))) {
+            segs.push_back(i);
+        }
+    }
+    return segs;
+}
+
+// Writes a queue file in the format used by earlier versions of FileQueue
+void writeOldQueueFile(const std::vector<std::pair<std::string, bool>>& entries) {
+    std::string d;
+    for (const auto& e: entries) {
+        FileQueue::QueueEntry h = {};
+        h.size = sizeof(h) + e.first.size();
+        h.flags = e.second ? FileQueue::QueueEntry::ACTIVE : 0;
+        d.append((const char*)&h, sizeof(h));
+        d.append(e.first);
+    }
+    const auto lfs = &filesystem_get_instance(nullptr)->instance;
+    lfs_file_t file = {};
+    REQUIRE(lfs_file_open(lfs, &file, QUEUE_PATH, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) == 0);
+    REQUIRE(lfs_file_write(lfs, &file, d.data(), d.size()) == (lfs_ssize_t)d.size());
+    REQUIRE(lfs_file_close(lfs, &file) == 0);
+}
+
+} // namespace
+
+TEST_CASE("FileQueue") {
+    test::formatFilesystem();
+
+    SECTION("an empty queue") {
+        auto q = openQueue();
+        CHECK(front(q.get()).empty());
+        CHECK(q->popFront() == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(q->compact() == 0);
+        CHECK(segments().empty());
+    }
+
+    SECTION("entries are pushed and popped in order across segments") {
+        auto q = openQueue();
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(push(q.get(), entryData(i)) == 0);
+        }
+        CHECK(segments() == std::vector<unsigned>({ 0, 1, 2 }));
+        for (int i = 0; i < 5; ++i) {
+            CHECK(pop(q.get()) == entryData(i));
+        }
+        // Entries can be pushed while the queue is being consumed
+        REQUIRE(push(q.get(), entryData(10)) == 0);
+        for (int i = 5; i < 11; ++i) {
+            CHECK(pop(q.get()) == entryData(i));
+        }
+        CHECK(front(q.get()).empty());
+        // Popping the last entry removes all files of the queue
+        CHECK(segments().empty());
+        CHECK_FALSE(fileExists(std::string(QUEUE_PATH) + ".head"));
+    }
+
+    SECTION("entries of different sizes") {
+        auto q = openQueue();
+        REQUIRE(push(q.get(), "a") == 0);
+        REQUIRE(push(q.get(), entryData(1, 3000)) == 0);
+        REQUIRE(push(q.get(), entryData(2, 3000)) == 0);
+        REQUIRE(push(q.get(), std::string()) == 0);
+        REQUIRE(push(q.get(), "b") == 0);
+        CHECK(pop(q.get()) == "a");
+        CHECK(pop(q.get()) == entryData(1, 3000));
+        CHECK(pop(q.get()) == entryData(2, 3000));
+        // An empty entry can't be told apart from an empty queue by front(), so pop it directly
+        REQUIRE(q->popFront() == 0);
+        CHECK(pop(q.get()) == "b");
+        CHECK(front(q.get()).empty());
+    }
+
+    SECTION("an entry that doesn't fit into the buffer is not removed") {
+        auto q = openQueue();
+        REQUIRE(push(q.get(), "abcdef") == 0);
+        FileQueue::QueueEntry entry = {};
+        char buf[4] = {};
+        CHECK(q->front(entry, buf, sizeof(buf)) == SYSTEM_ERROR_TOO_LARGE);
+        CHECK(pop(q.get()) == "abcdef");
+    }
+
+    SECTION("the front entry is restored from the cursor file after a reset") {
+        auto q = openQueue();
+        for (int i = 0; i < 6; ++i) {
+            REQUIRE(push(q.get(), entryData(i)) == 0);
+        }
+        for (int i = 0; i < 5; ++i) {
+            CHECK(pop(q.get()) == entryData(i));
+        }
+        test::resetFilesystem();
+        q = openQueue();
+        CHECK(pop(q.get()) == entryData(5));
+        CHECK(front(q.get()).empty());
+    }
+
+    SECTION("entries that haven't been synced are lost after a reset") {
+        auto q = openQueue();
+        REQUIRE(push(q.get(), entryData(0)) == 0);
+        REQUIRE(push(q.get(), entryData(1), false /* sync */) == 0);
+        REQUIRE(push(q.get(), entryData(2), false /* sync */) == 0);
+        // Unsynced entries are visible to the reader
+        CHECK(front(q.get()) == entryData(0));
+        test::resetFilesystem();
+        q = openQueue();
+        CHECK(pop(q.get()) == entryData(0));
+        CHECK(front(q.get()).empty());
+        // The queue can be used normally afterwards
+        REQUIRE(push(q.get(), entryData(3), false /* sync */) == 0);
+        REQUIRE(q->sync() == 0);
+        test::resetFilesystem();
+        q = openQueue();
+        CHECK(pop(q.get()) == entryData(3));
+    }
+
+    SECTION("compact() removes the consumed segments") {
+        auto q = openQueue();
+        for (int i = 0; i < 12; ++i) {
+            REQUIRE(push(q.get(), entryData(i)) == 0);
+        }
+        for (int i = 0; i < 9; ++i) {
+            CHECK(pop(q.get()) == entryData(i));
+        }
+        // The head segment is not removed until it's consumed entirely
+        CHECK(segments() == std::vector<unsigned>({ 0, 1, 2 }));
+        REQUIRE(q->compact() == 0);
+        CHECK(segments() == std::vector<unsigned>({ 2 }));
+        test::resetFilesystem();
+        q = openQueue();
+        for (int i = 9; i < 12; ++i) {
+            CHECK(pop(q.get()) == entryData(i));
+        }
+        CHECK(front(q.get()).empty());
+    }
+
+    SECTION("popFront() compacts the queue when too many segments have been consumed") {
+        auto q = openQueue();
+        const int count = (FileQueue::MAX_CONSUMED_SEGMENTS + 2) * 4;
+        for (int i = 0; i < count; ++i) {
+            REQUIRE(push(q.get(), entryData(i)) == 0);
+        }
+        int i = 0;
+        while (fileExists(segmentPath(0))) {
+            CHECK(pop(q.get()) == entryData(i++));
+            REQUIRE(i < count);
+        }
+        // The queue is compacted when the front entry is in the segment following the consumed ones
+        CHECK(i == (int)(FileQueue::MAX_CONSUMED_SEGMENTS + 1) * 4 + 1);
+        CHECK(segments() == std::vector<unsigned>({ FileQueue::MAX_CONSUMED_SEGMENTS + 1 }));
+        while (i < count) {
+            CHECK(pop(q.get()) == entryData(i++));
+        }
+        CHECK(front(q.get()).empty());
+    }
+
+    SECTION("clear() removes all entries") {
+        auto q = openQueue();
+        for (int i = 0; i < 6; ++i) {
+            REQUIRE(push(q.get(), entryData(i)) == 0);
+        }
+        CHECK(pop(q.get()) == entryData(0));
+        REQUIRE(q->clear() == 0);
+        CHECK(front(q.get()).empty());
+        CHECK(segments().empty());
+        REQUIRE(push(q.get(), "a") == 0);
+        test::resetFilesystem();
+        q = openQueue();
+        CHECK(pop(q.get()) == "a");
+    }
+
+    SECTION("a queue file of an earlier version is converted to the first segment") {
+        writeOldQueueFile({ { "removed 1", false }, { "first", true }, { "removed 2", false }, { "second", true } });
+        auto q = openQueue();
+        CHECK(front(q.get()) == "first");
+        CHECK_FALSE(fileExists(QUEUE_PATH));
+        CHECK(segments() == std::vector<unsigned>({ 0 }));
+        REQUIRE(push(q.get(), "third") == 0);
+        CHECK(pop(q.get()) == "first");
+        test::resetFilesystem();
+        q = openQueue();
+        CHECK(pop(q.get()) == "second");
+        CHECK(pop(q.get()) == "third");
+        CHECK(front(q.get()).empty());
+    }
+}
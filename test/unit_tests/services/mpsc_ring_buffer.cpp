@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mpsc_ring_buffer.h"
+#include "catch.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+
+using namespace particle;
+
+namespace {
+
+bool put(MpscRingBuffer* buf, const std::string& str) {
+    const auto p = (char*)buf->acquire(str.size() + 1);
+    if (!p) {
+        return false;
+    }
+    memcpy(p, str.c_str(), str.size() + 1);
+    buf->commit(p);
+    return true;
+}
+
+std::string get(MpscRingBuffer* buf) {
+    const auto p = (const char*)buf->peek();
+    if (!p) {
+        return std::string();
+    }
+    const std::string str(p);
+    buf->release();
+    return str;
+}
+
+} // namespace
+
+TEST_CASE("MpscRingBuffer") {
+    MpscRingBuffer buf;
+
+    SECTION("capacity is rounded up to a power of two") {
+        REQUIRE(buf.init(100));
+        CHECK(buf.capacity() == 128);
+        CHECK(buf.isEmpty());
+        CHECK(buf.peek() == nullptr);
+    }
+
+    SECTION("records are consumed in the order they were added") {
+        REQUIRE(buf.init(256));
+        CHECK(put(&buf, "a"));
+        CHECK(put(&buf, "bc"));
+        CHECK(put(&buf, "def"));
+        CHECK(get(&buf) == "a");
+        CHECK(get(&buf) == "bc");
+        CHECK(get(&buf) == "def");
+        CHECK(buf.isEmpty());
+    }
+
+    SECTION("uncommitted record blocks the consumer") {
+        REQUIRE(buf.init(256));
+        const auto p1 = (char*)buf.acquire(2);
+        REQUIRE(p1);
+        CHECK(put(&buf, "b"));
+        CHECK(buf.peek() == nullptr);
+        strcpy(p1, "a");
+        buf.commit(p1);
+        CHECK(get(&buf) == "a");
+        CHECK(get(&buf) == "b");
+    }
+
+    SECTION("records wrap around the end of the buffer") {
+        REQUIRE(buf.init(128));
+        for (int i = 0; i < 100; ++i) {
+            const std::string str(i % 40, 'a' + i % 26);
+            REQUIRE(put(&buf, str));
+            REQUIRE(get(&buf) == str);
+        }
+        CHECK(buf.isEmpty());
+    }
+
+    SECTION("acquire() fails when the buffer is full") {
+        REQUIRE(buf.init(64));
+        int n = 0;
+        while (put(&buf, "abc")) {
+            ++n;
+        }
+        CHECK(n > 0);
+        CHECK(get(&buf) == "abc");
+        CHECK(put(&buf, "abc"));
+    }
+
+    SECTION("records larger than half of the buffer are rejected") {
+        REQUIRE(buf.init(64));
+        CHECK(buf.acquire(48) == nullptr);
+    }
+
+    SECTION("multiple producers") {
+        const int PRODUCERS = 4;
+        const int RECORDS = 10000;
+        REQUIRE(buf.init(1024));
+        std::vector<std::thread> threads;
+        for (int i = 0; i < PRODUCERS; ++i) {
+            threads.emplace_back([&buf, i]() {
+                for (int j = 0; j < RECORDS;) {
+                    const auto p = (int*)buf.acquire(sizeof(int) * 2);
+                    if (!p) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    p[0] = i;
+                    p[1] = j++;
+                    buf.commit(p);
+                }
+            });
+        }
+        std::vector<int> next(PRODUCERS, 0);
+        int count = 0;
+        while (count < PRODUCERS * RECORDS) {
+            const auto p = (const int*)buf.peek();
+            if (!p) {
+                std::this_thread::yield();
+                continue;
+            }
+            REQUIRE(p[0] >= 0);
+            REQUIRE(p[0] < PRODUCERS);
+            // Records of each producer are seen in order
+            REQUIRE(p[1] == next[p[0]]++);
+            buf.release();
+            ++count;
+        }
+        for (auto& t: threads) {
+            t.join();
+        }
+        CHECK(buf.isEmpty());
+    }
+}
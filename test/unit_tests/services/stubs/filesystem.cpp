@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filesystem.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+
+namespace {
+
+struct File {
+    std::string path;
+    std::vector<uint8_t> data; // Unsynced contents
+    size_t pos;
+    int flags;
+    bool valid;
+};
+
+std::map<std::string, std::vector<uint8_t>> g_files; // Synced contents
+std::set<std::string> g_dirs;
+std::set<File*> g_handles;
+filesystem_t g_fs = {};
+
+File* getFile(lfs_file_t* file) {
+    const auto f = static_cast<File*>(file->impl);
+    if (!f || !f->valid) {
+        return nullptr;
+    }
+    return f;
+}
+
+} // namespace
+
+int lfs_file_open(lfs_t* lfs, lfs_file_t* file, const char* path, int flags) {
+    auto it = g_files.find(path);
+    if (it == g_files.end()) {
+        if (!(flags & LFS_O_CREAT)) {
+            return LFS_ERR_NOENT;
+        }
+        it = g_files.insert(std::make_pair(std::string(path), std::vector<uint8_t>())).first;
+    } else if ((flags & LFS_O_CREAT) && (flags & LFS_O_EXCL)) {
+        return LFS_ERR_EXIST;
+    }
+    const auto f = new File();
+    f->path = path;
+    f->data = it->second;
+    f->pos = 0;
+    f->flags = flags;
+    f->valid = true;
+    if (flags & LFS_O_TRUNC) {
+        f->data.clear();
+    }
+    g_handles.insert(f);
+    file->impl = f;
+    return 0;
+}
+
+int lfs_file_close(lfs_t* lfs, lfs_file_t* file) {
+    const auto f = static_cast<File*>(file->impl);
+    if (!f) {
+        return LFS_ERR_INVAL;
+    }
+    int r = 0;
+    if (f->valid) {
+        r = lfs_file_sync(lfs, file);
+    }
+    g_handles.erase(f);
+    delete f;
+    file->impl = nullptr;
+    return r;
+}
+
+int lfs_file_sync(lfs_t* lfs, lfs_file_t* file) {
+    const auto f = getFile(file);
+    if (!f) {
+        return LFS_ERR_INVAL;
+    }
+    if ((f->flags & LFS_O_WRONLY) && g_files.count(f->path)) {
+        g_files[f->path] = f->data;
+    }
+    return 0;
+}
+
+lfs_ssize_t lfs_file_read(lfs_t* lfs, lfs_file_t* file, void* buffer, lfs_size_t size) {
+    const auto f = getFile(file);
+    if (!f || !(f->flags & LFS_O_RDONLY)) {
+        return LFS_ERR_INVAL;
+    }
+    if (f->pos >= f->data.size()) {
+        return 0;
+    }
+    size = std::min<size_t>(size, f->data.size() - f->pos);
+    memcpy(buffer, f->data.data() + f->pos, size);
+    f->pos += size;
+    return size;
+}
+
+lfs_ssize_t lfs_file_write(lfs_t* lfs, lfs_file_t* file, const void* buffer, lfs_size_t size) {
+    const auto f = getFile(file);
+    if (!f || !(f->flags & LFS_O_WRONLY)) {
+        return LFS_ERR_INVAL;
+    }
+    if (f->flags & LFS_O_APPEND) {
+        f->pos = f->data.size();
+    }
+    if (f->data.size() < f->pos + size) {
+        f->data.resize(f->pos + size);
+    }
+    memcpy(f->data.data() + f->pos, buffer, size);
+    f->pos += size;
+    return size;
+}
+
+lfs_soff_t lfs_file_seek(lfs_t* lfs, lfs_file_t* file, lfs_soff_t off, int whence) {
+    const auto f = getFile(file);
+    if (!f) {
+        return LFS_ERR_INVAL;
+    }
+    lfs_soff_t pos = off;
+    if (whence == LFS_SEEK_CUR) {
+        pos += f->pos;
+    } else if (whence == LFS_SEEK_END) {
+        pos += f->data.size();
+    }
+    if (pos < 0) {
+        return LFS_ERR_INVAL;
+    }
+    f->pos = pos;
+    return pos;
+}
+
+int lfs_file_truncate(lfs_t* lfs, lfs_file_t* file, lfs_size_t size) {
+    const auto f = getFile(file);
+    if (!f || !(f->flags & LFS_O_WRONLY)) {
+        return LFS_ERR_INVAL;
+    }
+    f->data.resize(size);
+    return 0;
+}
+
+lfs_soff_t lfs_file_size(lfs_t* lfs, lfs_file_t* file) {
+    const auto f = getFile(file);
+    if (!f) {
+        return LFS_ERR_INVAL;
+    }
+    return f->data.size();
+}
+
+int lfs_remove(lfs_t* lfs, const char* path) {
+    if (g_files.erase(path) || g_dirs.erase(path)) {
+        return 0;
+    }
+    return LFS_ERR_NOENT;
+}
+
+int lfs_rename(lfs_t* lfs, const char* oldPath, const char* newPath) {
+    const auto it = g_files.find(oldPath);
+    if (it == g_files.end()) {
+        return LFS_ERR_NOENT;
+    }
+    auto data = std::move(it->second);
+    g_files.erase(it);
+    g_files[newPath] = std::move(data);
+    return 0;
+}
+
+int lfs_stat(lfs_t* lfs, const char* path, struct lfs_info* info) {
+    memset(info, 0, sizeof(lfs_info));
+    const auto it = g_files.find(path);
+    if (it != g_files.end()) {
+        info->type = LFS_TYPE_REG;
+        info->size = it->second.size();
+    } else if (g_dirs.count(path)) {
+        info->type = LFS_TYPE_DIR;
+    } else {
+        return LFS_ERR_NOENT;
+    }
+    return 0;
+}
+
+int lfs_mkdir(lfs_t* lfs, const char* path) {
+    if (g_files.count(path) || !g_dirs.insert(path).second) {
+        return LFS_ERR_EXIST;
+    }
+    return 0;
+}
+
+int filesystem_mount(filesystem_t* fs) {
+    return 0;
+}
+
+int filesystem_unmount(filesystem_t* fs) {
+    return 0;
+}
+
+filesystem_t* filesystem_get_instance(void* reserved) {
+    return &g_fs;
+}
+
+int filesystem_lock(filesystem_t* fs) {
+    return 0;
+}
+
+int filesystem_unlock(filesystem_t* fs) {
+    return 0;
+}
+
+void test::resetFilesystem() {
+    for (const auto f: g_handles) {
+        f->valid = false;
+    }
+}
+
+void test::formatFilesystem() {
+    resetFilesystem();
+    g_files.clear();
+    g_dirs.clear();
+}
+
+std::vector<uint8_t> test::readFile(const std::string& path) {
+    const auto it = g_files.find(path);
+    if (it == g_files.end()) {
+        return std::vector<uint8_t>();
+    }
+    return it->second;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+// HAL and system functions used by the tested services code
+
+#include "delay_hal.h"
+#include "logging.h"
+#include "panic.h"
+
+#include <cstdlib>
+
+void panic_(ePanicCode code, void* extraInfo, void (*HAL_Delay_Microseconds)(uint32_t)) {
+    abort();
+}
+
+void HAL_Delay_Microseconds(uint32_t micros) {
+}
+
+void log_message(int level, const char *category, LogAttributes *attr, void *reserved, const char *fmt, ...) {
+}
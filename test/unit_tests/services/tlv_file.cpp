@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tlv_file.h"
+#include "system_error.h"
+#include "catch.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace particle::services::settings;
+
+namespace {
+
+const char* const FILE_PATH = "/sys/test.dat";
+
+std::unique_ptr<TlvFile> openFile() {
+    std::unique_ptr<TlvFile> f(new TlvFile(FILE_PATH));
+    REQUIRE(f->init() == 0);
+    return f;
+}
+
+int set(TlvFile* f, uint16_t key, const std::string& val, int index = -1) {
+    return f->set(key, (const uint8_t*)val.data(), val.size(), index);
+}
+
+int add(TlvFile* f, uint16_t key, const std::string& val) {
+    return f->add(key, (const uint8_t*)val.data(), val.size());
+}
+
+std::string get(TlvFile* f, uint16_t key, int index = 0) {
+    char buf[64] = {};
+    const ssize_t n = f->get(key, (uint8_t*)buf, sizeof(buf), index);
+    if (n < 0) {
+        return std::string();
+    }
+    return std::string(buf, n);
+}
+
+// Looks up an entry the way the firmware versions that predate the RAM index do
+std::string getAsOldFirmware(uint16_t key, int index = 0) {
+    struct Header {
+        uint16_t magick;
+        uint16_t key;
+        uint16_t length;
+        uint16_t reserved;
+    } __attribute__((__packed__));
+    const auto data = test::readFile(FILE_PATH);
+    REQUIRE(data.size() >= 16);
+    uint32_t dataSize = 0;
+    memcpy(&dataSize, data.data() + data.size() - 12, sizeof(dataSize));
+    std::string val;
+    int idx = -1;
+    for (size_t pos = 0; pos + sizeof(Header) <= dataSize;) {
+        Header h = {};
+        memcpy(&h, data.data() + pos, sizeof(h));
+        if (h.magick != TLV_HEADER_MAGICK) {
+            pos += sizeof(uint16_t);
+            continue;
+        }
+        if (h.key == key) {
+            val = std::string((const char*)data.data() + pos + sizeof(h), h.length);
+            if (++idx == index) {
+                break;
+            }
+        }
+        pos += sizeof(h) + h.length;
+    }
+    return (idx >= 0 && (index < 0 || idx == index)) ? val : std::string();
+}
+
+} // namespace
+
+TEST_CASE("TlvFile") {
+    test::formatFilesystem();
+    auto f = openFile();
+
+    SECTION("entries are found after the file is reopened") {
+        REQUIRE(add(f.get(), 1, "a") == 0);
+        REQUIRE(add(f.get(), 2, "bc") == 0);
+        REQUIRE(add(f.get(), 1, "def") == 0);
+        REQUIRE(f->deInit() == 0);
+        f = openFile();
+        CHECK(get(f.get(), 1, 0) == "a");
+        CHECK(get(f.get(), 1, 1) == "def");
+        CHECK(get(f.get(), 2) == "bc");
+        CHECK(f->get(1, nullptr, 0, 2) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(f->get(3, nullptr, 0) == SYSTEM_ERROR_NOT_FOUND);
+    }
+
+    SECTION("deleted entries are not found after the file is reopened") {
+        REQUIRE(add(f.get(), 1, "a") == 0);
+        REQUIRE(add(f.get(), 2, "bc") == 0);
+        REQUIRE(add(f.get(), 1, "def") == 0);
+        REQUIRE(f->del(1, 0) == 0);
+        REQUIRE(set(f.get(), 2, "gh") == 0);
+        CHECK(get(f.get(), 1) == "def");
+        CHECK(get(f.get(), 2) == "gh");
+        REQUIRE(f->deInit() == 0);
+        f = openFile();
+        CHECK(get(f.get(), 1, 0) == "def");
+        CHECK(f->get(1, nullptr, 0, 1) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(get(f.get(), 2) == "gh");
+        CHECK(f->get(2, nullptr, 0, 1) == SYSTEM_ERROR_NOT_FOUND);
+    }
+
+    SECTION("deleted entries are not found by older firmware") {
+        REQUIRE(add(f.get(), 1, "a") == 0);
+        REQUIRE(add(f.get(), 2, "bc") == 0);
+        REQUIRE(f->del(1) == 0);
+        REQUIRE(set(f.get(), 2, "def") == 0);
+        CHECK(getAsOldFirmware(1) == "");
+        CHECK(getAsOldFirmware(2, 0) == "def");
+        CHECK(getAsOldFirmware(2, 1) == "");
+    }
+
+    SECTION("entries can't be added with the key reserved for deleted entries") {
+        CHECK(add(f.get(), TLV_DELETED_KEY, "a") == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(f->get(TLV_DELETED_KEY, nullptr, 0) == SYSTEM_ERROR_NOT_FOUND);
+    }
+
+    SECTION("compaction removes the deleted entries") {
+        REQUIRE(add(f.get(), 1, "a") == 0);
+        const std::string val(32, 'x');
+        // Not enough deleted data to trigger the automatic compaction
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(set(f.get(), 2, val + std::to_string(i)) == 0);
+        }
+        const auto sizeBefore = f->size();
+        REQUIRE(f->compact() == 0);
+        CHECK(f->size() < sizeBefore);
+        CHECK(f->size() == 8 + 1 + 8 + 33 + 16);
+        CHECK(get(f.get(), 1) == "a");
+        CHECK(get(f.get(), 2) == val + "2");
+        REQUIRE(f->deInit() == 0);
+        f = openFile();
+        CHECK(get(f.get(), 1) == "a");
+        CHECK(get(f.get(), 2) == val + "2");
+        CHECK(getAsOldFirmware(2) == val + "2");
+    }
+
+    SECTION("deleted entries are compacted automatically") {
+        const std::string val(64, 'x');
+        for (int i = 0; i < 20; ++i) {
+            REQUIRE(set(f.get(), 1, val) == 0);
+        }
+        CHECK(f->size() < (ssize_t)(TlvFile::MIN_COMPACTION_SIZE * 2));
+        CHECK(get(f.get(), 1) == val);
+    }
+
+    SECTION("abandoned changes are discarded") {
+        REQUIRE(add(f.get(), 1, "a") == 0);
+        REQUIRE(add(f.get(), 2, "bc") == 0);
+        const auto size = f->size();
+        REQUIRE(f->beginChanges() == 0);
+        REQUIRE(f->del(1) == 0);
+        REQUIRE(set(f.get(), 2, "def") == 0);
+        REQUIRE(add(f.get(), 3, "gh") == 0);
+        CHECK(f->get(1, nullptr, 0) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(get(f.get(), 2) == "def");
+        REQUIRE(f->abandonChanges() == 0);
+        CHECK(f->size() == size);
+        CHECK(get(f.get(), 1) == "a");
+        CHECK(get(f.get(), 2) == "bc");
+        CHECK(f->get(3, nullptr, 0) == SYSTEM_ERROR_NOT_FOUND);
+        REQUIRE(f->deInit() == 0);
+        f = openFile();
+        CHECK(get(f.get(), 1) == "a");
+        CHECK(get(f.get(), 2) == "bc");
+        CHECK(f->get(3, nullptr, 0) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(getAsOldFirmware(1) == "a");
+    }
+
+    SECTION("committed changes are applied") {
+        REQUIRE(add(f.get(), 1, "a") == 0);
+        REQUIRE(f->beginChanges() == 0);
+        REQUIRE(f->del(1) == 0);
+        REQUIRE(add(f.get(), 2, "bc") == 0);
+        REQUIRE(f->commitChanges() == 0);
+        REQUIRE(f->deInit() == 0);
+        f = openFile();
+        CHECK(f->get(1, nullptr, 0) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(get(f.get(), 2) == "bc");
+    }
+
+    SECTION("uncommitted changes are lost on reset") {
+        REQUIRE(add(f.get(), 1, "a") == 0);
+        REQUIRE(f->beginChanges() == 0);
+        REQUIRE(f->del(1) == 0);
+        REQUIRE(add(f.get(), 2, "bc") == 0);
+        test::resetFilesystem();
+        f = openFile();
+        CHECK(get(f.get(), 1) == "a");
+        CHECK(f->get(2, nullptr, 0) == SYSTEM_ERROR_NOT_FOUND);
+    }
+
+    f->deInit();
+}
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "active_object.h"
+#include "catch.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t TASK_BLOCK_SIZE = ACTIVE_OBJECT_TASK_BLOCK_SIZE;
+const size_t TASK_BLOCK_COUNT = ACTIVE_OBJECT_TASK_BLOCK_COUNT;
+const size_t SEMAPHORE_CACHE_SIZE = ACTIVE_OBJECT_SEMAPHORE_CACHE_SIZE;
+
+// Active object with an unbounded queue. The tasks are processed by the test code or by
+// a worker thread started via startWorker()
+class TestActiveObject: public ActiveObjectBase {
+public:
+    using ActiveObjectBase::allocate_task;
+    using ActiveObjectBase::free_task;
+
+    TestActiveObject() :
+            ActiveObjectBase(ActiveObjectConfiguration(nullptr, 0 /* take_wait */, 0 /* put_wait */, 0 /* queue_size */)),
+            stop_(false) {
+    }
+
+    ~TestActiveObject() {
+        stopWorker();
+        while (process()) {
+        }
+    }
+
+    void startWorker() {
+        worker_ = std::thread([this]() {
+            setCurrentThread();
+            while (!stop_) {
+                if (!process()) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    void stopWorker() {
+        if (worker_.joinable()) {
+            stop_ = true;
+            worker_.join();
+        }
+    }
+
+    size_t queued() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+protected:
+    bool take(Item& item) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty()) {
+            return false;
+        }
+        item = queue_.front();
+        queue_.pop_front();
+        return true;
+    }
+
+    bool put(Item& item) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(item);
+        return true;
+    }
+
+private:
+    std::deque<Item> queue_;
+    std::mutex mutex_;
+    std::thread worker_;
+    std::atomic<bool> stop_;
+};
+
+ActiveObjectTaskPoolStats poolStats() {
+    ActiveObjectTaskPoolStats stats = {};
+    ActiveObjectBase::task_pool_stats(&stats);
+    return stats;
+}
+
+// Returns true if all pointers are distinct and none of them is in the range of the others
+// assuming they're blocks of the specified size
+bool disjoint(std::vector<void*> ptrs, size_t size) {
+    std::sort(ptrs.begin(), ptrs.end());
+    for (size_t i = 1; i < ptrs.size(); ++i) {
+        if ((char*)ptrs[i] < (char*)ptrs[i - 1] + size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("ActiveObjectBase") {
+    TestActiveObject obj;
+    REQUIRE(poolStats().used == 0);
+
+    SECTION("tasks are allocated from the heap when the pool is exhausted") {
+        const auto stats = poolStats();
+        std::vector<void*> blocks;
+        for (size_t i = 0; i < TASK_BLOCK_COUNT; ++i) {
+            const auto p = obj.allocate_task(TASK_BLOCK_SIZE);
+            REQUIRE(p);
+            memset(p, 0xaa, TASK_BLOCK_SIZE);
+            blocks.push_back(p);
+        }
+        CHECK(disjoint(blocks, TASK_BLOCK_SIZE));
+        CHECK(poolStats().used == TASK_BLOCK_COUNT);
+        CHECK(poolStats().peak == TASK_BLOCK_COUNT);
+        CHECK(poolStats().exhausted == stats.exhausted);
+        // The pool blocks are contiguous, so the heap allocation is outside of their range
+        const auto heap = obj.allocate_task(TASK_BLOCK_SIZE);
+        REQUIRE(heap);
+        const auto first = *std::min_element(blocks.begin(), blocks.end());
+        CHECK(((char*)heap < (char*)first || (char*)heap >= (char*)first + TASK_BLOCK_SIZE * TASK_BLOCK_COUNT));
+        CHECK(poolStats().exhausted == stats.exhausted + 1);
+        CHECK(poolStats().used == TASK_BLOCK_COUNT);
+        obj.free_task(heap);
+        CHECK(poolStats().used == TASK_BLOCK_COUNT);
+        // A released block is reused
+        obj.free_task(blocks[3]);
+        CHECK(poolStats().used == TASK_BLOCK_COUNT - 1);
+        const auto block = obj.allocate_task(1);
+        CHECK(block == blocks[3]);
+        blocks[3] = block;
+        for (const auto p: blocks) {
+            obj.free_task(p);
+        }
+        CHECK(poolStats().used == 0);
+    }
+
+    SECTION("a functor larger than a pool block is allocated from the heap") {
+        const auto stats = poolStats();
+        std::array<char, TASK_BLOCK_SIZE + 16> data;
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] = (char)i;
+        }
+        bool ok = false;
+        obj.invoke_async([data, &ok]() {
+            ok = true;
+            for (size_t i = 0; i < data.size(); ++i) {
+                if (data[i] != (char)i) {
+                    ok = false;
+                }
+            }
+        });
+        CHECK(poolStats().oversized == stats.oversized + 1);
+        CHECK(poolStats().used == 0);
+        REQUIRE(obj.process());
+        CHECK(ok);
+        CHECK_FALSE(obj.process());
+        // Small tasks still use the pool
+        int n = 0;
+        obj.invoke_async([&n]() { ++n; });
+        CHECK(poolStats().used == 1);
+        REQUIRE(obj.process());
+        CHECK(n == 1);
+        CHECK(poolStats().used == 0);
+        CHECK(poolStats().oversized == stats.oversized + 1);
+    }
+
+    SECTION("asynchronous tasks fall back to the heap and are processed in order") {
+        const auto stats = poolStats();
+        std::vector<int> order;
+        const int count = TASK_BLOCK_COUNT * 2;
+        for (int i = 0; i < count; ++i) {
+            obj.invoke_async([&order, i]() { order.push_back(i); });
+        }
+        CHECK(poolStats().used == TASK_BLOCK_COUNT);
+        CHECK(poolStats().exhausted == stats.exhausted + count - TASK_BLOCK_COUNT);
+        while (obj.process()) {
+        }
+        CHECK(order.size() == (size_t)count);
+        CHECK(std::is_sorted(order.begin(), order.end()));
+        CHECK(poolStats().used == 0);
+    }
+
+    SECTION("pool blocks are claimed and released concurrently without sharing a block") {
+        const int threadCount = TASK_BLOCK_COUNT + 4; // Some threads fall back to the heap
+        const int iterations = 20000;
+        std::atomic<int> errors(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&obj, &errors, t]() {
+                for (int i = 0; i < iterations; ++i) {
+                    const auto p = (char*)obj.allocate_task(TASK_BLOCK_SIZE);
+                    if (!p) {
+                        ++errors;
+                        continue;
+                    }
+                    memset(p, t, TASK_BLOCK_SIZE);
+                    std::this_thread::yield();
+                    for (size_t j = 0; j < TASK_BLOCK_SIZE; ++j) {
+                        if (p[j] != (char)t) {
+                            ++errors;
+                            break;
+                        }
+                    }
+                    obj.free_task(p);
+                }
+            });
+        }
+        for (auto& t: threads) {
+            t.join();
+        }
+        CHECK(errors == 0);
+        CHECK(poolStats().used == 0);
+        CHECK(poolStats().peak <= TASK_BLOCK_COUNT);
+    }
+
+    SECTION("synchronous tasks return the result of the function") {
+        obj.startWorker();
+        CHECK(obj.invoke_sync([]() { return 42; }) == 42);
+        int n = 0;
+        obj.invoke_sync([&n]() { n = 1; });
+        CHECK(n == 1);
+        // A synchronous task doesn't use the task pool
+        CHECK(poolStats().used == 0);
+    }
+
+    SECTION("more concurrent synchronous tasks than cached semaphores") {
+        obj.startWorker();
+        const int threadCount = SEMAPHORE_CACHE_SIZE * 2;
+        const int iterations = 1000;
+        std::atomic<int> errors(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&obj, &errors, t]() {
+                for (int i = 0; i < iterations; ++i) {
+                    const int v = t * iterations + i;
+                    if (obj.invoke_sync([v]() { return v; }) != v) {
+                        ++errors;
+                    }
+                }
+            });
+        }
+        for (auto& t: threads) {
+            t.join();
+        }
+        CHECK(errors == 0);
+        obj.stopWorker();
+        CHECK(obj.queued() == 0);
+    }
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+// HAL functions used by the tested system code. The concurrency HAL is implemented with the
+// standard library primitives
+
+#include "concurrent_hal.h"
+#include "hal_irq_flag.h"
+#include "timer_hal.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+struct Semaphore {
+    std::mutex mutex;
+    std::condition_variable cond;
+    unsigned count;
+    unsigned maxCount;
+};
+
+} // namespace
+
+uint32_t HAL_Timer_Get_Milli_Seconds() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+int HAL_disable_irq() {
+    return 0;
+}
+
+void HAL_enable_irq(int mask) {
+}
+
+os_result_t os_thread_yield() {
+    std::this_thread::yield();
+    return 0;
+}
+
+int os_semaphore_create(os_semaphore_t* semaphore, unsigned max_count, unsigned initial_count) {
+    const auto s = new Semaphore;
+    s->count = initial_count;
+    s->maxCount = max_count;
+    *semaphore = s;
+    return 0;
+}
+
+int os_semaphore_destroy(os_semaphore_t semaphore) {
+    delete static_cast<Semaphore*>(semaphore);
+    return 0;
+}
+
+int os_semaphore_take(os_semaphore_t semaphore, system_tick_t timeout, bool reserved) {
+    const auto s = static_cast<Semaphore*>(semaphore);
+    std::unique_lock<std::mutex> lock(s->mutex);
+    const auto ready = [s]() { return s->count > 0; };
+    if (timeout == CONCURRENT_WAIT_FOREVER) {
+        s->cond.wait(lock, ready);
+    } else if (!s->cond.wait_for(lock, std::chrono::milliseconds(timeout), ready)) {
+        return 1;
+    }
+    --s->count;
+    return 0;
+}
+
+int os_semaphore_give(os_semaphore_t semaphore, bool reserved) {
+    const auto s = static_cast<Semaphore*>(semaphore);
+    // The waiting thread may destroy the semaphore as soon as it's given, so the condition
+    // variable is notified while the mutex is still locked
+    std::lock_guard<std::mutex> lock(s->mutex);
+    if (s->count < s->maxCount) {
+        ++s->count;
+    }
+    s->cond.notify_one();
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+// HAL and system functions used by the tested wiring code. The concurrency HAL is implemented
+// with the standard library primitives
+
+#include "concurrent_hal.h"
+#include "timer_hal.h"
+#include "system_control.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+struct Thread {
+    std::thread thread;
+};
+
+struct Semaphore {
+    std::mutex mutex;
+    std::condition_variable cond;
+    unsigned count;
+    unsigned maxCount;
+};
+
+} // namespace
+
+uint32_t HAL_Timer_Get_Milli_Seconds() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+os_result_t os_thread_create(os_thread_t* result, const char* name, os_thread_prio_t priority, os_thread_fn_t fun,
+        void* thread_param, size_t stack_size) {
+    const auto t = new Thread;
+    // The handle is assigned before the thread is started, so that the thread can find itself
+    *result = t;
+    t->thread = std::thread(fun, thread_param);
+    return 0;
+}
+
+bool os_thread_is_current(os_thread_t thread) {
+    return thread && static_cast<Thread*>(thread)->thread.get_id() == std::this_thread::get_id();
+}
+
+os_result_t os_thread_join(os_thread_t thread) {
+    static_cast<Thread*>(thread)->thread.join();
+    return 0;
+}
+
+os_result_t os_thread_exit(os_thread_t thread) {
+    // The thread function returns right after this call
+    return 0;
+}
+
+os_result_t os_thread_cleanup(os_thread_t thread) {
+    delete static_cast<Thread*>(thread);
+    return 0;
+}
+
+os_result_t os_thread_yield() {
+    std::this_thread::yield();
+    return 0;
+}
+
+int os_mutex_recursive_create(os_mutex_recursive_t* mutex) {
+    *mutex = new std::recursive_mutex;
+    return 0;
+}
+
+int os_mutex_recursive_destroy(os_mutex_recursive_t mutex) {
+    delete static_cast<std::recursive_mutex*>(mutex);
+    return 0;
+}
+
+int os_mutex_recursive_lock(os_mutex_recursive_t mutex) {
+    static_cast<std::recursive_mutex*>(mutex)->lock();
+    return 0;
+}
+
+int os_mutex_recursive_trylock(os_mutex_recursive_t mutex) {
+    return static_cast<std::recursive_mutex*>(mutex)->try_lock() ? 0 : 1;
+}
+
+int os_mutex_recursive_unlock(os_mutex_recursive_t mutex) {
+    static_cast<std::recursive_mutex*>(mutex)->unlock();
+    return 0;
+}
+
+int os_semaphore_create(os_semaphore_t* semaphore, unsigned max_count, unsigned initial_count) {
+    const auto s = new Semaphore;
+    s->count = initial_count;
+    s->maxCount = max_count;
+    *semaphore = s;
+    return 0;
+}
+
+int os_semaphore_destroy(os_semaphore_t semaphore) {
+    delete static_cast<Semaphore*>(semaphore);
+    return 0;
+}
+
+int os_semaphore_take(os_semaphore_t semaphore, system_tick_t timeout, bool reserved) {
+    const auto s = static_cast<Semaphore*>(semaphore);
+    std::unique_lock<std::mutex> lock(s->mutex);
+    if (!s->cond.wait_for(lock, std::chrono::milliseconds(timeout), [s]() { return s->count > 0; })) {
+        return 1;
+    }
+    --s->count;
+    return 0;
+}
+
+int os_semaphore_give(os_semaphore_t semaphore, bool reserved) {
+    const auto s = static_cast<Semaphore*>(semaphore);
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        if (s->count < s->maxCount) {
+            ++s->count;
+        }
+    }
+    s->cond.notify_one();
+    return 0;
+}
+
+void system_ctrl_set_result(ctrl_request* req, int result, ctrl_completion_handler_fn handler, void* data,
+        void* reserved) {
+}
+
+int system_ctrl_alloc_reply_data(ctrl_request* req, size_t size, void* reserved) {
+    return -1;
+}
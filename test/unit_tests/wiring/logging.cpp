@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_logging.h"
+#include "spark_wiring_log_args.h"
+#include "catch.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace spark;
+
+namespace {
+
+class TestLogHandler: public LogHandler {
+public:
+    TestLogHandler() :
+            LogHandler(LOG_LEVEL_ALL),
+            blocked_(false) {
+        LogManager::instance()->addHandler(this);
+    }
+
+    ~TestLogHandler() {
+        LogManager::instance()->removeHandler(this);
+    }
+
+    std::vector<std::string> messages() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return msgs_;
+    }
+
+    // Makes the handler wait until unblock() is called
+    void block() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        blocked_ = true;
+    }
+
+    void unblock() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            blocked_ = false;
+        }
+        cond_.notify_all();
+    }
+
+protected:
+    void logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        msgs_.push_back(msg);
+        cond_.wait(lock, [this]() { return !blocked_; });
+    }
+
+private:
+    std::vector<std::string> msgs_;
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    bool blocked_;
+};
+
+void logMessage(const char* fmt, ...) {
+    LogAttributes attr = {};
+    attr.size = sizeof(LogAttributes);
+    va_list args;
+    va_start(args, fmt);
+    log_message_v(LOG_LEVEL_INFO, "test", &attr, nullptr, fmt, args);
+    va_end(args);
+}
+
+// Returns the number of messages starting with the given prefix
+size_t countMessages(const std::vector<std::string>& msgs, const std::string& prefix) {
+    size_t n = 0;
+    for (const auto& msg: msgs) {
+        if (msg.compare(0, prefix.size(), prefix) == 0) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+// Packs the arguments and returns the size of the packed data, or -1 on error
+int packArgs(char* buf, size_t size, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    const int n = detail::packLogArgs(buf, size, fmt, args);
+    va_end(args);
+    return n;
+}
+
+} // namespace
+
+TEST_CASE("Packing of the format string arguments") {
+    char packed[64] = {};
+    char msg[64] = {};
+
+    SECTION("a string with a precision doesn't need to be null-terminated") {
+        // Only the last byte of the heap block is a null, anything read past the precision would show up in
+        // the packed size
+        std::vector<char> str(32, 'x');
+        str.back() = '\0';
+        str[0] = 'a';
+        str[1] = 'b';
+        str[2] = 'c';
+        int n = packArgs(packed, sizeof(packed), "%.*s|", 3, str.data());
+        CHECK(n == (int)(sizeof(int) + 4));
+        CHECK(detail::formatLogArgs(msg, sizeof(msg), "%.*s|", packed, n) == 4);
+        CHECK(std::string(msg) == "abc|");
+        n = packArgs(packed, sizeof(packed), "%.2s|", str.data());
+        CHECK(n == 3);
+        CHECK(detail::formatLogArgs(msg, sizeof(msg), "%.2s|", packed, n) == 3);
+        CHECK(std::string(msg) == "ab|");
+    }
+
+    SECTION("a string without a null terminator shorter than the precision") {
+        const char str[] = { 'a', 'b' };
+        const int n = packArgs(packed, sizeof(packed), "%.*s|", (int)sizeof(str), str);
+        CHECK(n == (int)(sizeof(int) + 3));
+        detail::formatLogArgs(msg, sizeof(msg), "%.*s|", packed, n);
+        CHECK(std::string(msg) == "ab|");
+    }
+
+    SECTION("a negative precision is ignored") {
+        const int n = packArgs(packed, sizeof(packed), "%.*s|", -1, "abcdef");
+        CHECK(n == (int)(sizeof(int) + 7));
+        detail::formatLogArgs(msg, sizeof(msg), "%.*s|", packed, n);
+        CHECK(std::string(msg) == "abcdef|");
+    }
+}
+
+TEST_CASE("Asynchronous logging") {
+    const auto mgr = LogManager::instance();
+    TestLogHandler handler;
+
+    SECTION("messages are passed to the handlers in order when asynchronous logging is disabled") {
+        REQUIRE(mgr->enableAsync());
+        CHECK(mgr->isAsync());
+        for (int i = 0; i < 10; ++i) {
+            logMessage("message %d", i);
+        }
+        mgr->disableAsync();
+        CHECK_FALSE(mgr->isAsync());
+        const auto msgs = handler.messages();
+        REQUIRE(msgs.size() == 10);
+        for (int i = 0; i < 10; ++i) {
+            CHECK(msgs[i] == "message " + std::to_string(i));
+        }
+    }
+
+    SECTION("the format string doesn't need to outlive the call") {
+        REQUIRE(mgr->enableAsync());
+        handler.block(); // Keep the log thread busy with the first message
+        logMessage("first");
+        char fmt[] = "%s %d";
+        logMessage(fmt, "second", 2);
+        memset(fmt, 'x', sizeof(fmt) - 1);
+        handler.unblock();
+        mgr->disableAsync();
+        const auto msgs = handler.messages();
+        REQUIRE(msgs.size() == 2);
+        CHECK(msgs[0] == "first");
+        CHECK(msgs[1] == "second 2");
+    }
+
+    SECTION("messages that don't fit into the buffer are dropped and counted") {
+        const unsigned droppedBefore = mgr->droppedMessageCount();
+        REQUIRE(mgr->enableAsync(256));
+        handler.block();
+        logMessage("first");
+        // Wait until the log thread has taken the first message
+        while (handler.messages().empty()) {
+            std::this_thread::yield();
+        }
+        const int count = 100;
+        for (int i = 0; i < count; ++i) {
+            logMessage("message %d", i);
+        }
+        const unsigned dropped = mgr->droppedMessageCount() - droppedBefore;
+        CHECK(dropped > 0);
+        handler.unblock();
+        mgr->disableAsync();
+        const auto msgs = handler.messages();
+        CHECK(countMessages(msgs, "message ") + dropped == count);
+        CHECK(msgs.back() == std::to_string(dropped) + " log message(s) dropped");
+    }
+
+    SECTION("disabling asynchronous logging doesn't lose the messages of concurrent producers") {
+        const unsigned droppedBefore = mgr->droppedMessageCount();
+        REQUIRE(mgr->enableAsync());
+        std::atomic<bool> stop(false);
+        std::vector<std::thread> threads;
+        const int threadCount = 4;
+        std::vector<int> sent(threadCount);
+        for (int i = 0; i < threadCount; ++i) {
+            threads.emplace_back([&stop, &sent, i]() {
+                while (!stop) {
+                    logMessage("message %d", sent[i]++);
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        mgr->disableAsync();
+        stop = true;
+        for (auto& t: threads) {
+            t.join();
+        }
+        int total = 0;
+        for (int n: sent) {
+            total += n;
+        }
+        const unsigned dropped = mgr->droppedMessageCount() - droppedBefore;
+        // Messages logged after asynchronous logging is disabled are passed to the handlers directly
+        CHECK(countMessages(handler.messages(), "message ") + dropped == (size_t)total);
+    }
+}
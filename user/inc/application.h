@@ -62,6 +62,7 @@
 #include "spark_wiring_tcpclient.h"
 #include "spark_wiring_tcpserver.h"
 #include "spark_wiring_udp.h"
+#include "spark_wiring_socket_poll.h"
 #include "spark_wiring_time.h"
 #include "spark_wiring_tone.h"
 #include "spark_wiring_eeprom.h"
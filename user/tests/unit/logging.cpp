@@ -2,6 +2,7 @@
 #define LOG_INCLUDE_SOURCE_INFO 1
 
 #include "spark_wiring_logging.h"
+#include "spark_wiring_log_args.h"
 #include "service_debug.h"
 
 #include "mocks/control.h"
@@ -996,6 +997,37 @@ TEST_CASE("Message formatting") {
                 .at(4).equals("-1")
                 .at(5).equals("details");
     }
+
+    SECTION("binary formatting") {
+        test::OutputStream stream;
+        ScopedLogHandler<BinaryStreamLogHandler> handler(stream);
+        const char* const fmt = "message %d";
+        LOG_C(INFO, "a", fmt, 0x0102);
+        const std::string s(stream.data(), stream.size());
+        // The record is terminated by a zero byte and doesn't contain other zero bytes
+        REQUIRE(s.size() > 1);
+        CHECK(s.find('\0') == s.size() - 1);
+        // Decode the record
+        std::string rec;
+        for (size_t i = 0; i < s.size() - 1;) {
+            const size_t code = (uint8_t)s.at(i);
+            REQUIRE(code > 0);
+            rec.append(s, i + 1, code - 1);
+            i += code;
+            if (code < 0xff && i < s.size() - 1) {
+                rec.push_back('\0');
+            }
+        }
+        REQUIRE(rec.size() > 3);
+        CHECK(rec.at(0) == BinaryStreamLogHandler::MESSAGE);
+        CHECK(rec.at(1) == LOG_LEVEL_INFO);
+        CHECK((rec.at(2) & 0x03) == 0x03); // Timestamp and category
+        // Packed arguments
+        int arg = 0;
+        REQUIRE(rec.size() > sizeof(arg));
+        memcpy(&arg, rec.data() + rec.size() - sizeof(arg), sizeof(arg));
+        CHECK(arg == 0x0102);
+    }
 }
 
 TEST_CASE("Configuration requests") {
@@ -1238,3 +1270,50 @@ TEST_CASE("Configuration requests") {
     CHECK(NamedOutputStream::instanceCount() == 0);
     CHECK(NamedLogHandler::instanceCount() == 0);
 }
+
+namespace {
+
+// Packs the arguments and formats the message with them, returns an empty string on error
+std::string formatPacked(size_t packedSize, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    std::vector<char> packed(packedSize);
+    const int n = spark::detail::packLogArgs(packed.data(), packed.size(), fmt, args);
+    va_end(args);
+    if (n < 0) {
+        return std::string();
+    }
+    char buf[LOG_MAX_STRING_LENGTH];
+    spark::detail::formatLogArgs(buf, sizeof(buf), fmt, packed.data(), n);
+    return buf;
+}
+
+} // namespace
+
+TEST_CASE("Deferred formatting") {
+    SECTION("arguments of all supported types are formatted as by printf()") {
+        std::string s = "temporary";
+        const std::string msg = formatPacked(256, "%d %5.2f %s %lld %% %-*d| %.*s %zu %lu %c %x", -3, 3.14159,
+                s.c_str(), 1234567890123LL, 4, 42, 3, "abcdef", (size_t)99, 5ul, 'q', 0xbeef);
+        s = "modified"; // Strings are copied
+        CHECK(msg == "-3  3.14 temporary 1234567890123 % 42  | abc 99 5 q beef");
+    }
+
+    SECTION("null string") {
+        CHECK(formatPacked(64, "%s", (const char*)nullptr) == "(null)");
+    }
+
+    SECTION("arguments that don't fit into the buffer") {
+        CHECK(formatPacked(8, "%s", "a long string") == "");
+    }
+
+    SECTION("unsupported conversion") {
+        CHECK(formatPacked(64, "%ls", L"wide") == "");
+    }
+
+    SECTION("truncated message") {
+        char buf[8];
+        CHECK(spark::detail::formatLogArgs(buf, sizeof(buf), "0123456789", nullptr, 0) == 10);
+        CHECK(std::string(buf) == "0123456");
+    }
+}
@@ -75,3 +75,42 @@ test(api_tcpclient_write_timeout) {
     API_COMPILE(client.write(0xff, 123456));
     API_COMPILE(client.write((const uint8_t*)&client, sizeof(client), 123456));
 }
+
+#if HAL_USE_SOCKET_HAL_POSIX
+
+test(api_socket_poll) {
+    TCPClient client;
+    TCPServer server(1000);
+    UDP udp;
+    SocketPoll poll;
+    int result = 0;
+    bool ready = false;
+    unsigned events = 0;
+    API_COMPILE(poll.add(client).add(server).add(udp));
+    API_COMPILE(poll.add(client, SocketPoll::READABLE | SocketPoll::WRITABLE));
+    API_COMPILE(result = poll.wait());
+    API_COMPILE(result = poll.wait(1000));
+    API_COMPILE(ready = poll.isReadable(client));
+    API_COMPILE(ready = poll.isReadable(server));
+    API_COMPILE(ready = poll.isReadable(udp));
+    API_COMPILE(events = poll.events(udp));
+    API_COMPILE(poll.remove(server));
+    API_COMPILE(poll.clear());
+    (void)result; // avoid unused warning
+    (void)ready;
+    (void)events;
+}
+
+test(api_udp_scatter_gather) {
+    UDP udp;
+    uint8_t header[4];
+    uint8_t payload[32];
+    struct iovec iov[2] = { { header, sizeof(header) }, { payload, sizeof(payload) } };
+    int result = 0;
+    API_COMPILE(result = udp.sendPacket(iov, 2, IPAddress(1,2,3,4), 50));
+    API_COMPILE(result = udp.receivePacket(iov, 2));
+    API_COMPILE(result = udp.receivePacket(iov, 2, 1000));
+    (void)result; // avoid unused warning
+}
+
+#endif // HAL_USE_SOCKET_HAL_POSIX
@@ -65,6 +65,24 @@ public:
     }
 };
 
+class Serial1BinaryLogHandler: public BinaryStreamLogHandler {
+public:
+    explicit Serial1BinaryLogHandler(LogLevel level = LOG_LEVEL_INFO, LogCategoryFilters filters = {}) :
+            Serial1BinaryLogHandler(115200, level, filters) {
+    }
+
+    explicit Serial1BinaryLogHandler(int baud, LogLevel level = LOG_LEVEL_INFO, LogCategoryFilters filters = {}) :
+            BinaryStreamLogHandler(Serial1, level, filters) {
+        Serial1.begin(baud);
+        LogManager::instance()->addHandler(this);
+    }
+
+    virtual ~Serial1BinaryLogHandler() {
+        LogManager::instance()->removeHandler(this);
+        Serial1.end();
+    }
+};
+
 #if Wiring_USBSerial1
 
 class USBSerial1LogHandler: public StreamLogHandler {
@@ -111,6 +129,26 @@ private:
     particle::RttOutputStream strm_;
 };
 
+class RttBinaryLogHandler: public BinaryStreamLogHandler {
+public:
+    explicit RttBinaryLogHandler(LogLevel level = LOG_LEVEL_INFO, LogCategoryFilters filters = {}) :
+            BinaryStreamLogHandler(strm_, level, filters) {
+        if (strm_.open() == 0) {
+            LogManager::instance()->addHandler(this);
+        }
+    }
+
+    virtual ~RttBinaryLogHandler() {
+        if (strm_.isOpen()) {
+            LogManager::instance()->removeHandler(this);
+            strm_.close();
+        }
+    }
+
+private:
+    particle::RttOutputStream strm_;
+};
+
 #endif // Wiring_Rtt
 
 } // namespace spark
@@ -31,6 +31,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "eeprom_hal.h"
+#include "hal_platform.h"
 
 /***
     EERef class.
@@ -166,6 +167,40 @@ struct EEPROMClass{
     {
         HAL_EEPROM_Perform_Pending_Erase();
     }
+
+#if HAL_PLATFORM_FILESYSTEM
+    /**
+     * Write the pending changes to the filesystem.
+     *
+     * @return 0 on success or a negative result code in case of an error.
+     */
+    int flush()
+    {
+        return hal_eeprom_flush(0, nullptr);
+    }
+
+    /**
+     * Buffer the changes in RAM and write them to the filesystem later.
+     *
+     * By default, every change is written immediately. With a non-zero `delay`, the changes are
+     * written after `delay` milliseconds or when more than `maxPendingSize` bytes have changed,
+     * whichever happens first. Until then, the changes are lost if the device resets.
+     *
+     * @param delay Maximum time in milliseconds the changes can stay unflushed.
+     * @param maxPendingSize Maximum number of changed bytes that can stay unflushed.
+     * @param flushBeforeSleep Write the pending changes before the device enters a sleep mode.
+     * @return 0 on success or a negative result code in case of an error.
+     */
+    int setFlushPolicy(uint32_t delay, uint32_t maxPendingSize = 256, bool flushBeforeSleep = true)
+    {
+        hal_eeprom_flush_policy policy = {};
+        policy.size = sizeof(policy);
+        policy.flags = flushBeforeSleep ? HAL_EEPROM_FLUSH_POLICY_BEFORE_SLEEP : 0;
+        policy.delay = delay;
+        policy.max_pending_size = maxPendingSize;
+        return hal_eeprom_set_flush_policy(&policy, nullptr);
+    }
+#endif // HAL_PLATFORM_FILESYSTEM
 };
 
 #define EEPROM __fetch_global_EEPROM()
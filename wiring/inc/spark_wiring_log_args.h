@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdarg>
+#include <cstddef>
+
+namespace spark {
+
+namespace detail {
+
+/*!
+    \brief Copies the arguments of a printf-style format string to a buffer.
+
+    Numeric arguments are stored in their native representation one after another, strings are
+    copied including the terminating null character. This allows the message to be formatted
+    later, after the arguments went out of scope, with `formatLogArgs()`.
+
+    \param buf Destination buffer.
+    \param size Buffer size.
+    \param fmt Format string.
+    \param args Arguments.
+    \return Number of bytes written, or a negative value if the buffer is too small or the format
+            string contains an unsupported conversion.
+*/
+int packLogArgs(char* buf, size_t size, const char* fmt, va_list args);
+
+/*!
+    \brief Formats a message using the arguments packed with `packLogArgs()`.
+
+    \param buf Destination buffer.
+    \param size Buffer size.
+    \param fmt Format string.
+    \param args Packed arguments.
+    \param argsSize Size of the packed arguments.
+    \return Length of the message that would have been written if the buffer was large enough,
+            in the same way as `vsnprintf()`.
+*/
+int formatLogArgs(char* buf, size_t size, const char* fmt, const char* args, size_t argsSize);
+
+} // namespace detail
+
+} // namespace spark
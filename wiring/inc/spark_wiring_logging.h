@@ -30,6 +30,11 @@
 #include "spark_wiring_vector.h"
 #include "spark_wiring_platform.h"
 
+#if PLATFORM_THREADING
+#include "mpsc_ring_buffer.h"
+#include <atomic>
+#endif
+
 #if Wiring_LogConfig
 #include "system_control.h"
 #endif
@@ -124,7 +129,19 @@ public:
 
     // These methods are called by the LogManager
     void message(const char *msg, LogLevel level, const char *category, const LogAttributes &attr);
+    void message(const char *fmt, const char *args, size_t argsSize, LogLevel level, const char *category,
+            const LogAttributes &attr);
     void write(const char *data, size_t size, LogLevel level, const char *category);
+    /*!
+        \brief Returns `true` if the handler processes messages with unformatted arguments.
+
+        Such handlers get the format string and the arguments packed with `detail::packLogArgs()`
+        via `logMessageArgs()`. Messages whose arguments can't be packed are still passed to
+        `logMessage()` as formatted text.
+
+        Default implementation returns `false`.
+    */
+    virtual bool acceptsArgs() const;
 
     // This class is non-copyable
     LogHandler(const LogHandler&) = delete;
@@ -141,6 +158,20 @@ protected:
         This method should be implemented by all subclasses.
     */
     virtual void logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) = 0;
+    /*!
+        \brief Performs processing of a log message with unformatted arguments.
+        \param fmt Format string.
+        \param args Arguments packed with `detail::packLogArgs()`.
+        \param argsSize Size of the packed arguments.
+        \param level Logging level.
+        \param category Category name (can be null).
+        \param attr Message attributes.
+
+        This method is only called for handlers that return `true` from `acceptsArgs()`.
+        Default implementation does nothing.
+    */
+    virtual void logMessageArgs(const char *fmt, const char *args, size_t argsSize, LogLevel level, const char *category,
+            const LogAttributes &attr);
     /*!
         \brief Writes character buffer to output stream.
         \param data Buffer.
@@ -227,6 +258,50 @@ protected:
     virtual void write(const char *data, size_t size) override;
 };
 
+/*!
+    \brief Binary stream-based log handler.
+
+    This handler doesn't format log messages on the device. Instead, it writes the address of the
+    format string and the raw arguments to the output stream, which is then decoded on the host
+    using the format strings extracted from the firmware's ELF files (see `scripts/logdecode.py`).
+
+    Every record is encoded with COBS and terminated by a zero byte, which allows the decoder to
+    resynchronize with the stream at any point. A decoded record has the following layout:
+
+    - Record type (1 byte): 1 - message, 2 - text message, 3 - direct output.
+    - Logging level (1 byte).
+    - Attribute flags (1 byte): 0x01 - time, 0x02 - category, 0x04 - file, 0x08 - line,
+      0x10 - function, 0x20 - code, 0x40 - details.
+    - Attributes, in the order of the flags above: timestamp (varint), 32-bit FNV-1a hash of the
+      category name (little-endian), address of the file name (varint), line number (varint),
+      address of the function name (varint), code (zigzag varint), details (null-terminated string).
+    - Message: address of the format string (varint) followed by the arguments packed with
+      `detail::packLogArgs()`. Text messages and direct output are written as is.
+
+    Messages with arguments that can't be packed are written as text messages.
+*/
+class BinaryStreamLogHandler: public StreamLogHandler {
+public:
+    /*!
+        \brief Record types.
+    */
+    enum RecordType {
+        MESSAGE = 1,
+        TEXT_MESSAGE = 2,
+        WRITE = 3
+    };
+
+    using StreamLogHandler::StreamLogHandler;
+
+    virtual bool acceptsArgs() const override;
+
+protected:
+    virtual void logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) override;
+    virtual void logMessageArgs(const char *fmt, const char *args, size_t argsSize, LogLevel level, const char *category,
+            const LogAttributes &attr) override;
+    virtual void write(const char *data, size_t size) override;
+};
+
 class AttributedLogger;
 
 /*!
@@ -563,6 +638,41 @@ public:
 
 #endif // Wiring_LogConfig
 
+#if PLATFORM_THREADING
+
+    /*!
+        \brief Default size of the ring buffer used for asynchronous logging.
+    */
+    static const size_t ASYNC_BUFFER_SIZE = 2048;
+
+    /*!
+        \brief Enables asynchronous logging.
+
+        Log messages are captured into a lock-free ring buffer along with their format string
+        arguments, and a dedicated thread formats them and passes them to the registered handlers.
+        Messages that don't fit into the buffer are dropped.
+
+        \param bufferSize Size of the ring buffer in bytes.
+        \return `false` in case of error.
+    */
+    bool enableAsync(size_t bufferSize = ASYNC_BUFFER_SIZE);
+    /*!
+        \brief Disables asynchronous logging.
+
+        The messages remaining in the buffer are passed to the handlers before this method returns.
+    */
+    void disableAsync();
+    /*!
+        \brief Returns `true` if asynchronous logging is enabled.
+    */
+    bool isAsync() const;
+    /*!
+        \brief Returns the number of messages dropped because the ring buffer was full.
+    */
+    unsigned droppedMessageCount() const;
+
+#endif // PLATFORM_THREADING
+
     /*!
         \brief Returns log manager's instance.
     */
@@ -587,6 +697,18 @@ private:
 
 #if PLATFORM_THREADING
     RecursiveMutex mutex_; // TODO: Use read-write lock?
+
+    struct AsyncRecord;
+
+    particle::MpscRingBuffer asyncBuf_;
+    os_thread_t asyncThread_;
+    os_semaphore_t asyncSem_;
+    std::atomic<bool> asyncEnabled_;
+    std::atomic<bool> asyncSignaled_; // Set if the log thread has been woken up
+    std::atomic<int> asyncProducers_; // Number of threads writing to the ring buffer
+    std::atomic<unsigned> asyncDropped_; // Messages dropped since the last report
+    std::atomic<unsigned> asyncDroppedTotal_;
+    volatile bool asyncStop_;
 #endif
 
     // This class can be instantiated only via instance() method
@@ -597,13 +719,29 @@ private:
     void destroyFactoryHandlers();
 #endif
 
-    static void setSystemCallbacks();
+    void setSystemCallbacks();
     static void resetSystemCallbacks();
+    void updateSystemCallbacks();
+
+    void processMessage(const char *msg, int level, const char *category, const LogAttributes &attr);
+    void processMessageArgs(const char *fmt, const char *args, size_t argsSize, int level, const char *category,
+            const LogAttributes &attr);
+    void processWrite(const char *data, size_t size, int level, const char *category);
+
+#if PLATFORM_THREADING
+    bool enqueueAsync(uint8_t type, const char *fmt, int level, const char *category, const LogAttributes *attr,
+            const char *data, size_t size);
+    void processAsyncRecords();
+
+    static void asyncThread(void *data);
+#endif
 
     // System callbacks
     static void logMessage(const char *msg, int level, const char *category, const LogAttributes *attr, void *reserved);
     static void logWrite(const char *data, size_t size, int level, const char *category, void *reserved);
     static int logEnabled(int level, const char *category, void *reserved);
+    static void logMessageDeferred(const char *fmt, va_list args, int level, const char *category,
+            const LogAttributes *attr, void *reserved);
 
     bool isActive() const;
     void setActive(bool output_active);
@@ -683,6 +821,13 @@ inline void spark::LogHandler::message(const char *msg, LogLevel level, const ch
     }
 }
 
+inline void spark::LogHandler::message(const char *fmt, const char *args, size_t argsSize, LogLevel level,
+        const char *category, const LogAttributes &attr) {
+    if (level >= filter_.level(category)) {
+        logMessageArgs(fmt, args, argsSize, level, category, attr);
+    }
+}
+
 inline void spark::LogHandler::write(const char *data, size_t size, LogLevel level, const char *category) {
     if (level >= filter_.level(category)) {
         write(data, size);
@@ -693,6 +838,15 @@ inline void spark::LogHandler::write(const char *data, size_t size) {
     // Default implementation does nothing
 }
 
+inline bool spark::LogHandler::acceptsArgs() const {
+    return false;
+}
+
+inline void spark::LogHandler::logMessageArgs(const char *fmt, const char *args, size_t argsSize, LogLevel level,
+        const char *category, const LogAttributes &attr) {
+    // Default implementation does nothing
+}
+
 // spark::StreamLogHandler
 inline spark::StreamLogHandler::StreamLogHandler(Print &stream, LogLevel level, LogCategoryFilters filters) :
         LogHandler(level, filters),
@@ -725,6 +879,11 @@ inline void spark::JSONStreamLogHandler::write(const char *data, size_t size) {
     // This handler doesn't support direct logging
 }
 
+// spark::BinaryStreamLogHandler
+inline bool spark::BinaryStreamLogHandler::acceptsArgs() const {
+    return true;
+}
+
 // spark::Logger
 inline spark::Logger::Logger(const char *name) :
         name_(name) {
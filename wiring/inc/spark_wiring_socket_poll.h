@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARK_WIRING_SOCKET_POLL_H
+#define SPARK_WIRING_SOCKET_POLL_H
+
+#include "hal_platform.h"
+
+#if HAL_USE_SOCKET_HAL_POSIX
+
+#include "spark_wiring_tcpclient.h"
+#include "spark_wiring_tcpserver.h"
+#include "spark_wiring_udp.h"
+#include "spark_wiring_vector.h"
+
+namespace particle {
+
+// This class allows an application thread to block until any of a set of TCP clients, TCP servers
+// or UDP sockets is ready, instead of polling each of them with available() or parsePacket() in
+// a loop. The objects are referenced, not copied, and must outlive the SocketPoll instance.
+//
+// Example:
+//
+// SocketPoll poll;
+// poll.add(client).add(udp);
+// if (poll.wait(1000) > 0) {
+//     if (poll.isReadable(client)) {
+//         int n = client.read(buf, sizeof(buf));
+//         ...
+//     }
+//     if (poll.isReadable(udp)) {
+//         int n = udp.parsePacket();
+//         ...
+//     }
+// }
+class SocketPoll {
+public:
+    enum Event {
+        NONE = 0x00,
+        READABLE = 0x01, // Data can be read, a connection can be accepted or a packet can be parsed
+        WRITABLE = 0x02, // Data can be written without blocking
+        CLOSED = 0x04 // The socket is closed or an error occurred on it
+    };
+
+    SocketPoll();
+
+    // Adds an object to the set. CLOSED is always reported and doesn't need to be requested
+    SocketPoll& add(TCPClient& client, unsigned events = READABLE);
+    SocketPoll& add(TCPServer& server);
+    SocketPoll& add(UDP& udp, unsigned events = READABLE);
+
+    void remove(const TCPClient& client);
+    void remove(const TCPServer& server);
+    void remove(const UDP& udp);
+    void clear();
+
+    // Waits until any of the objects is ready or the timeout expires. Returns the number of ready
+    // objects, 0 on timeout, or a negative result code in case of an error
+    int wait(system_tick_t timeout = SOCKET_WAIT_FOREVER);
+
+    // Events that occurred during the last call to wait()
+    unsigned events(const TCPClient& client) const;
+    unsigned events(const TCPServer& server) const;
+    unsigned events(const UDP& udp) const;
+
+    bool isReadable(const TCPClient& client) const;
+    bool isReadable(const TCPServer& server) const;
+    bool isReadable(const UDP& udp) const;
+
+    int size() const;
+    bool isEmpty() const;
+
+    // Returns false if adding an object failed due to a memory allocation error
+    bool isValid() const;
+
+private:
+    enum Type {
+        TCP_CLIENT,
+        TCP_SERVER,
+        UDP_SOCKET
+    };
+
+    struct Entry {
+        const void* obj;
+        Type type;
+        uint8_t events;
+        uint8_t revents;
+    };
+
+    Vector<Entry> entries_;
+    Vector<pollfd> fds_;
+    bool valid_;
+
+    SocketPoll& add(const void* obj, Type type, unsigned events);
+    void remove(const void* obj);
+    unsigned events(const void* obj) const;
+    sock_handle_t handle(const Entry& entry) const;
+};
+
+inline SocketPoll::SocketPoll() :
+        valid_(true) {
+}
+
+inline SocketPoll& SocketPoll::add(TCPClient& client, unsigned events) {
+    return add(&client, TCP_CLIENT, events);
+}
+
+inline SocketPoll& SocketPoll::add(TCPServer& server) {
+    return add(&server, TCP_SERVER, READABLE);
+}
+
+inline SocketPoll& SocketPoll::add(UDP& udp, unsigned events) {
+    return add(&udp, UDP_SOCKET, events);
+}
+
+inline void SocketPoll::remove(const TCPClient& client) {
+    remove((const void*)&client);
+}
+
+inline void SocketPoll::remove(const TCPServer& server) {
+    remove((const void*)&server);
+}
+
+inline void SocketPoll::remove(const UDP& udp) {
+    remove((const void*)&udp);
+}
+
+inline unsigned SocketPoll::events(const TCPClient& client) const {
+    return events((const void*)&client);
+}
+
+inline unsigned SocketPoll::events(const TCPServer& server) const {
+    return events((const void*)&server);
+}
+
+inline unsigned SocketPoll::events(const UDP& udp) const {
+    return events((const void*)&udp);
+}
+
+inline bool SocketPoll::isReadable(const TCPClient& client) const {
+    return events(client) & READABLE;
+}
+
+inline bool SocketPoll::isReadable(const TCPServer& server) const {
+    return events(server) & READABLE;
+}
+
+inline bool SocketPoll::isReadable(const UDP& udp) const {
+    return events(udp) & READABLE;
+}
+
+inline int SocketPoll::size() const {
+    return entries_.size();
+}
+
+inline bool SocketPoll::isEmpty() const {
+    return entries_.isEmpty();
+}
+
+inline bool SocketPoll::isValid() const {
+    return valid_;
+}
+
+} // namespace particle
+
+#endif // HAL_USE_SOCKET_HAL_POSIX
+
+#endif // SPARK_WIRING_SOCKET_POLL_H
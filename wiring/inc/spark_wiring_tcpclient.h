@@ -34,6 +34,10 @@
 
 #include <memory>
 
+namespace particle {
+class SocketPoll;
+} // namespace particle
+
 #define TCPCLIENT_BUF_MAX_SIZE  128
 /* 30 seconds */
 #define SPARK_WIRING_TCPCLIENT_DEFAULT_SEND_TIMEOUT (30000)
@@ -65,6 +69,7 @@ public:
     virtual IPAddress remoteIP();
 
     friend class TCPServer;
+    friend class particle::SocketPoll;
 
     using Print::write;
 
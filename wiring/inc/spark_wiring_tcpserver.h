@@ -31,6 +31,10 @@
 
 class TCPClient;
 
+namespace particle {
+class SocketPoll;
+} // namespace particle
+
 class TCPServer : public Print {
 private:
     uint16_t _port;
@@ -50,6 +54,8 @@ public:
     virtual size_t write(const uint8_t *buf, size_t size, system_tick_t timeout);
     void stop();
     using Print::write;
+
+    friend class particle::SocketPoll;
 };
 
 #endif
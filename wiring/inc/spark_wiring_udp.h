@@ -32,6 +32,10 @@
 #include "spark_wiring_stream.h"
 #include "socket_hal.h"
 
+namespace particle {
+class SocketPoll;
+} // namespace particle
+
 class UDP : public Stream, public Printable {
 private:
     /**
@@ -153,6 +157,32 @@ public:
         return receivePacket((uint8_t*)buffer, buf_size, timeout);
     }
 
+#if HAL_USE_SOCKET_HAL_POSIX
+    /**
+     * Sends the contents of multiple buffers as a single packet, e.g. a header and a payload,
+     * without copying them into a contiguous buffer first. This does not require the UDP instance
+     * to have an allocated buffer.
+     *
+     * @param iov           The buffers to send
+     * @param iovcnt        The number of buffers
+     * @param destination   The IP address of the destination peer.
+     * @param port          The destination port of the peer
+     * @return The number of bytes sent, or a negative value on error.
+     */
+    int sendPacket(const struct iovec* iov, size_t iovcnt, IPAddress destination, uint16_t port);
+
+    /**
+     * Retrieves a packet directly, scattering its contents across multiple buffers in order.
+     * This does not require the UDP instance to have an allocated buffer. If the buffers are not
+     * large enough for the packet, the remainder that doesn't fit is discarded.
+     *
+     * @param iov           The buffers to read data to
+     * @param iovcnt        The number of buffers
+     * @return The number of bytes written to the buffers, or a negative value on error.
+     */
+    int receivePacket(struct iovec* iov, size_t iovcnt, system_tick_t timeout = 0);
+#endif // HAL_USE_SOCKET_HAL_POSIX
+
     /**
      * Begin writing a packet to the given destination.
      * @param ip        The IP address of the destination peer.
@@ -242,6 +272,8 @@ public:
     int leaveMulticast(const IPAddress& ip);
 
     using Print::write;
+
+    friend class particle::SocketPoll;
 };
 
 #endif
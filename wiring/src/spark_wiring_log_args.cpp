@@ -0,0 +1,465 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_log_args.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+namespace {
+
+// Maximum length of a conversion specification, such as "%-08.3lld"
+const size_t MAX_SPEC_SIZE = 16;
+
+enum class ArgType {
+    NONE, // "%%"
+    INT,
+    LONG,
+    LONG_LONG,
+    INTMAX,
+    SIZE,
+    PTRDIFF,
+    DOUBLE,
+    LONG_DOUBLE,
+    POINTER,
+    STRING,
+    COUNT // "%n"
+};
+
+struct Spec {
+    ArgType type;
+    bool widthArg; // Width is passed as an argument ('*')
+    bool precisionArg; // Precision is passed as an argument (".*")
+    int precision; // Literal precision, or -1 if not specified
+};
+
+// Parses a conversion specification. `s` points to the character following '%'. Returns a pointer
+// to the character following the specification, or nullptr if the specification is not supported
+const char* parseSpec(const char* s, Spec* spec) {
+    const char* const begin = s;
+    spec->widthArg = false;
+    spec->precisionArg = false;
+    spec->precision = -1;
+    // Flags
+    while (*s && strchr("-+ #0", *s)) {
+        ++s;
+    }
+    // Width
+    if (*s == '*') {
+        spec->widthArg = true;
+        ++s;
+    } else {
+        while (*s >= '0' && *s <= '9') {
+            ++s;
+        }
+    }
+    // Precision
+    if (*s == '.') {
+        ++s;
+        if (*s == '*') {
+            spec->precisionArg = true;
+            ++s;
+        } else {
+            spec->precision = 0;
+            while (*s >= '0' && *s <= '9') {
+                spec->precision = spec->precision * 10 + (*s - '0');
+                ++s;
+            }
+        }
+    }
+    // Length modifier
+    enum { NONE, HH, H, L, LL, J, Z, T, LD } len = NONE;
+    switch (*s) {
+    case 'h':
+        len = (*++s == 'h') ? (++s, HH) : H;
+        break;
+    case 'l':
+        len = (*++s == 'l') ? (++s, LL) : L;
+        break;
+    case 'q':
+        len = LL;
+        ++s;
+        break;
+    case 'j':
+        len = J;
+        ++s;
+        break;
+    case 'z':
+        len = Z;
+        ++s;
+        break;
+    case 't':
+        len = T;
+        ++s;
+        break;
+    case 'L':
+        len = LD;
+        ++s;
+        break;
+    default:
+        break;
+    }
+    // Conversion
+    switch (*s) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        switch (len) {
+        case NONE:
+        case HH:
+        case H:
+            spec->type = ArgType::INT;
+            break;
+        case L:
+            spec->type = ArgType::LONG;
+            break;
+        case LL:
+            spec->type = ArgType::LONG_LONG;
+            break;
+        case J:
+            spec->type = ArgType::INTMAX;
+            break;
+        case Z:
+            spec->type = ArgType::SIZE;
+            break;
+        case T:
+            spec->type = ArgType::PTRDIFF;
+            break;
+        default:
+            return nullptr;
+        }
+        break;
+    case 'c':
+        if (len != NONE) {
+            return nullptr; // Wide characters are not supported
+        }
+        spec->type = ArgType::INT;
+        break;
+    case 's':
+        if (len != NONE) {
+            return nullptr;
+        }
+        spec->type = ArgType::STRING;
+        break;
+    case 'p':
+        spec->type = ArgType::POINTER;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec->type = (len == LD) ? ArgType::LONG_DOUBLE : ArgType::DOUBLE;
+        break;
+    case 'n':
+        spec->type = ArgType::COUNT;
+        break;
+    case '%':
+        spec->type = ArgType::NONE;
+        break;
+    default:
+        return nullptr;
+    }
+    ++s;
+    if ((size_t)(s - begin) >= MAX_SPEC_SIZE) {
+        return nullptr;
+    }
+    return s;
+}
+
+class ArgWriter {
+public:
+    ArgWriter(char* buf, size_t size) :
+            p_(buf),
+            end_(buf + size),
+            begin_(buf) {
+    }
+
+    template<typename T>
+    bool put(const T& val) {
+        return put(&val, sizeof(T));
+    }
+
+    bool put(const void* data, size_t size) {
+        if ((size_t)(end_ - p_) < size) {
+            return false;
+        }
+        memcpy(p_, data, size);
+        p_ += size;
+        return true;
+    }
+
+    size_t size() const {
+        return p_ - begin_;
+    }
+
+private:
+    char* p_;
+    char* end_;
+    char* begin_;
+};
+
+class ArgReader {
+public:
+    ArgReader(const char* args, size_t size) :
+            p_(args),
+            end_(args + size) {
+    }
+
+    template<typename T>
+    bool get(T* val) {
+        if ((size_t)(end_ - p_) < sizeof(T)) {
+            return false;
+        }
+        memcpy(val, p_, sizeof(T));
+        p_ += sizeof(T);
+        return true;
+    }
+
+    bool getString(const char** str) {
+        const size_t n = strnlen(p_, end_ - p_);
+        if (n == (size_t)(end_ - p_)) {
+            return false; // Not terminated
+        }
+        *str = p_;
+        p_ += n + 1;
+        return true;
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+class MessageWriter {
+public:
+    MessageWriter(char* buf, size_t size) :
+            buf_(buf),
+            size_(size),
+            pos_(0) {
+    }
+
+    ~MessageWriter() {
+        if (size_) {
+            buf_[(pos_ < size_) ? pos_ : size_ - 1] = '\0';
+        }
+    }
+
+    void write(const char* data, size_t size) {
+        if (pos_ < size_) {
+            const size_t n = (size < size_ - pos_) ? size : size_ - pos_;
+            memcpy(buf_ + pos_, data, n);
+        }
+        pos_ += size;
+    }
+
+    template<typename T>
+    void printf(const char* spec, T val) {
+        const int n = snprintf((pos_ < size_) ? buf_ + pos_ : nullptr, (pos_ < size_) ? size_ - pos_ : 0, spec, val);
+        if (n > 0) {
+            pos_ += n;
+        }
+    }
+
+    size_t length() const {
+        return pos_;
+    }
+
+private:
+    char* buf_;
+    size_t size_;
+    size_t pos_;
+};
+
+// Copies a conversion specification replacing '*' with the width and precision arguments
+bool makeSpec(char* dest, size_t destSize, const char* begin, const char* end, ArgReader* reader) {
+    int n = 0;
+    for (const char* s = begin; s != end; ++s) {
+        if (*s == '*') {
+            int val = 0;
+            if (!reader->get(&val)) {
+                return false;
+            }
+            if (val < 0 && s != begin && s[-1] == '.') {
+                --n; // A negative precision is taken as if it was omitted
+                continue;
+            }
+            n += snprintf(dest + n, destSize - n, "%d", val);
+        } else {
+            dest[n++] = *s;
+        }
+        if ((size_t)n >= destSize - 1) {
+            return false;
+        }
+    }
+    dest[n] = '\0';
+    return true;
+}
+
+bool formatArg(MessageWriter* writer, const char* spec, ArgType type, ArgReader* reader) {
+    switch (type) {
+    case ArgType::NONE:
+        writer->write("%", 1);
+        return true;
+    case ArgType::COUNT:
+        return true; // Ignored
+    case ArgType::INT: {
+        int val = 0;
+        return reader->get(&val) && (writer->printf(spec, val), true);
+    }
+    case ArgType::LONG: {
+        long val = 0;
+        return reader->get(&val) && (writer->printf(spec, val), true);
+    }
+    case ArgType::LONG_LONG: {
+        long long val = 0;
+        return reader->get(&val) && (writer->printf(spec, val), true);
+    }
+    case ArgType::INTMAX: {
+        intmax_t val = 0;
+        return reader->get(&val) && (writer->printf(spec, val), true);
+    }
+    case ArgType::SIZE: {
+        size_t val = 0;
+        return reader->get(&val) && (writer->printf(spec, val), true);
+    }
+    case ArgType::PTRDIFF: {
+        ptrdiff_t val = 0;
+        return reader->get(&val) && (writer->printf(spec, val), true);
+    }
+    case ArgType::DOUBLE: {
+        double val = 0;
+        return reader->get(&val) && (writer->printf(spec, val), true);
+    }
+    case ArgType::LONG_DOUBLE: {
+        long double val = 0;
+        return reader->get(&val) && (writer->printf(spec, val), true);
+    }
+    case ArgType::POINTER: {
+        void* val = nullptr;
+        return reader->get(&val) && (writer->printf(spec, val), true);
+    }
+    case ArgType::STRING: {
+        const char* val = nullptr;
+        return reader->getString(&val) && (writer->printf(spec, val), true);
+    }
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+int spark::detail::packLogArgs(char* buf, size_t size, const char* fmt, va_list args) {
+    va_list a;
+    va_copy(a, args); // Keep the caller's argument list intact
+    ArgWriter writer(buf, size);
+    bool ok = true;
+    for (const char* s = strchr(fmt, '%'); s && ok; s = strchr(s, '%')) {
+        Spec spec = {};
+        s = parseSpec(s + 1, &spec);
+        if (!s) {
+            ok = false;
+            break;
+        }
+        if (spec.widthArg) {
+            ok = writer.put(va_arg(a, int));
+        }
+        if (ok && spec.precisionArg) {
+            spec.precision = va_arg(a, int); // A negative precision is taken as if it was omitted
+            ok = writer.put(spec.precision);
+        }
+        if (!ok) {
+            break;
+        }
+        switch (spec.type) {
+        case ArgType::NONE:
+            break;
+        case ArgType::INT:
+            ok = writer.put(va_arg(a, int));
+            break;
+        case ArgType::LONG:
+            ok = writer.put(va_arg(a, long));
+            break;
+        case ArgType::LONG_LONG:
+            ok = writer.put(va_arg(a, long long));
+            break;
+        case ArgType::INTMAX:
+            ok = writer.put(va_arg(a, intmax_t));
+            break;
+        case ArgType::SIZE:
+            ok = writer.put(va_arg(a, size_t));
+            break;
+        case ArgType::PTRDIFF:
+            ok = writer.put(va_arg(a, ptrdiff_t));
+            break;
+        case ArgType::DOUBLE:
+            ok = writer.put(va_arg(a, double));
+            break;
+        case ArgType::LONG_DOUBLE:
+            ok = writer.put(va_arg(a, long double));
+            break;
+        case ArgType::POINTER:
+            ok = writer.put(va_arg(a, void*));
+            break;
+        case ArgType::STRING: {
+            const char* str = va_arg(a, const char*);
+            if (!str) {
+                str = "(null)";
+            }
+            // With a precision, the string doesn't need to be null-terminated
+            const size_t len = (spec.precision >= 0) ? strnlen(str, spec.precision) : strlen(str);
+            ok = writer.put(str, len) && writer.put('\0');
+            break;
+        }
+        case ArgType::COUNT:
+            va_arg(a, int*); // Not stored
+            break;
+        }
+    }
+    va_end(a);
+    return ok ? (int)writer.size() : -1;
+}
+
+int spark::detail::formatLogArgs(char* buf, size_t size, const char* fmt, const char* args, size_t argsSize) {
+    MessageWriter writer(buf, size);
+    ArgReader reader(args, argsSize);
+    const char* s = fmt;
+    for (;;) {
+        const char* p = strchr(s, '%');
+        if (!p) {
+            writer.write(s, strlen(s));
+            break;
+        }
+        writer.write(s, p - s);
+        Spec spec = {};
+        s = parseSpec(p + 1, &spec);
+        char specBuf[MAX_SPEC_SIZE + 24]; // Enough for two integer arguments
+        if (!s || !makeSpec(specBuf, sizeof(specBuf), p, s, &reader) ||
+                !formatArg(&writer, specBuf, spec.type, &reader)) {
+            break; // The arguments don't match the format string
+        }
+    }
+    return writer.length();
+}
@@ -21,15 +21,18 @@
 #include <cstring>
 
 #include "spark_wiring_logging.h"
+#include "spark_wiring_log_args.h"
 
 #include <algorithm>
 #include <cinttypes>
+#include <cstdio>
 #include <memory>
 
 #include "spark_wiring_usbserial.h"
 #include "spark_wiring_usartserial.h"
 
 #include "spark_wiring_interrupts.h"
+#include "timer_hal.h"
 
 // Uncomment to enable logging in interrupt handlers
 // #define LOG_FROM_ISR
@@ -345,6 +348,129 @@ const char* extractFuncName(const char *s, size_t *size) {
     return s1;
 }
 
+// Encodes a record of the binary log format with COBS and writes it to a stream
+class BinaryRecordWriter {
+public:
+    explicit BinaryRecordWriter(Print *stream) :
+            stream_(stream),
+            size_(1) { // The first byte is reserved for the block code
+    }
+
+    ~BinaryRecordWriter() {
+        flushBlock();
+        const uint8_t delim = 0;
+        stream_->write(&delim, 1);
+    }
+
+    void put(uint8_t b) {
+        if (b == 0) {
+            flushBlock();
+        } else {
+            buf_[size_++] = b;
+            if (size_ == sizeof(buf_)) {
+                flushBlock();
+            }
+        }
+    }
+
+    void write(const void *data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            put(((const uint8_t*)data)[i]);
+        }
+    }
+
+    void writeString(const char *str) {
+        write(str, strlen(str) + 1);
+    }
+
+    void writeVarint(uint32_t val) {
+        while (val >= 0x80) {
+            put((val & 0x7f) | 0x80);
+            val >>= 7;
+        }
+        put(val);
+    }
+
+    void writeUint32(uint32_t val) {
+        for (int i = 0; i < 4; ++i) {
+            put(val & 0xff);
+            val >>= 8;
+        }
+    }
+
+    // Writes the record type, level and attributes
+    void writeHeader(uint8_t type, LogLevel level, const char *category, const LogAttributes &attr) {
+        uint8_t flags = 0;
+        if (attr.has_time) {
+            flags |= 0x01;
+        }
+        if (category) {
+            flags |= 0x02;
+        }
+        if (attr.has_file) {
+            flags |= 0x04;
+        }
+        if (attr.has_line) {
+            flags |= 0x08;
+        }
+        if (attr.has_function) {
+            flags |= 0x10;
+        }
+        if (attr.has_code) {
+            flags |= 0x20;
+        }
+        if (attr.has_details) {
+            flags |= 0x40;
+        }
+        put(type);
+        put(level);
+        put(flags);
+        if (attr.has_time) {
+            writeVarint(attr.time);
+        }
+        if (category) {
+            writeUint32(hashCategory(category));
+        }
+        if (attr.has_file) {
+            writeVarint((uintptr_t)attr.file);
+        }
+        if (attr.has_line) {
+            writeVarint(attr.line);
+        }
+        if (attr.has_function) {
+            writeVarint((uintptr_t)attr.function);
+        }
+        if (attr.has_code) {
+            const int32_t code = attr.code;
+            writeVarint(((uint32_t)code << 1) ^ (uint32_t)(code >> 31)); // Zigzag encoding
+        }
+        if (attr.has_details) {
+            writeString(attr.details);
+        }
+    }
+
+    // 32-bit FNV-1a hash of the category name. Category names may be copied by the log manager,
+    // so, unlike the format strings, they can't be identified by their addresses
+    static uint32_t hashCategory(const char *category) {
+        uint32_t h = 2166136261u;
+        for (; *category; ++category) {
+            h = (h ^ (uint8_t)*category) * 16777619u;
+        }
+        return h;
+    }
+
+private:
+    Print *stream_;
+    uint8_t buf_[255];
+    size_t size_;
+
+    void flushBlock() {
+        buf_[0] = size_;
+        stream_->write(buf_, size_);
+        size_ = 1;
+    }
+};
+
 } // namespace
 
 // Default logger instance. This code is compiled as part of the wiring library which has its own
@@ -579,6 +705,31 @@ void spark::JSONStreamLogHandler::logMessage(const char *msg, LogLevel level, co
     this->stream()->write((const uint8_t*)"\r\n", 2);
 }
 
+// spark::BinaryStreamLogHandler
+void spark::BinaryStreamLogHandler::logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) {
+    BinaryRecordWriter w(stream());
+    w.writeHeader(TEXT_MESSAGE, level, category, attr);
+    if (msg) {
+        w.write(msg, strlen(msg));
+    }
+}
+
+void spark::BinaryStreamLogHandler::logMessageArgs(const char *fmt, const char *args, size_t argsSize, LogLevel level,
+        const char *category, const LogAttributes &attr) {
+    BinaryRecordWriter w(stream());
+    w.writeHeader(MESSAGE, level, category, attr);
+    w.writeVarint((uintptr_t)fmt);
+    w.write(args, argsSize);
+}
+
+void spark::BinaryStreamLogHandler::write(const char *data, size_t size) {
+    BinaryRecordWriter w(stream());
+    w.put(WRITE);
+    w.put(0); // Level
+    w.put(0); // Attribute flags
+    w.write(data, size);
+}
+
 #if Wiring_LogConfig
 
 // spark::DefaultLogHandlerFactory
@@ -594,6 +745,11 @@ LogHandler* spark::DefaultLogHandlerFactory::createHandler(const char *type, Log
             return nullptr;
         }
         return new(std::nothrow) StreamLogHandler(*stream, level, std::move(filters));
+    } else if (strcmp(type, "BinaryStreamLogHandler") == 0) {
+        if (!stream) {
+            return nullptr;
+        }
+        return new(std::nothrow) BinaryStreamLogHandler(*stream, level, std::move(filters));
     }
     return nullptr; // Unknown handler type
 }
@@ -669,15 +825,60 @@ struct spark::LogManager::FactoryHandler {
 
 #endif // Wiring_LogConfig
 
+#if PLATFORM_THREADING
+
+// spark::LogManager::AsyncRecord
+struct spark::LogManager::AsyncRecord {
+    enum Type: uint8_t {
+        MESSAGE, // Format string arguments packed with packLogArgs()
+        TEXT, // Formatted message
+        WRITE // Data passed to log_write()
+    };
+
+    LogAttributes attr;
+    int16_t level;
+    uint8_t type;
+    uint16_t categorySize; // Including the terminating null, 0 if there's no category
+    uint16_t detailsSize; // Including the terminating null, 0 if there are no details
+    uint16_t fmtSize; // Including the terminating null, 0 if there's no format string
+    uint16_t dataSize;
+    // Followed by the category name, details, format string and data
+};
+
+namespace {
+
+// Using the same priority as the application thread, as a lower priority thread would starve while
+// the application loop is busy
+const os_thread_prio_t ASYNC_THREAD_PRIORITY = OS_THREAD_PRIORITY_DEFAULT;
+const size_t ASYNC_THREAD_STACK_SIZE = OS_THREAD_STACK_SIZE_DEFAULT;
+const system_tick_t ASYNC_THREAD_WAIT_TIMEOUT = 1000;
+
+} // namespace
+
+#endif // PLATFORM_THREADING
+
 spark::LogManager::LogManager() {
 #if Wiring_LogConfig
     handlerFactory_ = DefaultLogHandlerFactory::instance();
     streamFactory_ = DefaultOutputStreamFactory::instance();
+#endif
+#if PLATFORM_THREADING
+    asyncThread_ = OS_THREAD_INVALID_HANDLE;
+    asyncSem_ = nullptr;
+    asyncEnabled_ = false;
+    asyncSignaled_ = false;
+    asyncProducers_ = 0;
+    asyncDropped_ = 0;
+    asyncDroppedTotal_ = 0;
+    asyncStop_ = false;
 #endif
     outputActive_ = false;
 }
 
 spark::LogManager::~LogManager() {
+#if PLATFORM_THREADING
+    disableAsync();
+#endif
     resetSystemCallbacks();
 #if Wiring_LogConfig
     LOG_WITH_LOCK(mutex_) {
@@ -691,17 +892,15 @@ bool spark::LogManager::addHandler(LogHandler *handler) {
         if (activeHandlers_.contains(handler) || !activeHandlers_.append(handler)) {
             return false;
         }
-        if (activeHandlers_.size() == 1) {
-            setSystemCallbacks();
-        }
+        updateSystemCallbacks();
     }
     return true;
 }
 
 void spark::LogManager::removeHandler(LogHandler *handler) {
     LOG_WITH_LOCK(mutex_) {
-        if (activeHandlers_.removeOne(handler) && activeHandlers_.isEmpty()) {
-            resetSystemCallbacks();
+        if (activeHandlers_.removeOne(handler)) {
+            updateSystemCallbacks();
         }
     }
 }
@@ -749,9 +948,7 @@ bool spark::LogManager::addFactoryHandler(const char *id, const char *handlerTyp
             factoryHandlers_.takeLast(); // Revert factoryHandlers_.append()
             return false;
         }
-        if (activeHandlers_.size() == 1) {
-            setSystemCallbacks();
-        }
+        updateSystemCallbacks();
         handler.release(); // Release scope guard pointers
         stream.release();
     }
@@ -795,9 +992,7 @@ void spark::LogManager::destroyFactoryHandler(const char *id) {
         const FactoryHandler &h = factoryHandlers_.at(i);
         if (h.id == id) {
             activeHandlers_.removeOne(h.handler);
-            if (activeHandlers_.isEmpty()) {
-                resetSystemCallbacks();
-            }
+            updateSystemCallbacks();
             handlerFactory_->destroyHandler(h.handler);
             if (h.stream) {
                 streamFactory_->destroyStream(h.stream);
@@ -811,9 +1006,7 @@ void spark::LogManager::destroyFactoryHandler(const char *id) {
 void spark::LogManager::destroyFactoryHandlers() {
     for (const FactoryHandler &h: factoryHandlers_) {
         activeHandlers_.removeOne(h.handler);
-        if (activeHandlers_.isEmpty()) {
-            resetSystemCallbacks();
-        }
+        updateSystemCallbacks();
         handlerFactory_->destroyHandler(h.handler);
         if (h.stream) {
             streamFactory_->destroyStream(h.stream);
@@ -824,52 +1017,312 @@ void spark::LogManager::destroyFactoryHandlers() {
 
 #endif // Wiring_LogConfig
 
+#if PLATFORM_THREADING
+
+bool spark::LogManager::enableAsync(size_t bufferSize) {
+    LOG_WITH_LOCK(mutex_) {
+        if (asyncEnabled_) {
+            return true;
+        }
+        if (!asyncBuf_.init(bufferSize)) {
+            return false;
+        }
+        if (os_semaphore_create(&asyncSem_, 1, 0) != 0) {
+            asyncBuf_.destroy();
+            return false;
+        }
+        asyncStop_ = false;
+        asyncSignaled_ = false;
+        if (os_thread_create(&asyncThread_, "log", ASYNC_THREAD_PRIORITY, asyncThread, this, ASYNC_THREAD_STACK_SIZE) != 0) {
+            os_semaphore_destroy(asyncSem_);
+            asyncSem_ = nullptr;
+            asyncBuf_.destroy();
+            return false;
+        }
+        asyncEnabled_ = true;
+        updateSystemCallbacks();
+    }
+    return true;
+}
+
+void spark::LogManager::disableAsync() {
+    LOG_WITH_LOCK(mutex_) {
+        if (!asyncEnabled_) {
+            return;
+        }
+        asyncEnabled_ = false;
+        updateSystemCallbacks();
+    }
+    // Wait for the producers that have seen the buffer as enabled, so that their messages are
+    // committed before the log thread makes its final pass over the buffer
+    while (asyncProducers_.load() > 0) {
+        os_thread_yield();
+    }
+    // The log thread acquires the lock to pass the remaining messages to the handlers
+    asyncStop_ = true;
+    os_semaphore_give(asyncSem_, false);
+    os_thread_join(asyncThread_);
+    os_thread_cleanup(asyncThread_);
+    asyncThread_ = OS_THREAD_INVALID_HANDLE;
+    os_semaphore_destroy(asyncSem_);
+    asyncSem_ = nullptr;
+    asyncBuf_.destroy();
+}
+
+bool spark::LogManager::isAsync() const {
+    return asyncEnabled_;
+}
+
+unsigned spark::LogManager::droppedMessageCount() const {
+    return asyncDroppedTotal_.load() + asyncDropped_.load();
+}
+
+bool spark::LogManager::enqueueAsync(uint8_t type, const char *fmt, int level, const char *category,
+        const LogAttributes *attr, const char *data, size_t size) {
+    ++asyncProducers_;
+    if (!asyncEnabled_) {
+        --asyncProducers_;
+        return false;
+    }
+    const size_t categorySize = category ? strlen(category) + 1 : 0;
+    const size_t detailsSize = (attr && attr->has_details && attr->details) ? strlen(attr->details) + 1 : 0;
+    // The format string is copied as well, as it may not outlive the call
+    const size_t fmtSize = fmt ? strlen(fmt) + 1 : 0;
+    const auto rec = (AsyncRecord*)asyncBuf_.acquire(sizeof(AsyncRecord) + categorySize + detailsSize + fmtSize + size);
+    if (rec) {
+        rec->level = level;
+        rec->type = type;
+        rec->categorySize = categorySize;
+        rec->detailsSize = detailsSize;
+        rec->fmtSize = fmtSize;
+        rec->dataSize = size;
+        memset(&rec->attr, 0, sizeof(rec->attr));
+        if (attr) {
+            memcpy(&rec->attr, attr, std::min(attr->size, sizeof(rec->attr)));
+        }
+        char *p = (char*)(rec + 1);
+        if (categorySize) {
+            memcpy(p, category, categorySize);
+            p += categorySize;
+        }
+        if (detailsSize) {
+            memcpy(p, attr->details, detailsSize);
+            p += detailsSize;
+        }
+        if (fmtSize) {
+            memcpy(p, fmt, fmtSize);
+            p += fmtSize;
+        }
+        memcpy(p, data, size);
+        asyncBuf_.commit(rec);
+        if (!asyncSignaled_.exchange(true)) {
+            os_semaphore_give(asyncSem_, false);
+        }
+    } else {
+        ++asyncDropped_;
+    }
+    --asyncProducers_;
+    return true;
+}
+
+void spark::LogManager::processAsyncRecords() {
+    char buf[LOG_MAX_STRING_LENGTH];
+    AsyncRecord *rec = nullptr;
+    while ((rec = (AsyncRecord*)asyncBuf_.peek())) {
+        const char *p = (const char*)(rec + 1);
+        const char *category = rec->categorySize ? p : nullptr;
+        p += rec->categorySize;
+        LogAttributes attr = rec->attr;
+        if (rec->detailsSize) {
+            attr.details = p;
+        }
+        p += rec->detailsSize;
+        const char *fmt = p;
+        p += rec->fmtSize;
+        if (rec->type == AsyncRecord::WRITE) {
+            processWrite(p, rec->dataSize, rec->level, category);
+        } else if (rec->type == AsyncRecord::MESSAGE) {
+            processMessageArgs(fmt, p, rec->dataSize, rec->level, category, attr);
+        } else {
+            processMessage(p, rec->level, category, attr);
+        }
+        asyncBuf_.release();
+    }
+    const unsigned dropped = asyncDropped_.exchange(0);
+    if (dropped) {
+        asyncDroppedTotal_ += dropped;
+        snprintf(buf, sizeof(buf), "%u log message(s) dropped", dropped);
+        LogAttributes attr = {};
+        attr.size = sizeof(LogAttributes);
+        LOG_ATTR_SET(attr, time, HAL_Timer_Get_Milli_Seconds());
+        processMessage(buf, LOG_LEVEL_WARN, nullptr, attr);
+    }
+}
+
+void spark::LogManager::asyncThread(void *data) {
+    const auto that = static_cast<LogManager*>(data);
+    while (!that->asyncStop_) {
+        os_semaphore_take(that->asyncSem_, ASYNC_THREAD_WAIT_TIMEOUT, false);
+        that->asyncSignaled_ = false;
+        that->processAsyncRecords();
+    }
+    that->processAsyncRecords();
+    os_thread_exit(nullptr);
+}
+
+#endif // PLATFORM_THREADING
+
 void spark::LogManager::setSystemCallbacks() {
     log_set_callbacks(logMessage, logWrite, logEnabled, nullptr);
+    // Messages are captured unformatted if they are going to be formatted asynchronously or there
+    // are handlers that accept unformatted messages
+    bool deferred = false;
+#if PLATFORM_THREADING
+    deferred = asyncEnabled_;
+#endif
+    for (int i = 0; i < activeHandlers_.size() && !deferred; ++i) {
+        deferred = activeHandlers_.at(i)->acceptsArgs();
+    }
+    log_set_deferred_callback(deferred ? logMessageDeferred : nullptr, nullptr);
 }
 
 void spark::LogManager::resetSystemCallbacks() {
     log_set_callbacks(nullptr, nullptr, nullptr, nullptr);
+#if PLATFORM_THREADING
+    log_set_deferred_callback(nullptr, nullptr);
+#endif
+}
+
+void spark::LogManager::updateSystemCallbacks() {
+    if (activeHandlers_.isEmpty()) {
+        resetSystemCallbacks();
+    } else {
+        setSystemCallbacks();
+    }
+}
+
+void spark::LogManager::processMessage(const char *msg, int level, const char *category, const LogAttributes &attr) {
+    LOG_WITH_LOCK(mutex_) {
+        // prevent re-entry
+        if (isActive()) {
+            return;
+        }
+        setActive(true);
+        for (LogHandler *handler: activeHandlers_) {
+            handler->message(msg, (LogLevel)level, category, attr);
+        }
+        setActive(false);
+    }
+}
+
+void spark::LogManager::processMessageArgs(const char *fmt, const char *args, size_t argsSize, int level,
+        const char *category, const LogAttributes &attr) {
+    LOG_WITH_LOCK(mutex_) {
+        // prevent re-entry
+        if (isActive()) {
+            return;
+        }
+        setActive(true);
+        char buf[LOG_MAX_STRING_LENGTH];
+        const char *msg = nullptr; // Formatted on demand
+        for (LogHandler *handler: activeHandlers_) {
+            if (handler->acceptsArgs()) {
+                handler->message(fmt, args, argsSize, (LogLevel)level, category, attr);
+                continue;
+            }
+            if (level < handler->level(category)) {
+                continue;
+            }
+            if (!msg) {
+                const int n = detail::formatLogArgs(buf, sizeof(buf), fmt, args, argsSize);
+                if (n > (int)sizeof(buf) - 1) {
+                    buf[sizeof(buf) - 2] = '~';
+                }
+                msg = buf;
+            }
+            handler->message(msg, (LogLevel)level, category, attr);
+        }
+        setActive(false);
+    }
+}
+
+void spark::LogManager::processWrite(const char *data, size_t size, int level, const char *category) {
+    LOG_WITH_LOCK(mutex_) {
+        // prevent re-entry
+        if (isActive()) {
+            return;
+        }
+        setActive(true);
+        for (LogHandler *handler: activeHandlers_) {
+            handler->write(data, size, (LogLevel)level, category);
+        }
+        setActive(false);
+    }
 }
 
 void spark::LogManager::logMessage(const char *msg, int level, const char *category, const LogAttributes *attr, void *reserved) {
+#ifndef LOG_FROM_ISR
+    if (HAL_IsISR()) {
+        return;
+    }
+#endif
+    instance()->processMessage(msg, level, category, *attr);
+}
+
+void spark::LogManager::logWrite(const char *data, size_t size, int level, const char *category, void *reserved) {
 #ifndef LOG_FROM_ISR
     if (HAL_IsISR()) {
         return;
     }
 #endif
     LogManager *that = instance();
-    LOG_WITH_LOCK(that->mutex_) {
-        // prevent re-entry
-        if (that->isActive()) {
-            return;
-        }
-        that->setActive(true);
-        for (LogHandler *handler: that->activeHandlers_) {
-            handler->message(msg, (LogLevel)level, category, *attr);
-        }
-        that->setActive(false);
+#if PLATFORM_THREADING
+    // Keep the order of the messages and direct output when logging asynchronously
+    if (that->asyncEnabled_ && !os_thread_is_current(that->asyncThread_) &&
+            that->enqueueAsync(AsyncRecord::WRITE, nullptr, level, category, nullptr, data, size)) {
+        return;
     }
+#endif
+    that->processWrite(data, size, level, category);
 }
 
-void spark::LogManager::logWrite(const char *data, size_t size, int level, const char *category, void *reserved) {
+void spark::LogManager::logMessageDeferred(const char *fmt, va_list args, int level, const char *category,
+        const LogAttributes *attr, void *reserved) {
 #ifndef LOG_FROM_ISR
     if (HAL_IsISR()) {
         return;
     }
 #endif
     LogManager *that = instance();
-    LOG_WITH_LOCK(that->mutex_) {
-        // prevent re-entry
-        if (that->isActive()) {
+#if PLATFORM_THREADING
+    // Messages logged on the log thread are processed synchronously. The handlers are not re-entered
+    // while they're being invoked, which prevents feedback loops
+    const bool async = !os_thread_is_current(that->asyncThread_);
+#endif
+    char buf[LOG_MAX_STRING_LENGTH];
+    const int n = detail::packLogArgs(buf, sizeof(buf), fmt, args);
+    if (n >= 0) {
+#if PLATFORM_THREADING
+        if (async && that->enqueueAsync(AsyncRecord::MESSAGE, fmt, level, category, attr, buf, n)) {
             return;
         }
-        that->setActive(true);
-        for (LogHandler *handler: that->activeHandlers_) {
-            handler->write(data, size, (LogLevel)level, category);
-        }
-        that->setActive(false);
+#endif
+        // Asynchronous logging is disabled or the message is logged on the log thread
+        that->processMessageArgs(fmt, buf, n, level, category, *attr);
+        return;
+    }
+    // The arguments don't fit into the buffer or can't be packed
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    if (len > (int)sizeof(buf) - 1) {
+        buf[sizeof(buf) - 2] = '~';
+        len = sizeof(buf) - 1;
     }
+#if PLATFORM_THREADING
+    if (async && that->enqueueAsync(AsyncRecord::TEXT, nullptr, level, category, attr, buf, len + 1)) {
+        return;
+    }
+#endif
+    that->processMessage(buf, level, category, *attr);
 }
 
 int spark::LogManager::logEnabled(int level, const char *category, void *reserved) {
@@ -85,6 +85,7 @@ int MeshPublish::Subscriptions::add_event_handler(const char *event_name, EventH
             memcpy(event_handlers[i].device_id, id, id_len);
             event_handlers[i].device_id[id_len] = 0;
             event_handlers[i].scope = scope;
+            event_handlers[i].flags = 0;
             return SYSTEM_ERROR_NONE;
         }
     }
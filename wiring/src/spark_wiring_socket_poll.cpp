@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hal_platform.h"
+
+#if HAL_USE_SOCKET_HAL_POSIX
+
+#include "spark_wiring_socket_poll.h"
+
+#include "system_error.h"
+#include "logging.h"
+
+#include <climits>
+#include <cerrno>
+
+namespace particle {
+
+SocketPoll& SocketPoll::add(const void* obj, Type type, unsigned events) {
+    for (auto& e: entries_) {
+        if (e.obj == obj) {
+            e.events = events;
+            return *this;
+        }
+    }
+    const Entry e = { obj, type, (uint8_t)events, NONE };
+    // The array of poll descriptors is allocated here so that wait() doesn't need to allocate memory
+    if (!fds_.reserve(entries_.size() + 1) || !entries_.append(e) || !fds_.resize(entries_.size())) {
+        valid_ = false;
+    }
+    return *this;
+}
+
+void SocketPoll::remove(const void* obj) {
+    for (int i = 0; i < entries_.size(); ++i) {
+        if (entries_.at(i).obj == obj) {
+            entries_.removeAt(i);
+            fds_.removeAt(i);
+            break;
+        }
+    }
+}
+
+void SocketPoll::clear() {
+    entries_.clear();
+    fds_.clear();
+    valid_ = true;
+}
+
+unsigned SocketPoll::events(const void* obj) const {
+    for (const auto& e: entries_) {
+        if (e.obj == obj) {
+            return e.revents;
+        }
+    }
+    return NONE;
+}
+
+sock_handle_t SocketPoll::handle(const Entry& entry) const {
+    switch (entry.type) {
+    case TCP_CLIENT:
+        return ((const TCPClient*)entry.obj)->d_->sock;
+    case TCP_SERVER:
+        return ((const TCPServer*)entry.obj)->_sock;
+    case UDP_SOCKET:
+        return ((const UDP*)entry.obj)->_sock;
+    default:
+        return -1;
+    }
+}
+
+int SocketPoll::wait(system_tick_t timeout) {
+    if (!valid_) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    int ready = 0;
+    for (int i = 0; i < entries_.size(); ++i) {
+        auto& e = entries_[i];
+        auto& fd = fds_[i];
+        e.revents = NONE;
+        fd.fd = handle(e);
+        fd.events = 0;
+        fd.revents = 0;
+        if (e.type == TCP_CLIENT && (e.events & READABLE)) {
+            const auto d = ((const TCPClient*)e.obj)->d_.get();
+            if (d->offset < d->total) {
+                // The client has buffered some data already
+                e.revents |= READABLE;
+            }
+        }
+        if (!socket_handle_valid(fd.fd)) {
+            // Negative descriptors are ignored by sock_poll()
+            e.revents |= CLOSED;
+        } else {
+            if (e.events & READABLE) {
+                fd.events |= POLLIN;
+            }
+            if (e.events & WRITABLE) {
+                fd.events |= POLLOUT;
+            }
+        }
+        if (e.revents) {
+            ++ready;
+        }
+    }
+    if (entries_.isEmpty()) {
+        return 0;
+    }
+    int t = 0;
+    if (!ready) {
+        t = (timeout == SOCKET_WAIT_FOREVER) ? -1 : (timeout > (system_tick_t)INT_MAX ? INT_MAX : (int)timeout);
+    }
+    const int r = sock_poll(fds_.data(), fds_.size(), t);
+    if (r < 0) {
+        if (errno == EINTR) {
+            return ready;
+        }
+        LOG(ERROR, "poll error = %d", errno);
+        return SYSTEM_ERROR_IO;
+    }
+    if (r == 0) {
+        return ready;
+    }
+    ready = 0;
+    for (int i = 0; i < entries_.size(); ++i) {
+        auto& e = entries_[i];
+        const auto& fd = fds_.at(i);
+        if (fd.revents & POLLIN) {
+            e.revents |= READABLE;
+        }
+        if (fd.revents & POLLOUT) {
+            e.revents |= WRITABLE;
+        }
+        if (fd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            e.revents |= CLOSED;
+        }
+        if (e.revents) {
+            ++ready;
+        }
+    }
+    return ready;
+}
+
+} // namespace particle
+
+#endif // HAL_USE_SOCKET_HAL_POSIX
@@ -302,6 +302,52 @@ int UDP::receivePacket(uint8_t* buffer, size_t size, system_tick_t timeout) {
     return ret;
 }
 
+int UDP::sendPacket(const struct iovec* iov, size_t iovcnt, IPAddress remoteIP, uint16_t port) {
+    LOG_DEBUG(TRACE, "sendPacket %d buffers, %s#%d", iovcnt, remoteIP.toString().c_str(), port);
+    sockaddr_storage s = {};
+    detail::ipAddressPortToSockaddr(remoteIP, port, (struct sockaddr*)&s);
+    if (s.ss_family == AF_UNSPEC) {
+        return -1;
+    }
+
+    struct msghdr msg = {};
+    msg.msg_name = &s;
+    msg.msg_namelen = sizeof(s);
+    msg.msg_iov = const_cast<struct iovec*>(iov);
+    msg.msg_iovlen = iovcnt;
+    return sock_sendmsg(_sock, &msg, 0);
+}
+
+int UDP::receivePacket(struct iovec* iov, size_t iovcnt, system_tick_t timeout) {
+    int ret = -1;
+    if (isOpen(_sock) && iov) {
+        sockaddr_storage saddr = {};
+        int flags = 0;
+        if (timeout == 0) {
+            flags = MSG_DONTWAIT;
+        } else {
+            struct timeval tv = {};
+            tv.tv_sec = timeout / 1000;
+            tv.tv_usec = (timeout % 1000) * 1000;
+            ret = sock_setsockopt(_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            if (ret) {
+                return ret;
+            }
+        }
+        struct msghdr msg = {};
+        msg.msg_name = &saddr;
+        msg.msg_namelen = sizeof(saddr);
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ret = sock_recvmsg(_sock, &msg, flags);
+        if (ret >= 0) {
+            detail::sockaddrToIpAddressPort((const struct sockaddr*)&saddr, _remoteIP, &_remotePort);
+            LOG_DEBUG(TRACE, "received %d bytes from %s#%d", ret, _remoteIP.toString().c_str(), _remotePort);
+        }
+    }
+    return ret;
+}
+
 int UDP::read() {
     return available() ? _buffer[_offset++] : -1;
 }